@@ -0,0 +1,136 @@
+#include "atomic_ops.h"
+
+/* Notes:
+
+Many sections only protect a counter increment or a flag update. These
+functions do the same without masking on ARMv7-M/ARMv8-M: the value is read
+with LDREX, updated, and written back with STREX, which fails (and the update
+is retried) if an exception happened in between. On ARMv6-M, which has no
+exclusive accesses, the update is done with PRIMASK set for the 2 or 3
+instructions it takes.
+
+The read-modify-write functions are sequentially consistent (DMB before and
+after, the same mapping as C11 atomics on ARMv7-M), load is an acquire and
+store a release.
+
+Each operation exists for 8, 16 and 32-bit values:
+	- ATOMIC_LoadAcquireN(ptr)
+	- ATOMIC_StoreReleaseN(ptr, value)
+	- ATOMIC_ExchangeN(ptr, value)                  returns the old value
+	- ATOMIC_CompareExchangeN(ptr, &expected, desired)
+	                                                returns true if *ptr was expected,
+	                                                otherwise expected gets *ptr
+	- ATOMIC_FetchAddN / FetchSubN / FetchOrN / FetchAndN(ptr, value)
+	                                                returns the old value
+ATOMIC_ExchangePtr and ATOMIC_CompareExchangePtr do the same on a pointer
+stored as uintptr_t.
+
+For example, instead of THREAD_SAFE_SECTION(counter++;):
+
+ATOMIC_FetchAdd32(&counter, 1u);
+
+*/
+
+#if (__CORTEX_M < 3) && defined(ATOMIC_PROVIDE_LIBATOMIC)
+
+/* Notes:
+
+On ARMv6-M the compiler turns the <stdatomic.h> read-modify-write operations
+into calls to __atomic_*_N functions, normally provided by libatomic, which is
+neither part of newlib nor interrupt-safe. With ATOMIC_PROVIDE_LIBATOMIC
+defined, they are provided here on top of the PRIMASK fallback of
+atomic_ops.h, so C11 atomics can be used from ISRs and mixed with the ATOMIC_
+functions. Load, store, exchange, compare-exchange, and fetch_<op> and
+<op>_fetch for add, sub, and, or, xor and nand are provided, on 1, 2 and 4
+bytes. The memory model arguments are ignored: disabling interrupts is
+always sequentially consistent on a single core.
+
+*/
+
+/* GCC declares these names as builtins with their own prototypes (the
+ * compare-exchange one with a weak argument that the library call does
+ * not pass): the definitions follow the libatomic ABI instead. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wbuiltin-declaration-mismatch"
+
+/* No ATOMIC_ function for these, only needed by the compiler calls */
+ATOMIC_DEFINE_RMW(FetchXor,  8,  oldValue ^ value)
+ATOMIC_DEFINE_RMW(FetchXor,  16, oldValue ^ value)
+ATOMIC_DEFINE_RMW(FetchXor,  32, oldValue ^ value)
+ATOMIC_DEFINE_RMW(FetchNand, 8,  ~(oldValue & value))
+ATOMIC_DEFINE_RMW(FetchNand, 16, ~(oldValue & value))
+ATOMIC_DEFINE_RMW(FetchNand, 32, ~(oldValue & value))
+
+#define ATOMIC_LIBATOMIC_exchange(bits, ptr, value)   ATOMIC_Exchange##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_add(bits, ptr, value)  ATOMIC_FetchAdd##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_sub(bits, ptr, value)  ATOMIC_FetchSub##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_or(bits, ptr, value)   ATOMIC_FetchOr##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_and(bits, ptr, value)  ATOMIC_FetchAnd##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_xor(bits, ptr, value)  ATOMIC_FetchXor##bits((ptr), (value))
+#define ATOMIC_LIBATOMIC_fetch_nand(bits, ptr, value) ATOMIC_FetchNand##bits((ptr), (value))
+
+/* __atomic_fetch_<op>_N: returns the old value */
+#define ATOMIC_DEFINE_LIBATOMIC_RMW(name, size, bits)                                  \
+uint##bits##_t __atomic_##name##_##size(volatile void *mem, uint##bits##_t value,      \
+                                        int model)                                     \
+{                                                                                      \
+  (void)model;                                                                         \
+  return ATOMIC_LIBATOMIC_##name(bits, (volatile uint##bits##_t*)mem, value);          \
+}
+
+/* __atomic_<op>_fetch_N: returns the new value (a += x on an _Atomic) */
+#define ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(op, size, bits, newValue)                     \
+uint##bits##_t __atomic_##op##_fetch_##size(volatile void *mem, uint##bits##_t value,  \
+                                            int model)                                 \
+{                                                                                      \
+  uint##bits##_t oldValue;                                                             \
+                                                                                       \
+  (void)model;                                                                         \
+  oldValue = ATOMIC_LIBATOMIC_fetch_##op(bits, (volatile uint##bits##_t*)mem, value);  \
+                                                                                       \
+  return (uint##bits##_t)(newValue);                                                   \
+}
+
+#define ATOMIC_DEFINE_LIBATOMIC(size, bits)                                            \
+uint##bits##_t __atomic_load_##size(const volatile void *mem, int model)              \
+{                                                                                      \
+  (void)model;                                                                         \
+  return ATOMIC_LoadAcquire##bits((const volatile uint##bits##_t*)mem);                \
+}                                                                                      \
+                                                                                       \
+void __atomic_store_##size(volatile void *mem, uint##bits##_t value, int model)        \
+{                                                                                      \
+  (void)model;                                                                         \
+  ATOMIC_StoreRelease##bits((volatile uint##bits##_t*)mem, value);                     \
+}                                                                                      \
+                                                                                       \
+bool __atomic_compare_exchange_##size(volatile void *mem, void *expected,              \
+                                      uint##bits##_t desired, int success, int failure) \
+{                                                                                      \
+  (void)success;                                                                       \
+  (void)failure;                                                                       \
+  return ATOMIC_CompareExchange##bits((volatile uint##bits##_t*)mem,                   \
+                                      (uint##bits##_t*)expected, desired);             \
+}                                                                                      \
+                                                                                       \
+ATOMIC_DEFINE_LIBATOMIC_RMW(exchange,   size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_add,  size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_sub,  size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_or,   size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_and,  size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_xor,  size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_RMW(fetch_nand, size, bits)                                    \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(add,  size, bits, oldValue + value)                   \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(sub,  size, bits, oldValue - value)                   \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(or,   size, bits, oldValue | value)                   \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(and,  size, bits, oldValue & value)                   \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(xor,  size, bits, oldValue ^ value)                   \
+ATOMIC_DEFINE_LIBATOMIC_OP_FETCH(nand, size, bits, ~(oldValue & value))
+
+ATOMIC_DEFINE_LIBATOMIC(1, 8)
+ATOMIC_DEFINE_LIBATOMIC(2, 16)
+ATOMIC_DEFINE_LIBATOMIC(4, 32)
+
+#pragma GCC diagnostic pop
+
+#endif
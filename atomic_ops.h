@@ -0,0 +1,208 @@
+#ifndef ATOMIC_OPS_H
+#define ATOMIC_OPS_H
+
+#include "interrupt_handling.h"
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) \
+    && !defined(__STDC_NO_ATOMICS__) && !defined(__cplusplus)
+#include <stdatomic.h>
+
+/* The ATOMIC_ functions and <stdatomic.h> can be used on the same object:
+ * both are LDREX/STREX on ARMv7-M, and on ARMv6-M the __atomic_* functions
+ * the compiler calls are provided by atomic_ops.c (ATOMIC_PROVIDE_LIBATOMIC). */
+_Static_assert(sizeof(atomic_uint_least32_t) == sizeof(uint32_t), "_Atomic uint32_t must be a plain word");
+_Static_assert(sizeof(atomic_uint_least16_t) == sizeof(uint16_t), "_Atomic uint16_t must be a plain halfword");
+_Static_assert(sizeof(atomic_uint_least8_t)  == sizeof(uint8_t),  "_Atomic uint8_t must be a plain byte");
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (__CORTEX_M >= 3)
+
+#define ATOMIC_LDREX8(ptr)            __LDREXB(ptr)
+#define ATOMIC_LDREX16(ptr)           __LDREXH(ptr)
+#define ATOMIC_LDREX32(ptr)           __LDREXW(ptr)
+#define ATOMIC_STREX8(value, ptr)     __STREXB((value), (ptr))
+#define ATOMIC_STREX16(value, ptr)    __STREXH((value), (ptr))
+#define ATOMIC_STREX32(value, ptr)    __STREXW((value), (ptr))
+
+/* oldValue = *ptr; *ptr = newValue; as one exclusive access */
+#define ATOMIC_UPDATE(bits, ptr, oldValue, newValue)                   \
+  __DMB();                                                             \
+  do                                                                   \
+  {                                                                    \
+    (oldValue) = ATOMIC_LDREX##bits(ptr);                              \
+  } while (ATOMIC_STREX##bits((newValue), (ptr)) != 0u);               \
+  __DMB()
+
+#define ATOMIC_DEFINE_COMPARE_EXCHANGE(bits)                                           \
+__STATIC_FORCEINLINE bool ATOMIC_CompareExchange##bits(volatile uint##bits##_t *ptr,   \
+                                                       uint##bits##_t *expected,       \
+                                                       uint##bits##_t desired)         \
+{                                                                                      \
+  uint##bits##_t current;                                                              \
+  bool           isExchanged = false;                                                  \
+                                                                                       \
+  __DMB();                                                                             \
+  for (;;)                                                                             \
+  {                                                                                    \
+    current = ATOMIC_LDREX##bits(ptr);                                                 \
+    if (current != *expected)                                                          \
+    {                                                                                  \
+      __CLREX();                                                                       \
+      *expected = current;                                                             \
+      break;                                                                           \
+    }                                                                                  \
+    if (ATOMIC_STREX##bits(desired, ptr) == 0u)                                        \
+    {                                                                                  \
+      isExchanged = true;                                                              \
+      break;                                                                           \
+    }                                                                                  \
+  }                                                                                    \
+  __DMB();                                                                             \
+                                                                                       \
+  return isExchanged;                                                                  \
+}
+
+#else
+
+/* oldValue = *ptr; *ptr = newValue; with interrupts disabled */
+#define ATOMIC_UPDATE(bits, ptr, oldValue, newValue)                   \
+  do                                                                   \
+  {                                                                    \
+    uint32_t primask = __get_PRIMASK();                                \
+    __disable_irq();                                                   \
+    (oldValue) = *(ptr);                                               \
+    *(ptr)     = (newValue);                                           \
+    __set_PRIMASK(primask);                                            \
+  } while (0)
+
+#define ATOMIC_DEFINE_COMPARE_EXCHANGE(bits)                                           \
+__STATIC_FORCEINLINE bool ATOMIC_CompareExchange##bits(volatile uint##bits##_t *ptr,   \
+                                                       uint##bits##_t *expected,       \
+                                                       uint##bits##_t desired)         \
+{                                                                                      \
+  uint##bits##_t current;                                                              \
+  bool           isExchanged = false;                                                  \
+  uint32_t       primask     = __get_PRIMASK();                                        \
+                                                                                       \
+  __disable_irq();                                                                     \
+  current = *ptr;                                                                      \
+  if (current == *expected)                                                            \
+  {                                                                                    \
+    *ptr        = desired;                                                             \
+    isExchanged = true;                                                                \
+  }                                                                                    \
+  __set_PRIMASK(primask);                                                              \
+                                                                                       \
+  if (!isExchanged)                                                                    \
+  {                                                                                    \
+    *expected = current;                                                               \
+  }                                                                                    \
+                                                                                       \
+  return isExchanged;                                                                  \
+}
+
+#endif
+
+#define ATOMIC_DEFINE_RMW(name, bits, newValue)                                        \
+__STATIC_FORCEINLINE uint##bits##_t ATOMIC_##name##bits(volatile uint##bits##_t *ptr,  \
+                                                        uint##bits##_t value)          \
+{                                                                                      \
+  uint##bits##_t oldValue;                                                             \
+                                                                                       \
+  ATOMIC_UPDATE(bits, ptr, oldValue, (uint##bits##_t)(newValue));                      \
+                                                                                       \
+  return oldValue;                                                                     \
+}
+
+#define ATOMIC_DEFINE_LOAD_STORE(bits)                                                 \
+__STATIC_FORCEINLINE uint##bits##_t ATOMIC_LoadAcquire##bits(const volatile uint##bits##_t *ptr) \
+{                                                                                      \
+  uint##bits##_t value = *ptr;                                                         \
+                                                                                       \
+  __DMB();                                                                             \
+                                                                                       \
+  return value;                                                                        \
+}                                                                                      \
+                                                                                       \
+__STATIC_FORCEINLINE void ATOMIC_StoreRelease##bits(volatile uint##bits##_t *ptr,      \
+                                                    uint##bits##_t value)              \
+{                                                                                      \
+  __DMB();                                                                             \
+  *ptr = value;                                                                        \
+}
+
+#define ATOMIC_DEFINE_ALL(bits)                                  \
+  ATOMIC_DEFINE_LOAD_STORE(bits)                                 \
+  ATOMIC_DEFINE_COMPARE_EXCHANGE(bits)                           \
+  ATOMIC_DEFINE_RMW(Exchange, bits, value)                       \
+  ATOMIC_DEFINE_RMW(FetchAdd, bits, oldValue + value)            \
+  ATOMIC_DEFINE_RMW(FetchSub, bits, oldValue - value)            \
+  ATOMIC_DEFINE_RMW(FetchOr,  bits, oldValue | value)            \
+  ATOMIC_DEFINE_RMW(FetchAnd, bits, oldValue & value)
+
+ATOMIC_DEFINE_ALL(8)
+ATOMIC_DEFINE_ALL(16)
+ATOMIC_DEFINE_ALL(32)
+
+/* Pointers, stored as uintptr_t. They are 32-bit on Cortex-M and use the
+ * 32-bit operations. Wider ones (the host emulation of tools/host) are
+ * updated with interrupts disabled, as on ARMv6-M. */
+#if (UINTPTR_MAX == UINT32_MAX)
+__STATIC_FORCEINLINE uintptr_t ATOMIC_ExchangePtr(volatile uintptr_t *ptr, uintptr_t value)
+{
+  return (uintptr_t)ATOMIC_Exchange32((volatile uint32_t*)ptr, (uint32_t)value);
+}
+
+__STATIC_FORCEINLINE bool ATOMIC_CompareExchangePtr(volatile uintptr_t *ptr, uintptr_t *expected,
+                                                    uintptr_t desired)
+{
+  return ATOMIC_CompareExchange32((volatile uint32_t*)ptr, (uint32_t*)expected, (uint32_t)desired);
+}
+#else
+__STATIC_FORCEINLINE uintptr_t ATOMIC_ExchangePtr(volatile uintptr_t *ptr, uintptr_t value)
+{
+  uintptr_t oldValue;
+  uint32_t  primask = __get_PRIMASK();
+
+  __disable_irq();
+  oldValue = *ptr;
+  *ptr     = value;
+  __set_PRIMASK(primask);
+
+  return oldValue;
+}
+
+__STATIC_FORCEINLINE bool ATOMIC_CompareExchangePtr(volatile uintptr_t *ptr, uintptr_t *expected,
+                                                    uintptr_t desired)
+{
+  uintptr_t current;
+  bool      isExchanged = false;
+  uint32_t  primask     = __get_PRIMASK();
+
+  __disable_irq();
+  current = *ptr;
+  if (current == *expected)
+  {
+    *ptr        = desired;
+    isExchanged = true;
+  }
+  __set_PRIMASK(primask);
+
+  if (!isExchanged)
+  {
+    *expected = current;
+  }
+
+  return isExchanged;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATOMIC_OPS_H */
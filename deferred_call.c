@@ -0,0 +1,237 @@
+#include "deferred_call.h"
+#include "atomic_ops.h"
+
+/* Lowest priority the NVIC can encode, PendSV must never preempt an ISR */
+#define DPC_PENDSV_PRIORITY        ((1UL << __NVIC_PRIO_BITS) - 1UL)
+
+/* Items posted and not yet taken by the PendSV handler, most recent first,
+ * as a uintptr_t for the pointer-sized ATOMIC_ functions */
+INTERRUPT_FAST_DATA static volatile uintptr_t dpcHead = 0u;
+
+#if defined(DPC_ENABLE_STATISTICS)
+static DPC_Statistics_t dpcStats = {0};
+#endif
+
+/* Notes:
+
+A deferred procedure call (DPC) moves the slow part of an interrupt handler to
+the PendSV exception, which runs at the lowest priority once every ISR has
+returned.
+
+Posting is lock-free on ARMv7-M: the item is marked as queued and pushed on a
+singly linked list with the ATOMIC_ functions (LDREX/STREX), so a post never
+masks interrupts and can be done from any priority (except NMI/HardFault,
+which must not be preempted by PendSV work anyway). The PendSV handler takes
+the whole list in one exchange and runs it in posting order, then looks again
+for items posted meanwhile.
+
+Posting an item that is already queued does nothing: the pending run will see
+the latest state anyway. The flag is cleared right before the function runs,
+so a post that happens while the function is running leads to one more run.
+
+ARMv6-M has no exclusive accesses, the few instructions that update the list
+then run with PRIMASK set (see atomic_ops.h).
+
+For example:
+
+static void UART_ProcessRx(void *arg);
+static DPC_DECLARE_ITEM(uartRxDpc, UART_ProcessRx, &uartRxBuffer);
+
+void USART1_IRQHandler(void)
+{
+    // Read the data register, clear the flags...
+    DPC_Post(&uartRxDpc);
+}
+
+With DPC_ENABLE_STATISTICS defined (and IRQ_EnableCycleCounter called), the
+handler records the post-to-run latency of every item and the cycles spent in
+the deferred functions, i.e. the time that no longer runs in ISRs.
+
+*/
+
+/* Push an item on the list */
+__STATIC_FORCEINLINE void DPC_Push(DPC_Item_t *item)
+{
+  uintptr_t head = dpcHead;
+
+  do
+  {
+    item->next = (DPC_Item_t*)head;
+  } while (!ATOMIC_CompareExchangePtr(&dpcHead, &head, (uintptr_t)item));
+}
+
+/**
+	\brief      		 Initialize the deferred call facility.
+	\details    		 Set PendSV to the lowest priority and optionally install
+									 DPC_PendSVHandler as its handler.
+	\param [in]      installHandler: true to install the handler through NVIC_SetIRQnHandler
+									 (the vector table must be in RAM, see NVIC_RelocateVectorTableToRam),
+									 false if PendSV_Handler calls DPC_PendSVHandler itself.
+	\note       		 PendSV cannot be shared with an RTOS that uses it for context switching.
+ */
+void DPC_Init(bool installHandler)
+{
+  NVIC_SetPriority(PendSV_IRQn, DPC_PENDSV_PRIORITY);
+
+  if (installHandler)
+  {
+    NVIC_SetIRQnHandler(PendSV_IRQn, (void*)DPC_PendSVHandler);
+  }
+
+#if defined(DPC_ENABLE_STATISTICS)
+  IRQ_EnableCycleCounter();
+#endif
+}
+
+/**
+	\brief      		 Initialize a deferred call item.
+	\param [out]     item:     The item to initialize.
+	\param [in]      function: The function to run from PendSV.
+	\param [in]      arg:      The argument given to the function.
+	\note       		 The item must not be queued.
+ */
+void DPC_InitItem(DPC_Item_t *item, DPC_Function_t function, void *arg)
+{
+  item->function = function;
+  item->arg      = arg;
+  item->next     = NULL;
+  item->isQueued = 0u;
+}
+
+/**
+	\brief      		 Post a deferred call.
+	\details    		 Queue the item and pend PendSV. If the item is already queued,
+									 the post is coalesced with the pending one.
+	\param [in, out] item: The item to run.
+	\return          true if the item has been queued, false if it was already queued.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE bool DPC_Post(DPC_Item_t *item)
+{
+  if (ATOMIC_Exchange32(&item->isQueued, 1u) != 0u)
+  {
+#if defined(DPC_ENABLE_STATISTICS)
+    ATOMIC_FetchAdd32(&dpcStats.numOfCoalescedPosts, 1u);
+#endif
+    return false;
+  }
+
+#if defined(DPC_ENABLE_STATISTICS)
+  item->postCycles = IRQ_GetCycleCount();
+  ATOMIC_FetchAdd32(&dpcStats.numOfPosts, 1u);
+#endif
+
+  DPC_Push(item);
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+
+  return true;
+}
+
+/**
+	\brief      		 PendSV handler running the deferred calls.
+	\details    		 Take all the queued items at once and run them in posting order,
+									 until no item is left.
+	\note       		 Must run at the lowest priority (see DPC_Init).
+ */
+INTERRUPT_FAST_CODE void DPC_PendSVHandler(void)
+{
+  DPC_Item_t *batch;
+  DPC_Item_t *item;
+  DPC_Item_t *next;
+#if defined(DPC_ENABLE_STATISTICS)
+  uint32_t    batchSize;
+  uint32_t    startCycles;
+#endif
+
+  while ((batch = (DPC_Item_t*)ATOMIC_ExchangePtr(&dpcHead, 0u)) != NULL)
+  {
+    /* The list is in LIFO order, reverse it to run the items in posting order */
+    item  = batch;
+    batch = NULL;
+    while (item != NULL)
+    {
+      next       = item->next;
+      item->next = batch;
+      batch      = item;
+      item       = next;
+    }
+
+#if defined(DPC_ENABLE_STATISTICS)
+    batchSize = 0u;
+#endif
+    for (item = batch; item != NULL; item = next)
+    {
+      next = item->next;
+
+#if defined(DPC_ENABLE_STATISTICS)
+      startCycles = IRQ_GetCycleCount();
+      if ((startCycles - item->postCycles) > dpcStats.maxLatencyCycles)
+      {
+        dpcStats.maxLatencyCycles = startCycles - item->postCycles;
+      }
+      dpcStats.totalLatencyCycles += startCycles - item->postCycles;
+#endif
+
+      /* From here the item can be posted again, even by the function itself */
+      item->isQueued = 0u;
+      __DMB();
+      item->function(item->arg);
+
+#if defined(DPC_ENABLE_STATISTICS)
+      dpcStats.totalRunCycles += IRQ_GetCycleCount() - startCycles;
+      dpcStats.numOfRuns++;
+      batchSize++;
+#endif
+    }
+
+#if defined(DPC_ENABLE_STATISTICS)
+    if (batchSize > dpcStats.maxBatchSize)
+    {
+      dpcStats.maxBatchSize = batchSize;
+    }
+#endif
+  }
+}
+
+/**
+	\brief      		 Whether an item is waiting to run.
+	\param [in]      item: The item to check.
+	\return          true if the item is queued.
+ */
+bool DPC_IsQueued(const DPC_Item_t *item)
+{
+  return item->isQueued != 0u;
+}
+
+/**
+	\brief      		 Get the deferred call statistics.
+	\details    		 Copy the counters collected since the last reset. All the counters
+									 are 0 when DPC_ENABLE_STATISTICS is not defined.
+	\param [out]     stats: The statistics.
+	\note       		 totalRunCycles is the time moved out of the posting ISRs,
+									 totalLatencyCycles / numOfRuns is the mean post-to-run latency.
+ */
+void DPC_GetStatistics(DPC_Statistics_t *stats)
+{
+#if defined(DPC_ENABLE_STATISTICS)
+  NO_INTERRUPTS_SECTION
+  (
+    *stats = dpcStats;
+  )
+#else
+  *stats = (DPC_Statistics_t){0};
+#endif
+}
+
+/**
+	\brief      		 Reset the deferred call statistics.
+ */
+void DPC_ResetStatistics(void)
+{
+#if defined(DPC_ENABLE_STATISTICS)
+  NO_INTERRUPTS_SECTION
+  (
+    dpcStats = (DPC_Statistics_t){0};
+  )
+#endif
+}
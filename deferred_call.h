@@ -0,0 +1,50 @@
+#ifndef DEFERRED_CALL_H
+#define DEFERRED_CALL_H
+
+#include "interrupt_handling.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*DPC_Function_t)(void *arg);
+
+/* A deferred call. Items are owned by the caller (usually static) and are
+ * linked into the queue in place, so posting never allocates. */
+typedef struct DPC_Item
+{
+  DPC_Function_t    function;
+  void             *arg;
+  struct DPC_Item  *next;
+  volatile uint32_t isQueued;
+#if defined(DPC_ENABLE_STATISTICS)
+  uint32_t          postCycles;
+#endif
+} DPC_Item_t;
+
+typedef struct
+{
+  uint32_t numOfPosts;
+  uint32_t numOfCoalescedPosts;
+  uint32_t numOfRuns;
+  uint32_t maxBatchSize;
+  uint32_t maxLatencyCycles;
+  uint32_t totalLatencyCycles;
+  uint32_t totalRunCycles;
+} DPC_Statistics_t;
+
+#define DPC_DECLARE_ITEM(name, fn, fnArg)  DPC_Item_t name = { (fn), (fnArg), NULL, 0u }
+
+void DPC_Init(bool installHandler);
+void DPC_InitItem(DPC_Item_t *item, DPC_Function_t function, void *arg);
+INTERRUPT_FAST_CODE bool DPC_Post(DPC_Item_t *item);
+INTERRUPT_FAST_CODE void DPC_PendSVHandler(void);
+bool DPC_IsQueued(const DPC_Item_t *item);
+void DPC_GetStatistics(DPC_Statistics_t *stats);
+void DPC_ResetStatistics(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFERRED_CALL_H */
@@ -0,0 +1,197 @@
+#include "event_flags.h"
+#include "atomic_ops.h"
+
+#if (EVENT_USE_BITBAND)
+/* SRAM region covered by the bit-band alias */
+#define BITBAND_SRAM_BASE          0x20000000UL
+#define BITBAND_SRAM_SIZE          0x00100000UL
+#define BITBAND_SRAM_ALIAS_BASE    0x22000000UL
+
+/* Whether the input address is in the bit-band SRAM region */
+#define IS_BITBAND_SRAM(addr)      (((uint32_t)(addr) - BITBAND_SRAM_BASE) < BITBAND_SRAM_SIZE)
+/* Alias word of a bit of the bit-band SRAM region */
+#define BITBAND_SRAM_ALIAS(addr, bit) \
+  ((volatile uint32_t*)(BITBAND_SRAM_ALIAS_BASE                       \
+                        + (((uint32_t)(addr) - BITBAND_SRAM_BASE) << 5) \
+                        + ((uint32_t)(bit) << 2)))
+#endif
+
+/* Wake up EVENT_Wait after a flag is set, see the notes below */
+#if defined(EVENT_USE_WFE)
+#define EVENT_SIGNAL()             __SEV()
+#else
+#define EVENT_SIGNAL()
+#endif
+
+/* Notes:
+
+An event flag group is a 32-bit word of flags set by ISRs and waited for by
+thread mode, replacing NO_INTERRUPTS_SECTION(flags |= bit;).
+
+On Cortex-M3/M4, a group placed in the first MB of SRAM (0x20000000, where
+.bss and .data are on STM32F4, but not CCMRAM) is updated through its bit-band
+alias: setting or clearing one flag is one store to the alias word, which the
+bus turns into an atomic read-modify-write. A group outside of the region,
+and every group on Cortex-M0 (no exclusive accesses: PRIMASK) and Cortex-M7
+(no bit-banding: LDREX/STREX), uses the atomic functions instead. Masks of
+several flags always use the atomic functions.
+
+Waiting is done in thread mode, for any (EVENT_WAIT_ANY) or all
+(EVENT_WAIT_ALL) of the flags of a mask. With EVENT_CLEAR_ON_EXIT, the flags
+that satisfied the wait are cleared atomically, so flags set meanwhile by an
+ISR are not lost.
+
+With EVENT_USE_WFE defined, EVENT_Wait sleeps with WFE between checks and
+every set executes SEV. SEV matters when the ISR runs between the last check
+and the WFE: the event register is then set and the WFE returns immediately
+instead of sleeping until the next interrupt.
+
+*/
+
+/**
+	\brief      		 Initialize an event flag group.
+	\param [out]     group: The group, with all flags cleared.
+ */
+void EVENT_InitGroup(EVENT_Group_t *group)
+{
+  group->flags = 0u;
+}
+
+/**
+	\brief      		 Set a flag.
+	\param [in, out] group:     The group.
+	\param [in]      flagIndex: Index of the flag, below EVENT_MAX_FLAGS.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void EVENT_SetFlag(EVENT_Group_t *group, uint8_t flagIndex)
+{
+  /* Past the word, the shift is undefined and the bit-band alias hits the next word */
+  ASSERT(flagIndex < EVENT_MAX_FLAGS);
+
+#if (EVENT_USE_BITBAND)
+  if (IS_BITBAND_SRAM(&group->flags))
+  {
+    *BITBAND_SRAM_ALIAS(&group->flags, flagIndex) = 1u;
+  }
+  else
+#endif
+  {
+    ATOMIC_FetchOr32(&group->flags, 1UL << flagIndex);
+  }
+
+  EVENT_SIGNAL();
+}
+
+/**
+	\brief      		 Clear a flag.
+	\param [in, out] group:     The group.
+	\param [in]      flagIndex: Index of the flag, below EVENT_MAX_FLAGS.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void EVENT_ClearFlag(EVENT_Group_t *group, uint8_t flagIndex)
+{
+  ASSERT(flagIndex < EVENT_MAX_FLAGS);
+
+#if (EVENT_USE_BITBAND)
+  if (IS_BITBAND_SRAM(&group->flags))
+  {
+    *BITBAND_SRAM_ALIAS(&group->flags, flagIndex) = 0u;
+  }
+  else
+#endif
+  {
+    ATOMIC_FetchAnd32(&group->flags, ~(1UL << flagIndex));
+  }
+}
+
+/**
+	\brief      		 Set several flags at once.
+	\param [in, out] group:    The group.
+	\param [in]      flagMask: The flags to set.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void EVENT_SetFlags(EVENT_Group_t *group, uint32_t flagMask)
+{
+  ATOMIC_FetchOr32(&group->flags, flagMask);
+  EVENT_SIGNAL();
+}
+
+/**
+	\brief      		 Clear several flags at once.
+	\param [in, out] group:    The group.
+	\param [in]      flagMask: The flags to clear.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void EVENT_ClearFlags(EVENT_Group_t *group, uint32_t flagMask)
+{
+  ATOMIC_FetchAnd32(&group->flags, ~flagMask);
+}
+
+/**
+	\brief      		 Get the flags of a group.
+	\param [in]      group: The group.
+	\return          The current flags.
+ */
+uint32_t EVENT_GetFlags(const EVENT_Group_t *group)
+{
+  return ATOMIC_LoadAcquire32(&group->flags);
+}
+
+/**
+	\brief      		 Check the flags of a group without waiting.
+	\param [in, out] group:    The group.
+	\param [in]      flagMask: The flags to check.
+	\param [in]      options:  EVENT_WAIT_ANY or EVENT_WAIT_ALL, optionally with
+									 EVENT_CLEAR_ON_EXIT.
+	\return          The flags of the mask that are set if the condition is met, 0 otherwise.
+ */
+uint32_t EVENT_Check(EVENT_Group_t *group, uint32_t flagMask, uint32_t options)
+{
+  uint32_t setFlags = ATOMIC_LoadAcquire32(&group->flags) & flagMask;
+  bool     isMet;
+
+  if ((options & EVENT_WAIT_ALL) != 0u)
+  {
+    isMet = (setFlags == flagMask);
+  }
+  else
+  {
+    isMet = (setFlags != 0u);
+  }
+
+  if (!isMet)
+  {
+    return 0u;
+  }
+
+  if ((options & EVENT_CLEAR_ON_EXIT) != 0u)
+  {
+    /* Only the flags seen as set are cleared, the ones set since then stay */
+    ATOMIC_FetchAnd32(&group->flags, ~setFlags);
+  }
+
+  return setFlags;
+}
+
+/**
+	\brief      		 Wait for the flags of a group.
+	\param [in, out] group:    The group.
+	\param [in]      flagMask: The flags to wait for, must not be 0.
+	\param [in]      options:  EVENT_WAIT_ANY or EVENT_WAIT_ALL, optionally with
+									 EVENT_CLEAR_ON_EXIT.
+	\return          The flags of the mask that were set when the condition was met.
+	\note       		 Must be called from thread mode: ISRs setting the flags need to run.
+ */
+uint32_t EVENT_Wait(EVENT_Group_t *group, uint32_t flagMask, uint32_t options)
+{
+  uint32_t setFlags;
+
+  while ((setFlags = EVENT_Check(group, flagMask, options)) == 0u)
+  {
+#if defined(EVENT_USE_WFE)
+    __WFE();
+#endif
+  }
+
+  return setFlags;
+}
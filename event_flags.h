@@ -0,0 +1,44 @@
+#ifndef EVENT_FLAGS_H
+#define EVENT_FLAGS_H
+
+#include "interrupt_handling.h"
+
+/* Bit-banding only exists on Cortex-M3 and Cortex-M4 */
+#ifndef EVENT_USE_BITBAND
+#if (__CORTEX_M == 3) || (__CORTEX_M == 4)
+#define EVENT_USE_BITBAND          1
+#else
+#define EVENT_USE_BITBAND          0
+#endif
+#endif
+
+#define EVENT_MAX_FLAGS            32u
+
+/* Wait options, EVENT_WAIT_ANY or EVENT_WAIT_ALL, optionally with EVENT_CLEAR_ON_EXIT */
+#define EVENT_WAIT_ANY             0x0u
+#define EVENT_WAIT_ALL             0x1u
+#define EVENT_CLEAR_ON_EXIT        0x2u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  volatile uint32_t flags;
+} EVENT_Group_t;
+
+void     EVENT_InitGroup(EVENT_Group_t *group);
+INTERRUPT_FAST_CODE void EVENT_SetFlag(EVENT_Group_t *group, uint8_t flagIndex);
+INTERRUPT_FAST_CODE void EVENT_ClearFlag(EVENT_Group_t *group, uint8_t flagIndex);
+INTERRUPT_FAST_CODE void EVENT_SetFlags(EVENT_Group_t *group, uint32_t flagMask);
+INTERRUPT_FAST_CODE void EVENT_ClearFlags(EVENT_Group_t *group, uint32_t flagMask);
+uint32_t EVENT_GetFlags(const EVENT_Group_t *group);
+uint32_t EVENT_Check(EVENT_Group_t *group, uint32_t flagMask, uint32_t options);
+uint32_t EVENT_Wait(EVENT_Group_t *group, uint32_t flagMask, uint32_t options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENT_FLAGS_H */
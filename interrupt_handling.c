@@ -1,13 +1,25 @@
 #include "interrupt_handling.h"
 
-#define ASSERT(cond) if ((cond) == 0) while (1) { /* Stay here forever */}
-
 /* Whether the input IRQn is an exception */
 #define IS_EXCEPTION_NUM(IRQn)     (((int16_t)(IRQn) >= -16) && ((int16_t)(IRQn) < 0))
 /* Whether the input IRQn is an interrupt */
 #define IS_INTERRUPT_NUM(IRQn)     (((int16_t)(IRQn) >= 0) && ((int16_t)(IRQn) < 0xF0))
 /* Whether the input IRQn is an interrupt or an exception */
 #define IS_IRQn(IRQn)              (IS_INTERRUPT_NUM(IRQn) || IS_EXCEPTION_NUM(IRQn))
+/* System exceptions with a configurable priority, by exception number (IRQn + 16) */
+#if (__CORTEX_M >= 3)
+#define CONFIGURABLE_EXCEPTIONS    ((1UL << (MemoryManagement_IRQn + 16)) | (1UL << (BusFault_IRQn + 16)) \
+                                    | (1UL << (UsageFault_IRQn + 16)) | (1UL << (SVCall_IRQn + 16))     \
+                                    | (1UL << (DebugMonitor_IRQn + 16)) | (1UL << (PendSV_IRQn + 16))   \
+                                    | (1UL << (SysTick_IRQn + 16)))
+#else
+#define CONFIGURABLE_EXCEPTIONS    ((1UL << (SVCall_IRQn + 16)) | (1UL << (PendSV_IRQn + 16)) \
+                                    | (1UL << (SysTick_IRQn + 16)))
+#endif
+/* Whether the priority of the input IRQn can be set (not reserved, NMI or HardFault) */
+#define IS_CONFIGURABLE_IRQn(IRQn) (IS_INTERRUPT_NUM(IRQn)                                 \
+                                    || (((int16_t)(IRQn) >= -16) && ((int16_t)(IRQn) < 0) \
+                                        && (((CONFIGURABLE_EXCEPTIONS >> ((int16_t)(IRQn) + 16)) & 1UL) != 0u)))
 /* Whether the input interrupt level is valid */
 #define IS_INT_LVL_VALID(intLevel) (INTERRUPT_HIGHEST_PRIORITY < (intLevel) \
 	                                  && (intLevel) <= INTERRUPT_LOWEST_PRIORITY)
@@ -16,10 +28,239 @@
 /* Hơw many bit should we left shift to reach the start of BASEPRI register */
 #define BASEPRI_START_BIT          (8U - __NVIC_PRIO_BITS)
 
-static int8_t basePriLevel = 3;
+INTERRUPT_FAST_DATA static int8_t basePriLevel = 3;
 #else
 static int8_t basePriLevel = -1;
 #endif
+
+/* Record section and BASEPRI events in the trace (see trace_recorder.c) */
+#if defined(INTERRUPT_ENABLE_TRACE)
+#include "trace_recorder.h"
+#define INTERRUPT_TRACE(event, payload)  TRACE_Record((event), (payload))
+#if (__CORTEX_M >= 3)
+#define INTERRUPT_TRACE_BASEPRI()        TRACE_Record(TRACE_EVENT_BASEPRI, __get_BASEPRI() >> BASEPRI_START_BIT)
+#else
+#define INTERRUPT_TRACE_BASEPRI()
+#endif
+#else
+#define INTERRUPT_TRACE(event, payload)
+#define INTERRUPT_TRACE_BASEPRI()
+#endif
+
+/* Count the interrupts blocked by the sections (see IRQ_GetContentionStats) */
+#if defined(INTERRUPT_ENABLE_CONTENTION_STATISTICS)
+#if (__CORTEX_M >= 3)
+#define INTERRUPT_CONTENTION_BASEPRI_ENTER(irqState)  IRQ_ContentionBasePriEnter(irqState)
+#define INTERRUPT_CONTENTION_BASEPRI_EXIT(irqState)   IRQ_ContentionBasePriExit(irqState)
+#endif
+#define INTERRUPT_CONTENTION_PRIMASK_ENTER()          IRQ_ContentionPrimaskEnter()
+#define INTERRUPT_CONTENTION_PRIMASK_EXIT()           IRQ_ContentionPrimaskExit()
+#define INTERRUPT_CONTENTION_NVIC_ENTER()             IRQ_ContentionNvicEnter()
+#define INTERRUPT_CONTENTION_NVIC_EXIT(nvicState)     IRQ_ContentionNvicExit(nvicState)
+
+/* Nesting of the specific-IRQ sections whose entry time is kept */
+#define INTERRUPT_MAX_NVIC_SECTION_DEPTH  8u
+
+INTERRUPT_FAST_DATA static IRQ_ContentionStats_t contentionStats[IRQ_NUM_OF_CONTENTION_LOCKS];
+INTERRUPT_FAST_DATA static uint32_t              contentionEntryCycles[IRQ_NUM_OF_CONTENTION_LOCKS];
+INTERRUPT_FAST_DATA static uint32_t              nvicSectionEntryCycles[INTERRUPT_MAX_NVIC_SECTION_DEPTH];
+INTERRUPT_FAST_DATA static uint32_t              nvicSectionDepth;
+
+/* Account a section exit that unblocks numOfBlocked pending interrupts */
+static void IRQ_RecordContention(uint32_t lock, uint32_t entryCycles, uint32_t numOfBlocked)
+{
+  uint32_t               cycles = IRQ_GetCycleCount() - entryCycles;
+  IRQ_ContentionStats_t *stats  = &contentionStats[lock];
+  uint32_t               primask;
+
+  /* Not a section macro: this is what they would call */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  stats->numOfSections++;
+  if (numOfBlocked != 0u)
+  {
+    stats->numOfContendedSections++;
+    stats->numOfBlockedArrivals += numOfBlocked;
+    stats->deferredCycles       += (uint64_t)cycles * numOfBlocked;
+  }
+  __set_PRIMASK(primask);
+}
+
+/* Priority level an interrupt must be below to preempt the running context:
+ * 2^__NVIC_PRIO_BITS in thread mode, 0 in NMI and HardFault */
+static uint32_t IRQ_GetPreemptionLevel(void)
+{
+  IRQn_Type activeIrqNum = IRQ_GetActiveIRQn();
+
+  if ((__get_IPSR() & 0x1FFUL) == 0u)
+  {
+    return 1UL << __NVIC_PRIO_BITS;
+  }
+  if (activeIrqNum <= HardFault_IRQn)
+  {
+    return 0u;
+  }
+
+  return NVIC_GetPriority(activeIrqNum);
+}
+
+/* Number of pending and enabled interrupts with a priority level in
+ * [lowestLevel, highestLevel), highestLevel 0 meaning no upper bound. The
+ * ones the running exception keeps pending are not unblocked by the exit. */
+static uint32_t IRQ_CountPendingInLevels(uint32_t lowestLevel, uint32_t highestLevel)
+{
+  uint32_t numOfBlocked    = 0u;
+  uint32_t preemptionLevel = IRQ_GetPreemptionLevel();
+  uint32_t pending;
+  uint32_t bit;
+  uint32_t level;
+
+  if ((highestLevel == 0u) || (highestLevel > preemptionLevel))
+  {
+    highestLevel = preemptionLevel;
+  }
+
+  for (uint32_t i = 0; i < MAX_NVIC_REG_WORDS; i++)
+  {
+    pending = NVIC->ISPR[i] & NVIC->ISER[i];
+    while (pending != 0u)
+    {
+#if (__CORTEX_M >= 3)
+      bit = 31u - __CLZ(pending);
+#else
+      for (bit = 0u; (pending & (1UL << bit)) == 0u; bit++)
+      {
+      }
+#endif
+      pending &= ~(1UL << bit);
+      level    = NVIC_GetPriority((IRQn_Type)((i * 32u) + bit));
+      if ((level >= lowestLevel) && (level < highestLevel))
+      {
+        numOfBlocked++;
+      }
+    }
+  }
+
+  return numOfBlocked;
+}
+
+#if (__CORTEX_M >= 3)
+static void IRQ_ContentionBasePriEnter(uint32_t irqState)
+{
+  uint32_t previousLevel = irqState >> BASEPRI_START_BIT;
+  uint32_t level         = __get_BASEPRI() >> BASEPRI_START_BIT;
+
+  /* Only a section raising the threshold starts blocking something */
+  if ((level != 0u) && ((previousLevel == 0u) || (level < previousLevel)))
+  {
+    contentionEntryCycles[level] = IRQ_GetCycleCount();
+  }
+}
+
+static void IRQ_ContentionBasePriExit(uint32_t irqState)
+{
+  uint32_t level     = __get_BASEPRI() >> BASEPRI_START_BIT;
+  uint32_t nextLevel = irqState >> BASEPRI_START_BIT;
+
+  /* Interrupts still masked by the outer section are counted by it */
+  if ((level != 0u) && ((nextLevel == 0u) || (nextLevel > level)))
+  {
+    IRQ_RecordContention(level, contentionEntryCycles[level], IRQ_CountPendingInLevels(level, nextLevel));
+  }
+}
+#endif
+
+static void IRQ_ContentionPrimaskEnter(void)
+{
+  contentionEntryCycles[IRQ_CONTENTION_PRIMASK] = IRQ_GetCycleCount();
+}
+
+static void IRQ_ContentionPrimaskExit(void)
+{
+#if (__CORTEX_M >= 3)
+  /* Interrupts under the BASEPRI threshold stay blocked */
+  uint32_t highestLevel = __get_BASEPRI() >> BASEPRI_START_BIT;
+#else
+  uint32_t highestLevel = 0u;
+#endif
+
+  IRQ_RecordContention(IRQ_CONTENTION_PRIMASK, contentionEntryCycles[IRQ_CONTENTION_PRIMASK],
+                       IRQ_CountPendingInLevels(0u, highestLevel));
+}
+
+static void IRQ_ContentionNvicEnter(void)
+{
+  /* A preempting section is exited before this one resumes */
+  uint32_t depth = nvicSectionDepth;
+
+  nvicSectionDepth = depth + 1u;
+  if (depth < INTERRUPT_MAX_NVIC_SECTION_DEPTH)
+  {
+    nvicSectionEntryCycles[depth] = IRQ_GetCycleCount();
+  }
+}
+
+static void IRQ_ContentionNvicExit(const NVIC_Mask_t *nvicState)
+{
+  uint32_t depth           = nvicSectionDepth - 1u;
+  uint32_t numOfBlocked    = 0u;
+  uint32_t preemptionLevel = IRQ_GetPreemptionLevel();
+  uint32_t blocked;
+  uint32_t bit;
+
+  nvicSectionDepth = depth;
+
+  /* Pending, enabled before the section, disabled by it and able to preempt */
+  for (uint32_t i = 0; i < MAX_NVIC_REG_WORDS; i++)
+  {
+    blocked = NVIC->ISPR[i] & nvicState->reg[i] & ~NVIC->ISER[i];
+    while (blocked != 0u)
+    {
+      for (bit = 0u; (blocked & (1UL << bit)) == 0u; bit++)
+      {
+      }
+      blocked &= ~(1UL << bit);
+      if (NVIC_GetPriority((IRQn_Type)((i * 32u) + bit)) < preemptionLevel)
+      {
+        numOfBlocked++;
+      }
+    }
+  }
+
+  if (depth < INTERRUPT_MAX_NVIC_SECTION_DEPTH)
+  {
+    IRQ_RecordContention(IRQ_CONTENTION_NVIC, nvicSectionEntryCycles[depth], numOfBlocked);
+  }
+}
+#endif
+
+#if !defined(INTERRUPT_CONTENTION_BASEPRI_ENTER)
+#define INTERRUPT_CONTENTION_BASEPRI_ENTER(irqState)
+#define INTERRUPT_CONTENTION_BASEPRI_EXIT(irqState)
+#endif
+#if !defined(INTERRUPT_CONTENTION_PRIMASK_ENTER)
+#define INTERRUPT_CONTENTION_PRIMASK_ENTER()
+#define INTERRUPT_CONTENTION_PRIMASK_EXIT()
+#define INTERRUPT_CONTENTION_NVIC_ENTER()
+#define INTERRUPT_CONTENTION_NVIC_EXIT(nvicState)
+#endif
+
+#if defined(INTERRUPT_ENABLE_RAM_VECTOR_TABLE)
+/* RAM copy of the vector table, see NVIC_RelocateVectorTableToRam */
+INTERRUPT_FAST_VECTORS static uint32_t ramVectorTable[INTERRUPT_VECTOR_TABLE_WORDS]
+  __ALIGNED(INTERRUPT_VECTOR_TABLE_WORDS * 4u);
+#endif
+
+#if defined(INTERRUPT_USE_FAST_RAM)
+/* Provided by the linker script fragments in linker/ */
+extern uint32_t __irq_fast_text_load[];
+extern uint32_t __irq_fast_text_start[];
+extern uint32_t __irq_fast_text_end[];
+extern uint32_t __irq_fast_data_load[];
+extern uint32_t __irq_fast_data_start[];
+extern uint32_t __irq_fast_data_end[];
+#endif
+
 /* Todo: write all descriptions (the same way as Fsoft Academy) */
 
 /*
@@ -49,11 +290,11 @@ For example:
 
 {
     uint32_t irqState;
-    irqState = PRIMASK_EnterCritical();
+    irqState = PRIMASK_EnterNoInterruptsSection();
     {
       // Your critical section ;
     }
-    PRIMASK_ExitCritical(irqState);
+    PRIMASK_ExitNoInterruptsSection(irqState);
 }
 
 */
@@ -67,12 +308,18 @@ For example:
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK uint32_t PRIMASK_EnterCriticalSection(void)
+__WEAK INTERRUPT_FAST_CODE uint32_t PRIMASK_EnterNoInterruptsSection(void)
 {
   uint32_t irqState = __get_PRIMASK();
 
   __disable_irq();
 
+  if (irqState == 0U)
+  {
+    INTERRUPT_TRACE(TRACE_EVENT_SECTION_ENTER, TRACE_SECTION_PRIMASK);
+    INTERRUPT_CONTENTION_PRIMASK_ENTER();
+  }
+
   return irqState;
 }
 
@@ -85,10 +332,12 @@ __WEAK uint32_t PRIMASK_EnterCriticalSection(void)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK void PRIMASK_ExitCriticalSection(uint32_t irqState)
+__WEAK INTERRUPT_FAST_CODE void PRIMASK_ExitNoInterruptsSection(uint32_t irqState)
 {
   if (irqState == 0U)
   {
+    INTERRUPT_CONTENTION_PRIMASK_EXIT();
+    INTERRUPT_TRACE(TRACE_EVENT_SECTION_EXIT, TRACE_SECTION_PRIMASK);
     __enable_irq();
   }
 }
@@ -130,7 +379,7 @@ __WEAK void PRIMASK_EnableIrq(void)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK void PRIMASK_TriggerPendingInterrupts(void)
+__WEAK INTERRUPT_FAST_CODE void PRIMASK_TriggerPendingInterrupts(void)
 {
   if ((__get_PRIMASK() & 1U) != 0U)
   {
@@ -177,6 +426,8 @@ To carry out an atomic task:
 	   Explannation: __NVIC_PRIO_BITS is the NVIC interrupt priority bits. Doing the
 	   above expression means that we are left-shifting BASE_PRIORITY
 	   to proper BASEPRI bits that are defined by microcontroller vendors.
+	   BASEPRI_MAX is used: inside a section with a tighter threshold (a
+	   priority ceiling above BASE_PRIORITY), the threshold is kept;
 	3. Execute the task;
 	4. Restore BASEPRI state.
 
@@ -240,15 +491,18 @@ int8_t BASEPRI_GetPriorityLevelThreshold(void)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK uint32_t BASEPRI_EnterInterruptsDisabledByThresholdSection(void)
+__WEAK INTERRUPT_FAST_CODE uint32_t BASEPRI_EnterInterruptsDisabledByThresholdSection(void)
 {
 	uint32_t irqState = 0;
 
 #if (__CORTEX_M >= 3)
   irqState = __get_BASEPRI();
-  __set_BASEPRI(basePriLevel << BASEPRI_START_BIT);
+  /* Never lower the threshold of an enclosing section (a tighter ceiling) */
+  __set_BASEPRI_MAX(basePriLevel << BASEPRI_START_BIT);
+  INTERRUPT_CONTENTION_BASEPRI_ENTER(irqState);
+  INTERRUPT_TRACE_BASEPRI();
 #else
-  irqState = PRIMASK_EnterCriticalSection();
+  irqState = PRIMASK_EnterNoInterruptsSection();
 #endif
 
   return irqState;
@@ -263,15 +517,47 @@ __WEAK uint32_t BASEPRI_EnterInterruptsDisabledByThresholdSection(void)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK void BASEPRI_ExitInterruptsDisabledByThresholdSection(uint32_t irqState)
+__WEAK INTERRUPT_FAST_CODE void BASEPRI_ExitInterruptsDisabledByThresholdSection(uint32_t irqState)
 {
 #if (__CORTEX_M >= 3)
+  INTERRUPT_CONTENTION_BASEPRI_EXIT(irqState);
   __set_BASEPRI(irqState);
+  INTERRUPT_TRACE_BASEPRI();
 #else
-  PRIMASK_ExitCriticalSection(irqState);
+  PRIMASK_ExitNoInterruptsSection(irqState);
 #endif
 }
 
+/**
+	\brief      		 Enter a section protected by a priority ceiling.
+	\details    		 Raise the priority threshold so that interrupts with a priority
+									 level equal to or lower than ceilingLevel are disabled. The
+									 threshold is never lowered: nested sections with a lower ceiling
+									 keep the current one.
+	\param [in]      ceilingLevel: Highest priority level (lowest value) of the
+									 contexts sharing the protected resource.
+	\return          The state to give to BASEPRI_ExitInterruptsDisabledByThresholdSection.
+	\note       		 On ARMv6-M all interrupts are disabled instead.
+ */
+__WEAK INTERRUPT_FAST_CODE uint32_t BASEPRI_EnterPriorityCeilingSection(uint8_t ceilingLevel)
+{
+	uint32_t irqState = 0;
+
+#if (__CORTEX_M >= 3)
+  ASSERT(IS_INT_LVL_VALID(ceilingLevel));
+
+  irqState = __get_BASEPRI();
+  __set_BASEPRI_MAX(ceilingLevel << BASEPRI_START_BIT);
+  INTERRUPT_CONTENTION_BASEPRI_ENTER(irqState);
+  INTERRUPT_TRACE_BASEPRI();
+#else
+  (void)ceilingLevel;
+  irqState = PRIMASK_EnterNoInterruptsSection();
+#endif
+
+  return irqState;
+}
+
 /**
 	\brief      		 Clear an bit in an NVIC mask.
 	\details    		 Clear an IRQn bit in an NVIC mask corresponding to the input IRQn.
@@ -285,6 +571,7 @@ __WEAK void BASEPRI_DisableIrqByThreshold(void)
 {
 #if (__CORTEX_M >= 3)
   __set_BASEPRI(basePriLevel << BASEPRI_START_BIT);
+  INTERRUPT_TRACE_BASEPRI();
 #else
   PRIMASK_DisableIrq();
 #endif
@@ -303,6 +590,7 @@ __WEAK void BASEPRI_EnableIrqByThreshold(void)
 {
 #if (__CORTEX_M >= 3)
   __set_BASEPRI(0);
+  INTERRUPT_TRACE_BASEPRI();
 #else
   PRIMASK_EnableIrq();
 #endif
@@ -317,7 +605,7 @@ __WEAK void BASEPRI_EnableIrqByThreshold(void)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK void BASEPRI_TriggerPendingInterruptsByThreshold(void)
+__WEAK INTERRUPT_FAST_CODE void BASEPRI_TriggerPendingInterruptsByThreshold(void)
 {
 #if (__CORTEX_M >= 3)
   uint32_t irqState = __get_BASEPRI();
@@ -335,36 +623,37 @@ __WEAK void BASEPRI_TriggerPendingInterruptsByThreshold(void)
 }
 
 /**
-	\brief      		 Clear an bit in an NVIC mask.
-	\details    		 Clear an IRQn bit in an NVIC mask corresponding to the input IRQn.
-	\param [in]      irqNum: Device specific interrupt number.
-	\param [in, out] mask:   The mask to set the interrupt bit.
-	\note       		 IRQn must be an interrupt number (not exception number).
-									 If input IRQn is invalid or it does not defined by the MCU vendor,
-									 this function will have no effect.
+	\brief      		 Enter a section with specific interrupts disabled.
+	\param [out]     nvicState: The interrupts enabled on entry, to give to
+									 NVIC_ExitSpecificInterruptDisabledSection.
+	\param [in]      disable:   The interrupts to disable.
  */
 void NVIC_EnterSpecificInterruptDisabledSection(NVIC_Mask_t *nvicState,
                              const NVIC_Mask_t *disable)
 {
   NO_INTERRUPTS_SECTION
 	(
-    *nvicState = *(NVIC_Mask_t*)((uint32_t)&NVIC->ICER[0]);
-    *(NVIC_Mask_t*)((uint32_t)&NVIC->ICER[0]) = *disable;
+    *nvicState = *(NVIC_Mask_t*)((uintptr_t)&NVIC->ICER[0]);
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ICER[0]) = *disable;
+    INTERRUPT_CONTENTION_NVIC_ENTER();
   )
+  INTERRUPT_TRACE(TRACE_EVENT_SECTION_ENTER, TRACE_SECTION_NVIC);
 }
 
 /**
-	\brief      		 Clear an bit in an NVIC mask.
-	\details    		 Clear an IRQn bit in an NVIC mask corresponding to the input IRQn.
-	\param [in]      irqNum: Device specific interrupt number.
-	\param [in, out] mask:   The mask to set the interrupt bit.
-	\note       		 IRQn must be an interrupt number (not exception number).
-									 If input IRQn is invalid or it does not defined by the MCU vendor,
-									 this function will have no effect.
+	\brief      		 Exit a section with specific interrupts disabled.
+	\details    		 Enable again the interrupts that were enabled on entry.
+	\param [in]      nvicState: The state saved by NVIC_EnterSpecificInterruptDisabledSection.
  */
-void NVIC_ExitSpecificInterruptDisabledSection(const NVIC_Mask_t *disable)
+void NVIC_ExitSpecificInterruptDisabledSection(const NVIC_Mask_t *nvicState)
 {
-	NVIC_DisableSpecificInterrupts(disable);
+  INTERRUPT_TRACE(TRACE_EVENT_SECTION_EXIT, TRACE_SECTION_NVIC);
+  /* Re-enable what was enabled on entry */
+  NO_INTERRUPTS_SECTION
+  (
+    INTERRUPT_CONTENTION_NVIC_EXIT(nvicState);
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]) = *nvicState;
+  )
 }
 
 /**
@@ -380,7 +669,7 @@ void NVIC_DisableSpecificInterrupts(const NVIC_Mask_t *disable)
 {
   NO_INTERRUPTS_SECTION
 	(
-    *(NVIC_Mask_t*)((uint32_t)&NVIC->ICER[0]) = *disable;
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ICER[0]) = *disable;
   )
 }
 
@@ -397,7 +686,7 @@ void NVIC_EnableSpecificInterrupts(const NVIC_Mask_t *enable)
 {
   NO_INTERRUPTS_SECTION
 	(
-    *(NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]) = *enable;
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]) = *enable;
   )
 }
 
@@ -418,10 +707,10 @@ void NVIC_TriggerSpecificPendingInterrupts(const NVIC_Mask_t *enable)
   // Get current NVIC enable mask.
   NO_INTERRUPTS_SECTION
 	(
-    nvicMask = *(NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]);
+    nvicMask = *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]);
   )
 
-  for (size_t i; i < MAX_NVIC_REG_WORDS; i++)
+  for (size_t i = 0; i < MAX_NVIC_REG_WORDS; i++)
 	{
   	nvicMask.reg[i] &= enable->reg[i];
 		nvicMask.reg[i] = ~nvicMask.reg[i] & enable->reg[i];
@@ -433,9 +722,9 @@ void NVIC_TriggerSpecificPendingInterrupts(const NVIC_Mask_t *enable)
 
 	if (shouldTrigger)
 	{
-    *(NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]) = nvicMask;
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]) = nvicMask;
     __ISB();
-    *(NVIC_Mask_t*)((uint32_t)&NVIC->ICER[0]) = nvicMask;
+    *(NVIC_Mask_t*)((uintptr_t)&NVIC->ICER[0]) = nvicMask;
   }
 }
 
@@ -482,7 +771,7 @@ void NVIC_ClearSpecificInterruptInAMask(IRQn_Type irqNum, NVIC_Mask_t *mask)
 									 If input IRQn is invalid or it does not defined by the MCU vendor,
 									 this function will have no effect.
  */
-__WEAK bool IRQ_IsInIrqContext(void)
+__WEAK INTERRUPT_FAST_CODE bool IRQ_IsInIrqContext(void)
 {
 	/* Reading VECTACTIVE to determine the currently executing
 	 * exception/interrupt number. The result of not being zero means
@@ -582,7 +871,7 @@ void NVIC_GetNvicIserMask(NVIC_Mask_t *mask)
 {
   NO_INTERRUPTS_SECTION
 	(
-    *mask = *(NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]);
+    *mask = *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]);
   )
 }
 
@@ -602,10 +891,10 @@ bool NVIC_IsNvicIserMaskDisabled(const NVIC_Mask_t *mask)
 
   NO_INTERRUPTS_SECTION
 	(
-    nvicMask = *(NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]);
+    nvicMask = *(NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]);
   )
 
-  for (size_t i; i < MAX_NVIC_REG_WORDS; i++)
+  for (size_t i = 0; i < MAX_NVIC_REG_WORDS; i++)
   {
   	if ((mask->reg[i] & nvicMask.reg[i]) != 0U)
   	{
@@ -634,7 +923,7 @@ bool NVIC_IsIRQnDisabled(IRQn_Type irqNum)
   if (IS_INTERRUPT_NUM(irqNum))
   {
   	/* Get Interrupt Set Enable Registers mask */
-  	mask = (NVIC_Mask_t*)((uint32_t)&NVIC->ISER[0]);
+  	mask = (NVIC_Mask_t*)((uintptr_t)&NVIC->ISER[0]);
   	/* Find and check whether the bit corresponding to input irqNum
   	   is equal to 0. */
   	isDisabled = (mask->reg[(((uint8_t)irqNum) >> 5UL)]    \
@@ -675,7 +964,7 @@ void *NVIC_GetIRQnHandler(IRQn_Type irqNum)
 						+ DO:   uint32_t <=> uint8_t  (Non-pointer to non-pointer with different type)
 						+ DONT: uint32_t <=> uint8_t* (Non-pointer to pointer with different type)
   	*/
-  	handler = (void*)((uint32_t*)(((uint32_t*)SCB->VTOR)[(int16_t)irqNum + 16]));
+  	handler = (void*)(uintptr_t)(((uint32_t*)(uintptr_t)SCB->VTOR)[(int16_t)irqNum + 16]);
   }
 
   return handler;
@@ -694,6 +983,481 @@ void NVIC_SetIRQnHandler(IRQn_Type irqNum, void *handler)
 {
 	if (IS_IRQn(irqNum))
 	{
-		((uint32_t*)SCB->VTOR)[(int16_t)irqNum + 16] = (uint32_t)((uint32_t*)handler);
+		((uint32_t*)(uintptr_t)SCB->VTOR)[(int16_t)irqNum + 16] = (uint32_t)(uintptr_t)handler;
 	}
 }
+
+/**
+	\brief      		 Set the priorities of a table of interrupts.
+	\details    		 The table is checked first: nothing is changed if an entry is invalid.
+									 The priorities are written with all interrupts disabled, so that no
+									 interrupt runs with half of the new configuration. Generated tables
+									 come from tools/prio_assign.c.
+	\param [in]      table:        Interrupts and their priority level.
+	\param [in]      numOfEntries: Number of entries of the table.
+	\return          true if set, false if an interrupt has no configurable priority or a
+									 level does not fit in __NVIC_PRIO_BITS.
+ */
+bool NVIC_SetPriorityTable(const NVIC_Priority_t *table, uint32_t numOfEntries)
+{
+  for (uint32_t i = 0; i < numOfEntries; i++)
+  {
+    if (!IS_CONFIGURABLE_IRQn(table[i].irqNum) || (table[i].priorityLevel >= (1u << __NVIC_PRIO_BITS)))
+    {
+      return false;
+    }
+  }
+
+  NO_INTERRUPTS_SECTION
+  (
+    for (uint32_t i = 0; i < numOfEntries; i++)
+    {
+      NVIC_SetPriority(table[i].irqNum, table[i].priorityLevel);
+    }
+  )
+
+  return true;
+}
+
+/* Notes:
+
+On STM32F4 running at 168 MHz the flash needs 5 wait states, so every
+exception entry that misses the ART accelerator pays for the vector fetch and
+for the first instructions of the handler. Defining INTERRUPT_USE_FAST_RAM
+moves the section enter/exit functions (and later the dispatchers built on
+top of them) to .irq_fast_text/.irq_fast_data, which the linker fragments in
+linker/ place in SRAM (STM32F4) or ITCM/DTCM (Cortex-M7).
+
+To use it:
+	1. Add the fragment matching your part to the linker script;
+	2. Call IRQ_CopyFastSectionsToRam() from the reset handler, before main()
+	   and before any section function is used;
+	3. Optionally define INTERRUPT_ENABLE_RAM_VECTOR_TABLE and call
+	   NVIC_RelocateVectorTableToRam() so that vector fetches are served from
+	   RAM as well (this is also what NVIC_SetIRQnHandler needs to be able to
+	   change a handler).
+
+Without the flag the attributes expand to nothing, IRQ_CopyFastSectionsToRam()
+does nothing and the vector table copy lands in regular .bss. Without
+INTERRUPT_ENABLE_RAM_VECTOR_TABLE there is no copy: the table and its
+alignment padding (up to INTERRUPT_VECTOR_TABLE_WORDS * 8 bytes) are not
+reserved, and NVIC_RelocateVectorTableToRam does not exist.
+
+*/
+
+/**
+	\brief      		 Copy the hot paths from flash to fast RAM.
+	\details    		 Copy the load images of .irq_fast_text and .irq_fast_data to
+									 their run addresses.
+	\note       		 Must be called from the startup code, before any function
+									 marked INTERRUPT_FAST_CODE runs. It is a no-op when
+									 INTERRUPT_USE_FAST_RAM is not defined.
+ */
+void IRQ_CopyFastSectionsToRam(void)
+{
+#if defined(INTERRUPT_USE_FAST_RAM)
+  uint32_t *src;
+  uint32_t *dst;
+
+  for (src = __irq_fast_text_load, dst = __irq_fast_text_start; dst < __irq_fast_text_end; )
+  {
+    *dst++ = *src++;
+  }
+
+  for (src = __irq_fast_data_load, dst = __irq_fast_data_start; dst < __irq_fast_data_end; )
+  {
+    *dst++ = *src++;
+  }
+
+#if defined(__ICACHE_PRESENT) && (__ICACHE_PRESENT == 1U)
+  /* Code copied through the data side must reach memory before it
+   * can be fetched through the instruction side. */
+  SCB_CleanDCache();
+  SCB_InvalidateICache();
+#endif
+  __DSB();
+  __ISB();
+#endif
+}
+
+/**
+	\brief      		 Move the vector table to RAM.
+	\details    		 Copy the first INTERRUPT_VECTOR_TABLE_WORDS entries of the current
+									 vector table (pointed by SCB->VTOR) into a RAM table and make
+									 SCB->VTOR point to it.
+	\note       		 INTERRUPT_VECTOR_TABLE_WORDS must cover all the vectors of the device.
+									 Calling it again when the table is already in RAM has no effect.
+									 Only built with INTERRUPT_ENABLE_RAM_VECTOR_TABLE.
+ */
+#if defined(INTERRUPT_ENABLE_RAM_VECTOR_TABLE)
+void NVIC_RelocateVectorTableToRam(void)
+{
+  uint32_t *currentTable = (uint32_t*)(uintptr_t)SCB->VTOR;
+
+  if (currentTable != ramVectorTable)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      for (uint32_t i = 0; i < INTERRUPT_VECTOR_TABLE_WORDS; i++)
+      {
+        ramVectorTable[i] = currentTable[i];
+      }
+      SCB->VTOR = (uint32_t)(uintptr_t)ramVectorTable;
+      __DSB();
+      __ISB();
+    )
+  }
+}
+#endif
+
+/**
+	\brief      		 Start the DWT cycle counter.
+	\details    		 Enable the trace block and the DWT cycle counter used by the
+									 statistics of the library (IRQ_GetCycleCount).
+	\note       		 ARMv6-M cores have no cycle counter, this function has no effect
+									 there and IRQ_GetCycleCount always returns 0.
+ */
+void IRQ_EnableCycleCounter(void)
+{
+#if (__CORTEX_M >= 3)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/* Notes:
+
+Critical section budget. A driver change that makes a masked section longer
+delays every interrupt it masks, usually without anything failing in the
+tests. With INTERRUPT_ENABLE_SECTION_BUDGET defined, NO_INTERRUPTS_SECTION,
+THREAD_SAFE_SECTION and SPECIFIC_INTERRUPT_DISABLED_SECTION (and their
+ENTER_/EXIT_ macros) read the cycle counter when they are entered. On exit,
+before unmasking, IRQ_ExitBudgetedSection compares the time spent with the
+budget of the section: INTERRUPT_SECTION_BUDGET_CYCLES, or the one given to
+the _WITH_BUDGET variant of the macro for a section known to be longer:
+
+NO_INTERRUPTS_SECTION_WITH_BUDGET(3000u,
+  FLASH_ProgramWord(address, data);
+)
+
+A violation is counted and recorded with its call site (the address of the
+exit of the section: arm-none-eabi-addr2line -e firmware.elf <address> gives
+the file and line), the time spent and the budget, and the callback set with
+IRQ_SetSectionBudgetCallback is called, interrupts still masked. The last and
+the worst violations are kept (IRQ_GetSectionBudgetStats). Nested sections
+are checked each against their own budget.
+
+With INTERRUPT_ENABLE_SECTION_WATCHDOG defined as well, the outermost section
+calls IRQ_ArmSectionWatchdog with its budget on entry and
+IRQ_DisarmSectionWatchdog on exit. Both are weak and do nothing: implement
+them with a one-shot timer whose interrupt has a priority above the BASEPRI
+threshold, and call IRQ_SectionWatchdogExpired from its handler. A
+THREAD_SAFE_SECTION running past its budget is then caught while it is still
+running, and the return address stacked by the timer interrupt shows where.
+A PRIMASK section masks the timer as well: its expiration is only handled on
+exit.
+
+INTERRUPT_SECTION_WATCHDOG_SYSTICK provides that timer on SysTick, present on
+every Cortex-M: IRQ_ArmSectionWatchdog loads it with the budget, counting the
+processor clock like the cycle counter, and SysTick_Handler stops it and calls
+IRQ_SectionWatchdogExpired. The application gives up SysTick for it (no RTOS
+or HAL tick on SysTick) and sets its level above the threshold:
+
+NVIC_SetPriority(SysTick_IRQn, 0u);
+BASEPRI_SetPriorityLevelThreshold(3u);
+
+The SysTick_Handler defined here is strong: it fails to link against the one
+of a CubeMX project calling HAL_IncTick, and HAL_InitTick would reprogram
+SysTick under the watchdog. Select another timer as the HAL time base
+(SYS > Timebase Source in CubeMX, stm32f4xx_hal_timebase_tim.c) and remove
+the generated SysTick_Handler, or implement the watchdog on a timer instead.
+
+The 24-bit reload caps the budget watched at 16777216 cycles, longer budgets
+expire at that. Another timer takes the same three functions.
+
+The cycle counter must be running (IRQ_EnableCycleCounter). On ARMv6-M it
+reads 0 and no violation is ever recorded.
+
+*/
+
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+INTERRUPT_FAST_DATA static IRQ_SectionBudgetStats_t    sectionBudgetStats;
+INTERRUPT_FAST_DATA static IRQ_SectionBudgetCallback_t sectionBudgetCallback;
+#if defined(INTERRUPT_ENABLE_SECTION_WATCHDOG)
+INTERRUPT_FAST_DATA static uint32_t                    sectionDepth;
+#endif
+#endif
+
+/**
+	\brief      		 Start timing a critical section.
+	\details    		 Called by the section macros after masking, when
+									 INTERRUPT_ENABLE_SECTION_BUDGET is defined.
+	\param [in]      budgetCycles: Budget of the section, given to IRQ_ArmSectionWatchdog
+									 by the outermost section.
+	\return          The cycle count to give to IRQ_ExitBudgetedSection.
+ */
+INTERRUPT_FAST_CODE uint32_t IRQ_EnterBudgetedSection(uint32_t budgetCycles)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET) && defined(INTERRUPT_ENABLE_SECTION_WATCHDOG)
+  /* Preempting sections are exited before the preempted one resumes, the
+   * depth is always back to its value when this one continues */
+  sectionDepth++;
+  if (sectionDepth == 1u)
+  {
+    IRQ_ArmSectionWatchdog(budgetCycles);
+  }
+#else
+  (void)budgetCycles;
+#endif
+
+  return IRQ_GetCycleCount();
+}
+
+/**
+	\brief      		 Check the time spent in a critical section.
+	\details    		 Called by the section macros before unmasking, when
+									 INTERRUPT_ENABLE_SECTION_BUDGET is defined. Record a violation
+									 if the section took longer than its budget.
+	\param [in]      startCycles:  Value returned by IRQ_EnterBudgetedSection.
+	\param [in]      budgetCycles: Budget of the section.
+ */
+__attribute__((noinline)) INTERRUPT_FAST_CODE void IRQ_ExitBudgetedSection(uint32_t startCycles, uint32_t budgetCycles)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+  uint32_t cycles   = IRQ_GetCycleCount() - startCycles;
+  uint32_t callSite = (uint32_t)(uintptr_t)__builtin_return_address(0);
+  uint32_t primask;
+
+#if defined(INTERRUPT_ENABLE_SECTION_WATCHDOG)
+  sectionDepth--;
+  if (sectionDepth == 0u)
+  {
+    IRQ_DisarmSectionWatchdog();
+  }
+#endif
+
+  if (cycles > budgetCycles)
+  {
+    /* Not a section macro: this is what they would call */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    sectionBudgetStats.numOfViolations++;
+    sectionBudgetStats.lastCallSite     = callSite;
+    sectionBudgetStats.lastCycles       = cycles;
+    sectionBudgetStats.lastBudgetCycles = budgetCycles;
+    if (cycles > sectionBudgetStats.worstCycles)
+    {
+      sectionBudgetStats.worstCallSite     = callSite;
+      sectionBudgetStats.worstCycles       = cycles;
+      sectionBudgetStats.worstBudgetCycles = budgetCycles;
+    }
+    __set_PRIMASK(primask);
+
+    if (sectionBudgetCallback != NULL)
+    {
+      sectionBudgetCallback(callSite, cycles, budgetCycles);
+    }
+  }
+#else
+  (void)startCycles;
+  (void)budgetCycles;
+#endif
+}
+
+/**
+	\brief      		 Set the function called on every budget violation.
+	\param [in]      callback: The function, NULL for none. It runs with interrupts masked.
+ */
+void IRQ_SetSectionBudgetCallback(IRQ_SectionBudgetCallback_t callback)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+  sectionBudgetCallback = callback;
+#else
+  (void)callback;
+#endif
+}
+
+/**
+	\brief      		 Get the budget violations recorded.
+	\param [out]     stats: The violations, all 0 when INTERRUPT_ENABLE_SECTION_BUDGET
+									 is not defined.
+ */
+void IRQ_GetSectionBudgetStats(IRQ_SectionBudgetStats_t *stats)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  *stats = sectionBudgetStats;
+  __set_PRIMASK(primask);
+#else
+  *stats = (IRQ_SectionBudgetStats_t){0};
+#endif
+}
+
+/**
+	\brief      		 Clear the budget violations recorded.
+ */
+void IRQ_ResetSectionBudgetStats(void)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  sectionBudgetStats = (IRQ_SectionBudgetStats_t){0};
+  __set_PRIMASK(primask);
+#endif
+}
+
+/**
+	\brief      		 Start the section watchdog timer.
+	\details    		 Called on entry of the outermost section when
+									 INTERRUPT_ENABLE_SECTION_WATCHDOG is defined. Does nothing,
+									 override it to start a one-shot timer of budgetCycles, or
+									 define INTERRUPT_SECTION_WATCHDOG_SYSTICK to use SysTick.
+	\param [in]      budgetCycles: Budget of the section.
+ */
+#if defined(INTERRUPT_SECTION_WATCHDOG_SYSTICK)
+INTERRUPT_FAST_CODE void IRQ_ArmSectionWatchdog(uint32_t budgetCycles)
+{
+  /* Expires after LOAD + 1 cycles, LOAD = 0 would never expire */
+  uint32_t reload = (budgetCycles > 1u) ? (budgetCycles - 1u) : 1u;
+
+  if (reload > SysTick_LOAD_RELOAD_Msk)
+  {
+    reload = SysTick_LOAD_RELOAD_Msk;
+  }
+
+  SysTick->CTRL = 0u;
+  SysTick->LOAD = reload;
+  SysTick->VAL  = 0u;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+#else
+__WEAK void IRQ_ArmSectionWatchdog(uint32_t budgetCycles)
+{
+  (void)budgetCycles;
+}
+#endif
+
+/**
+	\brief      		 Stop the section watchdog timer.
+	\details    		 Called on exit of the outermost section when
+									 INTERRUPT_ENABLE_SECTION_WATCHDOG is defined. Does nothing,
+									 override it to stop the timer started by IRQ_ArmSectionWatchdog,
+									 or define INTERRUPT_SECTION_WATCHDOG_SYSTICK to use SysTick.
+ */
+#if defined(INTERRUPT_SECTION_WATCHDOG_SYSTICK)
+INTERRUPT_FAST_CODE void IRQ_DisarmSectionWatchdog(void)
+{
+  /* An expiration held back by PRIMASK stays pending and is handled on exit */
+  SysTick->CTRL = 0u;
+}
+
+/**
+	\brief      		 Section watchdog expiration, with INTERRUPT_SECTION_WATCHDOG_SYSTICK.
+ */
+void SysTick_Handler(void)
+{
+  SysTick->CTRL = 0u;
+  IRQ_SectionWatchdogExpired();
+}
+#else
+__WEAK void IRQ_DisarmSectionWatchdog(void)
+{
+}
+#endif
+
+/**
+	\brief      		 Count a section watchdog expiration.
+	\details    		 Call it from the handler of the watchdog timer.
+	\note       		 Put a breakpoint here to stop while the section is still running.
+ */
+void IRQ_SectionWatchdogExpired(void)
+{
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  sectionBudgetStats.numOfWatchdogExpirations++;
+  __set_PRIMASK(primask);
+#endif
+}
+
+/* Notes:
+
+Contention statistics: how often a section actually delayed an interrupt,
+to know which locks to shrink, split or replace by lock-free code. With
+INTERRUPT_ENABLE_CONTENTION_STATISTICS defined, the exit of every section
+looks at the interrupts it is about to unblock: pending (NVIC ISPR), enabled,
+masked by this section but not by the one it returns to, and more urgent than
+the running exception (a section in a handler does not unblock the interrupts
+its handler keeps pending). Like
+NVIC_TriggerSpecificPendingInterrupts and
+BASEPRI_TriggerPendingInterruptsByThreshold, which open the same window on
+purpose.
+
+The statistics are kept per lock:
+	- every BASEPRI level (THREAD_SAFE_SECTION, priority ceilings): the level
+	  a section raises the threshold to, blocking the interrupts at that level
+	  and below;
+	- IRQ_CONTENTION_PRIMASK: the outermost NO_INTERRUPTS_SECTION;
+	- IRQ_CONTENTION_NVIC: SPECIFIC_INTERRUPT_DISABLED_SECTION (entry times of
+	  up to INTERRUPT_MAX_NVIC_SECTION_DEPTH nested sections are kept).
+
+For each lock: the number of sections, of sections that blocked at least one
+interrupt, of blocked interrupts, and the deferred cycles, counted for each
+blocked interrupt as the time since the section was entered. The interrupt
+may have arrived later than that, so it is an upper bound. Only the first
+arrival of an interrupt is seen, a second one while it is pending is merged
+by the NVIC.
+
+The exit costs a read of the ISPR and ISER words, plus a priority lookup per
+pending interrupt. The cycle counter must be running (IRQ_EnableCycleCounter).
+
+*/
+
+/**
+	\brief      		 Get the contention statistics of a lock.
+	\param [in]      lock:  A BASEPRI level (1 to 2^__NVIC_PRIO_BITS - 1), IRQ_CONTENTION_PRIMASK
+									 or IRQ_CONTENTION_NVIC.
+	\param [out]     stats: The statistics, all 0 when INTERRUPT_ENABLE_CONTENTION_STATISTICS
+									 is not defined.
+	\return          true if lock is valid.
+ */
+bool IRQ_GetContentionStats(uint32_t lock, IRQ_ContentionStats_t *stats)
+{
+  if (lock >= IRQ_NUM_OF_CONTENTION_LOCKS)
+  {
+    return false;
+  }
+
+#if defined(INTERRUPT_ENABLE_CONTENTION_STATISTICS)
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  *stats = contentionStats[lock];
+  __set_PRIMASK(primask);
+#else
+  *stats = (IRQ_ContentionStats_t){0};
+#endif
+
+  return true;
+}
+
+/**
+	\brief      		 Clear the contention statistics of all the locks.
+ */
+void IRQ_ResetContentionStats(void)
+{
+#if defined(INTERRUPT_ENABLE_CONTENTION_STATISTICS)
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  for (uint32_t i = 0; i < IRQ_NUM_OF_CONTENTION_LOCKS; i++)
+  {
+    contentionStats[i] = (IRQ_ContentionStats_t){0};
+  }
+  __set_PRIMASK(primask);
+#endif
+}
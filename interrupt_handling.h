@@ -19,75 +19,158 @@
 
 #endif
 
+/* Number of words of the vector table (16 system exceptions + device
+ * interrupts), must be a power of two for VTOR alignment. The RAM copy of
+ * NVIC_RelocateVectorTableToRam, reserved only with
+ * INTERRUPT_ENABLE_RAM_VECTOR_TABLE, has this size. */
+#ifndef INTERRUPT_VECTOR_TABLE_WORDS
+#define INTERRUPT_VECTOR_TABLE_WORDS 128u
+#endif
+
+/* Trap on an invalid argument, define ASSERT beforehand to report it instead */
+#ifndef ASSERT
+#define ASSERT(cond) if ((cond) == 0) while (1) { /* Stay here forever */}
+#endif
+
+/* Place the hot paths in zero-wait-state memory when INTERRUPT_USE_FAST_RAM is
+ * defined (see linker/ for the matching linker script fragments). Functions
+ * living in RAM are out of BL range from flash, hence long_call; toolchains
+ * that ignore it need -mlong-calls. Without the flag everything stays where
+ * the default linker script puts it. */
+#if defined(INTERRUPT_USE_FAST_RAM)
+#define INTERRUPT_FAST_CODE        __attribute__((section(".irq_fast_text"), noinline, long_call))
+#define INTERRUPT_FAST_DATA        __attribute__((section(".irq_fast_data")))
+#define INTERRUPT_FAST_VECTORS     __attribute__((section(".irq_fast_vectors")))
+#else
+#define INTERRUPT_FAST_CODE
+#define INTERRUPT_FAST_DATA
+#define INTERRUPT_FAST_VECTORS
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* With INTERRUPT_ENABLE_SECTION_BUDGET defined, every section below is timed
+ * and the ones masking longer than their budget are recorded (see
+ * IRQ_ExitBudgetedSection). The budget is INTERRUPT_SECTION_BUDGET_CYCLES,
+ * or the one given to the _WITH_BUDGET variants. Without the flag the
+ * sections are not timed and the budgets are ignored. */
+#if defined(INTERRUPT_ENABLE_SECTION_BUDGET)
+#define DECLARE_IRQ_STATE   uint32_t irqState; uint32_t sectionStartCycles
+#define DECLARE_NVIC_MASK  NVIC_Mask_t nvicMask; uint32_t nvicSectionStartCycles
+#define SECTION_BUDGET_ENTER(budgetCycles)     , sectionStartCycles = IRQ_EnterBudgetedSection(budgetCycles)
+#define SECTION_BUDGET_EXIT(budgetCycles)      IRQ_ExitBudgetedSection(sectionStartCycles, (budgetCycles)),
+#define NVIC_SECTION_BUDGET_ENTER(budgetCycles) , nvicSectionStartCycles = IRQ_EnterBudgetedSection(budgetCycles)
+#define NVIC_SECTION_BUDGET_EXIT(budgetCycles)  IRQ_ExitBudgetedSection(nvicSectionStartCycles, (budgetCycles)),
+#else
 #define DECLARE_IRQ_STATE   uint32_t irqState
 #define DECLARE_NVIC_MASK  NVIC_Mask_t nvicMask
+#define SECTION_BUDGET_ENTER(budgetCycles)
+#define SECTION_BUDGET_EXIT(budgetCycles)
+#define NVIC_SECTION_BUDGET_ENTER(budgetCycles)
+#define NVIC_SECTION_BUDGET_EXIT(budgetCycles)
+#endif
 
-#define ENTER_NO_INTERRUPTS_SECTION()    irqState = PRIMASK_EnterNoInterruptsSection()
-#define EXIT_NO_INTERRUPTS_SECTION()     PRIMASK_ExitNoInterruptsSection(irqState)
+#ifndef INTERRUPT_SECTION_BUDGET_CYCLES
+#define INTERRUPT_SECTION_BUDGET_CYCLES  1000u
+#endif
+
+#if defined(INTERRUPT_SECTION_WATCHDOG_SYSTICK) \
+    && !(defined(INTERRUPT_ENABLE_SECTION_BUDGET) && defined(INTERRUPT_ENABLE_SECTION_WATCHDOG))
+#error "INTERRUPT_SECTION_WATCHDOG_SYSTICK needs INTERRUPT_ENABLE_SECTION_BUDGET and INTERRUPT_ENABLE_SECTION_WATCHDOG"
+#endif
+
+#define ENTER_NO_INTERRUPTS_SECTION_WITH_BUDGET(budgetCycles) \
+  (irqState = PRIMASK_EnterNoInterruptsSection() SECTION_BUDGET_ENTER(budgetCycles))
+#define EXIT_NO_INTERRUPTS_SECTION_WITH_BUDGET(budgetCycles)  \
+  (SECTION_BUDGET_EXIT(budgetCycles) PRIMASK_ExitNoInterruptsSection(irqState))
+#define ENTER_NO_INTERRUPTS_SECTION()    ENTER_NO_INTERRUPTS_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES)
+#define EXIT_NO_INTERRUPTS_SECTION()     EXIT_NO_INTERRUPTS_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES)
+#define NO_INTERRUPTS_SECTION_WITH_BUDGET(budgetCycles, inputSection) \
+  {                                                                   \
+    DECLARE_IRQ_STATE;                                                \
+    ENTER_NO_INTERRUPTS_SECTION_WITH_BUDGET(budgetCycles);            \
+    {                                                                 \
+      inputSection                                                    \
+    }                                                                 \
+		EXIT_NO_INTERRUPTS_SECTION_WITH_BUDGET(budgetCycles);             \
+  }
 #define NO_INTERRUPTS_SECTION(inputSection) \
-  {                                         \
-    DECLARE_IRQ_STATE;                      \
-    ENTER_NO_INTERRUPTS_SECTION();          \
-    {                                       \
-      inputSection                          \
-    }                                       \
-		EXIT_NO_INTERRUPTS_SECTION();           \
+  NO_INTERRUPTS_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES, inputSection)
+
+#define ENTER_THREAD_SAFE_SECTION_WITH_BUDGET(budgetCycles) \
+  (irqState = BASEPRI_EnterInterruptsDisabledByThresholdSection() SECTION_BUDGET_ENTER(budgetCycles))
+#define EXIT_THREAD_SAFE_SECTION_WITH_BUDGET(budgetCycles)  \
+  (SECTION_BUDGET_EXIT(budgetCycles) BASEPRI_ExitInterruptsDisabledByThresholdSection(irqState))
+#define ENTER_THREAD_SAFE_SECTION()      ENTER_THREAD_SAFE_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES)
+#define EXIT_THREAD_SAFE_SECTION()       EXIT_THREAD_SAFE_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES)
+#define THREAD_SAFE_SECTION_WITH_BUDGET(budgetCycles, inputSection) \
+  {                                                                 \
+    DECLARE_IRQ_STATE;                                              \
+    ENTER_THREAD_SAFE_SECTION_WITH_BUDGET(budgetCycles);            \
+    {                                                               \
+      inputSection                                                  \
+    }                                                               \
+		EXIT_THREAD_SAFE_SECTION_WITH_BUDGET(budgetCycles);             \
   }
-
-#define ENTER_THREAD_SAFE_SECTION()      irqState = BASEPRI_EnterThreadSafeSection()
-#define EXIT_THREAD_SAFE_SECTION()       BASEPRI_ExitThreadSafeSection(irqState)
 #define THREAD_SAFE_SECTION(inputSection) \
-  {                                       \
-    DECLARE_IRQ_STATE;                    \
-    ENTER_THREAD_SAFE_SECTION();          \
-    {                                     \
-      inputSection                        \
-    }                                     \
-		EXIT_THREAD_SAFE_SECTION();           \
+  THREAD_SAFE_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES, inputSection)
+
+#define ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET(mask, budgetCycles) \
+  (NVIC_EnterSpecificInterruptDisabledSection(&nvicMask, (mask)) NVIC_SECTION_BUDGET_ENTER(budgetCycles))
+#define EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET(budgetCycles)        \
+  (NVIC_SECTION_BUDGET_EXIT(budgetCycles) NVIC_ExitSpecificInterruptDisabledSection(&nvicMask))
+#define ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION(mask) \
+  ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET((mask), INTERRUPT_SECTION_BUDGET_CYCLES)
+#define EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION()      \
+  EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET(INTERRUPT_SECTION_BUDGET_CYCLES)
+#define SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET(mask, budgetCycles, inputSection) \
+  {                                                                                       \
+    DECLARE_NVIC_MASK;                                                                    \
+    ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET((mask), (budgetCycles));        \
+    {                                                                                     \
+      inputSection                                                                        \
+    }                                                                                     \
+		EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET(budgetCycles);                   \
   }
-
-#define ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION(mask)    NVIC_EnterSpecificInterruptDisabledSection(&nvicMask, (mask))
-#define EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION()         NVIC_ExitSpecificInterruptDisabledSection(&nvicMask)
 #define SPECIFIC_INTERRUPT_DISABLED_SECTION(mask, inputSection) \
-  {                                                             \
-    DECLARE_NVIC_STATE;                                         \
-    ENTER_SPECIFIC_INTERRUPT_DISABLED_SECTION(mask);            \
-    {                                                           \
-      inputSection                                              \
-    }                                                           \
-		EXIT_SPECIFIC_INTERRUPT_DISABLED_SECTION();                 \
-  }
+  SPECIFIC_INTERRUPT_DISABLED_SECTION_WITH_BUDGET((mask), INTERRUPT_SECTION_BUDGET_CYCLES, inputSection)
 
 typedef struct
 {
   uint32_t reg[MAX_NVIC_REG_WORDS];
 } NVIC_Mask_t;
 
-__WEAK uint32_t PRIMASK_EnterNoInterruptsSection(void);
-__WEAK void     PRIMASK_ExitNoInterruptsSection(uint32_t irqState);
-__WEAK void     PRIMASK_TriggerPendingInterrupts(void);
+/* Entry of a priority table, see NVIC_SetPriorityTable */
+typedef struct
+{
+  IRQn_Type irqNum;
+  uint8_t   priorityLevel;
+} NVIC_Priority_t;
+
+__WEAK INTERRUPT_FAST_CODE uint32_t PRIMASK_EnterNoInterruptsSection(void);
+__WEAK INTERRUPT_FAST_CODE void     PRIMASK_ExitNoInterruptsSection(uint32_t irqState);
+__WEAK INTERRUPT_FAST_CODE void     PRIMASK_TriggerPendingInterrupts(void);
 __WEAK void     PRIMASK_DisableIrq(void);
 __WEAK void     PRIMASK_EnableIrq(void);
 
 bool            BASEPRI_SetPriorityLevelThreshold(uint8_t inputBasePriLevel);
 int8_t          BASEPRI_GetPriorityLevelThreshold(void);
-__WEAK uint32_t BASEPRI_EnterInterruptsDisabledByThresholdSection(void);
-__WEAK void     BASEPRI_ExitInterruptsDisabledByThresholdSection(uint32_t irqState);
-__WEAK void     BASEPRI_TriggerPendingInterruptsByThreshold(void);
+__WEAK INTERRUPT_FAST_CODE uint32_t BASEPRI_EnterInterruptsDisabledByThresholdSection(void);
+__WEAK INTERRUPT_FAST_CODE void     BASEPRI_ExitInterruptsDisabledByThresholdSection(uint32_t irqState);
+__WEAK INTERRUPT_FAST_CODE void     BASEPRI_TriggerPendingInterruptsByThreshold(void);
+__WEAK INTERRUPT_FAST_CODE uint32_t BASEPRI_EnterPriorityCeilingSection(uint8_t ceilingLevel);
 __WEAK void     BASEPRI_DisableIrqByThreshold(void);
 __WEAK void     BASEPRI_EnableIrqByThreshold(void);
 
-__WEAK bool IRQ_IsInIrqContext(void);
+__WEAK INTERRUPT_FAST_CODE bool IRQ_IsInIrqContext(void);
 __WEAK bool IRQ_IsIRQnBlocked(IRQn_Type irqNum);
 __WEAK bool IRQ_AreAllIRQnsDisabled(void);
 
 void  NVIC_EnterSpecificInterruptDisabledSection(NVIC_Mask_t *nvicState,
                               									 const NVIC_Mask_t *disable);
-void  NVIC_ExitSpecificInterruptDisabledSection(const NVIC_Mask_t *disable);
+void  NVIC_ExitSpecificInterruptDisabledSection(const NVIC_Mask_t *nvicState);
 void  NVIC_TriggerSpecificPendingInterrupts(const NVIC_Mask_t *enable);
 void  NVIC_DisableSpecificInterrupts(const NVIC_Mask_t *disable);
 void  NVIC_EnableSpecificInterrupts(const NVIC_Mask_t *enable);
@@ -98,6 +181,69 @@ bool  NVIC_IsNvicIserMaskDisabled(const NVIC_Mask_t *mask);
 bool  NVIC_IsIRQnDisabled(IRQn_Type irqNum);
 void* NVIC_GetIRQnHandler(IRQn_Type irqNum);
 void  NVIC_SetIRQnHandler(IRQn_Type irqNum, void *handler);
+#if defined(INTERRUPT_ENABLE_RAM_VECTOR_TABLE)
+void  NVIC_RelocateVectorTableToRam(void);
+#endif
+bool  NVIC_SetPriorityTable(const NVIC_Priority_t *table, uint32_t numOfEntries);
+
+void  IRQ_CopyFastSectionsToRam(void);
+void  IRQ_EnableCycleCounter(void);
+
+typedef struct
+{
+  uint32_t numOfViolations;
+  uint32_t numOfWatchdogExpirations;
+  uint32_t lastCallSite;
+  uint32_t lastCycles;
+  uint32_t lastBudgetCycles;
+  uint32_t worstCallSite;
+  uint32_t worstCycles;
+  uint32_t worstBudgetCycles;
+} IRQ_SectionBudgetStats_t;
+
+/* Called on every violation, with interrupts still masked */
+typedef void (*IRQ_SectionBudgetCallback_t)(uint32_t callSite, uint32_t cycles, uint32_t budgetCycles);
+
+INTERRUPT_FAST_CODE uint32_t IRQ_EnterBudgetedSection(uint32_t budgetCycles);
+INTERRUPT_FAST_CODE void     IRQ_ExitBudgetedSection(uint32_t startCycles, uint32_t budgetCycles);
+void  IRQ_SetSectionBudgetCallback(IRQ_SectionBudgetCallback_t callback);
+void  IRQ_GetSectionBudgetStats(IRQ_SectionBudgetStats_t *stats);
+void  IRQ_ResetSectionBudgetStats(void);
+__WEAK void IRQ_ArmSectionWatchdog(uint32_t budgetCycles);
+__WEAK void IRQ_DisarmSectionWatchdog(void);
+void  IRQ_SectionWatchdogExpired(void);
+
+/* Locks of IRQ_GetContentionStats: the BASEPRI levels, then PRIMASK and NVIC */
+#define IRQ_CONTENTION_PRIMASK       (1u << __NVIC_PRIO_BITS)
+#define IRQ_CONTENTION_NVIC          (IRQ_CONTENTION_PRIMASK + 1u)
+#define IRQ_NUM_OF_CONTENTION_LOCKS  (IRQ_CONTENTION_PRIMASK + 2u)
+
+typedef struct
+{
+  uint32_t numOfSections;
+  uint32_t numOfContendedSections;
+  uint32_t numOfBlockedArrivals;
+  uint64_t deferredCycles;
+} IRQ_ContentionStats_t;
+
+bool  IRQ_GetContentionStats(uint32_t lock, IRQ_ContentionStats_t *stats);
+void  IRQ_ResetContentionStats(void);
+
+/* Running exception/interrupt as an IRQn (-16 in thread mode), read from IPSR */
+__STATIC_FORCEINLINE IRQn_Type IRQ_GetActiveIRQn(void)
+{
+  return (IRQn_Type)((int32_t)(__get_IPSR() & 0x1FFUL) - 16);
+}
+
+/* Current value of the DWT cycle counter (0 on cores without DWT CYCCNT) */
+__STATIC_FORCEINLINE uint32_t IRQ_GetCycleCount(void)
+{
+#if (__CORTEX_M >= 3)
+  return DWT->CYCCNT;
+#else
+  return 0u;
+#endif
+}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,610 @@
+#include "irq_instrument.h"
+#include "atomic_ops.h"
+#include "seqlock.h"
+
+#if !defined(INTERRUPT_ENABLE_RAM_VECTOR_TABLE)
+#error "irq_instrument.c relocates the vector table: define INTERRUPT_ENABLE_RAM_VECTOR_TABLE"
+#endif
+
+#define INSTR_NUM_OF_MASK_WORDS    ((INSTR_NUM_OF_RECORDS + 31u) / 32u)
+
+/* Record index of a vector, valid when irqNum >= SysTick_IRQn */
+#define INSTR_INDEX(irqNum)        ((uint32_t)((int32_t)(irqNum) + 16) - INSTR_FIRST_EXCEPTION)
+
+/* The vector table and VTOR as they were before INSTR_Install */
+INTERRUPT_FAST_DATA static uint32_t           savedVectors[INTERRUPT_VECTOR_TABLE_WORDS];
+static uint32_t                               savedVtor;
+static bool                                   isInstalled;
+
+INTERRUPT_FAST_DATA static volatile uint32_t  enabledMask[INSTR_NUM_OF_MASK_WORDS];
+INTERRUPT_FAST_DATA static INSTR_Stats_t      instrRecords[INSTR_NUM_OF_RECORDS];
+INTERRUPT_FAST_DATA static volatile uint32_t  nestingDepth;
+INTERRUPT_FAST_DATA static volatile uint32_t  maxNestingDepth;
+/* Lowest MSP seen on entry of a wrapped handler */
+INTERRUPT_FAST_DATA static volatile uint32_t  mspLowWater = UINT32_MAX;
+
+/* Cycles of the measured handlers nested in the running one */
+INTERRUPT_FAST_DATA static uint32_t           nestedCycles;
+
+/* Records INSTR_RollWindow takes from the stub per PRIMASK section */
+#define INSTR_ROLL_BATCH_RECORDS   16u
+
+/* Window being accumulated by the stub */
+typedef struct
+{
+  uint32_t numOfCalls;
+  uint32_t exclusiveCycles;
+  uint32_t maxExclusiveCycles;
+} INSTR_Window_t;
+
+INTERRUPT_FAST_DATA static INSTR_Window_t     currentWindows[INSTR_NUM_OF_RECORDS];
+/* The last window completed, with its length, as INSTR_GetWindowStats returns it */
+static INSTR_WindowStats_t                    completedWindows[INSTR_NUM_OF_RECORDS];
+static uint32_t                               windowStartCycles;
+static SEQLOCK_Lock_t                         windowLock;
+
+INTERRUPT_FAST_DATA static const INSTR_Hook_t *instrHooks[INSTR_MAX_HOOKS];
+INTERRUPT_FAST_DATA static volatile uint32_t   numOfHooks;
+
+/* Notes:
+
+Instrument the interrupts of existing firmware without touching its drivers.
+
+INSTR_Install saves the vector table and VTOR, relocates the table to RAM and
+points every vector from SysTick on to INSTR_Stub. All the vectors share the
+same stub: it finds the running exception in IPSR and calls the saved
+handler. When the IRQ is enabled with INSTR_EnableIRQ, the stub also counts
+the call, reads the cycle counter before and after the handler, keeps the
+longest and the total run time.
+Registered hooks (INSTR_AddHook) are called with the same timestamps, on entry
+in registration order and on exit in reverse order. INSTR_Remove writes the
+saved table and VTOR back, exactly as they were.
+
+The stub measures two run times. The inclusive one contains the handlers
+that preempted it. The exclusive one does not: every measured handler adds its
+inclusive time to nestedCycles on exit, and the handler it preempted subtracts
+what accumulated there. The previous value is kept on the stack of the stub,
+which makes the preemption stack. The timestamp and the nestedCycles update
+are done with PRIMASK set (a few cycles) so a handler cannot slip in between.
+Handlers that are not enabled are not accounted: their own time goes to the
+exclusive time of the measured handler they preempted. A measured handler
+preempting them still has its time subtracted from that one, as if it had
+preempted it directly.
+
+Exclusive cycles are also accumulated per window. INSTR_RollWindow, called
+periodically (every second from a timer, for example), closes the current
+window of every IRQ and publishes it with the window length. The application
+reads the last completed window with INSTR_GetWindowStats or INSTR_GetLoad
+(USART1 at 3.00%, DMA2 at 11.00% of the last second) while the collection
+goes on. RAM is fixed: 32 bytes per vector from SysTick on for the totals,
+plus 28 bytes per vector for the two windows. INSTR_RollWindow takes the
+current windows from the stub INSTR_ROLL_BATCH_RECORDS records per PRIMASK
+section, a few hundred cycles with interrupts disabled each.
+
+The system exceptions below SysTick are never wrapped: NMI and HardFault must
+not depend on RAM state, and SVCall or PendSV handlers of an RTOS read the
+stacked frame and switch stacks, which only works when they are entered
+directly from the exception.
+
+Every wrapped handler, measured or not, also updates the preemption nesting
+depth (current and maximum) and samples MSP on entry to keep its low-water
+mark: the stack taken by the deepest preemption seen, exception frames
+included, which is what the main stack must be sized for. Add the deepest
+use of the handlers themselves, measured by painting the stack
+(stack_watermark.c).
+
+Every record is only written by its own exception, which cannot preempt
+itself, and the nesting depth is restored by every handler before it returns
+to the one it preempted, so the stub needs no critical section.
+
+Overhead of the stub on a Cortex-M4, in addition to the handler. These are
+estimates, counted by hand from the instructions of the stub with the code in
+zero wait state RAM (INTERRUPT_USE_FAST_RAM), not measurements:
+	- IRQ not enabled:            about 25 cycles (IPSR, nesting depth, MSP sample,
+	                              bitmap test, indirect call);
+	- IRQ enabled, no hook:       about 50 cycles;
+	- each hook:                  a call on entry and on exit, plus the hook itself.
+Count a few more from flash. To measure them on the target, pend an IRQ with
+an empty handler from thread mode (NVIC_SetPendingIRQ) with interrupts
+disabled, read DWT->CYCCNT, enable interrupts and read it again after the
+handler, with and without INSTR_Install: the difference is the overhead of
+the stub. The stub also stacks 24 bytes per nesting level on the main
+stack. Handlers that are not enabled still go through the stub, remove it to
+get the exact original timing back.
+
+For example:
+
+INSTR_Install();
+INSTR_EnableIRQ(USART1_IRQn);
+INSTR_EnableIRQ(DMA2_Stream0_IRQn);
+...
+INSTR_InitWindows(TIM6_PRIORITY_LEVEL);
+
+void TIM6_DAC_IRQHandler(void)
+{
+    INSTR_RollWindow();
+}
+
+load = INSTR_GetLoad(USART1_IRQn);
+INSTR_GetStats(USART1_IRQn, &stats);
+INSTR_Remove();
+
+*/
+
+/**
+	\brief      		 Install the instrumentation stub on every vector.
+	\details    		 Save the vector table and VTOR, relocate the table to RAM and
+									 replace SysTick and the device interrupt handlers by INSTR_Stub.
+									 All the IRQs start disabled (only forwarded).
+	\note       		 Call it from thread mode.
+ */
+void INSTR_Install(void)
+{
+  uint32_t *table;
+
+  if (isInstalled)
+  {
+    return;
+  }
+
+  IRQ_EnableCycleCounter();
+
+  for (uint32_t i = 0; i < INSTR_NUM_OF_MASK_WORDS; i++)
+  {
+    enabledMask[i] = 0u;
+  }
+  INSTR_ResetStats();
+
+  NO_INTERRUPTS_SECTION
+  (
+    savedVtor = SCB->VTOR;
+    table     = (uint32_t*)savedVtor;
+    for (uint32_t i = 0; i < INTERRUPT_VECTOR_TABLE_WORDS; i++)
+    {
+      savedVectors[i] = table[i];
+    }
+
+    NVIC_RelocateVectorTableToRam();
+
+    table = (uint32_t*)SCB->VTOR;
+    for (uint32_t i = INSTR_FIRST_EXCEPTION; i < INTERRUPT_VECTOR_TABLE_WORDS; i++)
+    {
+      if (savedVectors[i] != 0u)
+      {
+        table[i] = (uint32_t)INSTR_Stub;
+      }
+    }
+    isInstalled = true;
+  )
+}
+
+/**
+	\brief      		 Remove the instrumentation stub.
+	\details    		 Write the vector table and VTOR back as they were before INSTR_Install.
+	\note       		 Call it from thread mode. Handlers changed with NVIC_SetIRQnHandler
+									 meanwhile are reverted too.
+ */
+void INSTR_Remove(void)
+{
+  uint32_t *table;
+
+  if (!isInstalled)
+  {
+    return;
+  }
+
+  NO_INTERRUPTS_SECTION
+  (
+    table = (uint32_t*)SCB->VTOR;
+    for (uint32_t i = 0; i < INTERRUPT_VECTOR_TABLE_WORDS; i++)
+    {
+      table[i] = savedVectors[i];
+    }
+    SCB->VTOR   = savedVtor;
+    isInstalled = false;
+    __DSB();
+    __ISB();
+  )
+}
+
+/**
+	\brief      		 Check if the instrumentation stub is installed.
+	\return          true if INSTR_Install has been called and INSTR_Remove has not.
+ */
+bool INSTR_IsInstalled(void)
+{
+  return isInstalled;
+}
+
+/**
+	\brief      		 Start measuring an IRQ.
+	\param [in]      irqNum: SysTick_IRQn or a device interrupt number.
+ */
+void INSTR_EnableIRQ(IRQn_Type irqNum)
+{
+  uint32_t index;
+
+  if ((int32_t)irqNum >= (int32_t)SysTick_IRQn)
+  {
+    index = INSTR_INDEX(irqNum);
+    if (index < INSTR_NUM_OF_RECORDS)
+    {
+      ATOMIC_FetchOr32(&enabledMask[index >> 5], 1UL << (index & 31u));
+    }
+  }
+}
+
+/**
+	\brief      		 Stop measuring an IRQ.
+	\details    		 Its handler is still called through the stub.
+	\param [in]      irqNum: SysTick_IRQn or a device interrupt number.
+ */
+void INSTR_DisableIRQ(IRQn_Type irqNum)
+{
+  uint32_t index;
+
+  if ((int32_t)irqNum >= (int32_t)SysTick_IRQn)
+  {
+    index = INSTR_INDEX(irqNum);
+    if (index < INSTR_NUM_OF_RECORDS)
+    {
+      ATOMIC_FetchAnd32(&enabledMask[index >> 5], ~(1UL << (index & 31u)));
+    }
+  }
+}
+
+/**
+	\brief      		 Check if an IRQ is measured.
+	\param [in]      irqNum: Device specific interrupt number.
+	\return          true if the IRQ has been enabled with INSTR_EnableIRQ.
+ */
+bool INSTR_IsIRQEnabled(IRQn_Type irqNum)
+{
+  bool     isEnabled = false;
+  uint32_t index;
+
+  if ((int32_t)irqNum >= (int32_t)SysTick_IRQn)
+  {
+    index = INSTR_INDEX(irqNum);
+    if (index < INSTR_NUM_OF_RECORDS)
+    {
+      isEnabled = ((enabledMask[index >> 5] & (1UL << (index & 31u))) != 0u);
+    }
+  }
+
+  return isEnabled;
+}
+
+/**
+	\brief      		 Register a hook called by the stub around the measured handlers.
+	\param [in]      hook: The hook, must stay valid (static storage). Its functions
+									 can be NULL.
+	\return          true if the hook is registered, false if INSTR_MAX_HOOKS are.
+	\note       		 Hooks cannot be removed. Call it from thread mode.
+ */
+bool INSTR_AddHook(const INSTR_Hook_t *hook)
+{
+  uint32_t index = numOfHooks;
+
+  if (index >= INSTR_MAX_HOOKS)
+  {
+    return false;
+  }
+
+  /* The stub only reads hooks below numOfHooks */
+  instrHooks[index] = hook;
+  __DMB();
+  numOfHooks = index + 1u;
+
+  return true;
+}
+
+/**
+	\brief      		 Common handler of the instrumented vectors.
+	\details    		 Call the saved handler of the running exception, measuring it
+									 if its IRQ is enabled.
+	\note       		 Installed by INSTR_Install, not meant to be called directly.
+ */
+INTERRUPT_FAST_CODE void INSTR_Stub(void)
+{
+  uint32_t        exception = __get_IPSR() & 0x1FFUL;
+  void          (*handler)(void) = (void (*)(void))savedVectors[exception];
+  uint32_t        index = exception - INSTR_FIRST_EXCEPTION;
+  IRQn_Type       irqNum;
+  INSTR_Stats_t  *record;
+  INSTR_Window_t *window;
+  uint32_t        hookCount;
+  uint32_t        depth;
+  uint32_t        maxDepth;
+  uint32_t        msp;
+  uint32_t        lowWater;
+  uint32_t        irqState;
+  uint32_t        entryCycles;
+  uint32_t        exitCycles;
+  uint32_t        cycles;
+  uint32_t        exclusiveCycles;
+  uint32_t        parentNestedCycles;
+
+  /* Every wrapped handler is counted. A preempting handler may raise the
+   * maximum between the load and the store, hence the compare-exchange. */
+  depth        = nestingDepth + 1u;
+  nestingDepth = depth;
+  maxDepth     = maxNestingDepth;
+  while ((depth > maxDepth) && !ATOMIC_CompareExchange32(&maxNestingDepth, &maxDepth, depth))
+  {
+  }
+
+  msp      = __get_MSP();
+  lowWater = mspLowWater;
+  while ((msp < lowWater) && !ATOMIC_CompareExchange32(&mspLowWater, &lowWater, msp))
+  {
+  }
+
+  if ((enabledMask[index >> 5] & (1UL << (index & 31u))) == 0u)
+  {
+    handler();
+    nestingDepth = depth - 1u;
+    return;
+  }
+
+  /* A handler preempting between the timestamp and the swap would be
+   * charged to the wrong parent */
+  irqState           = PRIMASK_EnterNoInterruptsSection();
+  entryCycles        = IRQ_GetCycleCount();
+  parentNestedCycles = nestedCycles;
+  nestedCycles       = 0u;
+  PRIMASK_ExitNoInterruptsSection(irqState);
+
+  irqNum      = (IRQn_Type)((int32_t)exception - 16);
+  record      = &instrRecords[index];
+  window      = &currentWindows[index];
+  hookCount   = numOfHooks;
+
+  for (uint32_t i = 0; i < hookCount; i++)
+  {
+    if (instrHooks[i]->onEntry != NULL)
+    {
+      instrHooks[i]->onEntry(irqNum, entryCycles);
+    }
+  }
+
+  handler();
+
+  irqState        = PRIMASK_EnterNoInterruptsSection();
+  exitCycles      = IRQ_GetCycleCount();
+  cycles          = exitCycles - entryCycles;
+  exclusiveCycles = cycles - nestedCycles;
+  nestedCycles    = parentNestedCycles + cycles;
+  /* INSTR_RollWindow takes the window with interrupts masked as well */
+  window->numOfCalls++;
+  window->exclusiveCycles += exclusiveCycles;
+  if (exclusiveCycles > window->maxExclusiveCycles)
+  {
+    window->maxExclusiveCycles = exclusiveCycles;
+  }
+  PRIMASK_ExitNoInterruptsSection(irqState);
+
+  for (uint32_t i = hookCount; i > 0u; i--)
+  {
+    if (instrHooks[i - 1u]->onExit != NULL)
+    {
+      instrHooks[i - 1u]->onExit(irqNum, entryCycles, exitCycles);
+    }
+  }
+
+  record->numOfCalls++;
+  record->totalCycles += cycles;
+  record->totalExclusiveCycles += exclusiveCycles;
+  if (cycles > record->maxCycles)
+  {
+    record->maxCycles = cycles;
+  }
+  if (exclusiveCycles > record->maxExclusiveCycles)
+  {
+    record->maxExclusiveCycles = exclusiveCycles;
+  }
+
+  nestingDepth = depth - 1u;
+}
+
+/**
+	\brief      		 Get the measurements of an IRQ.
+	\param [in]      irqNum: SysTick_IRQn or a device interrupt number.
+	\param [out]     stats:  Number of calls, longest and total run times in cycles, inclusive
+									 and exclusive of nested handlers.
+	\return          true if irqNum has a record.
+ */
+bool INSTR_GetStats(IRQn_Type irqNum, INSTR_Stats_t *stats)
+{
+  uint32_t index;
+
+  if ((int32_t)irqNum < (int32_t)SysTick_IRQn)
+  {
+    return false;
+  }
+
+  index = INSTR_INDEX(irqNum);
+  if (index >= INSTR_NUM_OF_RECORDS)
+  {
+    return false;
+  }
+
+  /* The totals are 64 bits wide, copy them in one piece */
+  NO_INTERRUPTS_SECTION
+  (
+    *stats = instrRecords[index];
+  )
+
+  return true;
+}
+
+/**
+	\brief      		 Reset the measurements of all the IRQs, the maximum nesting depth and
+									 the MSP low-water mark.
+ */
+void INSTR_ResetStats(void)
+{
+  for (uint32_t i = 0; i < INSTR_NUM_OF_RECORDS; i++)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      instrRecords[i] = (INSTR_Stats_t){0};
+    )
+  }
+  maxNestingDepth = nestingDepth;
+  mspLowWater     = UINT32_MAX;
+}
+
+/**
+	\brief      		 Get the number of wrapped handlers running.
+	\return          0 in thread mode, else how many handlers preempting each other are
+									 running (system exceptions below SysTick not included).
+ */
+uint32_t INSTR_GetNestingDepth(void)
+{
+  return nestingDepth;
+}
+
+/**
+	\brief      		 Get the deepest nesting of wrapped handlers seen.
+	\return          The maximum of INSTR_GetNestingDepth since the last reset.
+ */
+uint32_t INSTR_GetMaxNestingDepth(void)
+{
+  return maxNestingDepth;
+}
+
+/**
+	\brief      		 Get the lowest main stack pointer seen on entry of a wrapped handler.
+	\return          The MSP low-water mark, UINT32_MAX if no handler ran since the last reset.
+	\note       		 Sampled at entry: the stack used inside the deepest handler is not
+									 included, see stack_watermark.c for that.
+ */
+uint32_t INSTR_GetMspLowWater(void)
+{
+  return mspLowWater;
+}
+
+/**
+	\brief      		 Get the main stack used by the deepest preemption seen.
+	\return          Bytes between the initial MSP (first word of the vector table) and the
+									 MSP low-water mark, 0 if no handler ran since the last reset.
+ */
+uint32_t INSTR_GetMaxMspUsage(void)
+{
+  uint32_t lowWater = mspLowWater;
+
+  return (lowWater == UINT32_MAX) ? 0u : (savedVectors[0] - lowWater);
+}
+
+/**
+	\brief      		 Start accounting the IRQs per window.
+	\details    		 Start the current window and clear the completed one.
+	\param [in]      rollerPriorityLevel: Priority level of the context calling INSTR_RollWindow,
+									 masked by the readers of the completed window when it keeps
+									 preempting them.
+	\return          false if rollerPriorityLevel is above INTERRUPT_LOWEST_PRIORITY.
+ */
+bool INSTR_InitWindows(uint8_t rollerPriorityLevel)
+{
+  if (!SEQLOCK_Init(&windowLock, rollerPriorityLevel))
+  {
+    return false;
+  }
+
+  for (uint32_t first = 0; first < INSTR_NUM_OF_RECORDS; first += INSTR_ROLL_BATCH_RECORDS)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      for (uint32_t i = first; (i < (first + INSTR_ROLL_BATCH_RECORDS)) && (i < INSTR_NUM_OF_RECORDS); i++)
+      {
+        currentWindows[i] = (INSTR_Window_t){0};
+      }
+    )
+  }
+  for (uint32_t i = 0; i < INSTR_NUM_OF_RECORDS; i++)
+  {
+    completedWindows[i] = (INSTR_WindowStats_t){0};
+  }
+  windowStartCycles = IRQ_GetCycleCount();
+
+  return true;
+}
+
+/**
+	\brief      		 Close the current window and start the next one.
+	\details    		 Publish the calls and exclusive cycles of every IRQ since the previous
+									 call, and the length of the window.
+	\note       		 Call it periodically from a single context, at the priority level given
+									 to INSTR_InitWindows. A window must be shorter than 2^32 cycles.
+ */
+void INSTR_RollWindow(void)
+{
+  uint32_t now          = IRQ_GetCycleCount();
+  uint32_t windowCycles = now - windowStartCycles;
+
+  SEQLOCK_WriteBegin(&windowLock);
+  for (uint32_t first = 0; first < INSTR_NUM_OF_RECORDS; first += INSTR_ROLL_BATCH_RECORDS)
+  {
+    /* The stub updates the current window with interrupts masked */
+    NO_INTERRUPTS_SECTION
+    (
+      for (uint32_t i = first; (i < (first + INSTR_ROLL_BATCH_RECORDS)) && (i < INSTR_NUM_OF_RECORDS); i++)
+      {
+        completedWindows[i].windowCycles       = windowCycles;
+        completedWindows[i].numOfCalls         = currentWindows[i].numOfCalls;
+        completedWindows[i].exclusiveCycles    = currentWindows[i].exclusiveCycles;
+        completedWindows[i].maxExclusiveCycles = currentWindows[i].maxExclusiveCycles;
+        currentWindows[i]                      = (INSTR_Window_t){0};
+      }
+    )
+  }
+  windowStartCycles = now;
+  SEQLOCK_WriteEnd(&windowLock);
+}
+
+/**
+	\brief      		 Get the last completed window of an IRQ.
+	\param [in]      irqNum: SysTick_IRQn or a device interrupt number.
+	\param [out]     stats:  Length of the window, calls and exclusive cycles of the IRQ in it.
+	\return          true if irqNum has a record.
+	\note       		 Does not stop the collection.
+ */
+bool INSTR_GetWindowStats(IRQn_Type irqNum, INSTR_WindowStats_t *stats)
+{
+  uint32_t index;
+
+  if ((int32_t)irqNum < (int32_t)SysTick_IRQn)
+  {
+    return false;
+  }
+
+  index = INSTR_INDEX(irqNum);
+  if (index >= INSTR_NUM_OF_RECORDS)
+  {
+    return false;
+  }
+
+  SEQLOCK_Read(&windowLock, stats, &completedWindows[index], sizeof(*stats));
+
+  return true;
+}
+
+/**
+	\brief      		 Get the CPU load of an IRQ in the last completed window.
+	\param [in]      irqNum: SysTick_IRQn or a device interrupt number.
+	\return          The exclusive cycles of the IRQ over the window length, in hundredths of
+									 percent (300 is 3.00%), 0 if there is no completed window.
+ */
+uint32_t INSTR_GetLoad(IRQn_Type irqNum)
+{
+  INSTR_WindowStats_t stats;
+  uint32_t            load = 0u;
+
+  if (INSTR_GetWindowStats(irqNum, &stats) && (stats.windowCycles != 0u))
+  {
+    load = (uint32_t)(((uint64_t)stats.exclusiveCycles * 10000u) / stats.windowCycles);
+  }
+
+  return load;
+}
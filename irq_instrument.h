@@ -0,0 +1,69 @@
+#ifndef IRQ_INSTRUMENT_H
+#define IRQ_INSTRUMENT_H
+
+#include "interrupt_handling.h"
+
+/* Instrumented vectors: SysTick and the device interrupts */
+#define INSTR_FIRST_EXCEPTION      15u
+#define INSTR_NUM_OF_RECORDS       (INTERRUPT_VECTOR_TABLE_WORDS - INSTR_FIRST_EXCEPTION)
+
+/* Number of hooks that can be registered */
+#ifndef INSTR_MAX_HOOKS
+#define INSTR_MAX_HOOKS            4u
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called by the stub around the original handler, from the handler context */
+typedef struct
+{
+  void (*onEntry)(IRQn_Type irqNum, uint32_t entryCycles);
+  void (*onExit)(IRQn_Type irqNum, uint32_t entryCycles, uint32_t exitCycles);
+} INSTR_Hook_t;
+
+typedef struct
+{
+  uint32_t numOfCalls;
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+  uint32_t maxExclusiveCycles;
+  uint64_t totalExclusiveCycles;
+} INSTR_Stats_t;
+
+typedef struct
+{
+  uint32_t windowCycles;
+  uint32_t numOfCalls;
+  uint32_t exclusiveCycles;
+  uint32_t maxExclusiveCycles;
+} INSTR_WindowStats_t;
+
+void     INSTR_Install(void);
+void     INSTR_Remove(void);
+bool     INSTR_IsInstalled(void);
+void     INSTR_EnableIRQ(IRQn_Type irqNum);
+void     INSTR_DisableIRQ(IRQn_Type irqNum);
+bool     INSTR_IsIRQEnabled(IRQn_Type irqNum);
+bool     INSTR_AddHook(const INSTR_Hook_t *hook);
+
+INTERRUPT_FAST_CODE void INSTR_Stub(void);
+
+bool     INSTR_GetStats(IRQn_Type irqNum, INSTR_Stats_t *stats);
+void     INSTR_ResetStats(void);
+uint32_t INSTR_GetNestingDepth(void);
+uint32_t INSTR_GetMaxNestingDepth(void);
+uint32_t INSTR_GetMspLowWater(void);
+uint32_t INSTR_GetMaxMspUsage(void);
+
+bool     INSTR_InitWindows(uint8_t rollerPriorityLevel);
+void     INSTR_RollWindow(void);
+bool     INSTR_GetWindowStats(IRQn_Type irqNum, INSTR_WindowStats_t *stats);
+uint32_t INSTR_GetLoad(IRQn_Type irqNum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_INSTRUMENT_H */
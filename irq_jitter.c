@@ -0,0 +1,413 @@
+#include "irq_jitter.h"
+#include "irq_instrument.h"
+#include "seqlock.h"
+#include <stdio.h>
+
+/* Deviations counted in the mean and the standard deviation are clamped, so
+ * that the sum of squares cannot overflow */
+#define JITTER_MAX_SUMMED_DEVIATION ((int32_t)1 << 20)
+
+typedef struct
+{
+  uint32_t       numOfSamples;
+  uint32_t       minPeriodCycles;
+  uint32_t       maxPeriodCycles;
+  int64_t        sumDeviation;
+  uint64_t       sumSquaredDeviation;
+  uint16_t       histogram[JITTER_NUM_OF_BUCKETS];
+  uint32_t       numOfLateArrivals;
+  uint32_t       numOfUnknownCauses;
+  uint32_t       numOfCauses;
+  JITTER_Cause_t causes[JITTER_MAX_CAUSES];
+} JITTER_Data_t;
+
+static IRQn_Type      jitterIrqNum;
+static uint32_t       jitterNominalPeriodCycles;
+static uint32_t       jitterBucketCycles;
+static uint32_t       jitterLateThresholdCycles;
+static bool           isInitialized;
+static bool           hasPreviousArrival;
+static uint32_t       previousArrivalCycles;
+static JITTER_Data_t  jitterData;
+static SEQLOCK_Lock_t jitterLock;
+
+static void JITTER_OnIrqEntry(IRQn_Type irqNum, uint32_t entryCycles);
+
+static const INSTR_Hook_t jitterHook = { JITTER_OnIrqEntry, NULL };
+
+/* Notes:
+
+Jitter of a periodic interrupt, typically the timer update interrupt running
+a control loop. Every entry of the handler is timestamped with the cycle
+counter, either by calling JITTER_Sample first thing in the handler, or by
+the irq_instrument.c stub when the IRQ is instrumented
+(JITTER_AttachToInstrument, no change to the handler). The time since the
+previous entry is compared with the nominal period:
+	- min and max period;
+	- mean and standard deviation of the deviation, from exact integer sums
+	  (deviations clamped to +/-2^20 cycles in the sums);
+	- histogram of the deviation, JITTER_NUM_OF_BUCKETS buckets of bucketCycles
+	  each, centered on the nominal period (the first and last buckets take
+	  everything beyond).
+
+An entry later than lateThresholdCycles is a late arrival. When the trace
+recorder runs (trace_recorder.c, with interrupt_handling.c built with
+INTERRUPT_ENABLE_TRACE and IRQ tracing enabled), the last section exit, IRQ
+exit or BASEPRI change before the entry, if it happened within the delay
+(and within 65535 cycles, the timestamps kept by the recorder), is what held
+the interrupt back: the late arrival is charged to it (for
+example "section_exit PRIMASK" or "irq_exit 44"). The JITTER_MAX_CAUSES
+distinct causes seen first are kept, the others and the late arrivals
+without a recent event are counted as unknown.
+
+A deviation is between two entries: a late entry makes one long period and,
+if the next entry is on time, one short period. Only the long one is a late
+arrival.
+
+The data is written by the IRQ and read under a sequence lock, the IRQ is
+never masked by JITTER_GetStats. JITTER_Export writes the results as text
+lines, for a console or a log sent to the host.
+
+For example:
+
+JITTER_Init(TIM1_UP_TIM10_IRQn, SystemCoreClock / 10000u, 16u, 64u);
+
+void TIM1_UP_TIM10_IRQHandler(void)
+{
+    JITTER_Sample();
+    CONTROL_Step();
+}
+
+*/
+
+/* Integer square root, rounded down */
+static uint32_t JITTER_SquareRoot(uint64_t value)
+{
+  uint64_t root = 0u;
+  uint64_t bit  = (uint64_t)1 << 62;
+
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0u)
+  {
+    if (value >= (root + bit))
+    {
+      value -= root + bit;
+      root   = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return (uint32_t)root;
+}
+
+/* Histogram bucket of a deviation */
+__STATIC_FORCEINLINE uint32_t JITTER_GetBucket(int32_t deviation)
+{
+  int32_t bucket;
+
+  /* Rounded towards minus infinity, so that 0 starts the upper half */
+  bucket = (deviation >= 0) ? (deviation / (int32_t)jitterBucketCycles)
+                            : (((deviation + 1) / (int32_t)jitterBucketCycles) - 1);
+  bucket += (int32_t)(JITTER_NUM_OF_BUCKETS / 2u);
+
+  if (bucket < 0)
+  {
+    bucket = 0;
+  }
+  else if (bucket >= (int32_t)JITTER_NUM_OF_BUCKETS)
+  {
+    bucket = (int32_t)JITTER_NUM_OF_BUCKETS - 1;
+  }
+
+  return (uint32_t)bucket;
+}
+
+/* Charge a late arrival to the event that unblocked the IRQ */
+__STATIC_FORCEINLINE void JITTER_Attribute(uint32_t entryCycles, uint32_t deviation)
+{
+  TRACE_Event_t   event;
+  uint32_t        payload;
+  JITTER_Cause_t *cause = NULL;
+  bool            isKnown;
+
+  /* The recorder keeps 16-bit timestamps; the event that unblocked the IRQ
+   * is just before its entry, well within them */
+  isKnown = TRACE_GetLastUnblockingEvent(entryCycles,
+                                         (deviation < TRACE_TIMESTAMP_MASK) ? deviation : TRACE_TIMESTAMP_MASK,
+                                         &event, &payload);
+  /* The previous exit of the IRQ itself is not a cause */
+  if (isKnown && (event == TRACE_EVENT_IRQ_EXIT) && (payload == (uint32_t)((int32_t)jitterIrqNum + 16)))
+  {
+    isKnown = false;
+  }
+
+  jitterData.numOfLateArrivals++;
+
+  if (isKnown)
+  {
+    for (uint32_t i = 0; i < jitterData.numOfCauses; i++)
+    {
+      if ((jitterData.causes[i].event == event) && (jitterData.causes[i].payload == payload))
+      {
+        cause = &jitterData.causes[i];
+        break;
+      }
+    }
+    if ((cause == NULL) && (jitterData.numOfCauses < JITTER_MAX_CAUSES))
+    {
+      cause          = &jitterData.causes[jitterData.numOfCauses++];
+      cause->event   = event;
+      cause->payload = payload;
+    }
+  }
+
+  if (cause == NULL)
+  {
+    jitterData.numOfUnknownCauses++;
+    return;
+  }
+
+  cause->numOfLateArrivals++;
+  if (deviation > cause->maxDeviationCycles)
+  {
+    cause->maxDeviationCycles = deviation;
+  }
+}
+
+/* Account an entry of the IRQ */
+__STATIC_FORCEINLINE void JITTER_Record(uint32_t entryCycles)
+{
+  uint32_t period;
+  int32_t  deviation;
+  int32_t  summedDeviation;
+  uint32_t bucket;
+
+  if (!hasPreviousArrival)
+  {
+    previousArrivalCycles = entryCycles;
+    hasPreviousArrival    = true;
+    return;
+  }
+
+  period                = entryCycles - previousArrivalCycles;
+  previousArrivalCycles = entryCycles;
+  deviation             = (int32_t)(period - jitterNominalPeriodCycles);
+
+  summedDeviation = deviation;
+  if (summedDeviation > JITTER_MAX_SUMMED_DEVIATION)
+  {
+    summedDeviation = JITTER_MAX_SUMMED_DEVIATION;
+  }
+  else if (summedDeviation < -JITTER_MAX_SUMMED_DEVIATION)
+  {
+    summedDeviation = -JITTER_MAX_SUMMED_DEVIATION;
+  }
+
+  SEQLOCK_WriteBegin(&jitterLock);
+  jitterData.numOfSamples++;
+  if (period < jitterData.minPeriodCycles)
+  {
+    jitterData.minPeriodCycles = period;
+  }
+  if (period > jitterData.maxPeriodCycles)
+  {
+    jitterData.maxPeriodCycles = period;
+  }
+  jitterData.sumDeviation        += summedDeviation;
+  jitterData.sumSquaredDeviation += (uint64_t)((int64_t)summedDeviation * summedDeviation);
+  bucket = JITTER_GetBucket(deviation);
+  if (jitterData.histogram[bucket] != UINT16_MAX)
+  {
+    jitterData.histogram[bucket]++;
+  }
+  if (deviation > (int32_t)jitterLateThresholdCycles)
+  {
+    JITTER_Attribute(entryCycles, (uint32_t)deviation);
+  }
+  SEQLOCK_WriteEnd(&jitterLock);
+}
+
+static void JITTER_OnIrqEntry(IRQn_Type irqNum, uint32_t entryCycles)
+{
+  if (isInitialized && (irqNum == jitterIrqNum))
+  {
+    JITTER_Record(entryCycles);
+  }
+}
+
+/**
+	\brief      		 Start analyzing the jitter of a periodic IRQ.
+	\param [in]      irqNum:              The periodic IRQ.
+	\param [in]      nominalPeriodCycles: Expected period in cycles.
+	\param [in]      bucketCycles:        Width of a histogram bucket in cycles.
+	\param [in]      lateThresholdCycles: Deviation above which an entry is a late arrival
+									 whose cause is looked for.
+	\return          true if started, false if bucketCycles or nominalPeriodCycles is 0, or
+									 if the priority of the IRQ is above INTERRUPT_LOWEST_PRIORITY.
+	\note       		 Call it with the IRQ disabled or before it is enabled, once its
+									 priority is set: the statistics are reset with it masked.
+ */
+bool JITTER_Init(IRQn_Type irqNum, uint32_t nominalPeriodCycles, uint32_t bucketCycles,
+                 uint32_t lateThresholdCycles)
+{
+  if ((nominalPeriodCycles == 0u) || (bucketCycles == 0u)
+      || !SEQLOCK_Init(&jitterLock, (uint8_t)NVIC_GetPriority(irqNum)))
+  {
+    return false;
+  }
+
+  IRQ_EnableCycleCounter();
+
+  jitterIrqNum              = irqNum;
+  jitterNominalPeriodCycles = nominalPeriodCycles;
+  jitterBucketCycles        = bucketCycles;
+  jitterLateThresholdCycles = lateThresholdCycles;
+  JITTER_ResetStats();
+  isInitialized = true;
+
+  return true;
+}
+
+/**
+	\brief      		 Sample the IRQ from the instrumentation stub.
+	\details    		 Register a hook in irq_instrument.c instead of calling JITTER_Sample:
+									 the IRQ must be enabled with INSTR_EnableIRQ.
+	\return          true if the hook is registered, false if irq_instrument.c has no room left.
+	\note       		 Call it once.
+ */
+bool JITTER_AttachToInstrument(void)
+{
+  return INSTR_AddHook(&jitterHook);
+}
+
+/**
+	\brief      		 Record an entry of the analyzed IRQ.
+	\note       		 Call it first thing in the handler, unless JITTER_AttachToInstrument
+									 is used.
+ */
+INTERRUPT_FAST_CODE void JITTER_Sample(void)
+{
+  uint32_t entryCycles = IRQ_GetCycleCount();
+
+  if (isInitialized)
+  {
+    JITTER_Record(entryCycles);
+  }
+}
+
+/**
+	\brief      		 Get the jitter statistics.
+	\param [out]     stats: The statistics, with the mean and the standard deviation computed.
+	\note       		 Does not mask the IRQ, unless it keeps preempting the copy.
+ */
+void JITTER_GetStats(JITTER_Stats_t *stats)
+{
+  JITTER_Data_t data;
+  int64_t       mean     = 0;
+  uint64_t      variance = 0u;
+
+  SEQLOCK_Read(&jitterLock, &data, &jitterData, sizeof(data));
+
+  if (data.numOfSamples != 0u)
+  {
+    mean     = data.sumDeviation / (int64_t)data.numOfSamples;
+    variance = (data.sumSquaredDeviation / data.numOfSamples) - (uint64_t)(mean * mean);
+    /* Rounding of the two divisions */
+    if ((int64_t)variance < 0)
+    {
+      variance = 0u;
+    }
+  }
+
+  stats->nominalPeriodCycles = jitterNominalPeriodCycles;
+  stats->bucketCycles        = jitterBucketCycles;
+  stats->numOfSamples        = data.numOfSamples;
+  stats->minPeriodCycles     = (data.numOfSamples != 0u) ? data.minPeriodCycles : 0u;
+  stats->maxPeriodCycles     = data.maxPeriodCycles;
+  stats->meanDeviationCycles = (int32_t)mean;
+  stats->stdDeviationCycles  = JITTER_SquareRoot(variance);
+  stats->numOfLateArrivals   = data.numOfLateArrivals;
+  stats->numOfUnknownCauses  = data.numOfUnknownCauses;
+  for (uint32_t i = 0; i < JITTER_NUM_OF_BUCKETS; i++)
+  {
+    stats->histogram[i] = data.histogram[i];
+  }
+  for (uint32_t i = 0; i < JITTER_MAX_CAUSES; i++)
+  {
+    stats->causes[i] = (i < data.numOfCauses) ? data.causes[i] : (JITTER_Cause_t){0};
+  }
+}
+
+/**
+	\brief      		 Reset the jitter statistics.
+	\details    		 The next entry of the IRQ starts a new period.
+ */
+void JITTER_ResetStats(void)
+{
+  uint32_t irqState = SEQLOCK_EnterWriterMaskedSection(&jitterLock);
+
+  jitterData                 = (JITTER_Data_t){0};
+  jitterData.minPeriodCycles = UINT32_MAX;
+  hasPreviousArrival         = false;
+
+  SEQLOCK_ExitWriterMaskedSection(&jitterLock, irqState);
+}
+
+/**
+	\brief      		 Export the jitter statistics.
+	\details    		 Write a "jitter irq=<n> nominal=<c> samples=<n> min=<c> max=<c> mean=<c>
+									 std=<c> late=<n> unknown=<n> bucket=<c> hist=<b0>,<b1>,..." line, then
+									 a "jitter_cause event=<type> payload=<p> late=<n> max=<c>" line per
+									 cause, with durations in cycles.
+	\param [in]      writeLine: Function receiving each line.
+ */
+void JITTER_Export(JITTER_WriteLineFn_t writeLine)
+{
+  static const char *eventNames[] =
+  {
+    "sync", "irq_enter", "irq_exit", "section_enter", "section_exit", "basepri", "marker", "marker_value"
+  };
+  JITTER_Stats_t stats;
+  char           line[160 + (JITTER_NUM_OF_BUCKETS * 6u)];
+  int            length;
+
+  JITTER_GetStats(&stats);
+
+  length = snprintf(line, sizeof(line),
+                    "jitter irq=%d nominal=%lu samples=%lu min=%lu max=%lu mean=%ld std=%lu late=%lu unknown=%lu bucket=%lu hist=",
+                    (int)jitterIrqNum,
+                    (unsigned long)stats.nominalPeriodCycles,
+                    (unsigned long)stats.numOfSamples,
+                    (unsigned long)stats.minPeriodCycles,
+                    (unsigned long)stats.maxPeriodCycles,
+                    (long)stats.meanDeviationCycles,
+                    (unsigned long)stats.stdDeviationCycles,
+                    (unsigned long)stats.numOfLateArrivals,
+                    (unsigned long)stats.numOfUnknownCauses,
+                    (unsigned long)stats.bucketCycles);
+
+  for (uint32_t k = 0; (k < JITTER_NUM_OF_BUCKETS) && (length > 0) && ((uint32_t)length < sizeof(line)); k++)
+  {
+    length += snprintf(&line[length], sizeof(line) - (uint32_t)length,
+                       (k == 0u) ? "%u" : ",%u", (unsigned)stats.histogram[k]);
+  }
+  writeLine(line);
+
+  for (uint32_t i = 0; (i < JITTER_MAX_CAUSES) && (stats.causes[i].numOfLateArrivals != 0u); i++)
+  {
+    snprintf(line, sizeof(line), "jitter_cause event=%s payload=%lu late=%lu max=%lu",
+             ((uint32_t)stats.causes[i].event < (sizeof(eventNames) / sizeof(eventNames[0])))
+               ? eventNames[stats.causes[i].event] : "unknown",
+             (unsigned long)stats.causes[i].payload,
+             (unsigned long)stats.causes[i].numOfLateArrivals,
+             (unsigned long)stats.causes[i].maxDeviationCycles);
+    writeLine(line);
+  }
+}
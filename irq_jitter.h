@@ -0,0 +1,60 @@
+#ifndef IRQ_JITTER_H
+#define IRQ_JITTER_H
+
+#include "interrupt_handling.h"
+#include "trace_recorder.h"
+
+/* Histogram of the deviation from the nominal period, centered on 0 */
+#ifndef JITTER_NUM_OF_BUCKETS
+#define JITTER_NUM_OF_BUCKETS      16u
+#endif
+
+/* Distinct causes of late arrivals kept */
+#ifndef JITTER_MAX_CAUSES
+#define JITTER_MAX_CAUSES          8u
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Receives one line of JITTER_Export, without newline */
+typedef void (*JITTER_WriteLineFn_t)(const char *line);
+
+/* What was running or masking just before a late arrival */
+typedef struct
+{
+  TRACE_Event_t event;
+  uint32_t      payload;
+  uint32_t      numOfLateArrivals;
+  uint32_t      maxDeviationCycles;
+} JITTER_Cause_t;
+
+typedef struct
+{
+  uint32_t       nominalPeriodCycles;
+  uint32_t       bucketCycles;
+  uint32_t       numOfSamples;
+  uint32_t       minPeriodCycles;
+  uint32_t       maxPeriodCycles;
+  int32_t        meanDeviationCycles;
+  uint32_t       stdDeviationCycles;
+  uint16_t       histogram[JITTER_NUM_OF_BUCKETS];
+  uint32_t       numOfLateArrivals;
+  uint32_t       numOfUnknownCauses;
+  JITTER_Cause_t causes[JITTER_MAX_CAUSES];
+} JITTER_Stats_t;
+
+bool JITTER_Init(IRQn_Type irqNum, uint32_t nominalPeriodCycles, uint32_t bucketCycles,
+                 uint32_t lateThresholdCycles);
+bool JITTER_AttachToInstrument(void);
+INTERRUPT_FAST_CODE void JITTER_Sample(void);
+void JITTER_GetStats(JITTER_Stats_t *stats);
+void JITTER_ResetStats(void);
+void JITTER_Export(JITTER_WriteLineFn_t writeLine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_JITTER_H */
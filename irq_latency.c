@@ -0,0 +1,366 @@
+#include "irq_latency.h"
+#include <stdio.h>
+
+typedef struct
+{
+  IRQn_Type           irqNum;
+  bool                isUsed;
+  void               *originalHandler;
+  LATENCY_ArrivalFn_t arrivalFn;
+  /* Arrival time stored by LATENCY_SetPendingIRQ */
+  volatile uint32_t   pendedCycles;
+  SEQLOCK_Lock_t      lock;
+  LATENCY_Stats_t     stats;
+} LATENCY_Entry_t;
+
+INTERRUPT_FAST_DATA static LATENCY_Entry_t latencyEntries[LATENCY_MAX_TRACKED_IRQS];
+
+/* Notes:
+
+Interrupt latency is the time between the event that raises an interrupt and
+the first instruction of its handler. It includes the masked sections and the
+higher priority handlers that delayed it, which is what a budget is about.
+
+LATENCY_Enable replaces the handler of an IRQ (through NVIC_SetIRQnHandler,
+the vector table must be in RAM) by LATENCY_Dispatcher, which reads the cycle
+counter first, asks for the arrival time, records the difference, then calls
+the original handler. LATENCY_Disable puts the original handler back.
+
+The arrival time comes from:
+	- a peripheral or a timer, through the arrivalFn given to LATENCY_Enable.
+	  For example a timer output compare raising the IRQ knows when it
+	  matched: arrival = now - (TIMx->CNT - TIMx->CCR1) * cycles per tick;
+	- LATENCY_SetPendingIRQ, when arrivalFn is NULL, which stores the cycle
+	  counter and pends the IRQ (software-triggered measurements).
+
+For every IRQ, in about 130 bytes: number of samples, min, max, number of
+samples over the budget, and a histogram of log2 buckets from which
+LATENCY_GetPercentile estimates any percentile (exact to the bucket, linear
+inside it). The buckets count as far as numOfSamples does, so the
+percentiles and the histogram stay consistent with it over a long run. The
+statistics are updated by the IRQ itself and read through a sequence lock,
+so reading them never masks the IRQ.
+
+The cycle counter must be running (IRQ_EnableCycleCounter), which excludes
+ARMv6-M.
+
+*/
+
+/* Entry of an IRQ, NULL if it is not tracked */
+__STATIC_FORCEINLINE LATENCY_Entry_t *LATENCY_FindEntry(IRQn_Type irqNum)
+{
+  for (uint32_t i = 0; i < LATENCY_MAX_TRACKED_IRQS; i++)
+  {
+    if (latencyEntries[i].isUsed && (latencyEntries[i].irqNum == irqNum))
+    {
+      return &latencyEntries[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Histogram bucket of a latency */
+__STATIC_FORCEINLINE uint32_t LATENCY_GetBucket(uint32_t cycles)
+{
+  uint32_t bucket = 0u;
+
+#if (__CORTEX_M >= 3)
+  if (cycles != 0u)
+  {
+    bucket = 31u - __CLZ(cycles);
+  }
+#else
+  while (cycles > 1u)
+  {
+    cycles >>= 1;
+    bucket++;
+  }
+#endif
+
+  return (bucket < LATENCY_NUM_OF_BUCKETS) ? bucket : (LATENCY_NUM_OF_BUCKETS - 1u);
+}
+
+/* Clear the statistics of an entry, keeping the budget */
+static void LATENCY_ClearStats(LATENCY_Stats_t *stats)
+{
+  uint32_t budgetCycles = stats->budgetCycles;
+
+  *stats = (LATENCY_Stats_t){0};
+  stats->minCycles    = UINT32_MAX;
+  stats->budgetCycles = budgetCycles;
+}
+
+/**
+	\brief      		 Start measuring the latency of an IRQ.
+	\param [in]      irqNum:       Device interrupt number.
+	\param [in]      arrivalFn:    Function giving the arrival time of the interrupt, NULL
+									 to use the time stored by LATENCY_SetPendingIRQ.
+	\param [in]      budgetCycles: Latency budget, samples above it are counted (0: no budget).
+	\return          true if the IRQ is measured, false if it is not a device interrupt,
+									 is already measured, LATENCY_MAX_TRACKED_IRQS are, or its
+									 priority is above INTERRUPT_LOWEST_PRIORITY.
+	\note       		 The vector table must be in RAM (see NVIC_RelocateVectorTableToRam).
+									 The priority of the IRQ must be set before, and not changed while
+									 it is measured: the statistics are copied with it masked.
+ */
+bool LATENCY_Enable(IRQn_Type irqNum, LATENCY_ArrivalFn_t arrivalFn, uint32_t budgetCycles)
+{
+  LATENCY_Entry_t *entry = NULL;
+
+  if (((int16_t)irqNum < 0) || (LATENCY_FindEntry(irqNum) != NULL))
+  {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < LATENCY_MAX_TRACKED_IRQS; i++)
+  {
+    if (!latencyEntries[i].isUsed)
+    {
+      entry = &latencyEntries[i];
+      break;
+    }
+  }
+
+  /* Statistics copies mask the IRQ at its level (PRIMASK for level 0) */
+  if ((entry == NULL) || !SEQLOCK_Init(&entry->lock, (uint8_t)NVIC_GetPriority(irqNum)))
+  {
+    return false;
+  }
+
+  IRQ_EnableCycleCounter();
+
+  entry->irqNum             = irqNum;
+  entry->arrivalFn          = arrivalFn;
+  entry->pendedCycles       = 0u;
+  entry->stats.budgetCycles = budgetCycles;
+  LATENCY_ClearStats(&entry->stats);
+
+  NO_INTERRUPTS_SECTION
+  (
+    entry->originalHandler = NVIC_GetIRQnHandler(irqNum);
+    entry->isUsed          = true;
+    NVIC_SetIRQnHandler(irqNum, (void*)LATENCY_Dispatcher);
+  )
+
+  return true;
+}
+
+/**
+	\brief      		 Stop measuring the latency of an IRQ.
+	\details    		 Put the original handler back.
+	\param [in]      irqNum: Device interrupt number.
+ */
+void LATENCY_Disable(IRQn_Type irqNum)
+{
+  LATENCY_Entry_t *entry = LATENCY_FindEntry(irqNum);
+
+  if (entry != NULL)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      NVIC_SetIRQnHandler(irqNum, entry->originalHandler);
+      entry->isUsed = false;
+    )
+  }
+}
+
+/**
+	\brief      		 Pend a measured IRQ, storing its arrival time.
+	\param [in]      irqNum: Device interrupt number, measured without arrivalFn.
+ */
+INTERRUPT_FAST_CODE void LATENCY_SetPendingIRQ(IRQn_Type irqNum)
+{
+  LATENCY_Entry_t *entry = LATENCY_FindEntry(irqNum);
+
+  if (entry != NULL)
+  {
+    entry->pendedCycles = IRQ_GetCycleCount();
+  }
+  NVIC_SetPendingIRQ(irqNum);
+}
+
+/**
+	\brief      		 Interrupt handler of the measured IRQs.
+	\details    		 Record the latency of the running interrupt then call its
+									 original handler.
+	\note       		 Installed by LATENCY_Enable, not meant to be called directly.
+ */
+INTERRUPT_FAST_CODE void LATENCY_Dispatcher(void)
+{
+  uint32_t         entryCycles = IRQ_GetCycleCount();
+  LATENCY_Entry_t *entry       = LATENCY_FindEntry(IRQ_GetActiveIRQn());
+  LATENCY_Stats_t *stats;
+  uint32_t         arrivalCycles;
+  uint32_t         latency;
+  uint32_t         bucket;
+
+  if (entry == NULL)
+  {
+    return;
+  }
+
+  arrivalCycles = (entry->arrivalFn != NULL) ? entry->arrivalFn(entry->irqNum)
+                                             : entry->pendedCycles;
+  latency       = entryCycles - arrivalCycles;
+  stats         = &entry->stats;
+  bucket        = LATENCY_GetBucket(latency);
+
+  SEQLOCK_WriteBegin(&entry->lock);
+  stats->numOfSamples++;
+  if (latency < stats->minCycles)
+  {
+    stats->minCycles = latency;
+  }
+  if (latency > stats->maxCycles)
+  {
+    stats->maxCycles = latency;
+  }
+  if ((stats->budgetCycles != 0u) && (latency > stats->budgetCycles))
+  {
+    stats->numOfOverBudget++;
+  }
+  if (stats->histogram[bucket] != UINT32_MAX)
+  {
+    stats->histogram[bucket]++;
+  }
+  SEQLOCK_WriteEnd(&entry->lock);
+
+  ((void (*)(void))entry->originalHandler)();
+}
+
+/**
+	\brief      		 Get the latency statistics of an IRQ.
+	\param [in]      irqNum: Device interrupt number.
+	\param [out]     stats:  The statistics.
+	\return          true if the IRQ is measured.
+	\note       		 Does not mask the IRQ, unless it keeps preempting the copy.
+ */
+bool LATENCY_GetStats(IRQn_Type irqNum, LATENCY_Stats_t *stats)
+{
+  LATENCY_Entry_t *entry = LATENCY_FindEntry(irqNum);
+
+  if (entry == NULL)
+  {
+    return false;
+  }
+
+  SEQLOCK_Read(&entry->lock, stats, &entry->stats, sizeof(*stats));
+
+  return true;
+}
+
+/**
+	\brief      		 Reset the latency statistics of an IRQ.
+	\param [in]      irqNum: Device interrupt number.
+ */
+void LATENCY_ResetStats(IRQn_Type irqNum)
+{
+  LATENCY_Entry_t *entry = LATENCY_FindEntry(irqNum);
+  uint32_t         irqState;
+
+  if (entry != NULL)
+  {
+    irqState = SEQLOCK_EnterWriterMaskedSection(&entry->lock);
+    LATENCY_ClearStats(&entry->stats);
+    SEQLOCK_ExitWriterMaskedSection(&entry->lock, irqState);
+  }
+}
+
+/**
+	\brief      		 Estimate a latency percentile.
+	\param [in]      stats:   Statistics returned by LATENCY_GetStats.
+	\param [in]      percent: The percentile, from 0 to 100.
+	\return          The estimated latency in cycles, 0 if there is no sample.
+ */
+uint32_t LATENCY_GetPercentile(const LATENCY_Stats_t *stats, uint8_t percent)
+{
+  uint64_t total = 0u;
+  uint64_t rank;
+  uint64_t cumulated = 0u;
+  uint32_t low;
+  uint32_t high;
+  uint32_t value = 0u;
+
+  for (uint32_t k = 0; k < LATENCY_NUM_OF_BUCKETS; k++)
+  {
+    total += stats->histogram[k];
+  }
+
+  if (total == 0u)
+  {
+    return 0u;
+  }
+
+  /* Rank of the sample, from 1 to total */
+  rank = ((total * percent) + 99u) / 100u;
+  if (rank == 0u)
+  {
+    rank = 1u;
+  }
+
+  for (uint32_t k = 0; k < LATENCY_NUM_OF_BUCKETS; k++)
+  {
+    if ((cumulated + stats->histogram[k]) >= rank)
+    {
+      low   = (k == 0u) ? 0u : (1UL << k);
+      high  = (k == (LATENCY_NUM_OF_BUCKETS - 1u)) ? stats->maxCycles : ((2UL << k) - 1u);
+      value = low + (uint32_t)(((uint64_t)(high - low) * (rank - cumulated)) / stats->histogram[k]);
+      break;
+    }
+    cumulated += stats->histogram[k];
+  }
+
+  /* The bucket bounds are wider than what was seen */
+  if (value > stats->maxCycles)
+  {
+    value = stats->maxCycles;
+  }
+  if (value < stats->minCycles)
+  {
+    value = stats->minCycles;
+  }
+
+  return value;
+}
+
+/**
+	\brief      		 Export the latency statistics of all the measured IRQs.
+	\details    		 Write one line per IRQ:
+									 "latency irq=<n> samples=<n> min=<c> max=<c> p50=<c> p99=<c> budget=<c> over=<n>
+									 hist=<b0>,<b1>,..." with latencies in cycles.
+	\param [in]      writeLine: Function receiving each line.
+ */
+void LATENCY_Export(LATENCY_WriteLineFn_t writeLine)
+{
+  LATENCY_Stats_t stats;
+  char            line[160 + (LATENCY_NUM_OF_BUCKETS * 11u)];
+  int             length;
+
+  for (uint32_t i = 0; i < LATENCY_MAX_TRACKED_IRQS; i++)
+  {
+    if (!latencyEntries[i].isUsed || !LATENCY_GetStats(latencyEntries[i].irqNum, &stats))
+    {
+      continue;
+    }
+
+    length = snprintf(line, sizeof(line),
+                      "latency irq=%d samples=%lu min=%lu max=%lu p50=%lu p99=%lu budget=%lu over=%lu hist=",
+                      (int)latencyEntries[i].irqNum,
+                      (unsigned long)stats.numOfSamples,
+                      (unsigned long)((stats.numOfSamples != 0u) ? stats.minCycles : 0u),
+                      (unsigned long)stats.maxCycles,
+                      (unsigned long)LATENCY_GetPercentile(&stats, 50u),
+                      (unsigned long)LATENCY_GetPercentile(&stats, 99u),
+                      (unsigned long)stats.budgetCycles,
+                      (unsigned long)stats.numOfOverBudget);
+
+    for (uint32_t k = 0; (k < LATENCY_NUM_OF_BUCKETS) && (length > 0) && ((uint32_t)length < sizeof(line)); k++)
+    {
+      length += snprintf(&line[length], sizeof(line) - (uint32_t)length,
+                         (k == 0u) ? "%lu" : ",%lu", (unsigned long)stats.histogram[k]);
+    }
+
+    writeLine(line);
+  }
+}
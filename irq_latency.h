@@ -0,0 +1,49 @@
+#ifndef IRQ_LATENCY_H
+#define IRQ_LATENCY_H
+
+#include "interrupt_handling.h"
+#include "seqlock.h"
+
+/* Number of IRQs that can be measured at the same time */
+#ifndef LATENCY_MAX_TRACKED_IRQS
+#define LATENCY_MAX_TRACKED_IRQS   8u
+#endif
+
+/* Histogram buckets: bucket k counts latencies in [2^k, 2^(k+1)) cycles,
+ * the last one everything above. */
+#define LATENCY_NUM_OF_BUCKETS     20u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the time the interrupt was raised, in IRQ_GetCycleCount units */
+typedef uint32_t (*LATENCY_ArrivalFn_t)(IRQn_Type irqNum);
+/* Receives one line of LATENCY_Export, without newline */
+typedef void (*LATENCY_WriteLineFn_t)(const char *line);
+
+typedef struct
+{
+  uint32_t numOfSamples;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint32_t budgetCycles;
+  uint32_t numOfOverBudget;
+  uint32_t histogram[LATENCY_NUM_OF_BUCKETS];
+} LATENCY_Stats_t;
+
+bool     LATENCY_Enable(IRQn_Type irqNum, LATENCY_ArrivalFn_t arrivalFn, uint32_t budgetCycles);
+void     LATENCY_Disable(IRQn_Type irqNum);
+INTERRUPT_FAST_CODE void LATENCY_SetPendingIRQ(IRQn_Type irqNum);
+INTERRUPT_FAST_CODE void LATENCY_Dispatcher(void);
+
+bool     LATENCY_GetStats(IRQn_Type irqNum, LATENCY_Stats_t *stats);
+void     LATENCY_ResetStats(IRQn_Type irqNum);
+uint32_t LATENCY_GetPercentile(const LATENCY_Stats_t *stats, uint8_t percent);
+void     LATENCY_Export(LATENCY_WriteLineFn_t writeLine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_LATENCY_H */
@@ -0,0 +1,179 @@
+#include "memory_pool.h"
+#include "atomic_ops.h"
+
+/* End of the free list */
+#define POOL_NIL                   0xFFFFu
+#define POOL_INDEX_MASK            0x0000FFFFUL
+#define POOL_TAG_MASK              0xFFFF0000UL
+#define POOL_TAG_INCREMENT         0x00010000UL
+
+/* Address of a block */
+#define POOL_BLOCK(pool, index)    (&(pool)->blocks[(index) * (pool)->stride])
+/* Link to the next free block, stored in the first word of a free block */
+#define POOL_NEXT(pool, index)     (*(volatile uint32_t*)POOL_BLOCK(pool, index))
+
+/* Notes:
+
+A pool of fixed-size blocks that can be allocated and freed in O(1) from any
+priority, so ISRs can hand buffers to thread mode (or the other way) without
+copying and without malloc.
+
+Free blocks form a singly linked list of block indices, the link being stored
+in the block itself. Allocating pops the head of the list and freeing pushes
+on it, both with one ATOMIC_CompareExchange32 on freeHead (LDREX/STREX on
+ARMv7-M, a few instructions with PRIMASK set on ARMv6-M).
+
+A lock-free list pop has an ABA problem: an ISR can preempt a pop between
+the read of the head and the compare-exchange, allocate that block and the
+next one, then free the first one back, so the head is the same again but
+its link is stale. The upper half of freeHead is a tag incremented by every
+push and pop, so the compare-exchange fails in that case.
+
+With POOL_ENABLE_STATISTICS defined, the pool counts its used blocks, their
+high-water mark and the allocations that failed.
+
+For example:
+
+static POOL_DEFINE_STORAGE_IN_SECTION(rxStorage, sizeof(RxFrame_t), 8u, ".ccmram");
+static POOL_Pool_t rxPool;
+
+POOL_Init(&rxPool, rxStorage, sizeof(RxFrame_t), 8u);
+
+void CAN1_RX0_IRQHandler(void)
+{
+    RxFrame_t *frame = POOL_Alloc(&rxPool);
+    ...
+    MPSC_Enqueue(&rxQueue, &frame);
+}
+
+*/
+
+/**
+	\brief      		 Initialize a pool.
+	\param [out]     pool:        The pool.
+	\param [in]      storage:     Storage defined with POOL_DEFINE_STORAGE.
+	\param [in]      blockSize:   Size of a block in bytes.
+	\param [in]      numOfBlocks: Number of blocks, at most POOL_MAX_BLOCKS - 1.
+	\return          true if the pool is initialized, false if there are too many blocks.
+ */
+bool POOL_Init(POOL_Pool_t *pool, void *storage, uint32_t blockSize, uint32_t numOfBlocks)
+{
+  bool isInitialized = false;
+
+  if ((numOfBlocks != 0u) && (numOfBlocks < POOL_MAX_BLOCKS))
+  {
+    pool->blocks      = (uint8_t*)storage;
+    pool->stride      = POOL_BLOCK_STRIDE(blockSize);
+    pool->numOfBlocks = numOfBlocks;
+
+    for (uint32_t i = 0; i < (numOfBlocks - 1u); i++)
+    {
+      POOL_NEXT(pool, i) = i + 1u;
+    }
+    POOL_NEXT(pool, numOfBlocks - 1u) = POOL_NIL;
+    pool->freeHead = 0u;
+
+#if defined(POOL_ENABLE_STATISTICS)
+    pool->numOfUsedBlocks   = 0u;
+    pool->maxUsedBlocks     = 0u;
+    pool->numOfFailedAllocs = 0u;
+#endif
+
+    isInitialized = true;
+  }
+
+  return isInitialized;
+}
+
+/**
+	\brief      		 Allocate a block.
+	\param [in, out] pool: The pool.
+	\return          The block, NULL if the pool is empty.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void *POOL_Alloc(POOL_Pool_t *pool)
+{
+  uint32_t head = pool->freeHead;
+  uint32_t index;
+  uint32_t newHead;
+#if defined(POOL_ENABLE_STATISTICS)
+  uint32_t numOfUsedBlocks;
+  uint32_t maxUsedBlocks;
+#endif
+
+  do
+  {
+    index = head & POOL_INDEX_MASK;
+    if (index == POOL_NIL)
+    {
+#if defined(POOL_ENABLE_STATISTICS)
+      ATOMIC_FetchAdd32(&pool->numOfFailedAllocs, 1u);
+#endif
+      return NULL;
+    }
+
+    /* The link may be stale if the block was taken meanwhile, the tag
+     * makes the compare-exchange fail in that case. */
+    newHead = ((head + POOL_TAG_INCREMENT) & POOL_TAG_MASK) | (POOL_NEXT(pool, index) & POOL_INDEX_MASK);
+  } while (!ATOMIC_CompareExchange32(&pool->freeHead, &head, newHead));
+
+#if defined(POOL_ENABLE_STATISTICS)
+  numOfUsedBlocks = ATOMIC_FetchAdd32(&pool->numOfUsedBlocks, 1u) + 1u;
+  maxUsedBlocks   = pool->maxUsedBlocks;
+  while ((numOfUsedBlocks > maxUsedBlocks)
+         && !ATOMIC_CompareExchange32(&pool->maxUsedBlocks, &maxUsedBlocks, numOfUsedBlocks))
+  {
+  }
+#endif
+
+  return POOL_BLOCK(pool, index);
+}
+
+/**
+	\brief      		 Free a block.
+	\param [in, out] pool:  The pool.
+	\param [in]      block: A block returned by POOL_Alloc.
+	\return          true if the block has been freed, false if it is not a block of the pool.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE bool POOL_Free(POOL_Pool_t *pool, void *block)
+{
+  uint32_t offset = (uint32_t)((uint8_t*)block - pool->blocks);
+  uint32_t index  = offset / pool->stride;
+  uint32_t head   = pool->freeHead;
+  uint32_t newHead;
+
+  if ((block == NULL) || (index >= pool->numOfBlocks) || ((offset % pool->stride) != 0u))
+  {
+    return false;
+  }
+
+  do
+  {
+    POOL_NEXT(pool, index) = head & POOL_INDEX_MASK;
+    newHead = ((head + POOL_TAG_INCREMENT) & POOL_TAG_MASK) | index;
+  } while (!ATOMIC_CompareExchange32(&pool->freeHead, &head, newHead));
+
+#if defined(POOL_ENABLE_STATISTICS)
+  ATOMIC_FetchSub32(&pool->numOfUsedBlocks, 1u);
+#endif
+
+  return true;
+}
+
+/**
+	\brief      		 Get the statistics of a pool.
+	\param [in]      pool:  The pool.
+	\param [out]     stats: The statistics, all 0 when POOL_ENABLE_STATISTICS is not defined.
+ */
+void POOL_GetStatistics(const POOL_Pool_t *pool, POOL_Statistics_t *stats)
+{
+#if defined(POOL_ENABLE_STATISTICS)
+  stats->numOfUsedBlocks   = pool->numOfUsedBlocks;
+  stats->maxUsedBlocks     = pool->maxUsedBlocks;
+  stats->numOfFailedAllocs = pool->numOfFailedAllocs;
+#else
+  (void)pool;
+  *stats = (POOL_Statistics_t){0};
+#endif
+}
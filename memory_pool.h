@@ -0,0 +1,56 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include "interrupt_handling.h"
+
+/* Maximum number of blocks of a pool (block indices are 16-bit) */
+#define POOL_MAX_BLOCKS            0xFFFFu
+
+/* Distance between two blocks, keeps each of them 8-byte aligned */
+#define POOL_BLOCK_STRIDE(blockSize) \
+  ((((blockSize) < 4u ? 4u : (blockSize)) + 7u) & ~7u)
+
+/* Storage of a pool of numOfBlocks blocks of blockSize bytes */
+#define POOL_DEFINE_STORAGE(name, blockSize, numOfBlocks) \
+  uint64_t name[(POOL_BLOCK_STRIDE(blockSize) * (numOfBlocks)) / 8u]
+
+/* Same, placed in the sectionName linker section (CCMRAM, DTCM, DMA-able RAM...) */
+#define POOL_DEFINE_STORAGE_IN_SECTION(name, blockSize, numOfBlocks, sectionName) \
+  __attribute__((section(sectionName)))                                          \
+  POOL_DEFINE_STORAGE(name, blockSize, numOfBlocks)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  /* Index of the first free block in the low half, ABA tag in the high half */
+  volatile uint32_t freeHead;
+  uint8_t          *blocks;
+  uint32_t          stride;
+  uint32_t          numOfBlocks;
+#if defined(POOL_ENABLE_STATISTICS)
+  volatile uint32_t numOfUsedBlocks;
+  volatile uint32_t maxUsedBlocks;
+  volatile uint32_t numOfFailedAllocs;
+#endif
+} POOL_Pool_t;
+
+typedef struct
+{
+  uint32_t numOfUsedBlocks;
+  uint32_t maxUsedBlocks;
+  uint32_t numOfFailedAllocs;
+} POOL_Statistics_t;
+
+bool  POOL_Init(POOL_Pool_t *pool, void *storage, uint32_t blockSize, uint32_t numOfBlocks);
+INTERRUPT_FAST_CODE void *POOL_Alloc(POOL_Pool_t *pool);
+INTERRUPT_FAST_CODE bool  POOL_Free(POOL_Pool_t *pool, void *block);
+void  POOL_GetStatistics(const POOL_Pool_t *pool, POOL_Statistics_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMORY_POOL_H */
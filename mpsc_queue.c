@@ -0,0 +1,200 @@
+#include "mpsc_queue.h"
+#include "atomic_ops.h"
+
+/* Sequence word at the start of each slot */
+#define MPSC_SLOT_SEQUENCE(queue, pos) \
+  ((volatile uint32_t*)&(queue)->slots[((pos) & (queue)->mask) * (queue)->slotSize])
+/* Message following the sequence word */
+#define MPSC_SLOT_MESSAGE(queue, pos) \
+  (&(queue)->slots[(((pos) & (queue)->mask) * (queue)->slotSize) + 4u])
+
+/* Notes:
+
+The usual ISR-to-thread handoff is a ring buffer whose push is wrapped in a
+THREAD_SAFE_SECTION, so every producer masks all the interrupts below the
+threshold, including the ones of higher priority than itself.
+
+This queue lets any number of producers (ISRs of any priority and thread
+mode) enqueue without masking, for a single consumer running in thread mode.
+Each slot holds a sequence word followed by the message:
+	- sequence == pos:              the slot is free for the producer at pos;
+	- sequence == pos + 1:          the message at pos is ready for the consumer;
+	- sequence == pos + capacity:   the consumer released it for the next lap.
+
+A producer claims a position by moving enqueuePos forward with
+ATOMIC_CompareExchange32 (LDREX/STREX), copies its message without any lock,
+then publishes the slot by writing its sequence. If a producer is preempted between claim and publish, the consumer
+stops at its slot until it is published; messages are never reordered.
+
+On ARMv6-M the compare-exchange runs with PRIMASK set for a few
+instructions, the copy stays outside of it.
+
+Indices and slots are aligned to MPSC_CACHE_LINE_SIZE so that, on Cortex-M7,
+producers and the consumer do not write to the same cache line.
+
+For example:
+
+static MPSC_DEFINE_STORAGE(eventStorage, sizeof(Event_t), 16u);
+static MPSC_Queue_t eventQueue;
+
+MPSC_Init(&eventQueue, eventStorage, sizeof(Event_t), 16u);
+
+void EXTI0_IRQHandler(void)       { MPSC_Enqueue(&eventQueue, &event); }
+int main(void) { ... while (MPSC_Dequeue(&eventQueue, &event)) { ... } }
+
+*/
+
+/* Claim the position of the next free slot, return false if the queue is full */
+__STATIC_FORCEINLINE bool MPSC_Claim(MPSC_Queue_t *queue, uint32_t *pos)
+{
+  uint32_t current = queue->enqueuePos;
+  int32_t  diff;
+
+  for (;;)
+  {
+    diff = (int32_t)(*MPSC_SLOT_SEQUENCE(queue, current) - current);
+
+    if (diff < 0)
+    {
+      return false;
+    }
+
+    if (diff == 0)
+    {
+      /* On failure current gets the position claimed by the other producer */
+      if (ATOMIC_CompareExchange32(&queue->enqueuePos, &current, current + 1u))
+      {
+        *pos = current;
+        return true;
+      }
+    }
+    else
+    {
+      current = queue->enqueuePos;
+    }
+  }
+}
+
+/* Copy a message, byte by byte so that any message size is supported */
+__STATIC_FORCEINLINE void MPSC_Copy(uint8_t *dst, const uint8_t *src, uint32_t size)
+{
+  while (size-- != 0u)
+  {
+    *dst++ = *src++;
+  }
+}
+
+/**
+	\brief      		 Initialize a queue.
+	\param [out]     queue:    The queue to initialize.
+	\param [in]      storage:  Storage defined with MPSC_DEFINE_STORAGE.
+	\param [in]      msgSize:  Size of a message in bytes.
+	\param [in]      capacity: Number of messages, must be a power of two.
+	\return          true if the queue is initialized, false if the capacity is not a
+									 power of two.
+ */
+bool MPSC_Init(MPSC_Queue_t *queue, void *storage, uint32_t msgSize, uint32_t capacity)
+{
+  bool isInitialized = false;
+
+  if ((capacity != 0u) && ((capacity & (capacity - 1u)) == 0u))
+  {
+    queue->slots      = (uint8_t*)storage;
+    queue->slotSize   = MPSC_SLOT_SIZE(msgSize);
+    queue->msgSize    = msgSize;
+    queue->mask       = capacity - 1u;
+    queue->enqueuePos = 0u;
+    queue->dequeuePos = 0u;
+
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+      *MPSC_SLOT_SEQUENCE(queue, i) = i;
+    }
+    __DMB();
+
+    isInitialized = true;
+  }
+
+  return isInitialized;
+}
+
+/**
+	\brief      		 Add a message to a queue.
+	\param [in, out] queue: The queue.
+	\param [in]      msg:   The message, queue->msgSize bytes are copied.
+	\return          true if the message has been queued, false if the queue is full.
+	\note       		 Can be called from thread mode and from any ISR, concurrently.
+ */
+INTERRUPT_FAST_CODE bool MPSC_Enqueue(MPSC_Queue_t *queue, const void *msg)
+{
+  uint32_t pos;
+
+  if (!MPSC_Claim(queue, &pos))
+  {
+    return false;
+  }
+
+  MPSC_Copy(MPSC_SLOT_MESSAGE(queue, pos), (const uint8_t*)msg, queue->msgSize);
+  /* The message must be visible before the slot is published */
+  __DMB();
+  *MPSC_SLOT_SEQUENCE(queue, pos) = pos + 1u;
+
+  return true;
+}
+
+/**
+	\brief      		 Take the oldest message of a queue.
+	\param [in, out] queue: The queue.
+	\param [out]     msg:   Where to copy the message.
+	\return          true if a message has been taken, false if none is ready.
+	\note       		 Must only be called by the consumer.
+ */
+bool MPSC_Dequeue(MPSC_Queue_t *queue, void *msg)
+{
+  return MPSC_DequeueBatch(queue, msg, 1u) == 1u;
+}
+
+/**
+	\brief      		 Take several messages of a queue.
+	\details    		 Take the ready messages in order, until maxCount messages are taken
+									 or the next message is not published yet.
+	\param [in, out] queue:    The queue.
+	\param [out]     msgs:     Array of maxCount messages.
+	\param [in]      maxCount: Maximum number of messages to take.
+	\return          The number of messages taken.
+	\note       		 Must only be called by the consumer.
+ */
+uint32_t MPSC_DequeueBatch(MPSC_Queue_t *queue, void *msgs, uint32_t maxCount)
+{
+  uint32_t pos   = queue->dequeuePos;
+  uint8_t *dst   = (uint8_t*)msgs;
+  uint32_t count = 0u;
+
+  while ((count < maxCount) && (*MPSC_SLOT_SEQUENCE(queue, pos) == (pos + 1u)))
+  {
+    /* Read the message only once the sequence says it is published */
+    __DMB();
+    MPSC_Copy(dst, MPSC_SLOT_MESSAGE(queue, pos), queue->msgSize);
+    /* The copy must be done before producers can reuse the slot */
+    __DMB();
+    *MPSC_SLOT_SEQUENCE(queue, pos) = pos + queue->mask + 1u;
+
+    dst += queue->msgSize;
+    pos++;
+    count++;
+  }
+
+  queue->dequeuePos = pos;
+
+  return count;
+}
+
+/**
+	\brief      		 Whether a queue has no message ready.
+	\param [in]      queue: The queue.
+	\return          true if the next message is not published yet.
+ */
+bool MPSC_IsEmpty(const MPSC_Queue_t *queue)
+{
+  return *MPSC_SLOT_SEQUENCE(queue, queue->dequeuePos) != (queue->dequeuePos + 1u);
+}
@@ -0,0 +1,51 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include "interrupt_handling.h"
+
+/* Alignment of the producer and consumer indices and of the slots. 32 bytes is
+ * the D-cache line of Cortex-M7; on cores without cache 4 is enough. */
+#ifndef MPSC_CACHE_LINE_SIZE
+#if (__CORTEX_M >= 7)
+#define MPSC_CACHE_LINE_SIZE       32u
+#else
+#define MPSC_CACHE_LINE_SIZE       4u
+#endif
+#endif
+
+/* Size of a slot: sequence word + message, rounded up to the cache line */
+#define MPSC_SLOT_SIZE(msgSize) \
+  ((((msgSize) + 4u) + (MPSC_CACHE_LINE_SIZE - 1u)) & ~(MPSC_CACHE_LINE_SIZE - 1u))
+
+/* Storage of a queue of capacity messages (capacity must be a power of two) */
+#define MPSC_DEFINE_STORAGE(name, msgSize, capacity) \
+  uint32_t name[(MPSC_SLOT_SIZE(msgSize) * (capacity)) / 4u] __ALIGNED(MPSC_CACHE_LINE_SIZE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  /* Written by the producers */
+  volatile uint32_t enqueuePos __ALIGNED(MPSC_CACHE_LINE_SIZE);
+  /* Written by the consumer */
+  uint32_t          dequeuePos __ALIGNED(MPSC_CACHE_LINE_SIZE);
+  /* Read-only after MPSC_Init */
+  uint8_t          *slots      __ALIGNED(MPSC_CACHE_LINE_SIZE);
+  uint32_t          slotSize;
+  uint32_t          msgSize;
+  uint32_t          mask;
+} MPSC_Queue_t;
+
+bool     MPSC_Init(MPSC_Queue_t *queue, void *storage, uint32_t msgSize, uint32_t capacity);
+INTERRUPT_FAST_CODE bool MPSC_Enqueue(MPSC_Queue_t *queue, const void *msg);
+bool     MPSC_Dequeue(MPSC_Queue_t *queue, void *msg);
+uint32_t MPSC_DequeueBatch(MPSC_Queue_t *queue, void *msgs, uint32_t maxCount);
+bool     MPSC_IsEmpty(const MPSC_Queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPSC_QUEUE_H */
@@ -0,0 +1,318 @@
+#include "pc_sampler.h"
+#include <stdio.h>
+
+#define SAMPLER_INDEX_MASK         (SAMPLER_TABLE_SIZE - 1u)
+
+/* Words of the exception frame */
+#define SAMPLER_FRAME_LR           5u
+#define SAMPLER_FRAME_PC           6u
+#define SAMPLER_FRAME_XPSR         7u
+#define SAMPLER_XPSR_EXCEPTION_MSK 0x1FFUL
+
+#if ((SAMPLER_TABLE_SIZE & (SAMPLER_TABLE_SIZE - 1u)) != 0u)
+#error "SAMPLER_TABLE_SIZE must be a power of two"
+#endif
+
+INTERRUPT_FAST_DATA static SAMPLER_Entry_t   samplerTable[SAMPLER_TABLE_SIZE];
+INTERRUPT_FAST_DATA static volatile bool     isRunning;
+INTERRUPT_FAST_DATA static SAMPLER_AckFn_t   samplerAckFn;
+INTERRUPT_FAST_DATA static volatile uint32_t numOfSamples;
+INTERRUPT_FAST_DATA static volatile uint32_t numOfDropped;
+INTERRUPT_FAST_DATA static volatile uint32_t numOfEntries;
+
+/* Notes:
+
+A statistical profiler: a timer interrupt at a fixed rate looks at where the
+CPU was when it fired. The interrupted context pushed its exception frame
+before the sampling handler runs, so SAMPLER_Handler finds there:
+	- the PC, where the CPU was;
+	- the LR, the caller in a leaf function, or the return address of the last
+	  call made by the function, or an EXC_RETURN value in a handler that did
+	  not call anything yet;
+	- the xPSR, whose IPSR field is the exception that was running (0 in
+	  thread mode, 11 SVCall, 15 SysTick, 16 + IRQn for the device
+	  interrupts).
+Time spent in thread mode and in every handler is seen the same way.
+
+Samples at the same PC, LR and exception are counted in one entry of a hash
+table in RAM (SAMPLER_TABLE_SIZE entries of 16 bytes, SAMPLER_MAX_PROBES slots
+tried), so a long profile takes the same memory as a short one. A sample that
+finds no room is counted as dropped: a high drop count means the table is too
+small for the code being profiled.
+
+To see time spent inside masked sections, the sampling timer must preempt
+them: its priority level must be higher (lower value) than the threshold of
+BASEPRI_SetPriorityLevelThreshold, which SAMPLER_Init checks. PRIMASK
+sections, and BASEPRI ceilings above the sampler, still hold the sample back
+until their exit: it is then charged to the first instruction after the
+section. On ARMv6-M every section masks with PRIMASK.
+
+The sampling handler is entered directly from the vector table: it reads the
+frame from the stack pointer that the exception used (MSP or PSP, from
+EXC_RETURN in LR) before anything is pushed, then tail-calls SAMPLER_Record.
+The vector table must be in RAM (see NVIC_RelocateVectorTableToRam and
+INTERRUPT_ENABLE_RAM_VECTOR_TABLE). With irq_instrument.c, call SAMPLER_Init
+after INSTR_Install: a handler called from INSTR_Stub does not find the frame
+where it expects it.
+
+The samples are written by the sampling handler only, which preempts the
+readers: SAMPLER_GetEntry and SAMPLER_Export copy each entry with interrupts
+disabled, for a few cycles. PRIMASK rather than a ceiling at the sampler
+level: the sampler is typically at level 0, which BASEPRI cannot mask.
+
+On the host, tools/profile_fold.c turns the output of SAMPLER_Export and the
+symbols of the firmware into folded stacks (flamegraph.pl, speedscope).
+
+For example:
+
+static void SamplerAck(void)
+{
+    TIM7->SR = 0u;
+}
+
+BASEPRI_SetPriorityLevelThreshold(3u);
+NVIC_RelocateVectorTableToRam();
+TIM7_Setup(10000u);                   // 10 kHz, update interrupt enabled
+SAMPLER_Init(TIM7_IRQn, 1u, SamplerAck);
+SAMPLER_Start();
+...
+SAMPLER_Stop();
+SAMPLER_Export(ConsoleWriteLine);
+
+*/
+
+/* Slot of a sample in the hash table */
+__STATIC_FORCEINLINE uint32_t SAMPLER_Hash(uint32_t pc, uint32_t lr, uint32_t exceptionNum)
+{
+  uint32_t hash = pc ^ (lr * 0x9E3779B1UL) ^ exceptionNum;
+
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6BUL;
+  hash ^= hash >> 13;
+
+  return hash & SAMPLER_INDEX_MASK;
+}
+
+/**
+	\brief      		 Initialize the sampler.
+	\details    		 Set the sampling handler and the priority of the sampling timer
+									 interrupt. The sampler is stopped: the timer can be started.
+	\param [in]      irqNum:        Interrupt of the sampling timer.
+	\param [in]      priorityLevel: Its priority level, higher than the
+									 BASEPRI_SetPriorityLevelThreshold threshold.
+	\param [in]      ackFn:         Clears the timer request, called on every sample.
+	\return          true if initialized, false if irqNum is not an interrupt, or
+									 priorityLevel is above INTERRUPT_LOWEST_PRIORITY or masked by the
+									 BASEPRI threshold.
+	\note       		 The vector table must be in RAM (see NVIC_RelocateVectorTableToRam).
+ */
+bool SAMPLER_Init(IRQn_Type irqNum, uint8_t priorityLevel, SAMPLER_AckFn_t ackFn)
+{
+  int8_t threshold = BASEPRI_GetPriorityLevelThreshold();
+
+  if (((int16_t)irqNum < 0) || (priorityLevel > INTERRUPT_LOWEST_PRIORITY)
+      || ((threshold >= 0) && (priorityLevel >= (uint8_t)threshold)))
+  {
+    return false;
+  }
+
+  isRunning            = false;
+  samplerAckFn         = ackFn;
+  SAMPLER_Reset();
+
+  NVIC_SetPriority(irqNum, priorityLevel);
+  NVIC_SetIRQnHandler(irqNum, (void*)SAMPLER_Handler);
+
+  return true;
+}
+
+/**
+	\brief      		 Start counting samples.
+ */
+void SAMPLER_Start(void)
+{
+  __DMB();
+  isRunning = true;
+}
+
+/**
+	\brief      		 Stop counting samples.
+	\details    		 The timer keeps running, its requests are only acknowledged.
+ */
+void SAMPLER_Stop(void)
+{
+  isRunning = false;
+  __DMB();
+}
+
+/**
+	\brief      		 Clear the samples.
+ */
+void SAMPLER_Reset(void)
+{
+  for (uint32_t i = 0; i < SAMPLER_TABLE_SIZE; i++)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      samplerTable[i] = (SAMPLER_Entry_t){0};
+    )
+  }
+
+  NO_INTERRUPTS_SECTION
+  (
+    numOfSamples = 0u;
+    numOfDropped = 0u;
+    numOfEntries = 0u;
+  )
+}
+
+/**
+	\brief      		 Sampling timer handler.
+	\details    		 Pass the exception frame of the interrupted context to
+									 SAMPLER_Record. Set by SAMPLER_Init, not to be called.
+ */
+__attribute__((naked)) INTERRUPT_FAST_CODE void SAMPLER_Handler(void)
+{
+  /* Bit 2 of EXC_RETURN: the frame is on PSP. Written for ARMv6-M as well:
+   * SAMPLER_Record is reached through a register, a b only reaches +/-2 KB
+   * there and the two functions may be placed apart. */
+  __ASM volatile
+  (
+    "movs r0, #4               \n"
+    "mov  r1, lr               \n"
+    "tst  r0, r1               \n"
+    "bne  1f                   \n"
+    "mrs  r0, msp              \n"
+    "b    2f                   \n"
+    "1:                        \n"
+    "mrs  r0, psp              \n"
+    "2:                        \n"
+    "ldr  r1, =SAMPLER_Record  \n"
+    "bx   r1                   \n"
+    ".ltorg                    \n"
+  );
+}
+
+/**
+	\brief      		 Count a sample.
+	\param [in]      frame: Exception frame of the interrupted context.
+	\note       		 Tail-called by SAMPLER_Handler, LR still holds EXC_RETURN.
+ */
+__USED INTERRUPT_FAST_CODE void SAMPLER_Record(const uint32_t *frame)
+{
+  uint32_t         pc;
+  uint32_t         lr;
+  uint32_t         exceptionNum;
+  uint32_t         index;
+  SAMPLER_Entry_t *entry;
+
+  if (samplerAckFn != NULL)
+  {
+    samplerAckFn();
+  }
+
+  if (!isRunning)
+  {
+    return;
+  }
+
+  pc           = frame[SAMPLER_FRAME_PC];
+  lr           = frame[SAMPLER_FRAME_LR];
+  exceptionNum = frame[SAMPLER_FRAME_XPSR] & SAMPLER_XPSR_EXCEPTION_MSK;
+  index        = SAMPLER_Hash(pc, lr, exceptionNum);
+
+  numOfSamples++;
+
+  for (uint32_t probe = 0; probe < SAMPLER_MAX_PROBES; probe++)
+  {
+    entry = &samplerTable[(index + probe) & SAMPLER_INDEX_MASK];
+
+    if (entry->count == 0u)
+    {
+      entry->pc           = pc;
+      entry->lr           = lr;
+      entry->exceptionNum = (uint16_t)exceptionNum;
+      entry->count        = 1u;
+      numOfEntries++;
+      return;
+    }
+
+    if ((entry->pc == pc) && (entry->lr == lr) && (entry->exceptionNum == exceptionNum))
+    {
+      entry->count++;
+      return;
+    }
+  }
+
+  numOfDropped++;
+}
+
+/**
+	\brief      		 Get the sample counters.
+	\param [out]     stats: Samples taken, dropped for lack of room, and entries used.
+ */
+void SAMPLER_GetStats(SAMPLER_Stats_t *stats)
+{
+  NO_INTERRUPTS_SECTION
+  (
+    stats->numOfSamples = numOfSamples;
+    stats->numOfDropped = numOfDropped;
+    stats->numOfEntries = numOfEntries;
+  )
+}
+
+/**
+	\brief      		 Get an entry of the sample table.
+	\param [in]      index: Slot of the table, from 0 to SAMPLER_TABLE_SIZE - 1.
+	\param [out]     entry: Copy of the entry.
+	\return          true if the slot holds samples.
+ */
+bool SAMPLER_GetEntry(uint32_t index, SAMPLER_Entry_t *entry)
+{
+  if (index >= SAMPLER_TABLE_SIZE)
+  {
+    return false;
+  }
+
+  NO_INTERRUPTS_SECTION
+  (
+    *entry = samplerTable[index];
+  )
+
+  return (entry->count != 0u);
+}
+
+/**
+	\brief      		 Export the samples.
+	\details    		 Write a "samples total=<n> dropped=<n> entries=<n>" line, then a
+									 "sample exc=<n> pc=0x<pc> lr=0x<lr> count=<n>" line per entry,
+									 read by tools/profile_fold.c.
+	\param [in]      writeLine: Function receiving each line.
+	\note       		 Stop the sampler first for a consistent profile.
+ */
+void SAMPLER_Export(SAMPLER_WriteLineFn_t writeLine)
+{
+  SAMPLER_Stats_t stats;
+  SAMPLER_Entry_t entry;
+  char            line[80];
+
+  SAMPLER_GetStats(&stats);
+  snprintf(line, sizeof(line), "samples total=%lu dropped=%lu entries=%lu",
+           (unsigned long)stats.numOfSamples,
+           (unsigned long)stats.numOfDropped,
+           (unsigned long)stats.numOfEntries);
+  writeLine(line);
+
+  for (uint32_t i = 0; i < SAMPLER_TABLE_SIZE; i++)
+  {
+    if (SAMPLER_GetEntry(i, &entry))
+    {
+      snprintf(line, sizeof(line), "sample exc=%u pc=0x%08lx lr=0x%08lx count=%lu",
+               (unsigned)entry.exceptionNum,
+               (unsigned long)entry.pc,
+               (unsigned long)entry.lr,
+               (unsigned long)entry.count);
+      writeLine(line);
+    }
+  }
+}
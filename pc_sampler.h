@@ -0,0 +1,57 @@
+#ifndef PC_SAMPLER_H
+#define PC_SAMPLER_H
+
+#include "interrupt_handling.h"
+
+/* Entries of the sample hash table, must be a power of two */
+#ifndef SAMPLER_TABLE_SIZE
+#define SAMPLER_TABLE_SIZE         256u
+#endif
+
+/* Slots tried before a sample is dropped */
+#ifndef SAMPLER_MAX_PROBES
+#define SAMPLER_MAX_PROBES         8u
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Clears the request of the sampling timer, called from the sampling handler */
+typedef void (*SAMPLER_AckFn_t)(void);
+/* Receives one line of SAMPLER_Export, without newline */
+typedef void (*SAMPLER_WriteLineFn_t)(const char *line);
+
+/* Samples taken at the same place: interrupted PC, LR and exception number */
+typedef struct
+{
+  uint32_t pc;
+  uint32_t lr;
+  uint32_t count;
+  uint16_t exceptionNum;
+} SAMPLER_Entry_t;
+
+typedef struct
+{
+  uint32_t numOfSamples;
+  uint32_t numOfDropped;
+  uint32_t numOfEntries;
+} SAMPLER_Stats_t;
+
+bool SAMPLER_Init(IRQn_Type irqNum, uint8_t priorityLevel, SAMPLER_AckFn_t ackFn);
+void SAMPLER_Start(void);
+void SAMPLER_Stop(void);
+void SAMPLER_Reset(void);
+
+INTERRUPT_FAST_CODE void SAMPLER_Handler(void);
+INTERRUPT_FAST_CODE void SAMPLER_Record(const uint32_t *frame);
+
+void SAMPLER_GetStats(SAMPLER_Stats_t *stats);
+bool SAMPLER_GetEntry(uint32_t index, SAMPLER_Entry_t *entry);
+void SAMPLER_Export(SAMPLER_WriteLineFn_t writeLine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PC_SAMPLER_H */
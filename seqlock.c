@@ -0,0 +1,234 @@
+#include "seqlock.h"
+#include <string.h>
+
+/* Notes:
+
+A sequence lock lets thread mode read multi-word data published by an ISR
+without masking the ISR during the copy.
+
+The writer (a single ISR) makes the sequence odd before the update and even
+again after it. The reader reads the sequence, copies the data and reads the
+sequence again: if it changed or was odd, the copy may be torn and is done
+again. The DMBs keep the data accesses between the two sequence accesses, on
+both sides.
+
+As long as the reader has a lower priority than the writer, which is the
+usual case, a retry only happens when the writer preempted the copy, and the
+next copy succeeds unless the writer runs again meanwhile. If that happens
+SEQLOCK_MAX_RETRIES times in a row (an interrupt storm), SEQLOCK_Read stops
+retrying and copies with the writer masked, raising BASEPRI to the priority
+level of the writer (PRIMASK on ARMv6-M, or for a writer at level 0, which
+BASEPRI cannot mask): the worst-case reader time stays bounded. The modules
+reading through a seqlock mask its writer the same way, with
+SEQLOCK_EnterWriterMaskedSection.
+
+For example:
+
+static SensorState_t  sensorState;
+static SEQLOCK_Lock_t sensorLock;
+
+SEQLOCK_Init(&sensorLock, 2u);
+
+void ADC_IRQHandler(void)
+{
+    SEQLOCK_WriteBegin(&sensorLock);
+    sensorState.x = ...;
+    sensorState.y = ...;
+    SEQLOCK_WriteEnd(&sensorLock);
+}
+
+void CONTROL_Loop(void)
+{
+    SensorState_t state;
+    SEQLOCK_Read(&sensorLock, &state, &sensorState, sizeof(state));
+}
+
+With SEQLOCK_ENABLE_STATISTICS defined (and IRQ_EnableCycleCounter called),
+the lock counts reads, retries (torn copies, each copied again, by the loop
+or by the fallback) and fallbacks and keeps the longest read.
+
+*/
+
+/**
+	\brief      		 Initialize a sequence lock.
+	\param [out]     lock:                The lock.
+	\param [in]      writerPriorityLevel: Priority level of the writer ISR, masked by
+									 SEQLOCK_Read after SEQLOCK_MAX_RETRIES torn reads.
+	\return          false if writerPriorityLevel is not a priority level, the lock
+									 is then not initialized.
+ */
+bool SEQLOCK_Init(SEQLOCK_Lock_t *lock, uint8_t writerPriorityLevel)
+{
+  if (writerPriorityLevel > INTERRUPT_LOWEST_PRIORITY)
+  {
+    return false;
+  }
+
+  lock->sequence            = 0u;
+  lock->writerPriorityLevel = writerPriorityLevel;
+#if defined(SEQLOCK_ENABLE_STATISTICS)
+  lock->numOfReads     = 0u;
+  lock->numOfRetries   = 0u;
+  lock->numOfFallbacks = 0u;
+  lock->maxReadCycles  = 0u;
+#endif
+
+  return true;
+}
+
+/**
+	\brief      		 Mask the writer of a lock.
+	\details    		 Raise BASEPRI to the priority level of the writer, or disable all
+									 interrupts for a writer at level 0, which BASEPRI cannot mask.
+	\param [in]      lock: The lock.
+	\return          The state to give to SEQLOCK_ExitWriterMaskedSection.
+ */
+INTERRUPT_FAST_CODE uint32_t SEQLOCK_EnterWriterMaskedSection(const SEQLOCK_Lock_t *lock)
+{
+  if (lock->writerPriorityLevel == INTERRUPT_HIGHEST_PRIORITY)
+  {
+    return PRIMASK_EnterNoInterruptsSection();
+  }
+
+  return BASEPRI_EnterPriorityCeilingSection(lock->writerPriorityLevel);
+}
+
+/**
+	\brief      		 Unmask the writer of a lock.
+	\param [in]      lock:     The lock.
+	\param [in]      irqState: The state returned by SEQLOCK_EnterWriterMaskedSection.
+ */
+INTERRUPT_FAST_CODE void SEQLOCK_ExitWriterMaskedSection(const SEQLOCK_Lock_t *lock, uint32_t irqState)
+{
+  if (lock->writerPriorityLevel == INTERRUPT_HIGHEST_PRIORITY)
+  {
+    PRIMASK_ExitNoInterruptsSection(irqState);
+  }
+  else
+  {
+    BASEPRI_ExitInterruptsDisabledByThresholdSection(irqState);
+  }
+}
+
+/**
+	\brief      		 Start an update of the protected data.
+	\param [in, out] lock: The lock.
+	\note       		 Writer side, there must be a single writer.
+ */
+INTERRUPT_FAST_CODE void SEQLOCK_WriteBegin(SEQLOCK_Lock_t *lock)
+{
+  lock->sequence = lock->sequence + 1u;
+  __DMB();
+}
+
+/**
+	\brief      		 End an update of the protected data.
+	\param [in, out] lock: The lock.
+	\note       		 Writer side, there must be a single writer.
+ */
+INTERRUPT_FAST_CODE void SEQLOCK_WriteEnd(SEQLOCK_Lock_t *lock)
+{
+  __DMB();
+  lock->sequence = lock->sequence + 1u;
+}
+
+/**
+	\brief      		 Copy data into the protected data.
+	\param [in, out] lock:   The lock.
+	\param [out]     shared: The protected data.
+	\param [in]      data:   The new value.
+	\param [in]      size:   Size of the data in bytes.
+	\note       		 Writer side, there must be a single writer.
+ */
+INTERRUPT_FAST_CODE void SEQLOCK_Write(SEQLOCK_Lock_t *lock, void *shared, const void *data,
+                                       uint32_t size)
+{
+  SEQLOCK_WriteBegin(lock);
+  memcpy(shared, data, size);
+  SEQLOCK_WriteEnd(lock);
+}
+
+/**
+	\brief      		 Start a read of the protected data.
+	\param [in]      lock: The lock.
+	\return          The sequence to give to SEQLOCK_ReadRetry.
+	\note       		 Reader side. The sequence is odd if an update is in progress,
+									 SEQLOCK_ReadRetry will then ask for a retry.
+ */
+uint32_t SEQLOCK_ReadBegin(const SEQLOCK_Lock_t *lock)
+{
+  uint32_t sequence = lock->sequence;
+
+  __DMB();
+
+  return sequence;
+}
+
+/**
+	\brief      		 Check a read of the protected data.
+	\param [in]      lock:     The lock.
+	\param [in]      sequence: The sequence returned by SEQLOCK_ReadBegin.
+	\return          true if the data read may be torn and must be read again.
+ */
+bool SEQLOCK_ReadRetry(const SEQLOCK_Lock_t *lock, uint32_t sequence)
+{
+  __DMB();
+
+  return ((sequence & 1u) != 0u) || (lock->sequence != sequence);
+}
+
+/**
+	\brief      		 Copy the protected data.
+	\details    		 Copy the data until the copy is not torn, or with the writer masked
+									 after SEQLOCK_MAX_RETRIES torn copies.
+	\param [in, out] lock:   The lock.
+	\param [out]     data:   Where to copy the data.
+	\param [in]      shared: The protected data.
+	\param [in]      size:   Size of the data in bytes.
+	\note       		 Reader side, the reader must have a lower priority than the writer.
+									 A copy torn SEQLOCK_MAX_RETRIES times is done a last time with
+									 SEQLOCK_EnterWriterMaskedSection.
+ */
+void SEQLOCK_Read(SEQLOCK_Lock_t *lock, void *data, const void *shared, uint32_t size)
+{
+  uint32_t sequence;
+  uint32_t numOfRetries = 0u;
+  uint32_t irqState;
+#if defined(SEQLOCK_ENABLE_STATISTICS)
+  uint32_t startCycles  = IRQ_GetCycleCount();
+  uint32_t readCycles;
+#endif
+
+  for (;;)
+  {
+    sequence = SEQLOCK_ReadBegin(lock);
+    memcpy(data, shared, size);
+    if (!SEQLOCK_ReadRetry(lock, sequence))
+    {
+      break;
+    }
+
+    /* Torn: copy again, with the writer masked once the retries are used up */
+    numOfRetries++;
+    if (numOfRetries == SEQLOCK_MAX_RETRIES)
+    {
+      irqState = SEQLOCK_EnterWriterMaskedSection(lock);
+      memcpy(data, shared, size);
+      SEQLOCK_ExitWriterMaskedSection(lock, irqState);
+#if defined(SEQLOCK_ENABLE_STATISTICS)
+      lock->numOfFallbacks++;
+#endif
+      break;
+    }
+  }
+
+#if defined(SEQLOCK_ENABLE_STATISTICS)
+  readCycles = IRQ_GetCycleCount() - startCycles;
+  if (readCycles > lock->maxReadCycles)
+  {
+    lock->maxReadCycles = readCycles;
+  }
+  lock->numOfRetries += numOfRetries;
+  lock->numOfReads++;
+#endif
+}
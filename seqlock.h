@@ -0,0 +1,44 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "interrupt_handling.h"
+
+/* Torn reads tolerated before SEQLOCK_Read masks the writer */
+#ifndef SEQLOCK_MAX_RETRIES
+#define SEQLOCK_MAX_RETRIES        4u
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  volatile uint32_t sequence;
+  uint8_t           writerPriorityLevel;
+#if defined(SEQLOCK_ENABLE_STATISTICS)
+  uint32_t          numOfReads;
+  uint32_t          numOfRetries;
+  uint32_t          numOfFallbacks;
+  uint32_t          maxReadCycles;
+#endif
+} SEQLOCK_Lock_t;
+
+bool     SEQLOCK_Init(SEQLOCK_Lock_t *lock, uint8_t writerPriorityLevel);
+INTERRUPT_FAST_CODE uint32_t SEQLOCK_EnterWriterMaskedSection(const SEQLOCK_Lock_t *lock);
+INTERRUPT_FAST_CODE void     SEQLOCK_ExitWriterMaskedSection(const SEQLOCK_Lock_t *lock, uint32_t irqState);
+
+INTERRUPT_FAST_CODE void SEQLOCK_WriteBegin(SEQLOCK_Lock_t *lock);
+INTERRUPT_FAST_CODE void SEQLOCK_WriteEnd(SEQLOCK_Lock_t *lock);
+INTERRUPT_FAST_CODE void SEQLOCK_Write(SEQLOCK_Lock_t *lock, void *shared, const void *data,
+                                       uint32_t size);
+
+uint32_t SEQLOCK_ReadBegin(const SEQLOCK_Lock_t *lock);
+bool     SEQLOCK_ReadRetry(const SEQLOCK_Lock_t *lock, uint32_t sequence);
+void     SEQLOCK_Read(SEQLOCK_Lock_t *lock, void *data, const void *shared, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEQLOCK_H */
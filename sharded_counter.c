@@ -0,0 +1,112 @@
+#include "sharded_counter.h"
+#include "atomic_ops.h"
+
+/* Shards of thread mode and of the fixed priority exceptions */
+#define COUNTER_THREAD_SHARD       0u
+#define COUNTER_NMI_SHARD          1u
+#define COUNTER_HARDFAULT_SHARD    2u
+#define COUNTER_FIRST_LEVEL_SHARD  3u
+
+/* Notes:
+
+A counter incremented from ISRs of different priorities needs its
+read-modify-write protected, by a THREAD_SAFE_SECTION or an atomic operation.
+A sharded counter avoids both: it is split in shards, each written by
+contexts that cannot preempt each other, so an increment is a plain
+load/add/store on the shard of the running context, and a read sums the
+shards.
+
+Two handlers with the same priority never preempt each other, so by default
+there is one shard per priority level (the value read back from the NVIC, not
+only the preemption part, so any priority grouping is fine), plus NMI and
+HardFault, which have fixed priorities. With COUNTER_SHARD_BY_EXCEPTION
+defined, there is one shard per exception number instead: no priority lookup,
+but INTERRUPT_VECTOR_TABLE_WORDS words per counter.
+
+Thread mode may be shared by several RTOS threads, so its shard is updated
+with ATOMIC_FetchAdd32.
+
+Each shard wraps around independently, the sum does too: compute rates as
+the difference of two reads.
+
+*/
+
+/* Shard written by the running context */
+__STATIC_FORCEINLINE uint32_t COUNTER_GetShard(void)
+{
+  IRQn_Type irqNum = IRQ_GetActiveIRQn();
+
+#if defined(COUNTER_SHARD_BY_EXCEPTION)
+  return (uint32_t)((int32_t)irqNum + 16);
+#else
+  uint32_t  shard;
+
+  if (irqNum == NonMaskableInt_IRQn)
+  {
+    shard = COUNTER_NMI_SHARD;
+  }
+  else if (irqNum == HardFault_IRQn)
+  {
+    shard = COUNTER_HARDFAULT_SHARD;
+  }
+  else
+  {
+    shard = COUNTER_FIRST_LEVEL_SHARD + NVIC_GetPriority(irqNum);
+  }
+
+  return shard;
+#endif
+}
+
+/**
+	\brief      		 Initialize a sharded counter.
+	\param [out]     counter: The counter, set to 0.
+ */
+void COUNTER_Init(COUNTER_Sharded_t *counter)
+{
+  for (uint32_t i = 0; i < COUNTER_NUM_OF_SHARDS; i++)
+  {
+    counter->shards[i] = 0u;
+  }
+}
+
+/**
+	\brief      		 Add to a sharded counter.
+	\param [in, out] counter: The counter.
+	\param [in]      value:   The value to add.
+	\note       		 Can be called from thread mode and from any ISR.
+ */
+INTERRUPT_FAST_CODE void COUNTER_Add(COUNTER_Sharded_t *counter, uint32_t value)
+{
+  uint32_t shard;
+
+  if (!IRQ_IsInIrqContext())
+  {
+    ATOMIC_FetchAdd32(&counter->shards[COUNTER_THREAD_SHARD], value);
+  }
+  else
+  {
+    /* Only contexts that cannot preempt each other write this shard */
+    shard = COUNTER_GetShard();
+    counter->shards[shard] = counter->shards[shard] + value;
+  }
+}
+
+/**
+	\brief      		 Read a sharded counter.
+	\param [in]      counter: The counter.
+	\return          The sum of the shards.
+	\note       		 The shards are read one by one: an increment happening during the
+									 read may or may not be counted, but none is ever lost.
+ */
+uint32_t COUNTER_Read(const COUNTER_Sharded_t *counter)
+{
+  uint32_t sum = 0u;
+
+  for (uint32_t i = 0; i < COUNTER_NUM_OF_SHARDS; i++)
+  {
+    sum += counter->shards[i];
+  }
+
+  return sum;
+}
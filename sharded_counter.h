@@ -0,0 +1,33 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include "interrupt_handling.h"
+
+/* One shard per exception number (IPSR), or one per priority level plus
+ * thread mode, NMI and HardFault. */
+#if defined(COUNTER_SHARD_BY_EXCEPTION)
+#define COUNTER_NUM_OF_SHARDS      INTERRUPT_VECTOR_TABLE_WORDS
+#else
+#define COUNTER_NUM_OF_SHARDS      ((1u << __NVIC_PRIO_BITS) + 3u)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  volatile uint32_t shards[COUNTER_NUM_OF_SHARDS];
+} COUNTER_Sharded_t;
+
+#define COUNTER_Increment(counter)  COUNTER_Add((counter), 1u)
+
+void     COUNTER_Init(COUNTER_Sharded_t *counter);
+INTERRUPT_FAST_CODE void COUNTER_Add(COUNTER_Sharded_t *counter, uint32_t value);
+uint32_t COUNTER_Read(const COUNTER_Sharded_t *counter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHARDED_COUNTER_H */
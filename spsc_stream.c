@@ -0,0 +1,215 @@
+#include "spsc_stream.h"
+
+/* Notes:
+
+A byte ring for one producer (an ISR or a DMA completion handler) and one
+consumer (thread mode or a lower priority handler), without any masking.
+
+head is only written by the producer and tail only by the consumer, each in
+its own word (its own cache line on Cortex-M7), so neither side needs an atomic
+read-modify-write. Both are free-running byte counts: head - tail is the number
+of bytes in the ring and the buffer size must be a power of two.
+
+The ring is used in place:
+	1. The producer asks for the contiguous free region with SPSC_Reserve,
+	   writes into it (or points a DMA transfer at it), then publishes the
+	   bytes with SPSC_Commit;
+	2. The consumer asks for the contiguous readable region with SPSC_Peek,
+	   reads it in place, then gives the bytes back with SPSC_Release.
+
+A region never wraps: when the free or readable part of the ring wraps, a
+second Reserve/Peek returns the part at the start of the buffer.
+
+Barriers:
+	- Commit: DMB before head is written, so the data is visible first;
+	- Peek:   DMB after head is read, so the data is not read before it;
+	- Release: DMB before tail is written, so the data is read before the
+	  producer can overwrite it;
+	- Reserve: DMB after tail is read, for the same reason on the producer side.
+
+On Cortex-M7 with the D-cache enabled, a buffer written by DMA must be in a
+non-cacheable region, or be invalidated by the consumer before SPSC_Peek.
+
+*/
+
+/**
+	\brief      		 Initialize a stream.
+	\param [out]     stream: The stream to initialize.
+	\param [in]      buffer: The ring buffer.
+	\param [in]      size:   Size of the buffer, must be a power of two.
+	\return          true if the stream is initialized, false if the size is not a
+									 power of two.
+ */
+bool SPSC_Init(SPSC_Stream_t *stream, uint8_t *buffer, uint32_t size)
+{
+  bool isInitialized = false;
+
+  if ((size != 0u) && ((size & (size - 1u)) == 0u))
+  {
+    stream->buffer = buffer;
+    stream->mask   = size - 1u;
+    stream->head   = 0u;
+    stream->tail   = 0u;
+    isInitialized  = true;
+  }
+
+  return isInitialized;
+}
+
+/**
+	\brief      		 Get the contiguous free region of a stream.
+	\param [in]      stream: The stream.
+	\param [out]     region: Start of the free region.
+	\return          The size of the region in bytes, 0 if the stream is full.
+	\note       		 Producer side.
+ */
+INTERRUPT_FAST_CODE uint32_t SPSC_Reserve(SPSC_Stream_t *stream, uint8_t **region)
+{
+  uint32_t head      = stream->head;
+  uint32_t tail      = stream->tail;
+  uint32_t offset    = head & stream->mask;
+  uint32_t freeSize  = (stream->mask + 1u) - (head - tail);
+  uint32_t untilEnd  = (stream->mask + 1u) - offset;
+
+  __DMB();
+  *region = &stream->buffer[offset];
+
+  return (freeSize < untilEnd) ? freeSize : untilEnd;
+}
+
+/**
+	\brief      		 Publish bytes written in the reserved region.
+	\param [in, out] stream: The stream.
+	\param [in]      count:  Number of bytes written, at most the size returned by
+									 SPSC_Reserve.
+	\note       		 Producer side.
+ */
+INTERRUPT_FAST_CODE void SPSC_Commit(SPSC_Stream_t *stream, uint32_t count)
+{
+  __DMB();
+  stream->head = stream->head + count;
+}
+
+/**
+	\brief      		 Copy bytes into a stream.
+	\param [in, out] stream: The stream.
+	\param [in]      data:   The bytes to write.
+	\param [in]      size:   Number of bytes to write.
+	\return          The number of bytes written, less than size if the stream is full.
+	\note       		 Producer side.
+ */
+INTERRUPT_FAST_CODE uint32_t SPSC_Write(SPSC_Stream_t *stream, const void *data, uint32_t size)
+{
+  const uint8_t *src     = (const uint8_t*)data;
+  uint32_t       written = 0u;
+  uint32_t       count;
+  uint8_t       *region;
+
+  /* At most two regions: until the end of the buffer, then from its start */
+  for (uint32_t i = 0; (i < 2u) && (written < size); i++)
+  {
+    count = SPSC_Reserve(stream, &region);
+    if (count > (size - written))
+    {
+      count = size - written;
+    }
+
+    for (uint32_t j = 0; j < count; j++)
+    {
+      region[j] = src[written + j];
+    }
+
+    SPSC_Commit(stream, count);
+    written += count;
+  }
+
+  return written;
+}
+
+/**
+	\brief      		 Get the contiguous readable region of a stream.
+	\param [in]      stream: The stream.
+	\param [out]     region: Start of the readable region.
+	\return          The size of the region in bytes, 0 if the stream is empty.
+	\note       		 Consumer side.
+ */
+uint32_t SPSC_Peek(SPSC_Stream_t *stream, const uint8_t **region)
+{
+  uint32_t head      = stream->head;
+  uint32_t tail      = stream->tail;
+  uint32_t offset    = tail & stream->mask;
+  uint32_t usedSize  = head - tail;
+  uint32_t untilEnd  = (stream->mask + 1u) - offset;
+
+  __DMB();
+  *region = &stream->buffer[offset];
+
+  return (usedSize < untilEnd) ? usedSize : untilEnd;
+}
+
+/**
+	\brief      		 Give back bytes read from the readable region.
+	\param [in, out] stream: The stream.
+	\param [in]      count:  Number of bytes read, at most the size returned by SPSC_Peek.
+	\note       		 Consumer side.
+ */
+void SPSC_Release(SPSC_Stream_t *stream, uint32_t count)
+{
+  __DMB();
+  stream->tail = stream->tail + count;
+}
+
+/**
+	\brief      		 Copy bytes out of a stream.
+	\param [in, out] stream: The stream.
+	\param [out]     data:   Where to copy the bytes.
+	\param [in]      size:   Maximum number of bytes to read.
+	\return          The number of bytes read.
+	\note       		 Consumer side.
+ */
+uint32_t SPSC_Read(SPSC_Stream_t *stream, void *data, uint32_t size)
+{
+  uint8_t       *dst  = (uint8_t*)data;
+  uint32_t       read = 0u;
+  uint32_t       count;
+  const uint8_t *region;
+
+  for (uint32_t i = 0; (i < 2u) && (read < size); i++)
+  {
+    count = SPSC_Peek(stream, &region);
+    if (count > (size - read))
+    {
+      count = size - read;
+    }
+
+    for (uint32_t j = 0; j < count; j++)
+    {
+      dst[read + j] = region[j];
+    }
+
+    SPSC_Release(stream, count);
+    read += count;
+  }
+
+  return read;
+}
+
+/**
+	\brief      		 Get the number of bytes in a stream.
+	\param [in]      stream: The stream.
+	\return          The number of committed bytes not released yet.
+ */
+uint32_t SPSC_GetUsedSize(const SPSC_Stream_t *stream)
+{
+  return stream->head - stream->tail;
+}
+
+/**
+	\brief      		 Get the free space of a stream.
+	\param [in]      stream: The stream.
+	\return          The number of bytes that can be written.
+ */
+uint32_t SPSC_GetFreeSize(const SPSC_Stream_t *stream)
+{
+  return (stream->mask + 1u) - (stream->head - stream->tail);
+}
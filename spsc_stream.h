@@ -0,0 +1,47 @@
+#ifndef SPSC_STREAM_H
+#define SPSC_STREAM_H
+
+#include "interrupt_handling.h"
+
+/* Alignment of the head and tail indices, see MPSC_CACHE_LINE_SIZE */
+#ifndef SPSC_CACHE_LINE_SIZE
+#if (__CORTEX_M >= 7)
+#define SPSC_CACHE_LINE_SIZE       32u
+#else
+#define SPSC_CACHE_LINE_SIZE       4u
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  /* Free-running count of bytes committed, written by the producer only */
+  volatile uint32_t head   __ALIGNED(SPSC_CACHE_LINE_SIZE);
+  /* Free-running count of bytes released, written by the consumer only */
+  volatile uint32_t tail   __ALIGNED(SPSC_CACHE_LINE_SIZE);
+  /* Read-only after SPSC_Init */
+  uint8_t          *buffer __ALIGNED(SPSC_CACHE_LINE_SIZE);
+  uint32_t          mask;
+} SPSC_Stream_t;
+
+bool     SPSC_Init(SPSC_Stream_t *stream, uint8_t *buffer, uint32_t size);
+
+INTERRUPT_FAST_CODE uint32_t SPSC_Reserve(SPSC_Stream_t *stream, uint8_t **region);
+INTERRUPT_FAST_CODE void     SPSC_Commit(SPSC_Stream_t *stream, uint32_t count);
+INTERRUPT_FAST_CODE uint32_t SPSC_Write(SPSC_Stream_t *stream, const void *data, uint32_t size);
+
+uint32_t SPSC_Peek(SPSC_Stream_t *stream, const uint8_t **region);
+void     SPSC_Release(SPSC_Stream_t *stream, uint32_t count);
+uint32_t SPSC_Read(SPSC_Stream_t *stream, void *data, uint32_t size);
+
+uint32_t SPSC_GetUsedSize(const SPSC_Stream_t *stream);
+uint32_t SPSC_GetFreeSize(const SPSC_Stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPSC_STREAM_H */
@@ -0,0 +1,114 @@
+#include "stack_watermark.h"
+
+/* Words never written below the current SP by STACK_Paint, for the frame of
+ * STACK_Paint itself */
+#define STACK_PAINT_MARGIN_WORDS   8u
+
+static uint32_t *stackBottom;
+static uint32_t *stackTop;
+/* Lowest word found written by the last scan, nothing is free below it */
+static uint32_t *stackWatermark;
+
+/* Notes:
+
+Size the main stack from measurements rather than guesswork: paint the free
+part of the stack with a pattern early, let the application run through its
+worst cases, then find the lowest word that is not the pattern anymore.
+
+STACK_Init takes the limits of the main stack: the bottom (lowest address,
+from the linker script) and the top, by default the initial MSP stored in the
+first word of the vector table. STACK_Paint writes the pattern from the
+bottom up to a few words below the current SP, so call it from thread mode,
+before the stack gets deep (at the start of main).
+
+The used part only grows downwards, so the scan goes up from the bottom,
+comparing four words per iteration, and stops at the first written word, or
+at the watermark of the previous scan when nothing changed. Its cost is
+proportional to the free part, about one cycle per byte, so it can run
+periodically from the idle loop.
+
+A function may reserve a large frame and write only part of it: the
+untouched words between are missed. Keep a margin over STACK_GetMaxUsedSize,
+and compare with INSTR_GetMaxMspUsage (irq_instrument.c), which gives the
+stack used by the deepest preemption seen.
+
+For example, with the symbols of the STM32CubeIDE linker scripts:
+
+extern uint32_t _estack;
+extern uint32_t _Min_Stack_Size;
+
+STACK_Init((uint8_t*)&_estack - (uint32_t)&_Min_Stack_Size, NULL);
+STACK_Paint();
+...
+maxUsed = STACK_GetMaxUsedSize();
+
+*/
+
+/**
+	\brief      		 Set the limits of the main stack.
+	\param [in]      bottom: Lowest address of the stack.
+	\param [in]      top:    Address above the stack, NULL to use the initial MSP of the
+									 vector table.
+ */
+void STACK_Init(void *bottom, void *top)
+{
+  stackBottom    = (uint32_t*)(((uint32_t)bottom + 3u) & ~3UL);
+  stackTop       = (top != NULL) ? (uint32_t*)top : (uint32_t*)(*(uint32_t*)SCB->VTOR);
+  stackWatermark = stackTop;
+}
+
+/**
+	\brief      		 Paint the free part of the main stack.
+	\details    		 Write STACK_PAINT_PATTERN from the bottom of the stack up to just below
+									 the current SP.
+	\note       		 Call it from thread mode, once STACK_Init has been called. Handlers
+									 preempting it use the stack below the SP and are done when it
+									 resumes, so interrupts can stay enabled.
+ */
+void STACK_Paint(void)
+{
+  uint32_t *limit = (uint32_t*)(__get_MSP() & ~3UL) - STACK_PAINT_MARGIN_WORDS;
+
+  for (volatile uint32_t *word = stackBottom; word < limit; word++)
+  {
+    *word = STACK_PAINT_PATTERN;
+  }
+  stackWatermark = limit;
+}
+
+/**
+	\brief      		 Get the part of the main stack never used since it was painted.
+	\return          Bytes between the bottom of the stack and the lowest written word.
+ */
+uint32_t STACK_GetFreeSize(void)
+{
+  const volatile uint32_t *word  = stackBottom;
+  const uint32_t          *limit = stackWatermark;
+
+  /* Four words per iteration while they all fit below the watermark */
+  while (((word + 4) <= limit)
+         && (word[0] == STACK_PAINT_PATTERN) && (word[1] == STACK_PAINT_PATTERN)
+         && (word[2] == STACK_PAINT_PATTERN) && (word[3] == STACK_PAINT_PATTERN))
+  {
+    word += 4;
+  }
+  while ((word < limit) && (*word == STACK_PAINT_PATTERN))
+  {
+    word++;
+  }
+
+  stackWatermark = (uint32_t*)word;
+
+  return (uint32_t)((uint32_t)word - (uint32_t)stackBottom);
+}
+
+/**
+	\brief      		 Get the deepest use of the main stack since it was painted.
+	\return          Bytes between the top of the stack and the lowest written word.
+ */
+uint32_t STACK_GetMaxUsedSize(void)
+{
+  uint32_t freeSize = STACK_GetFreeSize();
+
+  return (uint32_t)((uint32_t)stackTop - (uint32_t)stackBottom) - freeSize;
+}
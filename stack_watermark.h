@@ -0,0 +1,22 @@
+#ifndef STACK_WATERMARK_H
+#define STACK_WATERMARK_H
+
+#include "interrupt_handling.h"
+
+/* Written in the free part of the stack by STACK_Paint */
+#define STACK_PAINT_PATTERN        0xC5C5C5C5UL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void     STACK_Init(void *bottom, void *top);
+void     STACK_Paint(void);
+uint32_t STACK_GetFreeSize(void);
+uint32_t STACK_GetMaxUsedSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACK_WATERMARK_H */
@@ -0,0 +1,303 @@
+#include "task_scheduler.h"
+#include "atomic_ops.h"
+
+/* Whether the input priority level can be used by the scheduler */
+#define IS_TASK_LVL_VALID(lvl)     (INTERRUPT_HIGHEST_PRIORITY < (lvl) \
+                                    && (lvl) <= INTERRUPT_LOWEST_PRIORITY)
+/* Whether the input IRQn is a device interrupt with a vector in the table */
+#define IS_TASK_IRQn_VALID(IRQn)   (((int16_t)(IRQn) >= 0) \
+                                    && ((uint32_t)(IRQn) < (INTERRUPT_VECTOR_TABLE_WORDS - 16u)))
+
+typedef struct
+{
+  IRQn_Type          irqNum;
+  bool               isBound;
+  uint8_t            numOfTasks;
+  volatile uint32_t  readyMask;
+  TASK_Task_t       *tasks[TASK_MAX_TASKS_PER_LEVEL];
+} TASK_Level_t;
+
+INTERRUPT_FAST_DATA static TASK_Level_t taskLevels[INTERRUPT_LOWEST_PRIORITY + 1u];
+
+/* Notes:
+
+The scheduler runs software tasks the same way the NVIC runs interrupt
+handlers: each priority level is bound to an interrupt vector that no
+peripheral uses, and spawning a task only marks it ready and pends that
+vector. The NVIC then does the scheduling: the level runs as soon as nothing
+with a higher priority is running, preempts lower levels, and all the tasks
+share the main stack since a task always runs to completion.
+
+A task spawned while it is already ready runs once. Tasks of the same level
+run in registration order.
+
+Tasks sharing data lock it with a RESOURCE_SECTION, which raises BASEPRI to
+the ceiling of the resource (the highest priority level among its users).
+Tasks of a higher priority than the ceiling, and the interrupts above it,
+keep running. A user at level 0 cannot be masked by BASEPRI: the section of
+its resources disables all interrupts, like on ARMv6-M.
+
+For example:
+
+static TASK_Task_t     controlTask, loggerTask;
+static TASK_Resource_t setpoint;
+
+void APP_InitTasks(void)
+{
+    TASK_BindPriorityLevel(2u, CAN2_RX1_IRQn);
+    TASK_BindPriorityLevel(6u, CAN2_SCE_IRQn);
+    TASK_Register(&controlTask, CONTROL_Run, NULL, 2u);
+    TASK_Register(&loggerTask,  LOGGER_Run,  NULL, 6u);
+    TASK_InitResource(&setpoint);
+    TASK_AddResourceUser(&setpoint, 2u);
+    TASK_AddResourceUser(&setpoint, 6u);
+}
+
+static void LOGGER_Run(void *arg)
+{
+    RESOURCE_SECTION(&setpoint,
+      value = currentSetpoint;
+    )
+}
+
+With TASK_ENABLE_STATISTICS defined (and IRQ_EnableCycleCounter called), each
+task records its spawn-to-run latency. TASK_Spawn stores the spawn time
+before it sets the ready bit: storing it after would let an interrupt that
+spawns another task of the level, in between, pend the dispatcher, which
+would then run the task timed from its previous spawn. When two spawns of
+the same task race, the time kept was taken before the ready bit was set, so
+the latency can only be overestimated.
+
+*/
+
+/* Index of the lowest bit set in a non-zero mask */
+__STATIC_FORCEINLINE uint32_t TASK_LowestBit(uint32_t mask)
+{
+#if (__CORTEX_M >= 3)
+  return __CLZ(__RBIT(mask));
+#else
+  uint32_t index = 0u;
+
+  while ((mask & 1u) == 0u)
+  {
+    mask >>= 1;
+    index++;
+  }
+
+  return index;
+#endif
+}
+
+/**
+	\brief      		 Bind a priority level to a spare interrupt vector.
+	\details    		 Install TASK_Dispatcher as the handler of the vector, set its
+									 priority to the level and enable it.
+	\param [in]      priorityLevel: Priority level of the tasks dispatched by the vector.
+	\param [in]      spareIrqNum:   Device interrupt number that no peripheral uses.
+	\return          true if the level has been bound, false if the level or the
+									 interrupt number is invalid (or has no vector below
+									 INTERRUPT_VECTOR_TABLE_WORDS) or the level is already bound.
+	\note       		 The vector table must be in RAM (see NVIC_RelocateVectorTableToRam).
+ */
+bool TASK_BindPriorityLevel(uint8_t priorityLevel, IRQn_Type spareIrqNum)
+{
+  bool isBound = false;
+
+  if (IS_TASK_LVL_VALID(priorityLevel)
+      && IS_TASK_IRQn_VALID(spareIrqNum)
+      && !taskLevels[priorityLevel].isBound)
+  {
+    NVIC_DisableIRQ(spareIrqNum);
+    NVIC_ClearPendingIRQ(spareIrqNum);
+    taskLevels[priorityLevel].irqNum  = spareIrqNum;
+    taskLevels[priorityLevel].isBound = true;
+    NVIC_SetIRQnHandler(spareIrqNum, (void*)TASK_Dispatcher);
+    NVIC_SetPriority(spareIrqNum, priorityLevel);
+    NVIC_EnableIRQ(spareIrqNum);
+    isBound = true;
+  }
+
+  return isBound;
+}
+
+/**
+	\brief      		 Register a task.
+	\param [out]     task:          The task to register.
+	\param [in]      function:      The function run by the task.
+	\param [in]      arg:           The argument given to the function.
+	\param [in]      priorityLevel: Priority level of the task, it must be bound
+									 (see TASK_BindPriorityLevel).
+	\return          true if the task has been registered, false if the level is not
+									 bound or already has TASK_MAX_TASKS_PER_LEVEL tasks.
+	\note       		 Tasks are registered at initialization, before they are spawned.
+ */
+bool TASK_Register(TASK_Task_t *task, TASK_Function_t function, void *arg,
+                   uint8_t priorityLevel)
+{
+  bool          isRegistered = false;
+  TASK_Level_t *level;
+
+  if (IS_TASK_LVL_VALID(priorityLevel))
+  {
+    level = &taskLevels[priorityLevel];
+
+    if (level->isBound && (level->numOfTasks < TASK_MAX_TASKS_PER_LEVEL))
+    {
+      task->function      = function;
+      task->arg           = arg;
+      task->priorityLevel = priorityLevel;
+      task->index         = level->numOfTasks;
+#if defined(TASK_ENABLE_STATISTICS)
+      task->numOfRuns          = 0u;
+      task->maxLatencyCycles   = 0u;
+      task->totalLatencyCycles = 0u;
+#endif
+      level->tasks[level->numOfTasks] = task;
+      level->numOfTasks++;
+      isRegistered = true;
+    }
+  }
+
+  return isRegistered;
+}
+
+/**
+	\brief      		 Spawn a task.
+	\details    		 Mark the task ready and pend the vector of its level.
+	\param [in, out] task: The task to run.
+	\return          true if the task has been made ready, false if it was already ready.
+	\note       		 Can be called from thread mode, from any ISR and from any task.
+ */
+INTERRUPT_FAST_CODE bool TASK_Spawn(TASK_Task_t *task)
+{
+  TASK_Level_t *level = &taskLevels[task->priorityLevel];
+  uint32_t      bit   = 1UL << task->index;
+
+#if defined(TASK_ENABLE_STATISTICS)
+  uint32_t      spawnCycles = IRQ_GetCycleCount();
+
+  /* Timed before the task is made ready, so that the dispatcher never reads
+   * the time of a previous spawn. A coalesced spawn keeps the time of the
+   * first one. */
+  if ((level->readyMask & bit) == 0u)
+  {
+    task->spawnCycles = spawnCycles;
+  }
+#endif
+
+  if ((ATOMIC_FetchOr32(&level->readyMask, bit) & bit) != 0u)
+  {
+    return false;
+  }
+
+  NVIC_SetPendingIRQ(level->irqNum);
+
+  return true;
+}
+
+/**
+	\brief      		 Interrupt handler dispatching the tasks of a level.
+	\details    		 Find the level from the priority of the active vector and run its
+									 ready tasks until none is left.
+	\note       		 Installed by TASK_BindPriorityLevel, not meant to be called directly.
+ */
+INTERRUPT_FAST_CODE void TASK_Dispatcher(void)
+{
+  TASK_Level_t *level = &taskLevels[NVIC_GetPriority(IRQ_GetActiveIRQn())];
+  TASK_Task_t  *task;
+  uint32_t      readyMask;
+  uint32_t      index;
+
+  while ((readyMask = ATOMIC_Exchange32(&level->readyMask, 0u)) != 0u)
+  {
+    while (readyMask != 0u)
+    {
+      index      = TASK_LowestBit(readyMask);
+      readyMask &= ~(1UL << index);
+      task       = level->tasks[index];
+
+#if defined(TASK_ENABLE_STATISTICS)
+      {
+        uint32_t latency = IRQ_GetCycleCount() - task->spawnCycles;
+
+        if (latency > task->maxLatencyCycles)
+        {
+          task->maxLatencyCycles = latency;
+        }
+        task->totalLatencyCycles += latency;
+        task->numOfRuns++;
+      }
+#endif
+
+      task->function(task->arg);
+    }
+  }
+}
+
+/**
+	\brief      		 Initialize a shared resource.
+	\param [out]     resource: The resource to initialize.
+	\note       		 The ceiling starts at the lowest priority level, use
+									 TASK_AddResourceUser to raise it.
+ */
+void TASK_InitResource(TASK_Resource_t *resource)
+{
+  resource->ceilingLevel = INTERRUPT_LOWEST_PRIORITY;
+}
+
+/**
+	\brief      		 Declare a user of a shared resource.
+	\details    		 Raise the ceiling of the resource to the priority level of the
+									 user if it is higher. A user at level 0, which BASEPRI cannot
+									 mask, makes the sections of the resource disable all interrupts.
+	\param [in, out] resource:      The resource.
+	\param [in]      priorityLevel: Priority level of a task or interrupt handler
+									 accessing the resource.
+	\return          true if the user has been added, false if the level is invalid.
+ */
+bool TASK_AddResourceUser(TASK_Resource_t *resource, uint8_t priorityLevel)
+{
+  if (priorityLevel > INTERRUPT_LOWEST_PRIORITY)
+  {
+    return false;
+  }
+
+  if (priorityLevel < resource->ceilingLevel)
+  {
+    resource->ceilingLevel = priorityLevel;
+  }
+
+  return true;
+}
+
+/**
+	\brief      		 Lock a shared resource.
+	\param [in]      resource: The resource.
+	\return          The state to give to TASK_ExitResourceSection.
+ */
+uint32_t TASK_EnterResourceSection(const TASK_Resource_t *resource)
+{
+  if (resource->ceilingLevel == INTERRUPT_HIGHEST_PRIORITY)
+  {
+    return PRIMASK_EnterNoInterruptsSection();
+  }
+
+  return BASEPRI_EnterPriorityCeilingSection(resource->ceilingLevel);
+}
+
+/**
+	\brief      		 Unlock a shared resource.
+	\param [in]      resource: The resource given to TASK_EnterResourceSection.
+	\param [in]      irqState: The state returned by TASK_EnterResourceSection.
+ */
+void TASK_ExitResourceSection(const TASK_Resource_t *resource, uint32_t irqState)
+{
+  if (resource->ceilingLevel == INTERRUPT_HIGHEST_PRIORITY)
+  {
+    PRIMASK_ExitNoInterruptsSection(irqState);
+  }
+  else
+  {
+    BASEPRI_ExitInterruptsDisabledByThresholdSection(irqState);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include "interrupt_handling.h"
+
+/* Maximum number of tasks bound to one priority level, at most 32 */
+#ifndef TASK_MAX_TASKS_PER_LEVEL
+#define TASK_MAX_TASKS_PER_LEVEL   32u
+#endif
+
+#if (TASK_MAX_TASKS_PER_LEVEL > 32u)
+#error "TASK_MAX_TASKS_PER_LEVEL must fit in the 32-bit ready mask"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENTER_RESOURCE_SECTION(resource)   irqState = TASK_EnterResourceSection(resource)
+#define EXIT_RESOURCE_SECTION(resource)    TASK_ExitResourceSection((resource), irqState)
+#define RESOURCE_SECTION(resource, inputSection) \
+  {                                              \
+    DECLARE_IRQ_STATE;                           \
+    ENTER_RESOURCE_SECTION(resource);            \
+    {                                            \
+      inputSection                               \
+    }                                            \
+    EXIT_RESOURCE_SECTION(resource);             \
+  }
+
+typedef void (*TASK_Function_t)(void *arg);
+
+/* A run-to-completion software task, bound to a priority level */
+typedef struct
+{
+  TASK_Function_t function;
+  void           *arg;
+  uint8_t         priorityLevel;
+  uint8_t         index;
+#if defined(TASK_ENABLE_STATISTICS)
+  uint32_t        spawnCycles;
+  uint32_t        numOfRuns;
+  uint32_t        maxLatencyCycles;
+  uint32_t        totalLatencyCycles;
+#endif
+} TASK_Task_t;
+
+/* State shared between tasks, protected by the priority ceiling of its users */
+typedef struct
+{
+  uint8_t ceilingLevel;
+} TASK_Resource_t;
+
+bool     TASK_BindPriorityLevel(uint8_t priorityLevel, IRQn_Type spareIrqNum);
+bool     TASK_Register(TASK_Task_t *task, TASK_Function_t function, void *arg,
+                       uint8_t priorityLevel);
+INTERRUPT_FAST_CODE bool TASK_Spawn(TASK_Task_t *task);
+INTERRUPT_FAST_CODE void TASK_Dispatcher(void);
+
+void     TASK_InitResource(TASK_Resource_t *resource);
+bool     TASK_AddResourceUser(TASK_Resource_t *resource, uint8_t priorityLevel);
+uint32_t TASK_EnterResourceSection(const TASK_Resource_t *resource);
+void     TASK_ExitResourceSection(const TASK_Resource_t *resource, uint32_t irqState);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TASK_SCHEDULER_H */
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Replay the recordings of this directory on irqs.txt with tools/irq_sim.c:
+# a regression suite of the simulator, the model and the core timing. Builds
+# irq_sim unless one is given, prints the recordings that fail and exits
+# with 1 if any does.
+#
+# usage: tools/corpus/replay.sh [irq_sim]
+
+corpus=$(dirname "$0")
+sim=$1
+
+if [ -z "$sim" ]; then
+  sim=$(mktemp) || exit 2
+  trap 'rm -f "$sim"' EXIT
+  ${CC:-cc} -std=c99 -O2 -o "$sim" "$corpus/../irq_sim.c" || exit 2
+fi
+
+status=0
+for replay in "$corpus"/*.txt; do
+  [ "$replay" = "$corpus/irqs.txt" ] && continue
+  if ! "$sim" -r "$replay" "$corpus/irqs.txt" > /dev/null; then
+    echo "FAIL $replay"
+    status=1
+  fi
+done
+
+exit $status
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Latency of a vector table in RAM against one in flash, with
+# tools/irq_sim.c: runs irqs.txt, which has the table in zero wait state RAM
+# (core m4 0), then the same model with the table in flash (core m4 5, the
+# 5 wait states of STM32F4 flash at 168 MHz), and prints the latencies and
+# the rta.c response bound of every IRQ for both, with their difference.
+#
+# The run is a random one (-n 20000000 -j 10 -s 1), or the replay of a
+# recording when one is given, its expect lines dropped: they hold for the
+# RAM table only. The shortest latency is the tail-chaining or entry of an
+# idle core, where the wait states show alone; the mean and the longest
+# depend on the interleaving a run meets, the bound is the worst case.
+# Builds irq_sim unless one is given.
+#
+# usage: tools/corpus/vector_table.sh [irq_sim [recording]]
+
+corpus=$(dirname "$0")
+sim=$1
+
+work=$(mktemp -d) || exit 2
+trap 'rm -rf "$work"' EXIT
+if [ -z "$sim" ]; then
+  sim=$work/irq_sim
+  ${CC:-cc} -std=c99 -O2 -o "$sim" "$corpus/../irq_sim.c" || exit 2
+fi
+
+if [ -n "$2" ]; then
+  sed '/^expect/d' "$2" > "$work/replay.txt" || exit 2
+  run="-r $work/replay.txt"
+  echo "replay of $2"
+else
+  run="-n 20000000 -j 10 -s 1"
+  echo "random run, $run"
+fi
+sed 's/^core m4 0$/core m4 5/' "$corpus/irqs.txt" > "$work/flash.txt"
+
+# irq_sim exits with 3 to 5 on a response above the bound or the deadline,
+# still a result to compare
+for table in ram flash; do
+  model=$corpus/irqs.txt
+  [ "$table" = flash ] && model=$work/flash.txt
+  "$sim" $run "$model" > "$work/$table.out"
+  status=$?
+  if [ $status -ne 0 ] && [ $status -lt 3 ]; then
+    exit 1
+  fi
+  head -n 1 "$work/$table.out"
+done
+
+awk '
+  FNR == 1 { isTable = 0 }
+  /^irq / { isTable = 1; next }
+  isTable && ($2 ~ /^[0-9]+$/) {
+    if (FILENAME ~ /ram\.out$/) { names[++n] = $1; ram[$1] = $6 " " $7 " " $8 " " $10 }
+    else { flash[$1] = $6 " " $7 " " $8 " " $10 }
+  }
+  END {
+    printf "%-16s %-20s %-20s %-20s %s\n", "cycles ram/flash", "lat min", "lat avg", "lat max", "rta bound"
+    for (i = 1; i <= n; i++) {
+      split(ram[names[i]], r, " ")
+      split(flash[names[i]], f, " ")
+      line = sprintf("%-16s", names[i])
+      for (k = 1; k <= 4; k++) {
+        cell = r[k] "/" f[k]
+        # A bound above the deadline is no number
+        if ((r[k] ~ /^[0-9]+$/) && (f[k] ~ /^[0-9]+$/)) cell = cell sprintf(" (%+d)", f[k] - r[k])
+        line = line sprintf(" %-20s", cell)
+      }
+      sub(/ +$/, "", line)
+      print line
+    }
+  }' "$work/ram.out" "$work/flash.out"
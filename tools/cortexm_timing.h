@@ -0,0 +1,84 @@
+/* Exception timing of the Cortex-M cores, shared by the host tools
+(rta_model.h, irq_sim.c).
+
+Cycles with zero wait state memory:
+	- stacking: from the request to the first instruction of the handler,
+	  the 8-word frame pushed while the vector is fetched (the published
+	  interrupt latency: 16 on M0, 15 on M0+, 12 on M3/M4/M7);
+	- unstacking: from the exception return to the first instruction of the
+	  interrupted code;
+	- tail-chaining: from the end of a handler to the first instruction of a
+	  pending one, without unstacking and stacking again;
+	- late arrival: a more urgent request arriving in the first cycles of the
+	  stacking takes the entry over, the frame being the same, and is entered
+	  when the stacking ends;
+	- pop preemption: a request arriving during the unstacking abandons it
+	  and is tail-chained;
+	- FP: on cores with an FPU, the extended frame of a context using it is
+	  only reserved on entry (lazy stacking), the 17 FP words are pushed when
+	  the handler uses the FPU and popped on return.
+Each wait state of the memory holding the vector table adds a cycle to the
+vector fetch, on entry and on tail-chaining.
+
+Sources of the profiles below:
+	- stacking: the interrupt latency of the Technical Reference Manual of
+	  each core (Cortex-M0, M0+, M3, M4, M7 TRM, "Interrupt latency"),
+	  also listed in the Arm white paper "Cortex-M for Beginners";
+	- tail-chaining: 6 cycles in the Cortex-M3 and M4 TRMs; the M0, M0+ and
+	  M7 values reuse that figure;
+	- unstacking, late arrival window and FP: placeholders, estimated from
+	  the frame sizes of the ARMv6-M and ARMv7-M Architecture Reference
+	  Manuals, not published numbers.
+Only the stacking figures are published for every core. Measure the
+others on the target (DWT cycle counter, irq_latency.c) and set the entry,
+exit and tail-chain cycles with the overhead line of the model before
+trusting a bound that depends on them.
+
+*/
+
+#ifndef CORTEXM_TIMING_H
+#define CORTEXM_TIMING_H
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct
+{
+  const char *name;
+  uint32_t    stackingCycles;
+  uint32_t    unstackingCycles;
+  uint32_t    tailChainCycles;
+  /* Cycles from the start of the stacking during which a late arrival is taken */
+  uint32_t    lateArrivalCycles;
+  /* Extra cycles to push and pop the FP registers, 0 without FPU */
+  uint32_t    fpStackingCycles;
+  uint32_t    fpUnstackingCycles;
+} CORE_Profile_t;
+
+/* Stacking: TRM. Tail-chain: TRM on M3/M4, same value elsewhere. The other
+ * columns are placeholders, see above. */
+static const CORE_Profile_t coreProfiles[] =
+{
+  { "m0",     16u, 16u, 6u, 10u,  0u,  0u },
+  { "m0plus", 15u, 15u, 6u,  9u,  0u,  0u },
+  { "m3",     12u, 10u, 6u,  6u,  0u,  0u },
+  { "m4",     12u, 10u, 6u,  6u,  0u,  0u },
+  { "m4f",    12u, 10u, 6u,  6u, 18u, 18u },
+  { "m7",     12u, 10u, 6u,  6u, 18u, 18u },
+};
+
+/* Profile of a core by name, NULL if unknown */
+static const CORE_Profile_t *CORE_FindProfile(const char *name)
+{
+  for (size_t i = 0u; i < (sizeof(coreProfiles) / sizeof(coreProfiles[0])); i++)
+  {
+    if (strcmp(coreProfiles[i].name, name) == 0)
+    {
+      return &coreProfiles[i];
+    }
+  }
+
+  return NULL;
+}
+
+#endif /* CORTEXM_TIMING_H */
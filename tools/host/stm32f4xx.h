@@ -0,0 +1,672 @@
+/* Host stand-in of the device header, to run the library on Linux
+(irq_stress.c, irq_bench.c, irq_replay.c).
+
+The library includes "stm32f4xx.h": with -Itools/host it gets this one,
+which emulates the core instead of the CMSIS core header:
+	- the NVIC, SCB, SysTick, DWT and CoreDebug registers are plain memory mapped at
+	  their addresses by HOST_Init, below 4 GB so that their addresses fit
+	  the 32-bit words of the library on a 64-bit host;
+	- PRIMASK, BASEPRI, IPSR and the exclusive monitor of LDREX/STREX are
+	  variables of the emulation;
+	- every intrinsic is a point where an interrupt can be taken: the
+	  interrupt source (HOST_SetInterruptSource) may pend interrupts, then
+	  the pending, enabled and unmasked ones run, the most urgent first, as
+	  calls of the handlers given to HOST_SetHandler. Exception entry and
+	  return clear the exclusive monitor, so a STREX after a handler fails
+	  as on the core;
+	- HOST_Interrupt does the same from a signal handler, to preempt thread
+	  code anywhere and not only at the intrinsics. Inside the emulation, it
+	  is deferred to the end of the intrinsic.
+Handlers are not read from the vector table: the table holds 32-bit words,
+too small for host addresses.
+
+ISER, ICER, ISPR and ICPR are plain memory: the writes of the library to
+their first word are applied at the next intrinsic. Between two intrinsics
+ISER and ICER read as the enabled interrupts, ISPR and ICPR as the pending
+ones, each with a marker bit above the implemented interrupts. A word
+without its marker has been written since. The library never writes a value
+read from the same register, that would go unnoticed. The other words hold
+what was written to them, there are no interrupts there.
+
+PendSV and SysTick are the only system exceptions, and HOST_SetHandler
+takes PendSV_IRQn and SysTick_IRQn:
+	- a write of PENDSVSET to ICSR pends PendSV at the next intrinsic, which
+	  also restores VECTACTIVE;
+	- SysTick counts one cycle per intrinsic, like DWT->CYCCNT, on the
+	  processor clock whatever CLKSOURCE says. Enabled, it reloads from LOAD
+	  when VAL is 0 and otherwise decrements. Reaching 0 sets COUNTFLAG and,
+	  with TICKINT, pends the SysTick exception;
+	- each runs at its SHP priority and wins a tie with the device
+	  interrupts, PendSV first, as on the core.
+
+ARMv7-M by default (__NVIC_PRIO_BITS 4), ARMv6-M with -D__CORTEX_M=0
+(__NVIC_PRIO_BITS 2, no BASEPRI and no exclusive accesses in the library).
+Needs _DEFAULT_SOURCE for mmap.
+
+*/
+
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#ifndef __CORTEX_M
+#define __CORTEX_M                 4U
+#endif
+#if (__CORTEX_M >= 3)
+#define __NVIC_PRIO_BITS           4U
+#else
+#define __NVIC_PRIO_BITS           2U
+#endif
+
+#define __WEAK                     __attribute__((weak))
+#define __INLINE                   inline
+#define __STATIC_INLINE            static inline
+#define __STATIC_FORCEINLINE       static inline __attribute__((always_inline))
+#define __ALIGNED(x)               __attribute__((aligned(x)))
+#define __USED                     __attribute__((used))
+#define __NO_RETURN                __attribute__((noreturn))
+#define __ASM                      __asm
+
+#define __I                        volatile const
+#define __O                        volatile
+#define __IO                       volatile
+#define __IM                       volatile const
+#define __OM                       volatile
+#define __IOM                      volatile
+
+/* Device interrupts of the emulation, all in the first NVIC word */
+#define HOST_NUM_OF_IRQS           16u
+#define HOST_IRQ_MASK              ((1UL << HOST_NUM_OF_IRQS) - 1u)
+
+/* Markers of the NVIC words not written since the last intrinsic */
+#define HOST_ISPR_MARKER           (1UL << 28)
+#define HOST_ICPR_MARKER           (1UL << 29)
+#define HOST_ISER_MARKER           (1UL << 30)
+#define HOST_ICER_MARKER           (1UL << 31)
+
+typedef enum
+{
+  NonMaskableInt_IRQn   = -14,
+  HardFault_IRQn        = -13,
+  MemoryManagement_IRQn = -12,
+  BusFault_IRQn         = -11,
+  UsageFault_IRQn       = -10,
+  SVCall_IRQn           = -5,
+  DebugMonitor_IRQn     = -4,
+  PendSV_IRQn           = -2,
+  SysTick_IRQn          = -1,
+  HOST_IRQ0_IRQn        = 0
+} IRQn_Type;
+
+typedef struct
+{
+  __IOM uint32_t ISER[8U];
+        uint32_t RESERVED0[24U];
+  __IOM uint32_t ICER[8U];
+        uint32_t RESERVED1[24U];
+  __IOM uint32_t ISPR[8U];
+        uint32_t RESERVED2[24U];
+  __IOM uint32_t ICPR[8U];
+        uint32_t RESERVED3[24U];
+  __IOM uint32_t IABR[8U];
+        uint32_t RESERVED4[56U];
+  __IOM uint8_t  IP[240U];
+        uint32_t RESERVED5[644U];
+  __OM  uint32_t STIR;
+} NVIC_Type;
+
+typedef struct
+{
+  __IM  uint32_t CPUID;
+  __IOM uint32_t ICSR;
+  __IOM uint32_t VTOR;
+  __IOM uint32_t AIRCR;
+  __IOM uint32_t SCR;
+  __IOM uint32_t CCR;
+  __IOM uint8_t  SHP[12U];
+  __IOM uint32_t SHCSR;
+} SCB_Type;
+
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t LOAD;
+  __IOM uint32_t VAL;
+  __IM  uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct
+{
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CYCCNT;
+  __IOM uint32_t CPICNT;
+  __IOM uint32_t EXCCNT;
+  __IOM uint32_t SLEEPCNT;
+  __IOM uint32_t LSUCNT;
+  __IOM uint32_t FOLDCNT;
+  __IM  uint32_t PCSR;
+  __IOM uint32_t COMP0;
+} DWT_Type;
+
+typedef struct
+{
+  __IOM uint32_t DHCSR;
+  __OM  uint32_t DCRSR;
+  __IOM uint32_t DCRDR;
+  __IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define HOST_REGISTERS_BASE        0xE0000000UL
+#define HOST_REGISTERS_SIZE        0x10000UL
+
+#define NVIC                       ((NVIC_Type*)0xE000E100UL)
+#define SCB                        ((SCB_Type*)0xE000ED00UL)
+#define SysTick                    ((SysTick_Type*)0xE000E010UL)
+#define DWT                        ((DWT_Type*)0xE0001000UL)
+#define CoreDebug                  ((CoreDebug_Type*)0xE000EDF0UL)
+
+#define SCB_ICSR_VECTACTIVE_Pos    0U
+#define SCB_ICSR_VECTACTIVE_Msk    0x1FFUL
+#define SCB_ICSR_PENDSVSET_Msk     (1UL << 28)
+#define SCB_SCR_SEVONPEND_Msk      (1UL << 4)
+#define SysTick_CTRL_COUNTFLAG_Msk (1UL << 16)
+#define SysTick_CTRL_CLKSOURCE_Msk (1UL << 2)
+#define SysTick_CTRL_TICKINT_Msk   (1UL << 1)
+#define SysTick_CTRL_ENABLE_Msk    1UL
+#define SysTick_LOAD_RELOAD_Msk    0xFFFFFFUL
+#define DWT_CTRL_CYCCNTENA_Msk     1UL
+#define DWT_CTRL_NOCYCCNT_Msk      (1UL << 25)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+typedef void (*HOST_Handler_t)(void);
+/* Called at every interrupt point, isAsync set when called by HOST_Interrupt */
+typedef void (*HOST_InterruptSource_t)(int isAsync);
+
+typedef struct
+{
+  uint64_t numOfInterruptPoints;
+  uint64_t numOfHandlers;
+  uint64_t numOfFailedStrex;
+  uint64_t numOfDeferred;
+  uint32_t maxNesting;
+} HOST_Stats_t;
+
+static volatile uint32_t      hostPrimask;
+static volatile uint32_t      hostBasepri;
+static volatile uint32_t      hostIpsr;
+static volatile uint32_t      hostEnabled;
+static volatile uint32_t      hostPending;
+static volatile uintptr_t     hostExclusiveAddress;
+static int                    hostActivePriority[HOST_NUM_OF_IRQS + 3u];
+static uint32_t               hostNesting;
+static HOST_Handler_t         hostHandlers[HOST_NUM_OF_IRQS];
+static HOST_Handler_t         hostPendSvHandler;
+static volatile uint32_t      hostIsPendSvPending;
+static HOST_Handler_t         hostSysTickHandler;
+static volatile uint32_t      hostIsSysTickPending;
+static HOST_InterruptSource_t hostInterruptSource;
+static volatile sig_atomic_t  hostDepth;
+static volatile sig_atomic_t  hostIsDeferred;
+static HOST_Stats_t           hostStats;
+
+/* Read values of the NVIC words, from the emulation state */
+static inline void HOST_WriteNvic(void)
+{
+  NVIC->ISER[0] = hostEnabled | HOST_ISER_MARKER;
+  NVIC->ICER[0] = hostEnabled | HOST_ICER_MARKER;
+  NVIC->ISPR[0] = hostPending | HOST_ISPR_MARKER;
+  NVIC->ICPR[0] = hostPending | HOST_ICPR_MARKER;
+}
+
+/* Map the registers, exits if the address range is taken */
+static inline void HOST_Init(void)
+{
+  void *registers = mmap((void*)HOST_REGISTERS_BASE, HOST_REGISTERS_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (registers != (void*)HOST_REGISTERS_BASE)
+  {
+    fprintf(stderr, "cannot map the core registers at 0x%08lx\n", HOST_REGISTERS_BASE);
+    exit(1);
+  }
+  HOST_WriteNvic();
+}
+
+static inline void HOST_SetHandler(IRQn_Type irqNum, HOST_Handler_t handler)
+{
+  if (irqNum == PendSV_IRQn)
+  {
+    hostPendSvHandler = handler;
+  }
+  else if (irqNum == SysTick_IRQn)
+  {
+    hostSysTickHandler = handler;
+  }
+  else
+  {
+    hostHandlers[irqNum] = handler;
+  }
+}
+
+static inline void HOST_SetInterruptSource(HOST_InterruptSource_t source)
+{
+  hostInterruptSource = source;
+}
+
+/* Pend an interrupt without an interrupt point, for the interrupt source */
+static inline void HOST_SetPending(IRQn_Type irqNum)
+{
+  hostPending  |= 1UL << (uint32_t)irqNum;
+  NVIC->ISPR[0] = hostPending | HOST_ISPR_MARKER;
+  NVIC->ICPR[0] = hostPending | HOST_ICPR_MARKER;
+}
+
+static inline uint32_t HOST_GetEnabled(void)
+{
+  return hostEnabled;
+}
+
+static inline uint32_t HOST_GetPending(void)
+{
+  return hostPending;
+}
+
+/* Apply the writes to the NVIC words since the last call */
+static inline void HOST_SyncNvic(void)
+{
+  uint32_t isWritten = 0u;
+
+  if ((NVIC->ISER[0] & HOST_ISER_MARKER) == 0u)
+  {
+    hostEnabled |= NVIC->ISER[0] & HOST_IRQ_MASK;
+    isWritten    = 1u;
+  }
+  if ((NVIC->ICER[0] & HOST_ICER_MARKER) == 0u)
+  {
+    hostEnabled &= ~NVIC->ICER[0];
+    isWritten    = 1u;
+  }
+  if ((NVIC->ISPR[0] & HOST_ISPR_MARKER) == 0u)
+  {
+    hostPending |= NVIC->ISPR[0] & HOST_IRQ_MASK;
+    isWritten    = 1u;
+  }
+  if ((NVIC->ICPR[0] & HOST_ICPR_MARKER) == 0u)
+  {
+    hostPending &= ~NVIC->ICPR[0];
+    isWritten    = 1u;
+  }
+  if (isWritten != 0u)
+  {
+    HOST_WriteNvic();
+  }
+  if ((SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) != 0u)
+  {
+    hostIsPendSvPending = 1u;
+    SCB->ICSR           = hostIpsr;
+  }
+}
+
+static inline int HOST_GetIrqPriority(uint32_t irqNum)
+{
+  return NVIC->IP[irqNum] >> (8u - __NVIC_PRIO_BITS);
+}
+
+static inline int HOST_GetPendSvPriority(void)
+{
+  return SCB->SHP[10] >> (8u - __NVIC_PRIO_BITS);
+}
+
+static inline int HOST_GetSysTickPriority(void)
+{
+  return SCB->SHP[11] >> (8u - __NVIC_PRIO_BITS);
+}
+
+/* One cycle of the SysTick counter */
+static inline void HOST_TickSysTick(void)
+{
+  uint32_t value = SysTick->VAL & SysTick_LOAD_RELOAD_Msk;
+
+  if ((SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) == 0u)
+  {
+    return;
+  }
+  if (value == 0u)
+  {
+    SysTick->VAL = SysTick->LOAD & SysTick_LOAD_RELOAD_Msk;
+    return;
+  }
+  SysTick->VAL = --value;
+  if (value == 0u)
+  {
+    SysTick->CTRL |= SysTick_CTRL_COUNTFLAG_Msk;
+    if ((SysTick->CTRL & SysTick_CTRL_TICKINT_Msk) != 0u)
+    {
+      hostIsSysTickPending = 1u;
+    }
+  }
+}
+
+/* Priority the pending interrupts must beat, -1 with PRIMASK set */
+static inline int HOST_GetExecutionPriority(void)
+{
+  int priority = (hostNesting != 0u) ? hostActivePriority[hostNesting] : (1 << __NVIC_PRIO_BITS);
+
+  if (hostPrimask != 0u)
+  {
+    return -1;
+  }
+  if ((hostBasepri != 0u) && ((int)(hostBasepri >> (8u - __NVIC_PRIO_BITS)) < priority))
+  {
+    priority = (int)(hostBasepri >> (8u - __NVIC_PRIO_BITS));
+  }
+
+  return priority;
+}
+
+/* Run the pending interrupts that can preempt, the most urgent first */
+static inline void HOST_TakeInterrupts(void)
+{
+  uint32_t       ready;
+  uint32_t       best;
+  uint32_t       savedIpsr;
+  int            bestPriority;
+  /* System exception taken, HOST_IRQ0_IRQn for none (then best is taken) */
+  IRQn_Type      systemIrqNum;
+  HOST_Handler_t handler;
+
+  while (((ready = hostPending & hostEnabled) != 0u) || (hostIsPendSvPending != 0u)
+         || (hostIsSysTickPending != 0u))
+  {
+    bestPriority = HOST_GetExecutionPriority();
+    best         = HOST_NUM_OF_IRQS;
+    for (uint32_t irqNum = 0u; ready != 0u; irqNum++, ready >>= 1)
+    {
+      if (((ready & 1u) != 0u) && (HOST_GetIrqPriority(irqNum) < bestPriority))
+      {
+        best         = irqNum;
+        bestPriority = HOST_GetIrqPriority(irqNum);
+      }
+    }
+    /* The system exceptions have lower exception numbers than the device
+     * interrupts, and PendSV than SysTick: they win a tie in that order.
+     * SysTick is tested first, PendSV then takes over on a tie. */
+    systemIrqNum = HOST_IRQ0_IRQn;
+    if ((hostIsSysTickPending != 0u)
+        && ((HOST_GetSysTickPriority() < bestPriority)
+            || ((best != HOST_NUM_OF_IRQS) && (HOST_GetSysTickPriority() == bestPriority))))
+    {
+      systemIrqNum = SysTick_IRQn;
+      bestPriority = HOST_GetSysTickPriority();
+    }
+    if ((hostIsPendSvPending != 0u)
+        && ((HOST_GetPendSvPriority() < bestPriority)
+            || (((best != HOST_NUM_OF_IRQS) || (systemIrqNum != HOST_IRQ0_IRQn))
+                && (HOST_GetPendSvPriority() == bestPriority))))
+    {
+      systemIrqNum = PendSV_IRQn;
+      bestPriority = HOST_GetPendSvPriority();
+    }
+    if ((best == HOST_NUM_OF_IRQS) && (systemIrqNum == HOST_IRQ0_IRQn))
+    {
+      return;
+    }
+
+    /* Exception entry */
+    savedIpsr = hostIpsr;
+    if (systemIrqNum == PendSV_IRQn)
+    {
+      hostIsPendSvPending = 0u;
+      hostIpsr            = (uint32_t)PendSV_IRQn + 16u;
+      handler             = hostPendSvHandler;
+    }
+    else if (systemIrqNum == SysTick_IRQn)
+    {
+      hostIsSysTickPending = 0u;
+      hostIpsr             = (uint32_t)SysTick_IRQn + 16u;
+      handler              = hostSysTickHandler;
+    }
+    else
+    {
+      hostPending   &= ~(1UL << best);
+      NVIC->ISPR[0]  = hostPending | HOST_ISPR_MARKER;
+      NVIC->ICPR[0]  = hostPending | HOST_ICPR_MARKER;
+      NVIC->IABR[0] |= 1UL << best;
+      hostIpsr       = best + 16u;
+      handler        = hostHandlers[best];
+    }
+    hostActivePriority[++hostNesting] = bestPriority;
+    SCB->ICSR            = (SCB->ICSR & ~SCB_ICSR_VECTACTIVE_Msk) | hostIpsr;
+    hostExclusiveAddress = 0u;
+    hostStats.numOfHandlers++;
+    if (hostNesting > hostStats.maxNesting)
+    {
+      hostStats.maxNesting = hostNesting;
+    }
+
+    if (handler != NULL)
+    {
+      handler();
+    }
+
+    /* Exception return */
+    hostNesting--;
+    hostIpsr             = savedIpsr;
+    SCB->ICSR            = (SCB->ICSR & ~SCB_ICSR_VECTACTIVE_Msk) | hostIpsr;
+    if (systemIrqNum == HOST_IRQ0_IRQn)
+    {
+      NVIC->IABR[0]     &= ~(1UL << best);
+    }
+    hostExclusiveAddress = 0u;
+    HOST_SyncNvic();
+  }
+}
+
+static inline void HOST_InterruptPoint(int isAsync)
+{
+  hostStats.numOfInterruptPoints++;
+  DWT->CYCCNT = DWT->CYCCNT + 1u;
+  HOST_TickSysTick();
+  HOST_SyncNvic();
+  if (hostInterruptSource != NULL)
+  {
+    hostInterruptSource(isAsync);
+  }
+  HOST_TakeInterrupts();
+}
+
+/* Interrupt points of the intrinsics, an asynchronous interrupt deferred
+ * meanwhile is taken when the outermost one ends */
+static inline void HOST_Enter(void)
+{
+  hostDepth++;
+  HOST_InterruptPoint(0);
+}
+
+static inline void HOST_Leave(void)
+{
+  while ((hostDepth == 1) && hostIsDeferred)
+  {
+    hostIsDeferred = 0;
+    HOST_InterruptPoint(1);
+  }
+  hostDepth--;
+}
+
+/* Asynchronous interrupt point, for a signal handler */
+static inline void HOST_Interrupt(void)
+{
+  if (hostDepth != 0)
+  {
+    hostIsDeferred = 1;
+    hostStats.numOfDeferred++;
+    return;
+  }
+  hostDepth++;
+  HOST_InterruptPoint(1);
+  hostDepth--;
+}
+
+static inline void HOST_GetStats(HOST_Stats_t *stats)
+{
+  *stats = hostStats;
+}
+
+/* Core registers */
+static inline uint32_t __get_PRIMASK(void)         { HOST_Enter(); HOST_Leave(); return hostPrimask; }
+static inline void     __set_PRIMASK(uint32_t v)   { HOST_Enter(); hostPrimask = v & 1u; HOST_Leave(); }
+static inline void     __disable_irq(void)         { HOST_Enter(); hostPrimask = 1u; HOST_Leave(); }
+static inline void     __enable_irq(void)          { HOST_Enter(); hostPrimask = 0u; HOST_Leave(); }
+static inline uint32_t __get_IPSR(void)            { return hostIpsr; }
+static inline uint32_t __get_CONTROL(void)         { return 0u; }
+
+/* Only the implemented bits of BASEPRI are kept */
+#define HOST_BASEPRI_MASK          ((0xFFu << (8u - __NVIC_PRIO_BITS)) & 0xFFu)
+
+static inline uint32_t __get_BASEPRI(void)         { HOST_Enter(); HOST_Leave(); return hostBasepri; }
+static inline void     __set_BASEPRI(uint32_t v)   { HOST_Enter(); hostBasepri = v & HOST_BASEPRI_MASK; HOST_Leave(); }
+static inline void     __set_BASEPRI_MAX(uint32_t v)
+{
+  HOST_Enter();
+  v &= HOST_BASEPRI_MASK;
+  if ((v != 0u) && ((hostBasepri == 0u) || (v < hostBasepri)))
+  {
+    hostBasepri = v;
+  }
+  HOST_Leave();
+}
+
+/* Barriers and hints */
+static inline void __DMB(void)                     { HOST_Enter(); __sync_synchronize(); HOST_Leave(); }
+static inline void __DSB(void)                     { HOST_Enter(); __sync_synchronize(); HOST_Leave(); }
+static inline void __ISB(void)                     { HOST_Enter(); HOST_Leave(); }
+static inline void __NOP(void)                     { HOST_Enter(); HOST_Leave(); }
+static inline void __WFE(void)                     { HOST_Enter(); HOST_Leave(); }
+static inline void __WFI(void)                     { HOST_Enter(); HOST_Leave(); }
+static inline void __SEV(void)                     { HOST_Enter(); HOST_Leave(); }
+
+/* Exclusive accesses: the monitor holds the address of the last LDREX */
+#define HOST_DEFINE_EXCLUSIVE(suffix, type)                                   \
+static inline type __LDREX##suffix(volatile type *ptr)                        \
+{                                                                             \
+  type value;                                                                 \
+                                                                              \
+  HOST_Enter();                                                               \
+  value                = *ptr;                                                \
+  hostExclusiveAddress = (uintptr_t)ptr;                                      \
+  HOST_Leave();                                                               \
+                                                                              \
+  return value;                                                               \
+}                                                                             \
+                                                                              \
+static inline uint32_t __STREX##suffix(type value, volatile type *ptr)        \
+{                                                                             \
+  uint32_t isFailed = 1u;                                                     \
+                                                                              \
+  HOST_Enter();                                                               \
+  if (hostExclusiveAddress == (uintptr_t)ptr)                                 \
+  {                                                                           \
+    *ptr     = value;                                                         \
+    isFailed = 0u;                                                            \
+  }                                                                           \
+  else                                                                        \
+  {                                                                           \
+    hostStats.numOfFailedStrex++;                                             \
+  }                                                                           \
+  hostExclusiveAddress = 0u;                                                  \
+  HOST_Leave();                                                               \
+                                                                              \
+  return isFailed;                                                            \
+}
+
+HOST_DEFINE_EXCLUSIVE(B, uint8_t)
+HOST_DEFINE_EXCLUSIVE(H, uint16_t)
+HOST_DEFINE_EXCLUSIVE(W, uint32_t)
+
+static inline void    __CLREX(void)                { hostExclusiveAddress = 0u; }
+static inline uint8_t __CLZ(uint32_t v)            { return (v == 0u) ? 32u : (uint8_t)__builtin_clz(v); }
+static inline uint32_t __RBIT(uint32_t v)
+{
+  uint32_t result = 0u;
+
+  for (uint32_t i = 0u; i < 32u; i++, v >>= 1)
+  {
+    result = (result << 1) | (v & 1u);
+  }
+
+  return result;
+}
+
+/* NVIC functions of the CMSIS core */
+static inline void NVIC_EnableIRQ(IRQn_Type irqNum)
+{
+  HOST_Enter();
+  hostEnabled |= 1UL << (uint32_t)irqNum;
+  HOST_WriteNvic();
+  HOST_Leave();
+}
+
+static inline void NVIC_DisableIRQ(IRQn_Type irqNum)
+{
+  HOST_Enter();
+  hostEnabled &= ~(1UL << (uint32_t)irqNum);
+  HOST_WriteNvic();
+  HOST_Leave();
+}
+
+static inline void NVIC_SetPendingIRQ(IRQn_Type irqNum)
+{
+  HOST_Enter();
+  HOST_SetPending(irqNum);
+  HOST_Leave();
+}
+
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irqNum)
+{
+  HOST_Enter();
+  hostPending &= ~(1UL << (uint32_t)irqNum);
+  HOST_WriteNvic();
+  HOST_Leave();
+}
+
+static inline uint32_t NVIC_GetPendingIRQ(IRQn_Type irqNum)
+{
+  return (hostPending >> (uint32_t)irqNum) & 1u;
+}
+
+static inline uint32_t NVIC_GetActive(IRQn_Type irqNum)
+{
+  return (NVIC->IABR[0] >> (uint32_t)irqNum) & 1u;
+}
+
+static inline void NVIC_SetPriority(IRQn_Type irqNum, uint32_t priority)
+{
+  uint8_t value = (uint8_t)((priority << (8u - __NVIC_PRIO_BITS)) & 0xFFu);
+
+  if ((int32_t)irqNum >= 0)
+  {
+    NVIC->IP[(uint32_t)irqNum] = value;
+  }
+  else
+  {
+    SCB->SHP[((uint32_t)irqNum & 0xFu) - 4u] = value;
+  }
+}
+
+static inline uint32_t NVIC_GetPriority(IRQn_Type irqNum)
+{
+  if ((int32_t)irqNum >= 0)
+  {
+    return (uint32_t)NVIC->IP[(uint32_t)irqNum] >> (8u - __NVIC_PRIO_BITS);
+  }
+
+  return (uint32_t)SCB->SHP[((uint32_t)irqNum & 0xFu) - 4u] >> (8u - __NVIC_PRIO_BITS);
+}
+
+#endif /* STM32F4XX_H */
@@ -0,0 +1,937 @@
+/* Host benchmarks of the library primitives against their baselines.
+
+Runs the library itself on the host, on the core emulation of
+host/stm32f4xx.h (as irq_stress.c does), under interrupt pressure: at every
+intrinsic (-r percent of them, BENCH_NUM_OF_LOAD_IRQS times less in handlers)
+the interrupt source pends one of the load interrupts, spread over the
+priority levels. Each row runs -n samples from thread code; when the row
+shares data with the handlers, the load handlers use it too.
+
+Rows, each primitive followed by its baseline:
+	- TASK_Spawn until the task runs, on a level bound to a spare vector,
+	  then NVIC_SetPendingIRQ until a plain handler of the same level runs:
+	  the cost of the scheduler over the NVIC alone;
+	- a handler doing BENCH_DEFERRED_NOPS intrinsics of work itself, then
+	  the same handler posting the work with DPC_Post: the ISR time the
+	  deferral saves. Then the time from DPC_Post until the deferred
+	  function starts, from PendSV at the lowest priority;
+	- thread code enqueues BENCH_BATCH messages, the load handlers one each,
+	  then thread code takes them all: with MPSC_Enqueue and MPSC_Dequeue,
+	  with MPSC_DequeueBatch, then on a ring buffer with every put and get
+	  in a THREAD_SAFE_SECTION, the masked baseline. A sample is the time of
+	  a message;
+	- a handler streams BENCH_STREAM_CHUNK bytes to thread code, which
+	  takes them: in place with SPSC_Reserve/SPSC_Commit and
+	  SPSC_Peek/SPSC_Release, copied with SPSC_Write and SPSC_Read, then on
+	  a byte ring with every push and pop in a NO_INTERRUPTS_SECTION, the
+	  PRIMASK baseline. A sample is the time of a chunk, from the pend of
+	  the handler: the bytes per second are BENCH_STREAM_CHUNK * 1e9 / ns;
+	- thread code adds BENCH_BATCH times to a counter the load handlers
+	  also add to: with COUNTER_Add on a sharded counter, with
+	  ATOMIC_FetchAdd32, then in a THREAD_SAFE_SECTION
+	  (BASEPRI_EnterInterruptsDisabledByThresholdSection), the masked
+	  baseline. A sample is the time of an addition;
+	- the load handler of BENCH_WRITER_LOAD_IRQ publishes a payload of
+	  BENCH_PAYLOAD_WORDS words that thread code reads BENCH_BATCH times:
+	  with TRIPLE_Write and TRIPLE_Read, then with a plain memcpy in the
+	  handler and a NO_INTERRUPTS_SECTION memcpy in thread code, the
+	  pattern the triple buffer replaces. A sample is the time of a read,
+	  the wait columns give what the masked copy costs the load handlers;
+	- the same handler updates the payload between SEQLOCK_WriteBegin and
+	  SEQLOCK_WriteEnd and thread code reads it with SEQLOCK_Read, then the
+	  handler writes it plainly and thread code copies it in a
+	  THREAD_SAFE_SECTION, the masked baseline. A sample is the time of a
+	  read.
+
+The THREAD_SAFE_SECTION threshold is set to the highest load level, as data
+shared with all of them needs.
+
+memcpy has no intrinsic: the wait of the load handlers behind a masked copy
+only counts the intrinsics of the section itself here, and grows with the
+payload on the core.
+
+For every row: the median, 99th percentile and longest sample in host
+nanoseconds, then the intrinsics (interrupt points of the emulation) and the
+handlers per operation, the measured one included, and the mean and longest
+wait of the load handlers, in intrinsics from their pend to their entry: the
+latency the masking of the row adds to the interrupts. The last column is the
+longest wait of BENCH_WRITER_LOAD_IRQ alone, the writer the reads mask. The figures compare the rows
+with each other, they are not Cortex-M cycles: an intrinsic costs a call and
+the tests of the emulated masks, an exception entry is a C call, and the
+longest samples include the preemptions of the host. cortexm_timing.h and
+irq_sim.c model the core timings.
+
+deferred_call.c links its items with the pointer-sized ATOMIC_ functions.
+Host pointers are 64-bit, so on the host the list is updated with PRIMASK
+set, as on ARMv6-M, even in an ARMv7-M build.
+
+Build and run (-D__CORTEX_M=0 for the ARMv6-M paths):
+
+cc -std=c99 -O2 -Itools/host -o irq_bench tools/irq_bench.c
+./irq_bench -n 200000 -r 2 -s 1
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f4xx.h"
+
+#include "../interrupt_handling.c"
+#include "../task_scheduler.c"
+#include "../deferred_call.c"
+#include "../mpsc_queue.c"
+#include "../spsc_stream.c"
+#include "../sharded_counter.c"
+#include "../triple_buffer.c"
+#include "../seqlock.c"
+
+#define BENCH_NUM_OF_LOAD_IRQS     4u
+#define BENCH_TASK_IRQ             8u
+#define BENCH_PLAIN_IRQ            9u
+#define BENCH_INLINE_IRQ           10u
+#define BENCH_POSTING_IRQ          11u
+#define BENCH_STREAM_IRQ           12u
+/* Level of the task and of the plain handler, with load above and below */
+#define BENCH_TASK_LEVEL           ((INTERRUPT_LOWEST_PRIORITY / 2u) + 1u)
+/* Work of a load handler besides the one of the row, in intrinsics */
+#define BENCH_LOAD_NOPS            8u
+/* Work moved out of the handler by the deferred call rows, in intrinsics */
+#define BENCH_DEFERRED_NOPS        32u
+/* Operations of thread code in a throughput sample */
+#define BENCH_BATCH                16u
+#define BENCH_QUEUE_CAPACITY       64u
+#define BENCH_STREAM_CHUNK         64u
+#define BENCH_STREAM_SIZE          256u
+/* Load interrupt publishing the latest-value payload, with load above it */
+#define BENCH_WRITER_LOAD_IRQ      1u
+#define BENCH_PAYLOAD_WORDS        16u
+/* Spare words of the register mapping, used as the RAM vector table */
+#define BENCH_VECTOR_TABLE         0xE000F000UL
+
+typedef struct
+{
+  const char *name;
+  /* Run one sample, return its time in nanoseconds (per operation when
+   * it sets sampleOps) */
+  uint64_t  (*sample)(void);
+  /* Called by the load handlers while the row runs, can be NULL */
+  void      (*load)(void);
+} Row_t;
+
+typedef struct
+{
+  uint32_t producer;
+  uint32_t sequence;
+} Message_t;
+
+/* The PRIMASK baseline of the SPSC stream */
+typedef struct
+{
+  uint32_t head;
+  uint32_t tail;
+  uint8_t  bytes[BENCH_STREAM_SIZE];
+} ByteRing_t;
+
+typedef struct
+{
+  uint32_t words[BENCH_PAYLOAD_WORDS];
+} Payload_t;
+
+/* The masked baseline of the MPSC queue */
+typedef struct
+{
+  uint32_t  head;
+  uint32_t  tail;
+  Message_t slots[BENCH_QUEUE_CAPACITY];
+} MaskedRing_t;
+
+#if (__CORTEX_M >= 3)
+static const uint8_t loadLevels[BENCH_NUM_OF_LOAD_IRQS] = { 1u, 3u, 5u, 7u };
+#else
+static const uint8_t loadLevels[BENCH_NUM_OF_LOAD_IRQS] = { 1u, 2u, 3u, 3u };
+#endif
+
+static uint32_t          injectorRandom;
+static uint32_t          injectThreshold;
+static void            (*volatile loadWork)(void);
+static uint64_t         *samples;
+/* Operations of the current sample, 1 unless the sample sets it */
+static uint32_t          sampleOps;
+static uint64_t          loadPendPoints[BENCH_NUM_OF_LOAD_IRQS];
+static uint64_t          loadWaitPoints;
+static uint64_t          maxLoadWaitPoints;
+static uint64_t          maxWriterWaitPoints;
+static uint64_t          numOfLoads;
+
+static TASK_Task_t       task;
+static volatile uint64_t runTime;
+static DPC_Item_t        deferredItem;
+static volatile uint64_t handlerTime;
+static volatile uint64_t postTime;
+static MPSC_DEFINE_STORAGE(mpscStorage, sizeof(Message_t), BENCH_QUEUE_CAPACITY);
+static MPSC_Queue_t      mpscQueue;
+static MaskedRing_t      maskedRing;
+static uint32_t          numOfSent;
+static uint8_t           spscBuffer[BENCH_STREAM_SIZE];
+static SPSC_Stream_t     spscStream;
+static ByteRing_t        byteRing;
+static void            (*streamProducer)(void);
+static uint8_t           streamByte;
+static volatile uint32_t streamSum;
+static volatile uint32_t sharedCount;
+static COUNTER_Sharded_t shardedCount;
+static TRIPLE_DEFINE_STORAGE(tripleStorage, sizeof(Payload_t));
+static TRIPLE_Buffer_t   tripleBuffer;
+static Payload_t         sharedPayload;
+static SEQLOCK_Lock_t    seqlock;
+static uint32_t          numOfPublished;
+static volatile uint32_t payloadSum;
+
+static uint64_t GetNanoseconds(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/* Interrupt source of the emulation, as in irq_stress.c */
+static void InjectInterrupt(int isAsync)
+{
+  uint32_t x = injectorRandom;
+  uint32_t irqNum;
+
+  (void)isAsync;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  injectorRandom = x;
+
+  if (x < (IRQ_IsInIrqContext() ? (injectThreshold / BENCH_NUM_OF_LOAD_IRQS) : injectThreshold))
+  {
+    irqNum = (x >> 8) % BENCH_NUM_OF_LOAD_IRQS;
+    if (NVIC_GetPendingIRQ((IRQn_Type)irqNum) == 0u)
+    {
+      loadPendPoints[irqNum] = hostStats.numOfInterruptPoints;
+    }
+    HOST_SetPending((IRQn_Type)irqNum);
+  }
+}
+
+static void LoadHandler(void)
+{
+  void   (*work)(void) = loadWork;
+  uint64_t wait        = hostStats.numOfInterruptPoints - loadPendPoints[IRQ_GetActiveIRQn()];
+
+  loadWaitPoints += wait;
+  if (wait > maxLoadWaitPoints)
+  {
+    maxLoadWaitPoints = wait;
+  }
+  if ((IRQ_GetActiveIRQn() == (IRQn_Type)BENCH_WRITER_LOAD_IRQ) && (wait > maxWriterWaitPoints))
+  {
+    maxWriterWaitPoints = wait;
+  }
+  numOfLoads++;
+
+  for (uint32_t i = 0u; i < BENCH_LOAD_NOPS; i++)
+  {
+    __NOP();
+  }
+  if (work != NULL)
+  {
+    work();
+  }
+}
+
+/* Spawn to run */
+
+static void RecordRun(void *arg)
+{
+  (void)arg;
+  runTime = GetNanoseconds();
+}
+
+static void PlainHandler(void)
+{
+  runTime = GetNanoseconds();
+}
+
+/* The pend is taken at the next intrinsic, after the load above the level */
+static uint64_t WaitForRun(uint64_t startTime)
+{
+  while (runTime == 0u)
+  {
+    __ISB();
+  }
+
+  return runTime - startTime;
+}
+
+static uint64_t SampleTaskSpawn(void)
+{
+  uint64_t startTime;
+
+  runTime   = 0u;
+  startTime = GetNanoseconds();
+  (void)TASK_Spawn(&task);
+
+  return WaitForRun(startTime);
+}
+
+static uint64_t SamplePendIrq(void)
+{
+  uint64_t startTime;
+
+  runTime   = 0u;
+  startTime = GetNanoseconds();
+  NVIC_SetPendingIRQ((IRQn_Type)BENCH_PLAIN_IRQ);
+
+  return WaitForRun(startTime);
+}
+
+/* Deferred calls */
+
+static void DoDeferredWork(void)
+{
+  for (uint32_t i = 0u; i < BENCH_DEFERRED_NOPS; i++)
+  {
+    __NOP();
+  }
+}
+
+static void RunDeferred(void *arg)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  (void)arg;
+  DoDeferredWork();
+  runTime = startTime;
+}
+
+static void InlineHandler(void)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  DoDeferredWork();
+  runTime     = GetNanoseconds();
+  handlerTime = runTime - startTime;
+}
+
+static void PostingHandler(void)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  postTime = startTime;
+  (void)DPC_Post(&deferredItem);
+  handlerTime = GetNanoseconds() - startTime;
+}
+
+static uint64_t SampleInlineHandler(void)
+{
+  runTime = 0u;
+  NVIC_SetPendingIRQ((IRQn_Type)BENCH_INLINE_IRQ);
+  (void)WaitForRun(0u);
+
+  return handlerTime;
+}
+
+static uint64_t SamplePostingHandler(void)
+{
+  runTime = 0u;
+  NVIC_SetPendingIRQ((IRQn_Type)BENCH_POSTING_IRQ);
+  (void)WaitForRun(0u);
+
+  return handlerTime;
+}
+
+static uint64_t SamplePostToRun(void)
+{
+  runTime = 0u;
+  NVIC_SetPendingIRQ((IRQn_Type)BENCH_POSTING_IRQ);
+  (void)WaitForRun(0u);
+
+  return runTime - postTime;
+}
+
+/* ISR-to-thread queues */
+
+static bool MaskedRing_Put(MaskedRing_t *ring, const Message_t *msg)
+{
+  bool isPut = false;
+
+  THREAD_SAFE_SECTION
+  (
+    if ((ring->head - ring->tail) < BENCH_QUEUE_CAPACITY)
+    {
+      ring->slots[ring->head % BENCH_QUEUE_CAPACITY] = *msg;
+      ring->head++;
+      isPut = true;
+    }
+  )
+
+  return isPut;
+}
+
+static bool MaskedRing_Get(MaskedRing_t *ring, Message_t *msg)
+{
+  bool isGot = false;
+
+  THREAD_SAFE_SECTION
+  (
+    if (ring->head != ring->tail)
+    {
+      *msg = ring->slots[ring->tail % BENCH_QUEUE_CAPACITY];
+      ring->tail++;
+      isGot = true;
+    }
+  )
+
+  return isGot;
+}
+
+static Message_t NextMessage(void)
+{
+  Message_t msg = { (uint32_t)IRQ_GetActiveIRQn(), numOfSent++ };
+
+  return msg;
+}
+
+static void LoadMpscEnqueue(void)
+{
+  Message_t msg = NextMessage();
+
+  (void)MPSC_Enqueue(&mpscQueue, &msg);
+}
+
+static void LoadMaskedPut(void)
+{
+  Message_t msg = NextMessage();
+
+  (void)MaskedRing_Put(&maskedRing, &msg);
+}
+
+static uint64_t SampleMpsc(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Message_t msg;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    msg = NextMessage();
+    (void)MPSC_Enqueue(&mpscQueue, &msg);
+  }
+  sampleOps = 0u;
+  while (MPSC_Dequeue(&mpscQueue, &msg))
+  {
+    sampleOps++;
+  }
+
+  return (GetNanoseconds() - startTime) / sampleOps;
+}
+
+static uint64_t SampleMpscBatch(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Message_t msgs[BENCH_BATCH];
+  uint32_t  count;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    msgs[0] = NextMessage();
+    (void)MPSC_Enqueue(&mpscQueue, &msgs[0]);
+  }
+  sampleOps = 0u;
+  while ((count = MPSC_DequeueBatch(&mpscQueue, msgs, BENCH_BATCH)) != 0u)
+  {
+    sampleOps += count;
+  }
+
+  return (GetNanoseconds() - startTime) / sampleOps;
+}
+
+static uint64_t SampleMaskedRing(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Message_t msg;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    msg = NextMessage();
+    (void)MaskedRing_Put(&maskedRing, &msg);
+  }
+  sampleOps = 0u;
+  while (MaskedRing_Get(&maskedRing, &msg))
+  {
+    sampleOps++;
+  }
+
+  return (GetNanoseconds() - startTime) / sampleOps;
+}
+
+/* ISR-to-thread byte streams */
+
+static void StreamHandler(void)
+{
+  streamProducer();
+  runTime = GetNanoseconds();
+}
+
+static void ProduceInPlace(void)
+{
+  uint32_t written = 0u;
+  uint32_t count;
+  uint8_t *region;
+
+  while ((written < BENCH_STREAM_CHUNK) && ((count = SPSC_Reserve(&spscStream, &region)) != 0u))
+  {
+    if (count > (BENCH_STREAM_CHUNK - written))
+    {
+      count = BENCH_STREAM_CHUNK - written;
+    }
+    for (uint32_t i = 0u; i < count; i++)
+    {
+      region[i] = streamByte++;
+    }
+    SPSC_Commit(&spscStream, count);
+    written += count;
+  }
+}
+
+static void ProduceCopied(void)
+{
+  uint8_t chunk[BENCH_STREAM_CHUNK];
+
+  for (uint32_t i = 0u; i < BENCH_STREAM_CHUNK; i++)
+  {
+    chunk[i] = streamByte++;
+  }
+  (void)SPSC_Write(&spscStream, chunk, sizeof(chunk));
+}
+
+static void ProduceMasked(void)
+{
+  for (uint32_t i = 0u; i < BENCH_STREAM_CHUNK; i++)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      if ((byteRing.head - byteRing.tail) < BENCH_STREAM_SIZE)
+      {
+        byteRing.bytes[byteRing.head % BENCH_STREAM_SIZE] = streamByte;
+        byteRing.head++;
+      }
+    )
+    streamByte++;
+  }
+}
+
+/* Pend the producer, then take the chunk */
+static uint64_t StartStream(void (*producer)(void))
+{
+  uint64_t startTime = GetNanoseconds();
+
+  streamProducer = producer;
+  runTime        = 0u;
+  NVIC_SetPendingIRQ((IRQn_Type)BENCH_STREAM_IRQ);
+  (void)WaitForRun(0u);
+
+  return startTime;
+}
+
+static uint64_t SampleSpscInPlace(void)
+{
+  uint64_t       startTime = StartStream(ProduceInPlace);
+  uint32_t       sum       = 0u;
+  uint32_t       count;
+  const uint8_t *region;
+
+  while ((count = SPSC_Peek(&spscStream, &region)) != 0u)
+  {
+    for (uint32_t i = 0u; i < count; i++)
+    {
+      sum += region[i];
+    }
+    SPSC_Release(&spscStream, count);
+  }
+  streamSum = sum;
+
+  return GetNanoseconds() - startTime;
+}
+
+static uint64_t SampleSpscCopied(void)
+{
+  uint64_t startTime = StartStream(ProduceCopied);
+  uint32_t sum       = 0u;
+  uint32_t count;
+  uint8_t  chunk[BENCH_STREAM_CHUNK];
+
+  while ((count = SPSC_Read(&spscStream, chunk, sizeof(chunk))) != 0u)
+  {
+    for (uint32_t i = 0u; i < count; i++)
+    {
+      sum += chunk[i];
+    }
+  }
+  streamSum = sum;
+
+  return GetNanoseconds() - startTime;
+}
+
+static uint64_t SampleByteRing(void)
+{
+  uint64_t startTime = StartStream(ProduceMasked);
+  uint32_t sum       = 0u;
+  bool     isGot     = true;
+
+  while (isGot)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      isGot = (byteRing.head != byteRing.tail);
+      if (isGot)
+      {
+        sum += byteRing.bytes[byteRing.tail % BENCH_STREAM_SIZE];
+        byteRing.tail++;
+      }
+    )
+  }
+  streamSum = sum;
+
+  return GetNanoseconds() - startTime;
+}
+
+/* Shared counters */
+
+static void AddMasked(uint32_t value)
+{
+  THREAD_SAFE_SECTION
+  (
+    sharedCount += value;
+  )
+}
+
+static void LoadShardedAdd(void)
+{
+  COUNTER_Add(&shardedCount, 1u);
+}
+
+static void LoadAtomicAdd(void)
+{
+  (void)ATOMIC_FetchAdd32(&sharedCount, 1u);
+}
+
+static void LoadMaskedAdd(void)
+{
+  AddMasked(1u);
+}
+
+static uint64_t SampleShardedAdd(void)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    COUNTER_Add(&shardedCount, 1u);
+  }
+  sampleOps = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static uint64_t SampleAtomicAdd(void)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    (void)ATOMIC_FetchAdd32(&sharedCount, 1u);
+  }
+  sampleOps = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static uint64_t SampleMaskedAdd(void)
+{
+  uint64_t startTime = GetNanoseconds();
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    AddMasked(1u);
+  }
+  sampleOps = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+/* Latest-value publication */
+
+static void FillPayload(Payload_t *payload)
+{
+  numOfPublished++;
+  for (uint32_t i = 0u; i < BENCH_PAYLOAD_WORDS; i++)
+  {
+    payload->words[i] = numOfPublished + i;
+  }
+}
+
+static void LoadTripleWrite(void)
+{
+  Payload_t payload;
+
+  if (IRQ_GetActiveIRQn() == (IRQn_Type)BENCH_WRITER_LOAD_IRQ)
+  {
+    FillPayload(&payload);
+    TRIPLE_Write(&tripleBuffer, &payload, sizeof(payload));
+  }
+}
+
+/* Lower priorities never preempt the writer, thread code masks it */
+static void LoadPlainWrite(void)
+{
+  Payload_t payload;
+
+  if (IRQ_GetActiveIRQn() == (IRQn_Type)BENCH_WRITER_LOAD_IRQ)
+  {
+    FillPayload(&payload);
+    memcpy(&sharedPayload, &payload, sizeof(payload));
+  }
+}
+
+static void LoadSeqlockWrite(void)
+{
+  Payload_t payload;
+
+  if (IRQ_GetActiveIRQn() == (IRQn_Type)BENCH_WRITER_LOAD_IRQ)
+  {
+    FillPayload(&payload);
+    SEQLOCK_WriteBegin(&seqlock);
+    memcpy(&sharedPayload, &payload, sizeof(payload));
+    SEQLOCK_WriteEnd(&seqlock);
+  }
+}
+
+static uint64_t SampleTripleRead(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Payload_t payload;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    (void)TRIPLE_Read(&tripleBuffer, &payload, sizeof(payload));
+  }
+  payloadSum = payload.words[0];
+  sampleOps  = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static uint64_t SampleMaskedCopy(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Payload_t payload;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    NO_INTERRUPTS_SECTION
+    (
+      memcpy(&payload, &sharedPayload, sizeof(payload));
+    )
+  }
+  payloadSum = payload.words[0];
+  sampleOps  = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static uint64_t SampleSeqlockRead(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Payload_t payload;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    SEQLOCK_Read(&seqlock, &payload, &sharedPayload, sizeof(payload));
+  }
+  payloadSum = payload.words[0];
+  sampleOps  = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static uint64_t SampleThreadSafeCopy(void)
+{
+  uint64_t  startTime = GetNanoseconds();
+  Payload_t payload;
+
+  for (uint32_t i = 0u; i < BENCH_BATCH; i++)
+  {
+    THREAD_SAFE_SECTION
+    (
+      memcpy(&payload, &sharedPayload, sizeof(payload));
+    )
+  }
+  payloadSum = payload.words[0];
+  sampleOps  = BENCH_BATCH;
+
+  return (GetNanoseconds() - startTime) / BENCH_BATCH;
+}
+
+static const Row_t rows[] =
+{
+  { "TASK_Spawn to run",             SampleTaskSpawn,      NULL },
+  { "NVIC_SetPendingIRQ to run",     SamplePendIrq,        NULL },
+  { "handler with the work",         SampleInlineHandler,  NULL },
+  { "handler with DPC_Post",         SamplePostingHandler, NULL },
+  { "DPC_Post to run",               SamplePostToRun,      NULL },
+  { "MPSC enqueue + dequeue",        SampleMpsc,           LoadMpscEnqueue },
+  { "MPSC enqueue + batch",          SampleMpscBatch,      LoadMpscEnqueue },
+  { "THREAD_SAFE ring put + get",    SampleMaskedRing,     LoadMaskedPut },
+  { "SPSC in place, chunk",          SampleSpscInPlace,    NULL },
+  { "SPSC_Write + SPSC_Read, chunk", SampleSpscCopied,     NULL },
+  { "PRIMASK byte ring, chunk",      SampleByteRing,       NULL },
+  { "COUNTER_Add",                   SampleShardedAdd,     LoadShardedAdd },
+  { "ATOMIC_FetchAdd32",             SampleAtomicAdd,      LoadAtomicAdd },
+  { "THREAD_SAFE_SECTION add",       SampleMaskedAdd,      LoadMaskedAdd },
+  { "TRIPLE_Read, ISR TRIPLE_Write",  SampleTripleRead,     LoadTripleWrite },
+  { "NO_INTERRUPTS memcpy read",      SampleMaskedCopy,     LoadPlainWrite },
+  { "SEQLOCK_Read, ISR writer",       SampleSeqlockRead,    LoadSeqlockWrite },
+  { "THREAD_SAFE memcpy read",        SampleThreadSafeCopy, LoadPlainWrite },
+};
+
+#define BENCH_NUM_OF_ROWS          (sizeof(rows) / sizeof(rows[0]))
+
+static int CompareSamples(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t     numOfSamples  = 200000u;
+  uint64_t     seed          = 1u;
+  uint64_t     injectPercent = 2u;
+  uint64_t     numOfOps;
+  HOST_Stats_t before;
+  HOST_Stats_t after;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+    {
+      numOfSamples = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc))
+    {
+      seed = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc))
+    {
+      injectPercent = strtoull(argv[++i], NULL, 0);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-n <samples>] [-s <seed>] [-r <inject %%>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (injectPercent > 100u)
+  {
+    injectPercent = 100u;
+  }
+  if ((numOfSamples == 0u) || ((samples = malloc(numOfSamples * sizeof(samples[0]))) == NULL))
+  {
+    fprintf(stderr, "cannot allocate %llu samples\n", (unsigned long long)numOfSamples);
+    return 2;
+  }
+
+  HOST_Init();
+  SCB->VTOR       = BENCH_VECTOR_TABLE;
+  injectThreshold = (uint32_t)((0xFFFFFFFFull * injectPercent) / 100u);
+  injectorRandom  = (uint32_t)(seed * 0x9E3779B9u) | 1u;
+
+  for (uint32_t i = 0u; i < BENCH_NUM_OF_LOAD_IRQS; i++)
+  {
+    NVIC_SetPriority((IRQn_Type)i, loadLevels[i]);
+    HOST_SetHandler((IRQn_Type)i, LoadHandler);
+    NVIC_EnableIRQ((IRQn_Type)i);
+  }
+
+  /* The emulation does not fetch handlers from the vector table */
+  if (!TASK_BindPriorityLevel(BENCH_TASK_LEVEL, (IRQn_Type)BENCH_TASK_IRQ)
+      || !TASK_Register(&task, RecordRun, NULL, BENCH_TASK_LEVEL))
+  {
+    fprintf(stderr, "cannot bind the task level\n");
+    return 2;
+  }
+  HOST_SetHandler((IRQn_Type)BENCH_TASK_IRQ, TASK_Dispatcher);
+  NVIC_SetPriority((IRQn_Type)BENCH_PLAIN_IRQ, BENCH_TASK_LEVEL);
+  HOST_SetHandler((IRQn_Type)BENCH_PLAIN_IRQ, PlainHandler);
+  NVIC_EnableIRQ((IRQn_Type)BENCH_PLAIN_IRQ);
+
+  DPC_Init(false);
+  HOST_SetHandler(PendSV_IRQn, DPC_PendSVHandler);
+  DPC_InitItem(&deferredItem, RunDeferred, NULL);
+  NVIC_SetPriority((IRQn_Type)BENCH_INLINE_IRQ, BENCH_TASK_LEVEL);
+  HOST_SetHandler((IRQn_Type)BENCH_INLINE_IRQ, InlineHandler);
+  NVIC_EnableIRQ((IRQn_Type)BENCH_INLINE_IRQ);
+  NVIC_SetPriority((IRQn_Type)BENCH_POSTING_IRQ, BENCH_TASK_LEVEL);
+  HOST_SetHandler((IRQn_Type)BENCH_POSTING_IRQ, PostingHandler);
+  NVIC_EnableIRQ((IRQn_Type)BENCH_POSTING_IRQ);
+
+  (void)BASEPRI_SetPriorityLevelThreshold(loadLevels[0]);
+  MPSC_Init(&mpscQueue, mpscStorage, sizeof(Message_t), BENCH_QUEUE_CAPACITY);
+  SPSC_Init(&spscStream, spscBuffer, sizeof(spscBuffer));
+  COUNTER_Init(&shardedCount);
+  TRIPLE_Init(&tripleBuffer, tripleStorage, sizeof(Payload_t));
+  (void)SEQLOCK_Init(&seqlock, loadLevels[BENCH_WRITER_LOAD_IRQ]);
+  NVIC_SetPriority((IRQn_Type)BENCH_STREAM_IRQ, BENCH_TASK_LEVEL);
+  HOST_SetHandler((IRQn_Type)BENCH_STREAM_IRQ, StreamHandler);
+  NVIC_EnableIRQ((IRQn_Type)BENCH_STREAM_IRQ);
+
+  printf("%-34s  %8s  %8s  %8s  %10s  %11s  %9s  %8s  %10s\n", "row", "median", "p99", "max", "points/op",
+         "handlers/op", "load wait", "max wait", "writer max");
+  for (uint32_t row = 0u; row < BENCH_NUM_OF_ROWS; row++)
+  {
+    loadWork = rows[row].load;
+    HOST_SetInterruptSource(InjectInterrupt);
+    HOST_GetStats(&before);
+    numOfOps            = 0u;
+    loadWaitPoints      = 0u;
+    maxLoadWaitPoints   = 0u;
+    maxWriterWaitPoints = 0u;
+    numOfLoads          = 0u;
+    for (uint64_t i = 0u; i < numOfSamples; i++)
+    {
+      sampleOps  = 1u;
+      samples[i] = rows[row].sample();
+      numOfOps  += sampleOps;
+    }
+    HOST_GetStats(&after);
+    HOST_SetInterruptSource(NULL);
+    loadWork = NULL;
+
+    qsort(samples, numOfSamples, sizeof(samples[0]), CompareSamples);
+    printf("%-34s  %8llu  %8llu  %8llu  %10.1f  %11.2f  %9.2f  %8llu  %10llu\n", rows[row].name,
+           (unsigned long long)samples[numOfSamples / 2u],
+           (unsigned long long)samples[(numOfSamples * 99u) / 100u],
+           (unsigned long long)samples[numOfSamples - 1u],
+           (double)(after.numOfInterruptPoints - before.numOfInterruptPoints) / (double)numOfOps,
+           (double)(after.numOfHandlers - before.numOfHandlers) / (double)numOfOps,
+           (numOfLoads != 0u) ? (double)loadWaitPoints / (double)numOfLoads : 0.0,
+           (unsigned long long)maxLoadWaitPoints, (unsigned long long)maxWriterWaitPoints);
+  }
+  printf("\nns per operation, host time on the core emulation, not Cortex-M cycles\n");
+  free(samples);
+
+  return 0;
+}
@@ -0,0 +1,471 @@
+/* Replay of the recordings of irq_sim.c on the library code.
+
+Runs a recording of irq_sim.c (tools/corpus) on the core emulation of
+host/stm32f4xx.h, as irq_stress.c and irq_bench.c do: the interrupts are
+host interrupts and the sections of the model are the sections of the
+library, not the simulated masks of irq_sim.c:
+	- each IRQ of the model is a host interrupt at its priority, numbered in
+	  the order of the IRQn of the model so that a tie is won by the same
+	  IRQ as on the core. At most HOST_NUM_OF_IRQS IRQs, with priorities up
+	  to INTERRUPT_LOWEST_PRIORITY;
+	- the interrupt source pends the IRQ of each request at its recorded
+	  cycle, counted in intrinsics (one cycle each, as DWT->CYCCNT) from the
+	  start of the replay. A request while the IRQ is still pending is lost,
+	  as on the core;
+	- a handler spends the entry cycles of the model, runs the execution
+	  cycles recorded for the request (the wcet of the model for 0) with its
+	  section at their start, then spends the exit cycles of the model. The
+	  cycles are __NOP intrinsics, interrupt points of the emulation;
+	- thread code runs its sections in a loop, with the thread gap of the
+	  recording between them. A primask blocking, or a ceiling at level 0,
+	  is a PRIMASK_EnterNoInterruptsSection, a level blocking or a resource
+	  a BASEPRI_EnterPriorityCeilingSection at its level. The sections are
+	  chosen as irq_sim.c chooses them.
+A replay ends when every request is handled or lost, then prints for every
+IRQ the runs, the lost requests, the latency (from the request to the first
+instruction of the handler, after the entry cycles) and the longest
+response (to the end of the execution cycles), in cycles of the emulation.
+The throughput follows: the requests handled per million cycles, the share
+of the cycles spent in handlers, and the host time per request.
+
+The emulation charges every exception a full entry and exit, with no
+tail-chaining or late arrival, and the library adds the intrinsics of its
+sections to those of the model: the latencies are those of the library
+code, not of the core timing irq_sim.c simulates, and are not checked
+against the expect lines of the recording. They are deterministic, a change
+of the library that moves them shows in the numbers of the same recording.
+
+Build and run (-D__CORTEX_M=0 for the ARMv6-M paths, on a model within
+its 4 levels):
+
+cc -std=c99 -O2 -Itools/host -o irq_replay tools/irq_replay.c
+./irq_replay -r tools/corpus/burst.txt tools/corpus/irqs.txt
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f4xx.h"
+
+#include "../interrupt_handling.c"
+#include "rta_model.h"
+
+/* A section of code masking interrupts, through the library */
+typedef struct
+{
+  int      isPrimask;
+  int      level;
+  uint64_t cycles;
+} Section_t;
+
+/* A recorded request, cycles 0 for the wcet of the model */
+typedef struct
+{
+  uint64_t time;
+  int      irqIndex;
+  uint64_t cycles;
+} Replay_t;
+
+typedef struct
+{
+  uint64_t requestTime;
+  uint64_t requestCycles;
+  uint64_t numOfRuns;
+  uint64_t numOfLost;
+  uint64_t minLatency;
+  uint64_t maxLatency;
+  uint64_t sumLatency;
+  uint64_t maxResponse;
+} IrqState_t;
+
+static RTA_Model_t model;
+static IrqState_t  irqStates[RTA_MAX_IRQS];
+static Section_t   handlerSections[RTA_MAX_IRQS];
+static Section_t   threadSections[RTA_MAX_BLOCKINGS + RTA_MAX_RESOURCES];
+static int         numOfThreadSections;
+/* Host interrupt of each IRQ of the model, and the reverse */
+static IRQn_Type   hostIrqs[RTA_MAX_IRQS];
+static int         irqIndexes[HOST_NUM_OF_IRQS];
+static uint64_t    threadGap = 100u;
+static Replay_t   *replays;
+static size_t      numOfReplays;
+static size_t      maxReplays;
+static size_t      cursor;
+static uint64_t    numOfDone;
+static uint64_t    originPoints;
+static uint64_t    busyCycles;
+
+static uint64_t GetNanoseconds(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/* Cycles since the start of the replay */
+static uint64_t Now(void)
+{
+  return hostStats.numOfInterruptPoints - originPoints;
+}
+
+static void SpendCycles(uint64_t cycles)
+{
+  for (uint64_t i = 0u; i < cycles; i++)
+  {
+    __NOP();
+  }
+}
+
+static void RunSection(const Section_t *section, uint64_t cycles)
+{
+  uint32_t irqState;
+
+  if (section->isPrimask)
+  {
+    irqState = PRIMASK_EnterNoInterruptsSection();
+    SpendCycles(cycles);
+    PRIMASK_ExitNoInterruptsSection(irqState);
+  }
+  else
+  {
+    irqState = BASEPRI_EnterPriorityCeilingSection((uint8_t)section->level);
+    SpendCycles(cycles);
+    BASEPRI_ExitInterruptsDisabledByThresholdSection(irqState);
+  }
+}
+
+/* Interrupt source of the emulation: the requests due at this cycle */
+static void PendRequests(int isAsync)
+{
+  uint64_t        now = Now();
+  const Replay_t *replay;
+  IrqState_t     *state;
+
+  (void)isAsync;
+  if (__get_IPSR() != 0u)
+  {
+    busyCycles++;
+  }
+  for (; (cursor < numOfReplays) && (replays[cursor].time <= now); cursor++)
+  {
+    replay = &replays[cursor];
+    state  = &irqStates[replay->irqIndex];
+    if ((HOST_GetPending() & (1UL << hostIrqs[replay->irqIndex])) != 0u)
+    {
+      state->numOfLost++;
+      numOfDone++;
+      continue;
+    }
+    state->requestTime   = replay->time;
+    state->requestCycles = replay->cycles;
+    HOST_SetPending(hostIrqs[replay->irqIndex]);
+  }
+}
+
+static void ReplayHandler(void)
+{
+  int         i           = irqIndexes[IRQ_GetActiveIRQn()];
+  IrqState_t *state       = &irqStates[i];
+  /* Taken before the first intrinsic, a new request may overwrite them */
+  uint64_t    requestTime = state->requestTime;
+  uint64_t    work        = (state->requestCycles != 0u) ? state->requestCycles : model.irqs[i].wcet;
+  uint64_t    section     = handlerSections[i].cycles;
+  uint64_t    latency;
+  uint64_t    response;
+
+  SpendCycles(model.entryCycles);
+  latency = Now() - requestTime;
+  state->numOfRuns++;
+  state->sumLatency += latency;
+  if ((state->numOfRuns == 1u) || (latency < state->minLatency))
+  {
+    state->minLatency = latency;
+  }
+  if (latency > state->maxLatency)
+  {
+    state->maxLatency = latency;
+  }
+
+  section = (section < work) ? section : work;
+  if (section != 0u)
+  {
+    RunSection(&handlerSections[i], section);
+  }
+  SpendCycles(work - section);
+  response = Now() - requestTime;
+  if (response > state->maxResponse)
+  {
+    state->maxResponse = response;
+  }
+  numOfDone++;
+  SpendCycles(model.exitCycles);
+}
+
+/* Longest section of a handler, from its resources and blockings, as
+ * irq_sim.c sets them up */
+static void SetupSections(void)
+{
+  const RTA_Resource_t *resource;
+  const RTA_Blocking_t *blocking;
+  Section_t             section;
+  int                   ceiling;
+
+  for (int k = 0; k < model.numOfFixedBlockings; k++)
+  {
+    blocking          = &model.blockings[k];
+    section.isPrimask = blocking->isPrimask;
+    section.level     = blocking->level;
+    section.cycles    = blocking->cycles;
+    if (blocking->ownerPriority == RTA_THREAD_PRIORITY)
+    {
+      threadSections[numOfThreadSections++] = section;
+      continue;
+    }
+    for (int i = 0; i < model.numOfIrqs; i++)
+    {
+      if ((model.irqs[i].priority == blocking->ownerPriority) && (section.cycles > handlerSections[i].cycles))
+      {
+        handlerSections[i] = section;
+      }
+    }
+  }
+
+  for (int r = 0; r < model.numOfResources; r++)
+  {
+    resource          = &model.resources[r];
+    ceiling           = RTA_GetCeiling(&model, resource);
+    section.isPrimask = (ceiling <= 0);
+    section.level     = ceiling;
+    section.cycles    = resource->cycles;
+    for (int k = 0; (k < resource->numOfUsers) && (ceiling != RTA_THREAD_PRIORITY); k++)
+    {
+      if (resource->users[k] == RTA_THREAD_USER)
+      {
+        threadSections[numOfThreadSections++] = section;
+      }
+      else if (section.cycles > handlerSections[resource->users[k]].cycles)
+      {
+        handlerSections[resource->users[k]] = section;
+      }
+    }
+  }
+}
+
+/* Host interrupts in the order of the IRQn of the model, 0 on success */
+static int SetupIrqs(const char *path)
+{
+  int rank;
+
+  if (model.numOfIrqs > (int)HOST_NUM_OF_IRQS)
+  {
+    fprintf(stderr, "%s: %d IRQs, the emulation has %u\n", path, model.numOfIrqs, HOST_NUM_OF_IRQS);
+    return -1;
+  }
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if ((model.irqs[i].priority < 0) || (model.irqs[i].priority > (int)INTERRUPT_LOWEST_PRIORITY))
+    {
+      fprintf(stderr, "%s: priority of %s not in 0..%u\n", path, model.irqs[i].name,
+              INTERRUPT_LOWEST_PRIORITY);
+      return -1;
+    }
+    rank = 0;
+    for (int j = 0; j < model.numOfIrqs; j++)
+    {
+      rank += (model.irqs[j].irqNum < model.irqs[i].irqNum)
+              || ((model.irqs[j].irqNum == model.irqs[i].irqNum) && (j < i));
+    }
+    hostIrqs[i]       = (IRQn_Type)rank;
+    irqIndexes[rank]  = i;
+    NVIC_SetPriority(hostIrqs[i], (uint32_t)model.irqs[i].priority);
+    HOST_SetHandler(hostIrqs[i], ReplayHandler);
+    NVIC_EnableIRQ(hostIrqs[i]);
+  }
+
+  return 0;
+}
+
+static void AddReplayRequest(uint64_t time, int irqIndex, uint64_t cycles)
+{
+  Replay_t *grown;
+
+  if (numOfReplays == maxReplays)
+  {
+    maxReplays = (maxReplays != 0u) ? (maxReplays * 2u) : 1024u;
+    grown      = realloc(replays, maxReplays * sizeof(replays[0]));
+    if (grown == NULL)
+    {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    replays = grown;
+  }
+  replays[numOfReplays].time     = time;
+  replays[numOfReplays].irqIndex = irqIndex;
+  replays[numOfReplays].cycles   = cycles;
+  numOfReplays++;
+}
+
+static int CompareReplays(const void *a, const void *b)
+{
+  const Replay_t *left  = a;
+  const Replay_t *right = b;
+
+  if (left->time != right->time)
+  {
+    return (left->time > right->time) ? 1 : -1;
+  }
+
+  return left->irqIndex - right->irqIndex;
+}
+
+/* Read a recording of irq_sim.c, the expect lines ignored, 0 on success */
+static int LoadReplay(const char *path)
+{
+  FILE              *input = fopen(path, "r");
+  char               line[RTA_MAX_LINE];
+  char               name[RTA_MAX_NAME];
+  unsigned long long values[2];
+  int                lineNum = 0;
+  int                irqIndex;
+
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    lineNum++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    values[1] = 0u;
+    if ((sscanf(line, " %63s", name) != 1) || (strcmp(name, "expect") == 0))
+    {
+      continue;
+    }
+    if (sscanf(line, " gap %llu", &values[0]) == 1)
+    {
+      threadGap = (values[0] != 0u) ? values[0] : 1u;
+      continue;
+    }
+    if (sscanf(line, " request %llu %63s %llu", &values[0], name, &values[1]) >= 2)
+    {
+      irqIndex = RTA_FindIrqByName(&model, name);
+      if (irqIndex >= 0)
+      {
+        AddReplayRequest(values[0], irqIndex, values[1]);
+        continue;
+      }
+    }
+    fprintf(stderr, "%s:%d: bad line, or IRQ not in the model\n", path, lineNum);
+    fclose(input);
+    return -1;
+  }
+  fclose(input);
+  qsort(replays, numOfReplays, sizeof(replays[0]), CompareReplays);
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *modelPath  = NULL;
+  const char *replayPath = NULL;
+  uint64_t    nextSection = 0u;
+  uint64_t    numOfRuns   = 0u;
+  uint64_t    startTime;
+  uint64_t    hostTime;
+  uint64_t    cycles;
+  IrqState_t *state;
+  RTA_Irq_t  *irq;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc))
+    {
+      replayPath = argv[++i];
+    }
+    else if ((argv[i][0] != '-') && (modelPath == NULL))
+    {
+      modelPath = argv[i];
+    }
+    else
+    {
+      modelPath = NULL;
+      break;
+    }
+  }
+  if ((modelPath == NULL) || (replayPath == NULL))
+  {
+    fprintf(stderr, "usage: %s -r <recording> <model>\n", argv[0]);
+    return 2;
+  }
+
+  if ((RTA_LoadModel(modelPath, &model) != 0) || (RTA_CompleteModel(&model, modelPath) != 0)
+      || (LoadReplay(replayPath) != 0))
+  {
+    return 1;
+  }
+  RTA_ApplyResources(&model);
+  SetupSections();
+
+  HOST_Init();
+  if (SetupIrqs(modelPath) != 0)
+  {
+    return 1;
+  }
+
+  /* Thread code, until every request is handled or lost */
+  originPoints = hostStats.numOfInterruptPoints;
+  startTime    = GetNanoseconds();
+  HOST_SetInterruptSource(PendRequests);
+  while (numOfDone < numOfReplays)
+  {
+    SpendCycles(threadGap);
+    if (numOfThreadSections != 0)
+    {
+      RunSection(&threadSections[nextSection], threadSections[nextSection].cycles);
+      nextSection = (nextSection + 1u) % (uint64_t)numOfThreadSections;
+    }
+  }
+  HOST_SetInterruptSource(NULL);
+  hostTime = GetNanoseconds() - startTime;
+  cycles   = Now();
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    numOfRuns += irqStates[i].numOfRuns;
+  }
+  printf("replay of %s on the library, %llu requests, entry %llu, exit %llu cycles\n", replayPath,
+         (unsigned long long)numOfReplays, (unsigned long long)model.entryCycles,
+         (unsigned long long)model.exitCycles);
+  printf("%llu cycles, %llu handlers (%.1f per million cycles), busy %.1f%%, %.1f ns of host time per request\n",
+         (unsigned long long)cycles, (unsigned long long)numOfRuns,
+         (cycles != 0u) ? ((double)numOfRuns * 1e6 / (double)cycles) : 0.0,
+         (cycles != 0u) ? ((double)busyCycles * 100.0 / (double)cycles) : 0.0,
+         (numOfRuns != 0u) ? ((double)hostTime / (double)numOfRuns) : 0.0);
+  printf("%-16s %5s %4s %10s %6s %8s %8s %8s %10s\n",
+         "irq", "IRQn", "prio", "runs", "lost", "lat min", "lat avg", "lat max", "response");
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    irq   = &model.irqs[i];
+    state = &irqStates[i];
+    printf("%-16s %5d %4d %10llu %6llu %8llu %8llu %8llu %10llu\n",
+           irq->name, irq->irqNum, irq->priority,
+           (unsigned long long)state->numOfRuns, (unsigned long long)state->numOfLost,
+           (unsigned long long)state->minLatency,
+           (unsigned long long)((state->numOfRuns != 0u) ? (state->sumLatency / state->numOfRuns) : 0u),
+           (unsigned long long)state->maxLatency, (unsigned long long)state->maxResponse);
+  }
+  free(replays);
+
+  return 0;
+}
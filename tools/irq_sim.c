@@ -0,0 +1,935 @@
+/* Cycle-approximate simulation of the NVIC and the exception timing.
+
+Runs the interrupt model of rta_model.h on a simulated core, cycle by cycle,
+to see the latencies the timing of the exceptions gives, on the host:
+	- the IRQs are requested periodically, from a random phase, each period
+	  lengthened by a random jitter of up to -j percent. A request while the
+	  IRQ is still pending is lost, as the NVIC has a single pending bit;
+	- the pending IRQ of the highest priority (then the lowest number) is
+	  taken when it is more urgent than the running context and not masked by
+	  PRIMASK or BASEPRI;
+	- entry, exit and tail-chaining take the cycles of the model, with the
+	  core timing of cortexm_timing.h: a more urgent request arriving early
+	  in the stacking takes the entry over (late arrival), one arriving
+	  during the unstacking abandons it and is tail-chained (pop preemption);
+	- thread code runs its sections in a loop, -g cycles apart: the blocking
+	  lines owned by thread code, and the resources it uses at their ceiling;
+	- a handler runs the section of its longest resource, or of the longest
+	  blocking line of its priority, at the start of its execution time, then
+	  the rest of its wcet.
+Every cycle of the wcet is executed, so the numbers are those of the worst
+case execution, not of an average one.
+
+The latency is from the request to the first instruction of the handler,
+the response from the request to the end of the handler. The bound of rta.c
+is printed with them: a simulated response above it means the analysis
+misses a case of the model, and the exit status is 3. A response above the
+deadline is a MISS, with the exit status 5 (when nothing worse is found).
+The simulation does not replace the analysis, it shows the cases it happened
+to meet.
+
+Recordings replay a sequence of requests exactly, to reproduce an
+interleaving and to keep it as a regression case:
+
+# Recorded by tools/irq_sim.c with irqs.txt
+gap <thread gap>
+request <cycles> <irq name> <execution cycles of the run>
+expect <irq name> <max latency> <max response>
+
+	- -w records the requests of a run, then the worst latency and response
+	  of every IRQ as expect lines;
+	- -r replays a recording (-n only lengthens it), until every request is
+	  handled, with the thread gap of the recording: a different -g is
+	  refused, the expected numbers depend on it. A latency or response
+	  worse than expected fails it with the exit status 4, after a change of
+	  the model or of the core timing;
+	- -t takes the requests from the handler entries of a trace dump of
+	  trace_recorder.c, one entry overhead earlier, each with the exclusive
+	  time the handler took, and fills the wcet and period left to "-" in
+	  the model as rta.c does. The time a request waited on the device is
+	  not in the trace: the replayed latencies are lower bounds.
+The requests of a recording can be written by hand, or by a script, for
+synthetic sequences. tools/corpus holds recordings on the model of
+tools/corpus/irqs.txt, replayed by tools/corpus/replay.sh.
+
+Recordings drive the model of this simulator. irq_replay.c replays them
+on the library code itself, on the core emulation of irq_stress.c and
+irq_bench.c, and prints the latencies and the throughput it gives.
+
+Build and run:
+
+cc -std=c99 -O2 -o irq_sim tools/irq_sim.c
+./irq_sim -n 100000000 -j 10 -s 1 irqs.txt
+./irq_sim -t ram.bin -w boot.txt irqs.txt
+./irq_sim -r tools/corpus/burst.txt tools/corpus/irqs.txt
+tools/corpus/replay.sh ./irq_sim
+tools/corpus/vector_table.sh ./irq_sim
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rta_model.h"
+#include "trace_reader.h"
+
+#define MAX_NESTING                (RTA_MAX_IRQS + 1)
+/* No BASEPRI masking, above every level */
+#define NO_MASKING                 RTA_THREAD_PRIORITY
+
+typedef enum
+{
+  CPU_RUN,
+  CPU_ENTRY,
+  CPU_TAIL_CHAIN,
+  CPU_EXIT
+} CpuState_t;
+
+/* A section of code masking interrupts */
+typedef struct
+{
+  int      isPrimask;
+  int      level;
+  uint64_t cycles;
+} Section_t;
+
+/* Context running on the core, the thread or a handler */
+typedef struct
+{
+  int      irqIndex;
+  uint64_t requestTime;
+  uint64_t workLeft;
+  uint64_t sectionLeft;
+  int      savedPrimask;
+  int      savedBasepri;
+} Frame_t;
+
+typedef struct
+{
+  uint64_t nextRequest;
+  uint64_t requestTime;
+  uint64_t requestCycles;
+  int      isPending;
+  uint64_t numOfRuns;
+  uint64_t numOfLost;
+  uint64_t numOfLateArrivals;
+  uint64_t minLatency;
+  uint64_t maxLatency;
+  uint64_t sumLatency;
+  uint64_t maxResponse;
+  int      hasExpectation;
+  uint64_t expectedLatency;
+  uint64_t expectedResponse;
+} IrqState_t;
+
+/* A recorded request, cycles 0 for the wcet of the model */
+typedef struct
+{
+  uint64_t time;
+  int      irqIndex;
+  uint64_t cycles;
+} Replay_t;
+
+static RTA_Model_t model;
+static IrqState_t  irqStates[RTA_MAX_IRQS];
+static Section_t   handlerSections[RTA_MAX_IRQS];
+static Section_t   threadSections[RTA_MAX_BLOCKINGS + RTA_MAX_RESOURCES];
+static int         numOfThreadSections;
+static Frame_t     frames[MAX_NESTING];
+static int         depth;
+static int         primask;
+static int         basepri = NO_MASKING;
+static uint64_t    randomState = 1u;
+static uint64_t    threadGap = 100u;
+static int         isGapGiven;
+static uint64_t    nextSection;
+static CpuState_t  cpu = CPU_RUN;
+static int         target = -1;
+static uint64_t    stateLeft;
+static uint64_t    stateElapsed;
+static uint64_t    busyCycles;
+static uint64_t    numOfTailChains;
+static uint64_t    numOfLateArrivals;
+static uint64_t    numOfPopPreemptions;
+static Replay_t   *replays;
+static size_t      numOfReplays;
+static size_t      maxReplays;
+static FILE       *recordFile;
+
+/* xorshift64*, the same sequence for the same seed */
+static uint64_t Random(void)
+{
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+
+  return randomState * 0x2545F4914F6CDD1DULL;
+}
+
+/* Priority the pending IRQs must beat, 0 under PRIMASK as for level 0 */
+static int ExecutionPriority(void)
+{
+  int priority = (depth > 0) ? model.irqs[frames[depth].irqIndex].priority : RTA_THREAD_PRIORITY;
+
+  if (primask)
+  {
+    return 0;
+  }
+
+  return (basepri < priority) ? basepri : priority;
+}
+
+/* Pending IRQ that wins the arbitration above a priority, -1 if none */
+static int SelectPending(int priority)
+{
+  int best = -1;
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if (irqStates[i].isPending && (model.irqs[i].priority < priority)
+        && ((best < 0) || RTA_IsHigherPriority(&model.irqs[i], &model.irqs[best])))
+    {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+static void EnterSection(Frame_t *frame, const Section_t *section)
+{
+  frame->savedPrimask = primask;
+  frame->savedBasepri = basepri;
+  frame->sectionLeft  = section->cycles;
+  if (section->isPrimask)
+  {
+    primask = 1;
+  }
+  else if (section->level < basepri)
+  {
+    /* BASEPRI_MAX semantics, a section never lowers the masking */
+    basepri = section->level;
+  }
+}
+
+static void ExitSection(const Frame_t *frame)
+{
+  primask = frame->savedPrimask;
+  basepri = frame->savedBasepri;
+}
+
+/* Longest section of a handler, from its resources and blockings */
+static void SetupSections(void)
+{
+  const RTA_Resource_t *resource;
+  const RTA_Blocking_t *blocking;
+  Section_t             section;
+  int                   ceiling;
+
+  numOfThreadSections = 0;
+  for (int k = 0; k < model.numOfFixedBlockings; k++)
+  {
+    blocking          = &model.blockings[k];
+    section.isPrimask = blocking->isPrimask;
+    section.level     = blocking->level;
+    section.cycles    = blocking->cycles;
+    if (blocking->ownerPriority == RTA_THREAD_PRIORITY)
+    {
+      threadSections[numOfThreadSections++] = section;
+      continue;
+    }
+    for (int i = 0; i < model.numOfIrqs; i++)
+    {
+      if ((model.irqs[i].priority == blocking->ownerPriority) && (section.cycles > handlerSections[i].cycles))
+      {
+        handlerSections[i] = section;
+      }
+    }
+  }
+
+  for (int r = 0; r < model.numOfResources; r++)
+  {
+    resource          = &model.resources[r];
+    ceiling           = RTA_GetCeiling(&model, resource);
+    section.isPrimask = (ceiling <= 0);
+    section.level     = ceiling;
+    section.cycles    = resource->cycles;
+    for (int k = 0; (k < resource->numOfUsers) && (ceiling != RTA_THREAD_PRIORITY); k++)
+    {
+      if (resource->users[k] == RTA_THREAD_USER)
+      {
+        threadSections[numOfThreadSections++] = section;
+      }
+      else if (section.cycles > handlerSections[resource->users[k]].cycles)
+      {
+        handlerSections[resource->users[k]] = section;
+      }
+    }
+  }
+
+  /* A handler section never outlasts the handler */
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if (handlerSections[i].cycles > model.irqs[i].wcet)
+    {
+      handlerSections[i].cycles = model.irqs[i].wcet;
+    }
+  }
+
+  memset(&frames[0], 0, sizeof(frames[0]));
+  frames[0].irqIndex = -1;
+  frames[0].workLeft = threadGap;
+}
+
+static void ScheduleRequest(int i, uint64_t jitterPercent)
+{
+  uint64_t period = model.irqs[i].period;
+  uint64_t jitter = (period * jitterPercent) / 100u;
+
+  irqStates[i].nextRequest += period + ((jitter != 0u) ? (Random() % (jitter + 1u)) : 0u);
+}
+
+/* One cycle of thread code: sections separated by gaps */
+static void RunThread(void)
+{
+  Frame_t *frame = &frames[0];
+
+  if (numOfThreadSections == 0)
+  {
+    return;
+  }
+  if (frame->sectionLeft != 0u)
+  {
+    if (--frame->sectionLeft == 0u)
+    {
+      ExitSection(frame);
+      frame->workLeft = threadGap;
+    }
+  }
+  else if ((frame->workLeft == 0u) || (--frame->workLeft == 0u))
+  {
+    EnterSection(frame, &threadSections[nextSection]);
+    nextSection = (nextSection + 1u) % (uint64_t)numOfThreadSections;
+  }
+}
+
+static void WriteRequest(uint64_t time, int i, uint64_t cycles)
+{
+  fprintf(recordFile, "request %llu %s %llu\n", (unsigned long long)time, model.irqs[i].name,
+          (unsigned long long)((cycles != 0u) ? cycles : model.irqs[i].wcet));
+}
+
+/* A request of the IRQ, with the execution time of its run (0 for the wcet) */
+static void Request(int i, uint64_t now, uint64_t cycles)
+{
+  IrqState_t *state = &irqStates[i];
+
+  if (recordFile != NULL)
+  {
+    WriteRequest(now, i, cycles);
+  }
+  if (state->isPending)
+  {
+    state->numOfLost++;
+    return;
+  }
+  state->isPending     = 1;
+  state->requestTime   = now;
+  state->requestCycles = cycles;
+}
+
+static void Activate(int i, uint64_t now)
+{
+  IrqState_t *state = &irqStates[i];
+  Frame_t    *frame = &frames[++depth];
+  uint64_t    latency = now - state->requestTime;
+
+  state->isPending = 0;
+  state->numOfRuns++;
+  state->sumLatency += latency;
+  if ((state->numOfRuns == 1u) || (latency < state->minLatency))
+  {
+    state->minLatency = latency;
+  }
+  if (latency > state->maxLatency)
+  {
+    state->maxLatency = latency;
+  }
+
+  memset(frame, 0, sizeof(*frame));
+  frame->irqIndex    = i;
+  frame->requestTime = state->requestTime;
+  frame->workLeft    = (state->requestCycles != 0u) ? state->requestCycles : model.irqs[i].wcet;
+  if (handlerSections[i].cycles != 0u)
+  {
+    EnterSection(frame, &handlerSections[i]);
+    if (frame->sectionLeft > frame->workLeft)
+    {
+      frame->sectionLeft = frame->workLeft;
+    }
+  }
+}
+
+static int IsIdle(void)
+{
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if (irqStates[i].isPending)
+    {
+      return 0;
+    }
+  }
+
+  return (cpu == CPU_RUN) && (depth == 0);
+}
+
+/* One cycle of the core */
+static void Step(uint64_t now)
+{
+  Frame_t    *frame;
+  IrqState_t *state;
+  uint64_t    response;
+  int         next;
+
+  if ((cpu == CPU_RUN) || (cpu == CPU_EXIT))
+  {
+    next = SelectPending(ExecutionPriority());
+    if ((next >= 0) && (cpu == CPU_RUN))
+    {
+      cpu       = CPU_ENTRY;
+      stateLeft = model.entryCycles;
+    }
+    else if (next >= 0)
+    {
+      /* Pop preemption: the unstacking is abandoned */
+      cpu       = CPU_TAIL_CHAIN;
+      stateLeft = model.tailChainCycles;
+      numOfPopPreemptions++;
+    }
+    if (next >= 0)
+    {
+      target       = next;
+      stateElapsed = 0u;
+    }
+  }
+
+  switch (cpu)
+  {
+    case CPU_RUN:
+      if (depth == 0)
+      {
+        RunThread();
+        break;
+      }
+      busyCycles++;
+      frame = &frames[depth];
+      if ((frame->sectionLeft != 0u) && (--frame->sectionLeft == 0u))
+      {
+        ExitSection(frame);
+      }
+      if (--frame->workLeft != 0u)
+      {
+        break;
+      }
+      response = now + 1u - frame->requestTime;
+      state    = &irqStates[frame->irqIndex];
+      if (response > state->maxResponse)
+      {
+        state->maxResponse = response;
+      }
+      depth--;
+      /* The next context is chosen at the return, before any unstacking */
+      next = SelectPending(ExecutionPriority());
+      if (next >= 0)
+      {
+        cpu       = CPU_TAIL_CHAIN;
+        target    = next;
+        stateLeft = model.tailChainCycles;
+        numOfTailChains++;
+      }
+      else
+      {
+        cpu       = CPU_EXIT;
+        stateLeft = model.exitCycles;
+      }
+      stateElapsed = 0u;
+      break;
+
+    case CPU_ENTRY:
+    case CPU_TAIL_CHAIN:
+      busyCycles++;
+      /* Late arrival: a more urgent IRQ takes the vector of the entry */
+      next = SelectPending(model.irqs[target].priority);
+      if ((next >= 0) && (stateElapsed < model.core->lateArrivalCycles))
+      {
+        target = next;
+        irqStates[next].numOfLateArrivals++;
+        numOfLateArrivals++;
+      }
+      stateElapsed++;
+      if (--stateLeft == 0u)
+      {
+        Activate(target, now + 1u);
+        cpu = CPU_RUN;
+      }
+      break;
+
+    case CPU_EXIT:
+      busyCycles++;
+      if (--stateLeft == 0u)
+      {
+        cpu = CPU_RUN;
+      }
+      break;
+  }
+}
+
+static void AddReplayRequest(uint64_t time, int irqIndex, uint64_t cycles)
+{
+  Replay_t *grown;
+
+  if (numOfReplays == maxReplays)
+  {
+    maxReplays = (maxReplays != 0u) ? (maxReplays * 2u) : 1024u;
+    grown      = realloc(replays, maxReplays * sizeof(replays[0]));
+    if (grown == NULL)
+    {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    replays = grown;
+  }
+  replays[numOfReplays].time     = time;
+  replays[numOfReplays].irqIndex = irqIndex;
+  replays[numOfReplays].cycles   = cycles;
+  numOfReplays++;
+}
+
+static int CompareReplays(const void *a, const void *b)
+{
+  const Replay_t *left  = a;
+  const Replay_t *right = b;
+
+  if (left->time != right->time)
+  {
+    return (left->time > right->time) ? 1 : -1;
+  }
+
+  return left->irqIndex - right->irqIndex;
+}
+
+/* Read a recording: gap, request and expect lines, 0 on success */
+static int LoadReplay(const char *path)
+{
+  FILE              *input = fopen(path, "r");
+  char               line[RTA_MAX_LINE];
+  char               name[RTA_MAX_NAME];
+  unsigned long long values[3];
+  int                lineNum = 0;
+  int                irqIndex;
+
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    lineNum++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    values[1] = 0u;
+    if (sscanf(line, " %63s", name) != 1)
+    {
+      continue;
+    }
+    if (sscanf(line, " gap %llu", &values[0]) == 1)
+    {
+      values[0] = (values[0] != 0u) ? values[0] : 1u;
+      if (isGapGiven && (values[0] != threadGap))
+      {
+        fprintf(stderr, "%s:%d: recorded with a thread gap of %llu, not the one of -g\n", path, lineNum,
+                values[0]);
+        fclose(input);
+        return -1;
+      }
+      threadGap = values[0];
+      continue;
+    }
+    if (sscanf(line, " request %llu %63s %llu", &values[0], name, &values[1]) >= 2)
+    {
+      irqIndex = RTA_FindIrqByName(&model, name);
+      if (irqIndex >= 0)
+      {
+        AddReplayRequest(values[0], irqIndex, values[1]);
+        continue;
+      }
+    }
+    else if (sscanf(line, " expect %63s %llu %llu", name, &values[0], &values[1]) == 3)
+    {
+      irqIndex = RTA_FindIrqByName(&model, name);
+      if (irqIndex >= 0)
+      {
+        irqStates[irqIndex].hasExpectation   = 1;
+        irqStates[irqIndex].expectedLatency  = values[0];
+        irqStates[irqIndex].expectedResponse = values[1];
+        continue;
+      }
+    }
+    fprintf(stderr, "%s:%d: bad line, or IRQ not in the model\n", path, lineNum);
+    fclose(input);
+    return -1;
+  }
+  fclose(input);
+
+  return 0;
+}
+
+typedef struct
+{
+  uint64_t origin;
+  int      isStarted;
+  /* Index of the replayed request of each nesting level, -1 if not in the model */
+  long     requestIndex[MAX_NESTING];
+  uint64_t enterCycles[MAX_NESTING];
+  uint64_t nestedCycles[MAX_NESTING];
+  uint32_t exception[MAX_NESTING];
+  int      depth;
+} TraceState_t;
+
+static void TraceEvent(void *context, uint32_t type, uint32_t payload, uint64_t cycles, uint32_t value)
+{
+  TraceState_t *trace = context;
+  RTA_Irq_t    *irq;
+  uint64_t      duration;
+  int           level;
+
+  (void)value;
+
+  if (!trace->isStarted)
+  {
+    trace->origin    = cycles;
+    trace->isStarted = 1;
+  }
+
+  if ((type == TRACE_EVENT_IRQ_ENTER) && (trace->depth < MAX_NESTING))
+  {
+    level = trace->depth++;
+    irq   = (payload >= 16u) ? RTA_FindIrq(&model, (int)payload - 16) : NULL;
+    trace->exception[level]    = payload;
+    trace->enterCycles[level]  = cycles;
+    trace->nestedCycles[level] = 0u;
+    trace->requestIndex[level] = -1;
+    if (irq != NULL)
+    {
+      /* The request is taken one entry before the handler, the latency of
+       * the recorded run is lost */
+      trace->requestIndex[level] = (long)numOfReplays;
+      AddReplayRequest(((cycles - trace->origin) > model.entryCycles) ? (cycles - trace->origin - model.entryCycles) : 0u,
+                       (int)(irq - model.irqs), 0u);
+    }
+  }
+  else if ((type == TRACE_EVENT_IRQ_EXIT) && (trace->depth != 0) && (trace->exception[trace->depth - 1] == payload))
+  {
+    level    = --trace->depth;
+    duration = cycles - trace->enterCycles[level];
+    if (trace->requestIndex[level] >= 0)
+    {
+      /* The exclusive time of the run is replayed as its execution time */
+      replays[trace->requestIndex[level]].cycles = (duration > trace->nestedCycles[level])
+                                                   ? (duration - trace->nestedCycles[level]) : 1u;
+    }
+    if (level != 0)
+    {
+      trace->nestedCycles[level - 1] += duration;
+    }
+  }
+}
+
+/* Requests of the handler entries of a trace dump, 0 on success */
+static int LoadTrace(const char *path)
+{
+  static TraceState_t trace;
+  TRACE_Dump_t        dump;
+
+  if (TRACE_LoadDump(path, &dump) != 0)
+  {
+    return -1;
+  }
+  TRACE_ReadEvents(&dump, TraceEvent, &trace);
+  free(dump.data);
+  return 0;
+}
+
+/* Values left to be measured in the model, taken from the requests as rta.c
+ * does from a trace: the longest run and the shortest inter-arrival time */
+static void MeasureReplays(void)
+{
+  static uint64_t lastTime[RTA_MAX_IRQS];
+  static int      hasLastTime[RTA_MAX_IRQS];
+  RTA_Irq_t      *irq;
+  const Replay_t *replay;
+
+  for (size_t k = 0u; k < numOfReplays; k++)
+  {
+    replay = &replays[k];
+    irq    = &model.irqs[replay->irqIndex];
+    if ((!irq->hasWcet || irq->isWcetMeasured) && (replay->cycles > irq->wcet))
+    {
+      irq->wcet           = replay->cycles;
+      irq->hasWcet        = 1;
+      irq->isWcetMeasured = 1;
+    }
+    if (hasLastTime[replay->irqIndex] && (replay->time != lastTime[replay->irqIndex])
+        && ((irq->period == 0u) || (irq->isPeriodMeasured && ((replay->time - lastTime[replay->irqIndex]) < irq->period))))
+    {
+      irq->period           = replay->time - lastTime[replay->irqIndex];
+      irq->isPeriodMeasured = 1;
+    }
+    lastTime[replay->irqIndex]    = replay->time;
+    hasLastTime[replay->irqIndex] = 1;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const char *modelPath     = NULL;
+  const char *replayPath    = NULL;
+  const char *tracePath     = NULL;
+  const char *recordPath    = NULL;
+  uint64_t    duration      = 0u;
+  uint64_t    jitterPercent = 0u;
+  uint64_t    seed          = 1u;
+  uint64_t    now;
+  uint64_t    numOfRuns = 0u;
+  uint64_t    blocking;
+  uint64_t    bound;
+  size_t      cursor = 0u;
+  int         numOfExceeded  = 0;
+  int         numOfRegressed = 0;
+  int         numOfMissed    = 0;
+  int         isReplay;
+  char        boundText[24];
+  const char *result;
+  IrqState_t *state;
+  RTA_Irq_t  *irq;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+    {
+      duration = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-j") == 0) && ((i + 1) < argc))
+    {
+      jitterPercent = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-g") == 0) && ((i + 1) < argc))
+    {
+      threadGap  = strtoull(argv[++i], NULL, 0);
+      isGapGiven = 1;
+    }
+    else if ((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc))
+    {
+      seed = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc))
+    {
+      replayPath = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc))
+    {
+      tracePath = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-w") == 0) && ((i + 1) < argc))
+    {
+      recordPath = argv[++i];
+    }
+    else if ((argv[i][0] != '-') && (modelPath == NULL))
+    {
+      modelPath = argv[i];
+    }
+    else
+    {
+      modelPath = NULL;
+      break;
+    }
+  }
+  if ((modelPath == NULL) || (threadGap == 0u) || ((replayPath != NULL) && (tracePath != NULL)))
+  {
+    fprintf(stderr, "usage: %s [-n <cycles>] [-j <jitter %%>] [-g <thread gap>] [-s <seed>] "
+            "[-r <recording> | -t <trace dump>] [-w <recording>] <model>\n", argv[0]);
+    return 2;
+  }
+  isReplay = (replayPath != NULL) || (tracePath != NULL);
+
+  if (RTA_LoadModel(modelPath, &model) != 0)
+  {
+    return 1;
+  }
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if (model.irqs[i].priority == RTA_UNASSIGNED)
+    {
+      fprintf(stderr, "%s: no priority for %s (see prio_assign.c)\n", modelPath, model.irqs[i].name);
+      return 1;
+    }
+  }
+  if (((replayPath != NULL) && (LoadReplay(replayPath) != 0))
+      || ((tracePath != NULL) && (LoadTrace(tracePath) != 0)))
+  {
+    return 1;
+  }
+  qsort(replays, numOfReplays, sizeof(replays[0]), CompareReplays);
+  MeasureReplays();
+  if (RTA_CompleteModel(&model, modelPath) != 0)
+  {
+    return 1;
+  }
+  RTA_ApplyResources(&model);
+  SetupSections();
+
+  if (recordPath != NULL)
+  {
+    recordFile = fopen(recordPath, "w");
+    if (recordFile == NULL)
+    {
+      perror(recordPath);
+      return 1;
+    }
+    fprintf(recordFile, "# Recorded by tools/irq_sim.c with %s\ngap %llu\n", modelPath, (unsigned long long)threadGap);
+  }
+
+  if (isReplay)
+  {
+    /* Until every request is handled, or longer if asked */
+    if ((numOfReplays != 0u) && (duration <= replays[numOfReplays - 1u].time))
+    {
+      duration = replays[numOfReplays - 1u].time + 1u;
+    }
+  }
+  else
+  {
+    duration    = (duration != 0u) ? duration : 10000000u;
+    randomState = (seed != 0u) ? seed : 1u;
+    for (int i = 0; i < model.numOfIrqs; i++)
+    {
+      irqStates[i].nextRequest = Random() % model.irqs[i].period;
+    }
+  }
+
+  for (now = 0u; (now < duration) || (isReplay && !IsIdle()); now++)
+  {
+    if (isReplay)
+    {
+      for (; (cursor < numOfReplays) && (replays[cursor].time == now); cursor++)
+      {
+        Request(replays[cursor].irqIndex, now, replays[cursor].cycles);
+      }
+    }
+    else
+    {
+      for (int i = 0; i < model.numOfIrqs; i++)
+      {
+        if (irqStates[i].nextRequest == now)
+        {
+          Request(i, now, 0u);
+          ScheduleRequest(i, jitterPercent);
+        }
+      }
+    }
+    Step(now);
+  }
+
+  printf("core %s, vector wait states %u%s: entry %llu, exit %llu, tail-chain %llu cycles\n",
+         model.core->name, (unsigned)model.vectorWaitStates, model.isFpuUsed ? ", fpu" : "",
+         (unsigned long long)model.entryCycles, (unsigned long long)model.exitCycles,
+         (unsigned long long)model.tailChainCycles);
+  if (isReplay)
+  {
+    printf("replay of %s, %llu requests: ", (replayPath != NULL) ? replayPath : tracePath,
+           (unsigned long long)numOfReplays);
+  }
+  else
+  {
+    printf("seed %llu, jitter %llu%%: ", (unsigned long long)seed, (unsigned long long)jitterPercent);
+  }
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    numOfRuns += irqStates[i].numOfRuns;
+  }
+  printf("%llu cycles, %llu handlers (%.1f per million cycles), busy %.1f%% (model %.1f%%), %llu tail-chains, "
+         "%llu late arrivals, %llu pop preemptions\n",
+         (unsigned long long)now, (unsigned long long)numOfRuns,
+         (now != 0u) ? ((double)numOfRuns * 1e6 / (double)now) : 0.0,
+         (now != 0u) ? ((double)busyCycles * 100.0 / (double)now) : 0.0,
+         RTA_GetUtilization(&model) * 100.0, (unsigned long long)numOfTailChains,
+         (unsigned long long)numOfLateArrivals, (unsigned long long)numOfPopPreemptions);
+  printf("%-16s %5s %4s %10s %6s %8s %8s %8s %10s %10s  %s\n",
+         "irq", "IRQn", "prio", "runs", "lost", "lat min", "lat avg", "lat max", "response", "rta", "result");
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    irq   = &model.irqs[i];
+    state = &irqStates[i];
+    bound = RTA_GetResponseTime(&model, irq, &blocking);
+    /* The analysis stops at the deadline, its value is no bound above it */
+    if (bound > irq->deadline)
+    {
+      snprintf(boundText, sizeof(boundText), ">deadline");
+      result = (state->maxResponse > irq->deadline) ? "MISS" : "ok";
+    }
+    else
+    {
+      snprintf(boundText, sizeof(boundText), "%llu", (unsigned long long)bound);
+      result = (state->maxResponse > bound) ? "ABOVE RTA" : "ok";
+      numOfExceeded += (state->maxResponse > bound);
+    }
+    numOfMissed += (state->maxResponse > irq->deadline);
+    /* A recording expects the worst values it gave, or better */
+    if (state->hasExpectation
+        && ((state->maxLatency > state->expectedLatency) || (state->maxResponse > state->expectedResponse)))
+    {
+      result = "REGRESSED";
+      numOfRegressed++;
+    }
+    printf("%-16s %5d %4d %10llu %6llu %8llu %8llu %8llu %10llu %10s  %s\n",
+           irq->name, irq->irqNum, irq->priority,
+           (unsigned long long)state->numOfRuns, (unsigned long long)state->numOfLost,
+           (unsigned long long)state->minLatency,
+           (unsigned long long)((state->numOfRuns != 0u) ? (state->sumLatency / state->numOfRuns) : 0u),
+           (unsigned long long)state->maxLatency, (unsigned long long)state->maxResponse,
+           boundText, result);
+    if (state->hasExpectation && (strcmp(result, "REGRESSED") == 0))
+    {
+      printf("  expected latency <= %llu, response <= %llu\n", (unsigned long long)state->expectedLatency,
+             (unsigned long long)state->expectedResponse);
+    }
+  }
+
+  if (recordFile != NULL)
+  {
+    for (int i = 0; i < model.numOfIrqs; i++)
+    {
+      if (irqStates[i].numOfRuns != 0u)
+      {
+        fprintf(recordFile, "expect %s %llu %llu\n", model.irqs[i].name,
+                (unsigned long long)irqStates[i].maxLatency, (unsigned long long)irqStates[i].maxResponse);
+      }
+    }
+    fclose(recordFile);
+  }
+  free(replays);
+
+  if (numOfRegressed != 0)
+  {
+    return 4;
+  }
+  if (numOfExceeded != 0)
+  {
+    return 3;
+  }
+
+  return (numOfMissed != 0) ? 5 : 0;
+}
@@ -0,0 +1,1444 @@
+/* Randomized preemption stress of the sections and lock-free primitives.
+
+Runs the library itself on the host, on the core emulation of
+host/stm32f4xx.h, with interrupts taken at random instants:
+	- STRESS_NUM_OF_IRQS interrupts get random priorities from the seed. The
+	  first three are the single writers: of the seqlock, of the triple
+	  buffer, and the producer of the SPSC stream;
+	- at every intrinsic (-r percent of them, 8 times less in handlers) the
+	  interrupt source pends a random interrupt, taken there if the masks
+	  let it: in thread code, in handlers, and in the middle of the library
+	  functions. With -a, a timer
+	  signal also preempts thread code every -a microseconds, between any
+	  two instructions and not only at the intrinsics;
+	- thread code loops on random actions: the four kinds of sections
+	  (NO_INTERRUPTS, THREAD_SAFE, priority ceiling, specific NVIC), nested
+	  up to STRESS_MAX_SECTION_DEPTH deep, the reads of the seqlock, triple
+	  buffer and SPSC stream, and MPSC_Dequeue;
+	- handlers post their event flag (bit irq) when it is clear, counting
+	  the posts, and set or clear their level flag (bit 16 + irq), while one more
+	  action of thread code waits for any posted flag, clearing it on exit,
+	  with a random interrupt pended at each of its interrupt points until
+	  one is set;
+	- one more action is a SEQLOCK_Read under a writer storm: the seqlock
+	  writer is pended at every interrupt point of thread code but the
+	  STREX of an open exclusive access (the trace recorder claims its
+	  words with one), so every copy is torn and the read must end with the
+	  writer masked, counted as SEQLOCK_MAX_RETRIES retries and one
+	  fallback;
+	- handlers and sections do random ATOMIC_FetchAdd32, COUNTER_Add,
+	  MPSC_Enqueue and POOL_Alloc or POOL_Free, every context counting what
+	  it did and holding up to STRESS_POOL_HELD blocks, sometimes with a
+	  nested section or pending another interrupt.
+
+Checked on the way, each failure counted as a violation:
+	- no handler runs while it is masked: by PRIMASK, BASEPRI or its NVIC
+	  enable bit in one of the sections entered, or by the priority of the
+	  context it preempts;
+	- inside a section the masks are the ones of the outer context tightened
+	  by the section, never loosened, and after it they are exactly the ones
+	  before it: PRIMASK, BASEPRI and the NVIC enable bits;
+	- a handler leaves the masks as it found them;
+	- the data read is never torn and never goes back, also after a seqlock
+	  fallback (the writer may be at level 0, masked by PRIMASK): the seqlock and
+	  triple buffer payloads are consistent and newer than the previous one,
+	  the SPSC bytes and the MPSC messages of each producer come in order
+	  without gaps;
+	- an event flag is never taken more often than it was posted: the clear
+	  on exit only clears the flags it returns. A level flag always reads
+	  as its handler last left it, whatever the other contexts set or
+	  cleared;
+	- a pool block is never handed out while another context holds it, and
+	  still carries the mark of its holder when freed. POOL_Free rejects a
+	  pointer into the middle of a block, past the pool and before it;
+	- at the end, once the queues are drained, every increment and every
+	  message is accounted for, a flag is set exactly when its last post
+	  was not taken, and the blocks held plus the blocks of the
+	  free list (each once) are the numOfBlocks of the pool, the held ones
+	  being the used blocks of its statistics;
+	- with INTERRUPT_SECTION_WATCHDOG_SYSTICK, before the run and without
+	  injected interrupts: a section within its budget does not expire the
+	  SysTick watchdog, a THREAD_SAFE section over it calls
+	  IRQ_SectionWatchdogExpired while still running (on exit on ARMv6-M),
+	  a NO_INTERRUPTS section over it on exit;
+	- before the run on ARMv7-M (ARMv6-M has no cycle counter), a periodic
+	  interrupt sampled by irq_jitter.c is held past its late threshold
+	  once by a NO_INTERRUPTS section and once by a higher priority
+	  handler: JITTER_Attribute charges the late arrivals to "section_exit
+	  PRIMASK" (with INTERRUPT_ENABLE_TRACE, unknown without the section
+	  events) and to the exit of the handler.
+The exit status is 1 on a violation, the first ones are printed.
+
+The time of every batch of actions is measured, handlers preempting it
+included: the table gives the throughput of each primitive under the
+contention of the run. The sections are timed with the work done inside.
+
+Above -r 30 or so, or with -a below 20, the interrupts keep each other
+pending and thread code barely runs.
+
+The trace recorder is built in and started: with INTERRUPT_ENABLE_TRACE its
+section events are recorded from every context. Its IRQ events come from the
+irq_instrument.c stub, which needs a 32-bit vector table and is not built
+here: the handler delaying the jitter interrupt records its exit itself, as
+the stub would.
+
+Build and run (-D__CORTEX_M=0 for the ARMv6-M paths, the INTERRUPT_ENABLE_
+flags of the library to stress theirs too):
+
+cc -std=c99 -O2 -Itools/host -o irq_stress tools/irq_stress.c
+./irq_stress -n 10000000 -s 1
+./irq_stress -n 10000000 -r 20 -a 20 -s 2
+cc -std=c99 -O2 -Itools/host -DINTERRUPT_ENABLE_SECTION_BUDGET -DINTERRUPT_ENABLE_SECTION_WATCHDOG \
+   -DINTERRUPT_SECTION_WATCHDOG_SYSTICK -o irq_stress tools/irq_stress.c
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define SEQLOCK_ENABLE_STATISTICS
+#define POOL_ENABLE_STATISTICS
+/* The emulation maps no bit-band alias */
+#define EVENT_USE_BITBAND          0
+
+#include "../interrupt_handling.c"
+#include "../seqlock.c"
+#include "../mpsc_queue.c"
+#include "../spsc_stream.c"
+#include "../triple_buffer.c"
+#include "../sharded_counter.c"
+#include "../trace_recorder.c"
+#include "../memory_pool.c"
+#include "../event_flags.c"
+#include "../irq_jitter.c"
+
+/* Instead of irq_instrument.c: IRQ tracing cannot be enabled */
+bool INSTR_AddHook(const INSTR_Hook_t *hook)
+{
+  (void)hook;
+
+  return false;
+}
+
+#define STRESS_NUM_OF_IRQS         8u
+/* Context index of thread code, after the handlers */
+#define STRESS_THREAD              STRESS_NUM_OF_IRQS
+#define STRESS_NUM_OF_CONTEXTS     (STRESS_NUM_OF_IRQS + 1u)
+#define STRESS_SEQLOCK_IRQ         0u
+#define STRESS_TRIPLE_IRQ          1u
+#define STRESS_SPSC_IRQ            2u
+#define STRESS_MAX_SECTION_DEPTH   3u
+#define STRESS_BATCH               16u
+#define STRESS_PAYLOAD_WORDS       8u
+#define STRESS_MPSC_CAPACITY       64u
+#define STRESS_SPSC_SIZE           64u
+#define STRESS_MAX_REPORTED        16u
+#define STRESS_WATCHDOG_BUDGET     100u
+/* Fewer blocks than the contexts may hold, the pool runs empty */
+#define STRESS_POOL_BLOCKS         16u
+#define STRESS_POOL_HELD           3u
+/* Owner of a block in the free list */
+#define STRESS_POOL_NO_OWNER       0xFFFFFFFFu
+/* Periodic interrupt of the jitter check and the handler delaying it, above
+ * the stressed ones and disabled during the run */
+#define STRESS_JITTER_IRQ          (STRESS_NUM_OF_IRQS + 0u)
+#define STRESS_BLOCKER_IRQ         (STRESS_NUM_OF_IRQS + 1u)
+#define STRESS_JITTER_PERIOD       100u
+#define STRESS_JITTER_LATE         50u
+/* Delay of the late arrivals, well past STRESS_JITTER_LATE */
+#define STRESS_JITTER_DELAY        200u
+/* Event flags of the handlers: posted at bit irq, level at bit 16 + irq */
+#define STRESS_EVENT_POSTS         ((1UL << STRESS_NUM_OF_IRQS) - 1u)
+#define STRESS_EVENT_LEVEL_SHIFT   16u
+/* Priority of thread mode, below every level */
+#define STRESS_THREAD_PRIORITY     (1u << __NVIC_PRIO_BITS)
+
+typedef enum
+{
+  SECTION_PRIMASK,
+  SECTION_THREAD_SAFE,
+  SECTION_CEILING,
+  SECTION_NVIC,
+  NUM_OF_SECTION_KINDS
+} SectionKind_t;
+
+typedef enum
+{
+  ACTION_PRIMASK,
+  ACTION_THREAD_SAFE,
+  ACTION_CEILING,
+  ACTION_NVIC,
+  ACTION_ATOMIC,
+  ACTION_COUNTER,
+  ACTION_MPSC_ENQUEUE,
+  ACTION_MPSC_DEQUEUE,
+  ACTION_POOL,
+  ACTION_EVENT_WAIT,
+  ACTION_SEQLOCK_READ,
+  ACTION_SEQLOCK_STORM,
+  ACTION_TRIPLE_READ,
+  ACTION_SPSC_READ,
+  NUM_OF_ACTIONS
+} Action_t;
+
+static const char *const actionNames[NUM_OF_ACTIONS] =
+{
+  "NO_INTERRUPTS_SECTION",
+  "THREAD_SAFE_SECTION",
+  "priority ceiling section",
+  "NVIC section",
+  "ATOMIC_FetchAdd32",
+  "COUNTER_Add",
+  "MPSC_Enqueue",
+  "MPSC_Dequeue",
+  "POOL_Alloc or POOL_Free",
+  "EVENT_Wait",
+  "SEQLOCK_Read",
+  "SEQLOCK_Read, writer storm",
+  "TRIPLE_Read",
+  "SPSC_Read",
+};
+
+/* Masks of the core: PRIMASK, BASEPRI level (0 for none) and enabled IRQs */
+typedef struct
+{
+  uint32_t primask;
+  uint32_t basepriLevel;
+  uint32_t enabled;
+} Masks_t;
+
+typedef struct
+{
+  uint32_t index;
+  uint32_t random;
+  uint32_t priority;
+  uint64_t numOfRuns;
+  uint64_t numOfAtomicAdds;
+  uint64_t numOfCounterAdds;
+  uint32_t numOfMpscSent;
+  uint64_t numOfMpscFull;
+  uint64_t numOfPoolAllocs;
+  uint64_t numOfPoolEmpty;
+  uint32_t numOfPoolHeld;
+  uint32_t *poolHeld[STRESS_POOL_HELD];
+} Context_t;
+
+typedef struct
+{
+  uint32_t producer;
+  uint32_t sequence;
+} Message_t;
+
+typedef struct
+{
+  uint32_t words[STRESS_PAYLOAD_WORDS];
+} Payload_t;
+
+typedef struct
+{
+  const char *what;
+  uint32_t    context;
+  uint64_t    iteration;
+} Violation_t;
+
+typedef struct
+{
+  uint64_t numOfOps;
+  uint64_t nanoseconds;
+  uint64_t numOfHandlers;
+} ActionStats_t;
+
+static Context_t         contexts[STRESS_NUM_OF_CONTEXTS];
+static uint32_t          injectorRandom;
+static uint32_t          injectThreshold;
+static uint32_t          allIrqs;
+
+/* Masks the sections entered so far announce, for the handler entry checks */
+static volatile uint32_t expectedPrimask;
+static volatile uint32_t expectedBasepriLevel;
+static volatile uint32_t expectedDisabled;
+/* Priorities of the running contexts, thread mode at the bottom */
+static uint32_t          activePriorities[STRESS_NUM_OF_CONTEXTS + 1u];
+static volatile uint32_t activeDepth;
+
+static volatile uint64_t iteration;
+static volatile uint32_t numOfViolations;
+static Violation_t       violations[STRESS_MAX_REPORTED];
+
+static volatile uint32_t atomicTotal;
+static COUNTER_Sharded_t counter;
+static MPSC_DEFINE_STORAGE(mpscStorage, sizeof(Message_t), STRESS_MPSC_CAPACITY);
+static MPSC_Queue_t      mpscQueue;
+static uint32_t          mpscReceived[STRESS_NUM_OF_CONTEXTS];
+static uint8_t           spscBuffer[STRESS_SPSC_SIZE];
+static SPSC_Stream_t     spscStream;
+static uint32_t          spscProduced;
+static uint32_t          spscConsumed;
+static TRIPLE_DEFINE_STORAGE(tripleStorage, sizeof(Payload_t));
+static TRIPLE_Buffer_t   tripleBuffer;
+static uint32_t          tripleWritten;
+static uint32_t          tripleRead;
+static SEQLOCK_Lock_t    seqlock;
+static POOL_DEFINE_STORAGE(poolStorage, 2u * sizeof(uint32_t), STRESS_POOL_BLOCKS);
+static POOL_Pool_t       pool;
+static volatile uint32_t poolOwners[STRESS_POOL_BLOCKS];
+static EVENT_Group_t     eventGroup;
+/* Posts of each handler and takes of thread code: as a flag is only posted
+ * when clear, they alternate */
+static volatile uint32_t eventPosted[STRESS_NUM_OF_IRQS];
+static uint32_t          eventTaken[STRESS_NUM_OF_IRQS];
+/* Level flags as their handlers left them */
+static volatile uint32_t eventLevels;
+/* Flags thread code waits for: until one is set, a random interrupt is
+ * pended at each of its interrupt points. Not after, the pends would clear
+ * the exclusive monitor at every STREX of the clear on exit. */
+static volatile uint32_t eventWaitMask;
+static Payload_t         seqlockShared;
+static uint32_t          seqlockWritten;
+static uint32_t          seqlockRead;
+static uint64_t          numOfSeqlockRetries;
+/* Pend the seqlock writer at every interrupt point of thread code, but
+ * inside an exclusive access: its STREX would never succeed */
+static volatile uint32_t isSeqlockStorm;
+
+static uint32_t Random(Context_t *context)
+{
+  uint32_t x = context->random;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  context->random = x;
+
+  return x;
+}
+
+static void Violation(const Context_t *context, const char *what)
+{
+  uint32_t index = __sync_fetch_and_add(&numOfViolations, 1u);
+
+  if (index < STRESS_MAX_REPORTED)
+  {
+    violations[index].what      = what;
+    violations[index].context   = context->index;
+    violations[index].iteration = iteration;
+  }
+}
+
+static Masks_t ReadMasks(void)
+{
+  Masks_t masks;
+
+  masks.primask = __get_PRIMASK() & 1u;
+#if (__CORTEX_M >= 3)
+  masks.basepriLevel = __get_BASEPRI() >> BASEPRI_START_BIT;
+#else
+  masks.basepriLevel = 0u;
+#endif
+  /* Up to date after the intrinsics */
+  masks.enabled = HOST_GetEnabled();
+
+  return masks;
+}
+
+static int AreMasksEqual(const Masks_t *a, const Masks_t *b)
+{
+  return (a->primask == b->primask) && (a->basepriLevel == b->basepriLevel) && (a->enabled == b->enabled);
+}
+
+#if (__CORTEX_M >= 3)
+/* BASEPRI level masking both levels, 0 being no masking */
+static uint32_t TightenLevel(uint32_t level, uint32_t otherLevel)
+{
+  return ((level == 0u) || ((otherLevel != 0u) && (otherLevel < level))) ? otherLevel : level;
+}
+#endif
+
+/* Payload of a writer sequence, every word derived from it */
+static void FillPayload(Payload_t *payload, uint32_t sequence)
+{
+  payload->words[0] = sequence;
+  for (uint32_t i = 1u; i < STRESS_PAYLOAD_WORDS; i++)
+  {
+    payload->words[i] = (sequence * 0x9E3779B9u) ^ i;
+  }
+}
+
+static int IsPayloadConsistent(const Payload_t *payload)
+{
+  Payload_t expected;
+
+  FillPayload(&expected, payload->words[0]);
+
+  return memcmp(&expected, payload, sizeof(expected)) == 0;
+}
+
+static uint32_t GetPoolIndex(const uint32_t *block)
+{
+  return (uint32_t)((const uint8_t*)block - pool.blocks) / pool.stride;
+}
+
+/* Pointers of no block, in the middle of one or outside the pool */
+static void CheckPoolRejects(Context_t *context, uint32_t *block)
+{
+  if (POOL_Free(&pool, (uint8_t*)block + sizeof(uint32_t))
+      || POOL_Free(&pool, pool.blocks + (pool.numOfBlocks * pool.stride))
+      || POOL_Free(&pool, pool.blocks - pool.stride)
+      || POOL_Free(&pool, NULL))
+  {
+    Violation(context, "POOL_Free accepted a pointer that is not a block of the pool");
+  }
+}
+
+/* Allocate or free one block, marked with its holder while held */
+static void DoPoolWork(Context_t *context, uint32_t choice)
+{
+  uint32_t *block;
+  uint32_t  index;
+  uint32_t  slot;
+
+  if ((context->numOfPoolHeld == 0u)
+      || ((context->numOfPoolHeld < STRESS_POOL_HELD) && ((choice & 1u) != 0u)))
+  {
+    block = (uint32_t*)POOL_Alloc(&pool);
+    if (block == NULL)
+    {
+      context->numOfPoolEmpty++;
+      return;
+    }
+    index = GetPoolIndex(block);
+    if ((index >= STRESS_POOL_BLOCKS)
+        || !__sync_bool_compare_and_swap(&poolOwners[index], STRESS_POOL_NO_OWNER, context->index))
+    {
+      Violation(context, "pool block handed out twice");
+      return;
+    }
+    block[0] = context->index;
+    block[1] = ~context->index;
+    context->poolHeld[context->numOfPoolHeld++] = block;
+    context->numOfPoolAllocs++;
+    if ((choice & 0xF0u) == 0u)
+    {
+      CheckPoolRejects(context, block);
+    }
+  }
+  else
+  {
+    slot  = (choice >> 1) % context->numOfPoolHeld;
+    block = context->poolHeld[slot];
+    index = GetPoolIndex(block);
+    context->poolHeld[slot] = context->poolHeld[--context->numOfPoolHeld];
+    if ((block[0] != context->index) || (block[1] != ~context->index) || (poolOwners[index] != context->index))
+    {
+      Violation(context, "pool block changed by another context while held");
+    }
+    /* Before the free: the block may be handed out again right after */
+    poolOwners[index] = STRESS_POOL_NO_OWNER;
+    if (!POOL_Free(&pool, block))
+    {
+      Violation(context, "POOL_Free refused a block of the pool");
+    }
+  }
+}
+
+/* Work any context may do, on the multi-producer primitives */
+static void DoProducerWork(Context_t *context, uint32_t choice)
+{
+  Message_t message;
+
+  switch (choice % 4u)
+  {
+  case 0u:
+    ATOMIC_FetchAdd32(&atomicTotal, 1u);
+    context->numOfAtomicAdds++;
+    break;
+  case 1u:
+    COUNTER_Increment(&counter);
+    context->numOfCounterAdds++;
+    break;
+  case 3u:
+    DoPoolWork(context, choice >> 2);
+    break;
+  default:
+    message.producer = context->index;
+    message.sequence = context->numOfMpscSent;
+    if (MPSC_Enqueue(&mpscQueue, &message))
+    {
+      context->numOfMpscSent++;
+    }
+    else
+    {
+      context->numOfMpscFull++;
+    }
+    break;
+  }
+}
+
+static void RunSection(Context_t *context, SectionKind_t kind, uint32_t depth);
+
+/* Inside a section: check its masks, announce them to the handlers, then work */
+static void RunSectionBody(Context_t *context, uint32_t depth, const Masks_t *inside)
+{
+  Masks_t  masks = ReadMasks();
+  uint32_t outsidePrimask      = expectedPrimask;
+  uint32_t outsideBasepriLevel = expectedBasepriLevel;
+  uint32_t outsideDisabled     = expectedDisabled;
+  uint32_t numOfSteps = 1u + (Random(context) % 4u);
+  uint32_t choice;
+
+  if (!AreMasksEqual(&masks, inside))
+  {
+    Violation(context, "masks on section entry are not the outer ones tightened by the section");
+  }
+  expectedPrimask      = inside->primask;
+  expectedBasepriLevel = inside->basepriLevel;
+  expectedDisabled     = allIrqs & ~inside->enabled;
+
+  for (uint32_t i = 0u; i < numOfSteps; i++)
+  {
+    choice = Random(context);
+    if (((choice & 0x30u) == 0u) && (depth < STRESS_MAX_SECTION_DEPTH))
+    {
+      RunSection(context, (SectionKind_t)((choice >> 8) % NUM_OF_SECTION_KINDS), depth + 1u);
+    }
+    else if ((choice & 0x30u) == 0x10u)
+    {
+      __NOP();
+    }
+    else
+    {
+      DoProducerWork(context, choice >> 8);
+    }
+  }
+
+  masks = ReadMasks();
+  if (!AreMasksEqual(&masks, inside))
+  {
+    Violation(context, "masks changed by the work inside a section");
+  }
+  expectedDisabled     = outsideDisabled;
+  expectedBasepriLevel = outsideBasepriLevel;
+  expectedPrimask      = outsidePrimask;
+}
+
+/* Enter a section of a kind, do random work in it and check the masks after */
+static void RunSection(Context_t *context, SectionKind_t kind, uint32_t depth)
+{
+  Masks_t     before = ReadMasks();
+  Masks_t     inside = before;
+  Masks_t     after;
+  NVIC_Mask_t disable = {{0u}};
+  uint32_t    ceilingLevel;
+
+  switch (kind)
+  {
+  case SECTION_PRIMASK:
+    inside.primask = 1u;
+    NO_INTERRUPTS_SECTION
+    (
+      RunSectionBody(context, depth, &inside);
+    )
+    break;
+
+  case SECTION_THREAD_SAFE:
+#if (__CORTEX_M >= 3)
+    inside.basepriLevel = TightenLevel(before.basepriLevel, (uint32_t)BASEPRI_GetPriorityLevelThreshold());
+#else
+    inside.primask = 1u;
+#endif
+    THREAD_SAFE_SECTION
+    (
+      RunSectionBody(context, depth, &inside);
+    )
+    break;
+
+  case SECTION_CEILING:
+    ceilingLevel = INTERRUPT_HIGHEST_PRIORITY + 1u + (Random(context) % INTERRUPT_LOWEST_PRIORITY);
+#if (__CORTEX_M >= 3)
+    inside.basepriLevel = TightenLevel(before.basepriLevel, ceilingLevel);
+#else
+    inside.primask = 1u;
+#endif
+    {
+      uint32_t irqState = BASEPRI_EnterPriorityCeilingSection((uint8_t)ceilingLevel);
+
+      RunSectionBody(context, depth, &inside);
+      BASEPRI_ExitInterruptsDisabledByThresholdSection(irqState);
+    }
+    break;
+
+  default:
+    disable.reg[0]  = Random(context) & allIrqs;
+    inside.enabled &= ~disable.reg[0];
+    SPECIFIC_INTERRUPT_DISABLED_SECTION
+    (
+      &disable,
+      RunSectionBody(context, depth, &inside);
+    )
+    break;
+  }
+
+  after = ReadMasks();
+  if (!AreMasksEqual(&after, &before))
+  {
+    Violation(context, "masks not restored exactly on section exit");
+  }
+}
+
+/* Post the flag of the handler if clear, then set or clear its level flag */
+static void DoEventWork(Context_t *context, uint32_t irq, uint32_t choice)
+{
+  uint32_t level = 1UL << (STRESS_EVENT_LEVEL_SHIFT + irq);
+
+  if (((choice & 3u) == 0u) && ((EVENT_GetFlags(&eventGroup) & (1UL << irq)) == 0u))
+  {
+    eventPosted[irq]++;
+    EVENT_SetFlag(&eventGroup, (uint8_t)irq);
+  }
+  if ((choice & 0x30u) == 0u)
+  {
+    if ((choice & 0x40u) != 0u)
+    {
+      eventLevels |= level;
+      EVENT_SetFlags(&eventGroup, level);
+    }
+    else
+    {
+      eventLevels &= ~level;
+      EVENT_ClearFlags(&eventGroup, level);
+    }
+  }
+  if ((EVENT_GetFlags(&eventGroup) & level) != (eventLevels & level))
+  {
+    Violation(context, "event level flag not as its handler left it");
+  }
+}
+
+/* Common part of the handlers */
+static void RunHandler(uint32_t irq)
+{
+  Context_t *context  = &contexts[irq];
+  Payload_t  payload;
+  Masks_t    entryMasks;
+  Masks_t    exitMasks;
+  uint32_t   primask      = expectedPrimask;
+  uint32_t   basepriLevel = expectedBasepriLevel;
+  uint32_t   disabled     = expectedDisabled;
+  uint32_t   choice;
+  uint32_t   count;
+  uint8_t    bytes[8];
+
+  if (primask != 0u)
+  {
+    Violation(context, "handler ran inside a NO_INTERRUPTS section");
+  }
+  if ((basepriLevel != 0u) && (context->priority >= basepriLevel))
+  {
+    Violation(context, "handler ran while masked by BASEPRI");
+  }
+  if ((disabled & (1UL << irq)) != 0u)
+  {
+    Violation(context, "handler ran while disabled in the NVIC");
+  }
+  if (context->priority >= activePriorities[activeDepth])
+  {
+    Violation(context, "handler preempted a context of higher or equal priority");
+  }
+  if (!IRQ_IsInIrqContext() || (IRQ_GetActiveIRQn() != (IRQn_Type)irq))
+  {
+    Violation(context, "handler does not see itself active");
+  }
+  activePriorities[++activeDepth] = context->priority;
+  context->numOfRuns++;
+  entryMasks = ReadMasks();
+
+  switch (irq)
+  {
+  case STRESS_SEQLOCK_IRQ:
+    /* Word by word, higher priorities may preempt the update */
+    FillPayload(&payload, ++seqlockWritten);
+    SEQLOCK_WriteBegin(&seqlock);
+    for (uint32_t i = 0u; i < STRESS_PAYLOAD_WORDS; i++)
+    {
+      ((volatile uint32_t*)seqlockShared.words)[i] = payload.words[i];
+      __NOP();
+    }
+    SEQLOCK_WriteEnd(&seqlock);
+    break;
+
+  case STRESS_TRIPLE_IRQ:
+    FillPayload(&payload, ++tripleWritten);
+    TRIPLE_Write(&tripleBuffer, &payload, sizeof(payload));
+    break;
+
+  case STRESS_SPSC_IRQ:
+    count = 1u + (Random(context) % sizeof(bytes));
+    for (uint32_t i = 0u; i < count; i++)
+    {
+      bytes[i] = (uint8_t)(spscProduced + i);
+    }
+    spscProduced += SPSC_Write(&spscStream, bytes, count);
+    break;
+
+  default:
+    break;
+  }
+
+  DoEventWork(context, irq, Random(context));
+  choice = Random(context);
+  for (uint32_t i = 0u; i < (choice & 3u); i++)
+  {
+    DoProducerWork(context, Random(context));
+  }
+  if ((choice & 0x70u) == 0u)
+  {
+    RunSection(context, (SectionKind_t)((choice >> 8) % NUM_OF_SECTION_KINDS), 1u);
+  }
+  if ((choice & 0x380u) == 0u)
+  {
+    NVIC_SetPendingIRQ((IRQn_Type)((choice >> 16) % STRESS_NUM_OF_IRQS));
+  }
+
+  exitMasks = ReadMasks();
+  if (!AreMasksEqual(&exitMasks, &entryMasks)
+      || (expectedPrimask != primask) || (expectedBasepriLevel != basepriLevel) || (expectedDisabled != disabled))
+  {
+    Violation(context, "handler did not restore the masks");
+  }
+  activeDepth--;
+}
+
+#define STRESS_DEFINE_HANDLER(irq)  static void StressIrq##irq##Handler(void) { RunHandler(irq##u); }
+
+STRESS_DEFINE_HANDLER(0)
+STRESS_DEFINE_HANDLER(1)
+STRESS_DEFINE_HANDLER(2)
+STRESS_DEFINE_HANDLER(3)
+STRESS_DEFINE_HANDLER(4)
+STRESS_DEFINE_HANDLER(5)
+STRESS_DEFINE_HANDLER(6)
+STRESS_DEFINE_HANDLER(7)
+
+static const HOST_Handler_t stressHandlers[STRESS_NUM_OF_IRQS] =
+{
+  StressIrq0Handler, StressIrq1Handler, StressIrq2Handler, StressIrq3Handler,
+  StressIrq4Handler, StressIrq5Handler, StressIrq6Handler, StressIrq7Handler,
+};
+
+/* Interrupt source of the emulation, always pends on the timer signal. In
+ * handlers the rate is divided by STRESS_NUM_OF_IRQS: a handler has tens of
+ * intrinsics, at the full rate the interrupts would keep each other pending
+ * and starve thread code. */
+static void InjectInterrupt(int isAsync)
+{
+  uint32_t x = injectorRandom;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  injectorRandom = x;
+
+  if ((isSeqlockStorm != 0u) && (hostExclusiveAddress == 0u) && !IRQ_IsInIrqContext())
+  {
+    HOST_SetPending((IRQn_Type)STRESS_SEQLOCK_IRQ);
+  }
+  if ((eventWaitMask != 0u) && ((eventGroup.flags & eventWaitMask) == 0u) && !IRQ_IsInIrqContext())
+  {
+    HOST_SetPending((IRQn_Type)((x >> 16) % STRESS_NUM_OF_IRQS));
+  }
+  if ((isAsync != 0)
+      || (x < (IRQ_IsInIrqContext() ? (injectThreshold / STRESS_NUM_OF_IRQS) : injectThreshold)))
+  {
+    HOST_SetPending((IRQn_Type)((x >> 8) % STRESS_NUM_OF_IRQS));
+  }
+}
+
+static void OnTimer(int signalNumber)
+{
+  (void)signalNumber;
+  HOST_Interrupt();
+}
+
+static void ConsumeMpsc(Context_t *context)
+{
+  Message_t message;
+
+  while (MPSC_Dequeue(&mpscQueue, &message))
+  {
+    if ((message.producer >= STRESS_NUM_OF_CONTEXTS) || (message.sequence != mpscReceived[message.producer]))
+    {
+      Violation(context, "MPSC message lost, duplicated or out of order");
+      if (message.producer >= STRESS_NUM_OF_CONTEXTS)
+      {
+        continue;
+      }
+    }
+    mpscReceived[message.producer] = message.sequence + 1u;
+  }
+}
+
+static void ConsumeSpsc(Context_t *context)
+{
+  uint8_t  bytes[16];
+  uint32_t count;
+
+  while ((count = SPSC_Read(&spscStream, bytes, sizeof(bytes))) != 0u)
+  {
+    for (uint32_t i = 0u; i < count; i++)
+    {
+      if (bytes[i] != (uint8_t)spscConsumed)
+      {
+        Violation(context, "SPSC byte lost or out of order");
+      }
+      spscConsumed++;
+    }
+  }
+}
+
+static void ReadSeqlock(Context_t *context)
+{
+  Payload_t payload;
+  uint32_t  sequence;
+
+  if ((Random(context) & 1u) != 0u)
+  {
+    SEQLOCK_Read(&seqlock, &payload, &seqlockShared, sizeof(payload));
+  }
+  else
+  {
+    /* Word by word, the writer may preempt the copy */
+    for (;;)
+    {
+      sequence = SEQLOCK_ReadBegin(&seqlock);
+      for (uint32_t i = 0u; i < STRESS_PAYLOAD_WORDS; i++)
+      {
+        payload.words[i] = ((volatile uint32_t*)seqlockShared.words)[i];
+        __NOP();
+      }
+      if (!SEQLOCK_ReadRetry(&seqlock, sequence))
+      {
+        break;
+      }
+      numOfSeqlockRetries++;
+    }
+  }
+
+  if (!IsPayloadConsistent(&payload))
+  {
+    Violation(context, "torn seqlock read");
+  }
+  else if (payload.words[0] < seqlockRead)
+  {
+    Violation(context, "seqlock read went back");
+  }
+  else
+  {
+    seqlockRead = payload.words[0];
+  }
+}
+
+/* Every copy is torn: the read must fall back to a copy with the writer masked */
+static void ReadSeqlockInStorm(Context_t *context)
+{
+  Payload_t      payload;
+  SEQLOCK_Lock_t before = seqlock;
+
+  isSeqlockStorm = 1u;
+  SEQLOCK_Read(&seqlock, &payload, &seqlockShared, sizeof(payload));
+  isSeqlockStorm = 0u;
+
+  if ((seqlock.numOfFallbacks != (before.numOfFallbacks + 1u))
+      || (seqlock.numOfRetries != (before.numOfRetries + SEQLOCK_MAX_RETRIES)))
+  {
+    Violation(context, "seqlock read in a writer storm not ended by one fallback after SEQLOCK_MAX_RETRIES retries");
+  }
+  if (!IsPayloadConsistent(&payload))
+  {
+    Violation(context, "torn seqlock read in the fallback");
+  }
+  else if (payload.words[0] < seqlockRead)
+  {
+    Violation(context, "seqlock read went back");
+  }
+  else
+  {
+    seqlockRead = payload.words[0];
+  }
+}
+
+/* Every flag taken must have been posted since it was last taken */
+static void TakeEvents(Context_t *context, uint32_t flags, uint32_t flagMask)
+{
+  if ((flags & ~flagMask) != 0u)
+  {
+    Violation(context, "event flags returned outside of the mask waited for");
+  }
+  for (uint32_t irq = 0u; irq < STRESS_NUM_OF_IRQS; irq++)
+  {
+    if ((flags & (1UL << irq)) != 0u)
+    {
+      if (++eventTaken[irq] > eventPosted[irq])
+      {
+        Violation(context, "event flag returned without a post since it was taken");
+      }
+    }
+  }
+}
+
+static void WaitEvents(Context_t *context)
+{
+  uint32_t flagMask = Random(context) & STRESS_EVENT_POSTS;
+  uint32_t flags;
+
+  if (flagMask == 0u)
+  {
+    flagMask = STRESS_EVENT_POSTS;
+  }
+  if ((Random(context) & 1u) != 0u)
+  {
+    eventWaitMask = flagMask;
+    flags         = EVENT_Wait(&eventGroup, flagMask, EVENT_WAIT_ANY | EVENT_CLEAR_ON_EXIT);
+    eventWaitMask = 0u;
+    if (flags == 0u)
+    {
+      Violation(context, "EVENT_Wait returned without a flag");
+    }
+  }
+  else
+  {
+    flags = EVENT_Check(&eventGroup, flagMask, EVENT_WAIT_ALL | EVENT_CLEAR_ON_EXIT);
+    if ((flags != 0u) && (flags != flagMask))
+    {
+      Violation(context, "EVENT_Check for all the flags returned only some");
+    }
+  }
+  TakeEvents(context, flags, flagMask);
+}
+
+static void ReadTriple(Context_t *context)
+{
+  Payload_t payload;
+
+  if (TRIPLE_Read(&tripleBuffer, &payload, sizeof(payload)))
+  {
+    if (!IsPayloadConsistent(&payload))
+    {
+      Violation(context, "torn triple buffer read");
+    }
+    else if (payload.words[0] <= tripleRead)
+    {
+      Violation(context, "triple buffer read not newer than the previous one");
+    }
+    else
+    {
+      tripleRead = payload.words[0];
+    }
+  }
+}
+
+#if defined(INTERRUPT_SECTION_WATCHDOG_SYSTICK)
+/* Sections of STRESS_WATCHDOG_BUDGET cycles, one cycle per intrinsic here: the
+ * SysTick watchdog expires in the section running past it and only there.
+ * SysTick at level 0 is above the THREAD_SAFE threshold of ARMv7-M, the
+ * expiration is seen inside that section; PRIMASK holds it back to the exit. */
+static void CheckSectionWatchdog(Context_t *thread)
+{
+  IRQ_SectionBudgetStats_t stats;
+  uint32_t                 numOfExpirationsInside = 0u;
+
+  HOST_SetHandler(SysTick_IRQn, SysTick_Handler);
+  NVIC_SetPriority(SysTick_IRQn, 0u);
+  IRQ_ResetSectionBudgetStats();
+
+  THREAD_SAFE_SECTION_WITH_BUDGET(STRESS_WATCHDOG_BUDGET,
+    for (uint32_t i = 0u; i < (STRESS_WATCHDOG_BUDGET / 2u); i++)
+    {
+      __NOP();
+    }
+  )
+  IRQ_GetSectionBudgetStats(&stats);
+  if (stats.numOfWatchdogExpirations != 0u)
+  {
+    Violation(thread, "section watchdog expired in a section within its budget");
+  }
+
+  THREAD_SAFE_SECTION_WITH_BUDGET(STRESS_WATCHDOG_BUDGET,
+    for (uint32_t i = 0u; i < (STRESS_WATCHDOG_BUDGET * 3u); i++)
+    {
+      __NOP();
+    }
+    IRQ_GetSectionBudgetStats(&stats);
+    numOfExpirationsInside = stats.numOfWatchdogExpirations;
+  )
+  IRQ_GetSectionBudgetStats(&stats);
+  if ((stats.numOfWatchdogExpirations != 1u) || ((__CORTEX_M >= 3) && (numOfExpirationsInside != 1u)))
+  {
+    Violation(thread, "section watchdog not expired once, inside the THREAD_SAFE section over its budget");
+  }
+
+  NO_INTERRUPTS_SECTION_WITH_BUDGET(STRESS_WATCHDOG_BUDGET,
+    for (uint32_t i = 0u; i < (STRESS_WATCHDOG_BUDGET * 3u); i++)
+    {
+      __NOP();
+    }
+    IRQ_GetSectionBudgetStats(&stats);
+    numOfExpirationsInside = stats.numOfWatchdogExpirations;
+  )
+  IRQ_GetSectionBudgetStats(&stats);
+  if ((stats.numOfWatchdogExpirations != 2u) || (numOfExpirationsInside != 1u))
+  {
+    Violation(thread, "section watchdog not expired once, on exit of the NO_INTERRUPTS section over its budget");
+  }
+  IRQ_ResetSectionBudgetStats();
+}
+#endif
+
+#if (__CORTEX_M >= 3)
+static void SpendCycles(uint32_t numOfCycles)
+{
+  for (uint32_t i = 0u; i < numOfCycles; i++)
+  {
+    __NOP();
+  }
+}
+
+static void JitterHandler(void)
+{
+  JITTER_Sample();
+}
+
+/* Pends the jitter interrupt below it, then holds it back */
+static void BlockerHandler(void)
+{
+  NVIC_SetPendingIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+  SpendCycles(STRESS_JITTER_DELAY);
+  TRACE_Record(TRACE_EVENT_IRQ_EXIT, STRESS_BLOCKER_IRQ + 16u);
+}
+
+static const JITTER_Cause_t *FindJitterCause(const JITTER_Stats_t *stats, TRACE_Event_t event, uint32_t payload)
+{
+  for (uint32_t i = 0u; i < JITTER_MAX_CAUSES; i++)
+  {
+    if ((stats->causes[i].numOfLateArrivals != 0u) && (stats->causes[i].event == event)
+        && (stats->causes[i].payload == payload))
+    {
+      return &stats->causes[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Arrivals of the jitter interrupt every STRESS_JITTER_PERIOD cycles, one
+ * cycle per intrinsic here: on time, late behind a NO_INTERRUPTS section,
+ * late behind a higher priority handler. */
+static void CheckJitterAttribution(Context_t *thread)
+{
+  JITTER_Stats_t        stats;
+  const JITTER_Cause_t *primaskCause;
+  const JITTER_Cause_t *blockerCause;
+  uint32_t              numOfUnknownCauses = 1u;
+
+  NVIC_SetPriority((IRQn_Type)STRESS_JITTER_IRQ, INTERRUPT_HIGHEST_PRIORITY + 2u);
+  NVIC_SetPriority((IRQn_Type)STRESS_BLOCKER_IRQ, INTERRUPT_HIGHEST_PRIORITY + 1u);
+  HOST_SetHandler((IRQn_Type)STRESS_JITTER_IRQ, JitterHandler);
+  HOST_SetHandler((IRQn_Type)STRESS_BLOCKER_IRQ, BlockerHandler);
+  if (!JITTER_Init((IRQn_Type)STRESS_JITTER_IRQ, STRESS_JITTER_PERIOD, 8u, STRESS_JITTER_LATE))
+  {
+    Violation(thread, "JITTER_Init refused a valid IRQ");
+    return;
+  }
+  NVIC_EnableIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+  NVIC_EnableIRQ((IRQn_Type)STRESS_BLOCKER_IRQ);
+
+  NVIC_SetPendingIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+  SpendCycles(STRESS_JITTER_PERIOD);
+  NVIC_SetPendingIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+  NO_INTERRUPTS_SECTION
+  (
+    SpendCycles(STRESS_JITTER_PERIOD);
+    NVIC_SetPendingIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+    SpendCycles(STRESS_JITTER_DELAY);
+  )
+  SpendCycles(STRESS_JITTER_PERIOD);
+  NVIC_SetPendingIRQ((IRQn_Type)STRESS_BLOCKER_IRQ);
+  SpendCycles(STRESS_JITTER_PERIOD);
+
+  NVIC_DisableIRQ((IRQn_Type)STRESS_JITTER_IRQ);
+  NVIC_DisableIRQ((IRQn_Type)STRESS_BLOCKER_IRQ);
+  JITTER_GetStats(&stats);
+  primaskCause = FindJitterCause(&stats, TRACE_EVENT_SECTION_EXIT, TRACE_SECTION_PRIMASK);
+  blockerCause = FindJitterCause(&stats, TRACE_EVENT_IRQ_EXIT, STRESS_BLOCKER_IRQ + 16u);
+#if defined(INTERRUPT_ENABLE_TRACE)
+  numOfUnknownCauses = 0u;
+  if ((primaskCause == NULL) || (primaskCause->numOfLateArrivals != 1u)
+      || (primaskCause->maxDeviationCycles < STRESS_JITTER_DELAY))
+  {
+    Violation(thread, "jitter late arrival behind a NO_INTERRUPTS section not charged to its exit");
+  }
+#else
+  (void)primaskCause;
+#endif
+  if ((blockerCause == NULL) || (blockerCause->numOfLateArrivals != 1u)
+      || (blockerCause->maxDeviationCycles < STRESS_JITTER_DELAY))
+  {
+    Violation(thread, "jitter late arrival behind a higher priority handler not charged to its exit");
+  }
+  if ((stats.numOfSamples != 3u) || (stats.numOfLateArrivals != 2u)
+      || (stats.numOfUnknownCauses != numOfUnknownCauses))
+  {
+    Violation(thread, "jitter samples, late arrivals or unknown causes miscounted");
+  }
+}
+#endif
+
+static void RunAction(Context_t *context, Action_t action)
+{
+  switch (action)
+  {
+  case ACTION_PRIMASK:
+  case ACTION_THREAD_SAFE:
+  case ACTION_CEILING:
+  case ACTION_NVIC:
+    RunSection(context, (SectionKind_t)(action - ACTION_PRIMASK), 1u);
+    break;
+  case ACTION_ATOMIC:
+    DoProducerWork(context, 0u);
+    break;
+  case ACTION_COUNTER:
+    DoProducerWork(context, 1u);
+    break;
+  case ACTION_MPSC_ENQUEUE:
+    DoProducerWork(context, 2u);
+    break;
+  case ACTION_MPSC_DEQUEUE:
+    ConsumeMpsc(context);
+    break;
+  case ACTION_POOL:
+    DoProducerWork(context, 3u | (Random(context) << 2));
+    break;
+  case ACTION_EVENT_WAIT:
+    WaitEvents(context);
+    break;
+  case ACTION_SEQLOCK_READ:
+    ReadSeqlock(context);
+    break;
+  case ACTION_SEQLOCK_STORM:
+    ReadSeqlockInStorm(context);
+    break;
+  case ACTION_TRIPLE_READ:
+    ReadTriple(context);
+    break;
+  default:
+    ConsumeSpsc(context);
+    break;
+  }
+}
+
+static uint64_t GetNanoseconds(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/* Every block either held or once in the free list */
+static void CheckPoolTotals(Context_t *thread)
+{
+  POOL_Statistics_t stats;
+  uint8_t           isFree[STRESS_POOL_BLOCKS];
+  uint32_t          numOfHeld = 0u;
+  uint32_t          numOfFree = 0u;
+  uint32_t          index     = pool.freeHead & POOL_INDEX_MASK;
+
+  memset(isFree, 0, sizeof(isFree));
+  while ((index != POOL_NIL) && (numOfFree <= STRESS_POOL_BLOCKS))
+  {
+    if ((index >= STRESS_POOL_BLOCKS) || (isFree[index] != 0u) || (poolOwners[index] != STRESS_POOL_NO_OWNER))
+    {
+      Violation(thread, "pool free list broken, looping or holding a used block");
+      break;
+    }
+    isFree[index] = 1u;
+    numOfFree++;
+    index = POOL_NEXT(&pool, index) & POOL_INDEX_MASK;
+  }
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_CONTEXTS; i++)
+  {
+    numOfHeld += contexts[i].numOfPoolHeld;
+  }
+  POOL_GetStatistics(&pool, &stats);
+  if (((numOfHeld + numOfFree) != pool.numOfBlocks) || (stats.numOfUsedBlocks != numOfHeld))
+  {
+    Violation(thread, "pool blocks held plus free are not the blocks of the pool");
+  }
+}
+
+/* Totals once every pending interrupt ran and the consumers drained */
+static void CheckTotals(Context_t *thread)
+{
+  Masks_t  masks;
+  uint64_t numOfAtomicAdds  = 0u;
+  uint64_t numOfCounterAdds = 0u;
+  uint32_t flags;
+
+  while ((HOST_GetPending() & HOST_GetEnabled()) != 0u)
+  {
+    __NOP();
+  }
+  ConsumeMpsc(thread);
+  ConsumeSpsc(thread);
+  ReadSeqlock(thread);
+  ReadTriple(thread);
+
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_CONTEXTS; i++)
+  {
+    numOfAtomicAdds  += contexts[i].numOfAtomicAdds;
+    numOfCounterAdds += contexts[i].numOfCounterAdds;
+    if (mpscReceived[i] != contexts[i].numOfMpscSent)
+    {
+      Violation(&contexts[i], "MPSC messages missing at the end");
+    }
+  }
+  if (atomicTotal != (uint32_t)numOfAtomicAdds)
+  {
+    Violation(thread, "ATOMIC_FetchAdd32 increments lost");
+  }
+  if (COUNTER_Read(&counter) != (uint32_t)numOfCounterAdds)
+  {
+    Violation(thread, "COUNTER_Add increments lost");
+  }
+  if (spscConsumed != spscProduced)
+  {
+    Violation(thread, "SPSC bytes missing at the end");
+  }
+  CheckPoolTotals(thread);
+  flags = EVENT_GetFlags(&eventGroup);
+  for (uint32_t irq = 0u; irq < STRESS_NUM_OF_IRQS; irq++)
+  {
+    if ((eventPosted[irq] - eventTaken[irq]) != (((flags >> irq) & 1u)))
+    {
+      Violation(thread, "event flag lost or set without a post at the end");
+    }
+  }
+  if ((flags & ~STRESS_EVENT_POSTS) != eventLevels)
+  {
+    Violation(thread, "event level flags not as their handlers left them at the end");
+  }
+  if ((seqlockRead != seqlockWritten) || (tripleRead != tripleWritten))
+  {
+    Violation(thread, "last seqlock or triple buffer value not read at the end");
+  }
+  masks = ReadMasks();
+  if ((masks.primask != 0u) || (masks.basepriLevel != 0u) || (masks.enabled != allIrqs))
+  {
+    Violation(thread, "masks not back to their initial state at the end");
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t          numOfIterations = 1000000u;
+  uint64_t          seed            = 1u;
+  uint64_t          injectPercent   = 2u;
+  uint64_t          asyncPeriod     = 0u;
+  uint64_t          startTime;
+  uint64_t          batchStartTime;
+  uint64_t          batchHandlers;
+  uint64_t          totalTime;
+  Context_t        *thread = &contexts[STRESS_THREAD];
+  Action_t          action;
+  ActionStats_t     actionStats[NUM_OF_ACTIONS];
+  HOST_Stats_t      hostStatsEnd;
+  struct sigaction  timerAction;
+  struct itimerval  timer;
+  SEQLOCK_Lock_t    before;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+    {
+      numOfIterations = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc))
+    {
+      seed = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc))
+    {
+      injectPercent = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-a") == 0) && ((i + 1) < argc))
+    {
+      asyncPeriod = strtoull(argv[++i], NULL, 0);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-n <iterations>] [-s <seed>] [-r <inject %%>] [-a <timer us>]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (injectPercent > 100u)
+  {
+    injectPercent = 100u;
+  }
+
+  HOST_Init();
+  memset(actionStats, 0, sizeof(actionStats));
+  injectThreshold = (uint32_t)((0xFFFFFFFFull * injectPercent) / 100u);
+  injectorRandom  = (uint32_t)(seed * 0x9E3779B9u) | 1u;
+  allIrqs         = (1UL << STRESS_NUM_OF_IRQS) - 1u;
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_CONTEXTS; i++)
+  {
+    contexts[i].index  = i;
+    contexts[i].random = (uint32_t)((seed + i + 1u) * 0x85EBCA6Bu) | 1u;
+  }
+
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_IRQS; i++)
+  {
+    contexts[i].priority = Random(thread) % (INTERRUPT_LOWEST_PRIORITY + 1u);
+    NVIC_SetPriority((IRQn_Type)i, contexts[i].priority);
+    HOST_SetHandler((IRQn_Type)i, stressHandlers[i]);
+  }
+  contexts[STRESS_THREAD].priority = STRESS_THREAD_PRIORITY;
+  activePriorities[0]              = STRESS_THREAD_PRIORITY;
+
+  if (!SEQLOCK_Init(&seqlock, (uint8_t)contexts[STRESS_SEQLOCK_IRQ].priority)
+      || SEQLOCK_Init(&before, (uint8_t)(INTERRUPT_LOWEST_PRIORITY + 1u)))
+  {
+    Violation(thread, "SEQLOCK_Init accepted a level out of range or refused a valid one");
+  }
+  FillPayload(&seqlockShared, 0u);
+  COUNTER_Init(&counter);
+  MPSC_Init(&mpscQueue, mpscStorage, sizeof(Message_t), STRESS_MPSC_CAPACITY);
+  SPSC_Init(&spscStream, spscBuffer, sizeof(spscBuffer));
+  TRIPLE_Init(&tripleBuffer, tripleStorage, sizeof(Payload_t));
+  if (!POOL_Init(&pool, poolStorage, 2u * sizeof(uint32_t), STRESS_POOL_BLOCKS))
+  {
+    Violation(thread, "POOL_Init refused a valid pool");
+  }
+  for (uint32_t i = 0u; i < STRESS_POOL_BLOCKS; i++)
+  {
+    poolOwners[i] = STRESS_POOL_NO_OWNER;
+  }
+  EVENT_InitGroup(&eventGroup);
+  TRACE_Init(168000000u);
+  TRACE_Start();
+#if defined(INTERRUPT_SECTION_WATCHDOG_SYSTICK)
+  CheckSectionWatchdog(thread);
+#endif
+#if (__CORTEX_M >= 3)
+  CheckJitterAttribution(thread);
+#endif
+
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_IRQS; i++)
+  {
+    NVIC_EnableIRQ((IRQn_Type)i);
+  }
+  HOST_SetInterruptSource(InjectInterrupt);
+  if (asyncPeriod != 0u)
+  {
+    memset(&timerAction, 0, sizeof(timerAction));
+    timerAction.sa_handler = OnTimer;
+    sigemptyset(&timerAction.sa_mask);
+    sigaction(SIGALRM, &timerAction, NULL);
+    timer.it_interval.tv_sec  = (time_t)(asyncPeriod / 1000000u);
+    timer.it_interval.tv_usec = (suseconds_t)(asyncPeriod % 1000000u);
+    timer.it_value            = timer.it_interval;
+    setitimer(ITIMER_REAL, &timer, NULL);
+  }
+
+  startTime = GetNanoseconds();
+  while (iteration < numOfIterations)
+  {
+    action         = (Action_t)(Random(thread) % NUM_OF_ACTIONS);
+    batchHandlers  = hostStats.numOfHandlers;
+    batchStartTime = GetNanoseconds();
+    for (uint32_t i = 0u; i < STRESS_BATCH; i++)
+    {
+      RunAction(thread, action);
+    }
+    actionStats[action].nanoseconds   += GetNanoseconds() - batchStartTime;
+    actionStats[action].numOfHandlers += hostStats.numOfHandlers - batchHandlers;
+    actionStats[action].numOfOps      += STRESS_BATCH;
+    iteration                         += STRESS_BATCH;
+  }
+  totalTime = GetNanoseconds() - startTime;
+
+  if (asyncPeriod != 0u)
+  {
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_REAL, &timer, NULL);
+  }
+  HOST_SetInterruptSource(NULL);
+  CheckTotals(thread);
+  HOST_GetStats(&hostStatsEnd);
+
+  printf("irq  priority  role              runs  atomic  counter  mpsc sent  mpsc full  pool allocs  pool empty\n");
+  for (uint32_t i = 0u; i < STRESS_NUM_OF_CONTEXTS; i++)
+  {
+    const char *role = (i == STRESS_SEQLOCK_IRQ) ? "seqlock writer"
+                     : (i == STRESS_TRIPLE_IRQ) ? "triple writer"
+                     : (i == STRESS_SPSC_IRQ) ? "spsc producer"
+                     : (i == STRESS_THREAD) ? "thread" : "-";
+
+    if (i == STRESS_THREAD)
+    {
+      printf("-    -         %-14s  %6s", role, "-");
+    }
+    else
+    {
+      printf("%-3u  %-8u  %-14s  %6llu", i, contexts[i].priority, role, (unsigned long long)contexts[i].numOfRuns);
+    }
+    printf("  %6llu  %7llu  %9u  %9llu  %11llu  %10llu\n", (unsigned long long)contexts[i].numOfAtomicAdds,
+           (unsigned long long)contexts[i].numOfCounterAdds, contexts[i].numOfMpscSent,
+           (unsigned long long)contexts[i].numOfMpscFull, (unsigned long long)contexts[i].numOfPoolAllocs,
+           (unsigned long long)contexts[i].numOfPoolEmpty);
+  }
+
+  printf("\n%-26s  %10s  %8s  %8s  %11s\n", "primitive", "ops", "ns/op", "Mops/s", "handlers/op");
+  for (uint32_t i = 0u; i < NUM_OF_ACTIONS; i++)
+  {
+    if (actionStats[i].numOfOps != 0u)
+    {
+      printf("%-26s  %10llu  %8.1f  %8.2f  %11.2f\n", actionNames[i], (unsigned long long)actionStats[i].numOfOps,
+             (double)actionStats[i].nanoseconds / (double)actionStats[i].numOfOps,
+             (actionStats[i].nanoseconds != 0u)
+               ? ((double)actionStats[i].numOfOps * 1e3) / (double)actionStats[i].nanoseconds : 0.0,
+             (double)actionStats[i].numOfHandlers / (double)actionStats[i].numOfOps);
+    }
+  }
+
+  printf("\n%llu iterations in %.2f s (%.2f M/s), %llu interrupt points, %llu handlers, "
+         "max nesting %u, %llu failed STREX, %llu deferred signals, seqlock retries: %llu by hand, "
+         "%u in SEQLOCK_Read, %u fallbacks\n",
+         (unsigned long long)iteration, (double)totalTime / 1e9,
+         (totalTime != 0u) ? ((double)iteration * 1e3) / (double)totalTime : 0.0,
+         (unsigned long long)hostStatsEnd.numOfInterruptPoints, (unsigned long long)hostStatsEnd.numOfHandlers,
+         hostStatsEnd.maxNesting, (unsigned long long)hostStatsEnd.numOfFailedStrex,
+         (unsigned long long)hostStatsEnd.numOfDeferred, (unsigned long long)numOfSeqlockRetries,
+         seqlock.numOfRetries, seqlock.numOfFallbacks);
+  printf("violations: %u\n", numOfViolations);
+  for (uint32_t i = 0u; (i < numOfViolations) && (i < STRESS_MAX_REPORTED); i++)
+  {
+    if (violations[i].context == STRESS_THREAD)
+    {
+      printf("  iteration %llu, thread: %s\n", (unsigned long long)violations[i].iteration, violations[i].what);
+    }
+    else
+    {
+      printf("  iteration %llu, irq %u: %s\n", (unsigned long long)violations[i].iteration, violations[i].context,
+             violations[i].what);
+    }
+  }
+
+  return (numOfViolations != 0u) ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/* Priority and ceiling assignment of an interrupt configuration.
+
+Reads the model of rta_model.h, where the priorities can be left to "-", and
+assigns the NVIC preemption priority levels that meet every deadline, within
+the levels of __NVIC_PRIO_BITS:
+	- Audsley's optimal assignment (default): from the least urgent level up,
+	  an IRQ is put at a level if it meets its deadline there with all the IRQs
+	  not assigned yet above it, as many IRQs as fit sharing the level;
+	- deadline-monotonic (-d): the shorter the deadline, the more urgent, the
+	  deadlines spread over the levels.
+The response times are those of rta.c, with the blocking of the resources
+computed from the priorities being tried.
+
+Then every resource gets its ceiling, the most urgent level of its IRQ users,
+which is the least masking BASEPRI that protects it. The IRQs sharing a
+resource are never put at level 0, which BASEPRI cannot mask (unless the
+sections mask with PRIMASK, -p, as on ARMv6-M). Levels below -r are kept
+free for the IRQs that must preempt everything (pc_sampler.c, for example),
+and levels above -l are not used (default 7, the least urgent level the
+section functions of interrupt_handling.c accept on ARMv7-M).
+
+The output is a header for the application:
+	- IRQ_PRIORITY_<NAME> and IRQ_CEILING_<RESOURCE>, for
+	  BASEPRI_EnterPriorityCeilingSection;
+	- IRQ_BASEPRI_THRESHOLD, the ceiling of the resources shared with thread
+	  code, for BASEPRI_SetPriorityLevelThreshold (THREAD_SAFE_SECTION);
+	- IRQ_PRIORITY_TABLE, for NVIC_SetPriorityTable.
+It checks __NVIC_PRIO_BITS and the library levels at compile time, so it can
+be generated by the build from the model.
+
+Build and run:
+
+cc -std=c99 -O2 -o prio_assign tools/prio_assign.c
+./prio_assign -b 4 -r 1 -o irq_priorities.h irqs.txt
+
+static const NVIC_Priority_t priorities[] = IRQ_PRIORITY_TABLE;
+
+NVIC_SetPriorityTable(priorities, IRQ_PRIORITY_TABLE_SIZE);
+BASEPRI_SetPriorityLevelThreshold(IRQ_BASEPRI_THRESHOLD);
+
+The exit status is 3 when no assignment meets every deadline, and nothing is
+written.
+
+*/
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rta_model.h"
+
+/* INTERRUPT_LOWEST_PRIORITY of interrupt_handling.h on ARMv7-M, the least
+ * urgent level its section functions accept */
+#define DEFAULT_LOWEST_LEVEL       7
+
+static RTA_Model_t model;
+static int         isPrimaskOnly;
+
+/* True if the IRQ shares a resource with other code */
+static int IsSharing(int irqIndex)
+{
+  const RTA_Resource_t *resource;
+  int                   isUser;
+
+  for (int r = 0; r < model.numOfResources; r++)
+  {
+    resource = &model.resources[r];
+    isUser   = 0;
+    for (int k = 0; k < resource->numOfUsers; k++)
+    {
+      isUser |= (resource->users[k] == irqIndex);
+    }
+    if (isUser && (resource->numOfUsers > 1))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Resource blockings of the current priorities, as PRIMASK sections with -p */
+static void ApplyResources(void)
+{
+  RTA_ApplyResources(&model);
+  if (isPrimaskOnly)
+  {
+    for (int k = model.numOfFixedBlockings; k < model.numOfBlockings; k++)
+    {
+      model.blockings[k].isPrimask = 1;
+      model.blockings[k].level     = 0;
+    }
+  }
+}
+
+/* True if the IRQs at a level meet their deadline */
+static int IsLevelSchedulable(int level)
+{
+  uint64_t blocking;
+
+  ApplyResources();
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if ((model.irqs[i].priority == level)
+        && (RTA_GetResponseTime(&model, &model.irqs[i], &blocking) > model.irqs[i].deadline))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Audsley's assignment, from the least urgent level, 0 on success */
+static int AssignAudsley(int firstLevel, int lastLevel)
+{
+  int numOfUnassigned = model.numOfIrqs;
+  int best;
+
+  for (int level = lastLevel; (level >= firstLevel) && (numOfUnassigned != 0); level--)
+  {
+    /* Try the longest deadlines first, they are the most likely to fit low */
+    do
+    {
+      best = -1;
+      for (int i = 0; i < model.numOfIrqs; i++)
+      {
+        if ((model.irqs[i].priority != RTA_UNASSIGNED) || ((level == 0) && !isPrimaskOnly && IsSharing(i)))
+        {
+          continue;
+        }
+        model.irqs[i].priority = level;
+        if (IsLevelSchedulable(level) && ((best < 0) || (model.irqs[i].deadline > model.irqs[best].deadline)))
+        {
+          best = i;
+        }
+        model.irqs[i].priority = RTA_UNASSIGNED;
+      }
+      if (best >= 0)
+      {
+        model.irqs[best].priority = level;
+        numOfUnassigned--;
+      }
+    } while ((best >= 0) && (numOfUnassigned != 0));
+  }
+
+  return (numOfUnassigned == 0) ? 0 : -1;
+}
+
+static int CompareDeadlines(const void *a, const void *b)
+{
+  const RTA_Irq_t *left  = &model.irqs[*(const int*)a];
+  const RTA_Irq_t *right = &model.irqs[*(const int*)b];
+
+  return (left->deadline > right->deadline) - (left->deadline < right->deadline);
+}
+
+/* Deadline-monotonic assignment, spread over the levels */
+static void AssignDeadlineMonotonic(int firstLevel, int lastLevel)
+{
+  int order[RTA_MAX_IRQS];
+  int ranks[RTA_MAX_IRQS];
+  int numOfRanks = 0;
+  int numOfLevels = lastLevel - firstLevel + 1;
+  int level;
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    order[i] = i;
+  }
+  qsort(order, (size_t)model.numOfIrqs, sizeof(order[0]), CompareDeadlines);
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if ((i != 0) && (model.irqs[order[i]].deadline != model.irqs[order[i - 1]].deadline))
+    {
+      numOfRanks++;
+    }
+    ranks[i] = numOfRanks;
+  }
+  numOfRanks++;
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    level = firstLevel + (int)(((long long)ranks[i] * numOfLevels) / numOfRanks);
+    if ((level == 0) && !isPrimaskOnly && IsSharing(order[i]) && (lastLevel > 0))
+    {
+      level = 1;
+    }
+    model.irqs[order[i]].priority = level;
+  }
+}
+
+/* Upper case identifier of a name */
+static void MacroName(const char *name, char *macro, size_t size)
+{
+  size_t i;
+
+  for (i = 0u; (name[i] != '\0') && (i < (size - 1u)); i++)
+  {
+    macro[i] = isalnum((unsigned char)name[i]) ? (char)toupper((unsigned char)name[i]) : '_';
+  }
+  macro[i] = '\0';
+}
+
+static void WriteHeader(FILE *output, const char *modelPath, int priorityBits, const char *method)
+{
+  char macro[RTA_MAX_NAME];
+  int  ceiling;
+  int  threshold = RTA_THREAD_PRIORITY;
+  int  maxCeiling = 0;
+
+  fprintf(output, "/* Generated by tools/prio_assign.c (%s, %d priority bits) from %s, do not edit */\n\n",
+          method, priorityBits, modelPath);
+  fprintf(output, "#ifndef IRQ_PRIORITIES_H\n#define IRQ_PRIORITIES_H\n\n#include \"interrupt_handling.h\"\n\n");
+  fprintf(output, "#if (__NVIC_PRIO_BITS != %d)\n#error \"Generated for %d priority bits\"\n#endif\n\n",
+          priorityBits, priorityBits);
+
+  fprintf(output, "/* Preemption priority levels */\n");
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    MacroName(model.irqs[i].name, macro, sizeof(macro));
+    fprintf(output, "#define IRQ_PRIORITY_%-24s %du\n", macro, model.irqs[i].priority);
+  }
+
+  fprintf(output, "\n/* Ceilings of the shared resources, for BASEPRI_EnterPriorityCeilingSection */\n");
+  for (int r = 0; r < model.numOfResources; r++)
+  {
+    ceiling = RTA_GetCeiling(&model, &model.resources[r]);
+    MacroName(model.resources[r].name, macro, sizeof(macro));
+    if (ceiling == RTA_THREAD_PRIORITY)
+    {
+      fprintf(output, "/* %s: no IRQ user, no masking needed */\n", model.resources[r].name);
+      continue;
+    }
+    if (ceiling == 0)
+    {
+      fprintf(output, "/* %s: shared at level 0, use a PRIMASK section */\n", model.resources[r].name);
+      continue;
+    }
+    fprintf(output, "#define IRQ_CEILING_%-25s %du\n", macro, ceiling);
+    if (ceiling > maxCeiling)
+    {
+      maxCeiling = ceiling;
+    }
+    for (int k = 0; k < model.resources[r].numOfUsers; k++)
+    {
+      if ((model.resources[r].users[k] == RTA_THREAD_USER) && (ceiling < threshold))
+      {
+        threshold = ceiling;
+      }
+    }
+  }
+
+  if (threshold != RTA_THREAD_PRIORITY)
+  {
+    fprintf(output, "\n/* Threshold of THREAD_SAFE_SECTION, for BASEPRI_SetPriorityLevelThreshold */\n");
+    fprintf(output, "#define %-37s %du\n", "IRQ_BASEPRI_THRESHOLD", threshold);
+  }
+  if (maxCeiling != 0)
+  {
+    fprintf(output, "\n#if (%du > INTERRUPT_LOWEST_PRIORITY)\n#error \"A ceiling is above INTERRUPT_LOWEST_PRIORITY\"\n#endif\n",
+            maxCeiling);
+  }
+
+  fprintf(output, "\n/* For NVIC_SetPriorityTable */\n#define %-37s %du\n", "IRQ_PRIORITY_TABLE_SIZE", model.numOfIrqs);
+  fprintf(output, "#define IRQ_PRIORITY_TABLE \\\n  { \\\n");
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    MacroName(model.irqs[i].name, macro, sizeof(macro));
+    fprintf(output, "    { (IRQn_Type)%d, IRQ_PRIORITY_%s }, \\\n", model.irqs[i].irqNum, macro);
+  }
+  fprintf(output, "  }\n\n#endif /* IRQ_PRIORITIES_H */\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *modelPath      = NULL;
+  const char *outputPath     = NULL;
+  int         priorityBits   = 4;
+  int         firstLevel     = 0;
+  int         lastLevel      = -1;
+  int         isDeadlineMono = 0;
+  int         numOfMisses    = 0;
+  uint64_t    blocking;
+  uint64_t    response;
+  FILE       *output;
+  RTA_Irq_t  *irq;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-b") == 0) && ((i + 1) < argc))
+    {
+      priorityBits = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc))
+    {
+      firstLevel = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc))
+    {
+      lastLevel = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-o") == 0) && ((i + 1) < argc))
+    {
+      outputPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "-d") == 0)
+    {
+      isDeadlineMono = 1;
+    }
+    else if (strcmp(argv[i], "-p") == 0)
+    {
+      isPrimaskOnly = 1;
+    }
+    else if ((argv[i][0] != '-') && (modelPath == NULL))
+    {
+      modelPath = argv[i];
+    }
+    else
+    {
+      modelPath = NULL;
+      break;
+    }
+  }
+  if (lastLevel < 0)
+  {
+    lastLevel = ((1 << priorityBits) - 1 < DEFAULT_LOWEST_LEVEL) ? ((1 << priorityBits) - 1) : DEFAULT_LOWEST_LEVEL;
+  }
+  if ((modelPath == NULL) || (priorityBits < 1) || (priorityBits > 8)
+      || (firstLevel < 0) || (firstLevel > lastLevel) || (lastLevel >= (1 << priorityBits)))
+  {
+    fprintf(stderr, "usage: %s [-b <priority bits>] [-r <first level>] [-l <last level>] [-d] [-p] [-o <header>] <model>\n",
+            argv[0]);
+    return 2;
+  }
+
+  if ((RTA_LoadModel(modelPath, &model) != 0) || (RTA_CompleteModel(&model, modelPath) != 0))
+  {
+    return 1;
+  }
+
+  /* The priorities of the model are assigned again */
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    model.irqs[i].priority = RTA_UNASSIGNED;
+  }
+
+  if (isDeadlineMono)
+  {
+    AssignDeadlineMonotonic(firstLevel, lastLevel);
+  }
+  else if (AssignAudsley(firstLevel, lastLevel) != 0)
+  {
+    for (int i = 0; i < model.numOfIrqs; i++)
+    {
+      if (model.irqs[i].priority == RTA_UNASSIGNED)
+      {
+        fprintf(stderr, "%s: no level left where %s meets its deadline\n", modelPath, model.irqs[i].name);
+      }
+    }
+    return 3;
+  }
+
+  ApplyResources();
+  fprintf(stderr, "utilization %.1f%%\n", RTA_GetUtilization(&model) * 100.0);
+  fprintf(stderr, "%-16s %5s %4s %10s %10s\n", "irq", "IRQn", "prio", "deadline", "response");
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    irq      = &model.irqs[i];
+    response = RTA_GetResponseTime(&model, irq, &blocking);
+    fprintf(stderr, "%-16s %5d %4d %10llu %10llu%s\n", irq->name, irq->irqNum, irq->priority,
+            (unsigned long long)irq->deadline, (unsigned long long)response,
+            (response > irq->deadline) ? "  MISS" : "");
+    if (response > irq->deadline)
+    {
+      numOfMisses++;
+    }
+  }
+  if (numOfMisses != 0)
+  {
+    return 3;
+  }
+
+  output = (outputPath != NULL) ? fopen(outputPath, "w") : stdout;
+  if (output == NULL)
+  {
+    perror(outputPath);
+    return 1;
+  }
+  WriteHeader(output, modelPath, priorityBits, isDeadlineMono ? "deadline-monotonic" : "Audsley");
+  if (output != stdout)
+  {
+    fclose(output);
+  }
+
+  return 0;
+}
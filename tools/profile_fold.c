@@ -0,0 +1,293 @@
+/* Host tool turning the samples of pc_sampler.c into a flame graph profile.
+
+Reads the symbols of the firmware, as listed by nm, and the lines written by
+SAMPLER_Export (a console log is fine: other lines are skipped), and writes
+folded stacks, one "context;caller;function count" line per stack, which
+flamegraph.pl, inferno and speedscope open:
+	- the root frame is the interrupted context: "Thread", a system exception
+	  ("SysTick", "PendSV"...) or "IRQ<n>";
+	- the function of the sampled PC is the leaf;
+	- the function of the stacked LR is put in between when it is a different
+	  function, which is the caller in a leaf function (in other functions it
+	  may be the return address of the last call instead).
+Addresses outside any function are kept as hexadecimal frames.
+
+Build and run:
+
+cc -std=c99 -O2 -o profile_fold tools/profile_fold.c
+arm-none-eabi-nm -n -S -C --defined-only firmware.elf > firmware.sym
+./profile_fold firmware.sym console.log > profile.folded
+flamegraph.pl profile.folded > profile.svg
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE                   512
+#define MAX_STACK                  768
+
+typedef struct
+{
+  uint32_t address;
+  uint32_t size;
+  char    *name;
+} Symbol_t;
+
+typedef struct
+{
+  char         *stack;
+  unsigned long count;
+} Sample_t;
+
+static const char *exceptionNames[16] =
+{
+  "Thread", "Reset", "NMI", "HardFault", "MemManage", "BusFault", "UsageFault", "Reserved7",
+  "Reserved8", "Reserved9", "Reserved10", "SVCall", "DebugMonitor", "Reserved13", "PendSV", "SysTick"
+};
+
+static Symbol_t *symbols;
+static size_t    numOfSymbols;
+
+static int CompareSymbols(const void *a, const void *b)
+{
+  const Symbol_t *left  = a;
+  const Symbol_t *right = b;
+
+  return (left->address > right->address) - (left->address < right->address);
+}
+
+static int CompareSamples(const void *a, const void *b)
+{
+  return strcmp(((const Sample_t*)a)->stack, ((const Sample_t*)b)->stack);
+}
+
+static char *CopyString(const char *string)
+{
+  char *copy = malloc(strlen(string) + 1u);
+
+  if (copy != NULL)
+  {
+    strcpy(copy, string);
+  }
+
+  return copy;
+}
+
+/* Keep the code symbols of "address [size] type name" lines */
+static int LoadSymbols(const char *path)
+{
+  FILE         *input = fopen(path, "r");
+  char          line[MAX_LINE];
+  char          fields[3][MAX_LINE];
+  unsigned long address;
+  unsigned long size;
+  const char   *type;
+  const char   *name;
+  int           numOfFields;
+  size_t        capacity = 0u;
+
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    size        = 0u;
+    numOfFields = sscanf(line, "%lx %511s %511s %511[^\n]", &address, fields[0], fields[1], fields[2]);
+    if ((numOfFields == 4) && (strlen(fields[1]) == 1u))
+    {
+      size = strtoul(fields[0], NULL, 16);
+      type = fields[1];
+      name = fields[2];
+    }
+    else if ((numOfFields >= 3) && (strlen(fields[0]) == 1u))
+    {
+      /* No size column, the name may contain spaces (demangled) */
+      type = fields[0];
+      name = strstr(line, fields[1]);
+    }
+    else
+    {
+      continue;
+    }
+
+    if (strchr("TtWw", type[0]) == NULL)
+    {
+      continue;
+    }
+
+    if (numOfSymbols == capacity)
+    {
+      capacity = (capacity == 0u) ? 1024u : (capacity * 2u);
+      symbols  = realloc(symbols, capacity * sizeof(Symbol_t));
+      if (symbols == NULL)
+      {
+        fclose(input);
+        return -1;
+      }
+    }
+    /* Thumb functions have bit 0 set in some tools */
+    symbols[numOfSymbols].address = (uint32_t)address & ~1UL;
+    symbols[numOfSymbols].size    = (uint32_t)size;
+    symbols[numOfSymbols].name    = CopyString(name);
+    numOfSymbols++;
+  }
+
+  fclose(input);
+  qsort(symbols, numOfSymbols, sizeof(Symbol_t), CompareSymbols);
+
+  return 0;
+}
+
+/* Function containing an address, NULL if none */
+static const Symbol_t *FindSymbol(uint32_t address)
+{
+  size_t low  = 0u;
+  size_t high = numOfSymbols;
+  size_t middle;
+
+  /* Last symbol at or below the address */
+  while (low < high)
+  {
+    middle = (low + high) / 2u;
+    if (symbols[middle].address <= address)
+    {
+      low = middle + 1u;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  if ((low == 0u)
+      || ((symbols[low - 1u].size != 0u) && (address >= (symbols[low - 1u].address + symbols[low - 1u].size))))
+  {
+    return NULL;
+  }
+
+  return &symbols[low - 1u];
+}
+
+/* Append the frame of an address to a stack */
+static void AppendFrame(char *stack, size_t size, const Symbol_t *symbol, uint32_t address)
+{
+  size_t length = strlen(stack);
+
+  if (symbol != NULL)
+  {
+    snprintf(&stack[length], size - length, ";%s", symbol->name);
+  }
+  else
+  {
+    snprintf(&stack[length], size - length, ";0x%08lx", (unsigned long)address);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  FILE           *input;
+  char            line[MAX_LINE];
+  char            stack[MAX_STACK];
+  const char     *fields;
+  unsigned        exceptionNum;
+  unsigned long   pc;
+  unsigned long   lr;
+  unsigned long   count;
+  const Symbol_t *pcSymbol;
+  const Symbol_t *lrSymbol;
+  Sample_t       *samples      = NULL;
+  size_t          numOfSamples = 0u;
+  size_t          capacity     = 0u;
+  size_t          i;
+
+  if (argc != 3)
+  {
+    fprintf(stderr, "usage: %s <nm output> <SAMPLER_Export output>\n", argv[0]);
+    return 2;
+  }
+
+  if (LoadSymbols(argv[1]) != 0)
+  {
+    return 1;
+  }
+
+  input = fopen(argv[2], "r");
+  if (input == NULL)
+  {
+    perror(argv[2]);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    fields = strstr(line, "sample exc=");
+    if ((fields == NULL)
+        || (sscanf(fields, "sample exc=%u pc=%lx lr=%lx count=%lu", &exceptionNum, &pc, &lr, &count) != 4))
+    {
+      continue;
+    }
+
+    if (exceptionNum < 16u)
+    {
+      snprintf(stack, sizeof(stack), "%s", exceptionNames[exceptionNum]);
+    }
+    else
+    {
+      snprintf(stack, sizeof(stack), "IRQ%u", exceptionNum - 16u);
+    }
+
+    pcSymbol = FindSymbol((uint32_t)pc & ~1UL);
+    /* EXC_RETURN values are not code; the return address follows the call */
+    if (((uint32_t)lr & 0xF0000000UL) != 0xF0000000UL)
+    {
+      lrSymbol = FindSymbol(((uint32_t)lr & ~1UL) - 2u);
+      if ((lrSymbol != NULL) && (lrSymbol != pcSymbol))
+      {
+        AppendFrame(stack, sizeof(stack), lrSymbol, (uint32_t)lr);
+      }
+    }
+    AppendFrame(stack, sizeof(stack), pcSymbol, (uint32_t)pc);
+
+    if (numOfSamples == capacity)
+    {
+      capacity = (capacity == 0u) ? 256u : (capacity * 2u);
+      samples  = realloc(samples, capacity * sizeof(Sample_t));
+      if (samples == NULL)
+      {
+        return 1;
+      }
+    }
+    samples[numOfSamples].stack = CopyString(stack);
+    samples[numOfSamples].count = count;
+    numOfSamples++;
+  }
+  fclose(input);
+
+  if (numOfSamples == 0u)
+  {
+    fprintf(stderr, "%s: no \"sample\" line found\n", argv[2]);
+    return 1;
+  }
+
+  /* Entries at different PCs of the same function fold into one stack */
+  qsort(samples, numOfSamples, sizeof(Sample_t), CompareSamples);
+  for (i = 0u; i < numOfSamples; i++)
+  {
+    count = samples[i].count;
+    while (((i + 1u) < numOfSamples) && (strcmp(samples[i].stack, samples[i + 1u].stack) == 0))
+    {
+      i++;
+      count += samples[i].count;
+    }
+    printf("%s %lu\n", samples[i].stack, count);
+  }
+
+  return 0;
+}
@@ -0,0 +1,373 @@
+/* Response-time analysis of an interrupt configuration.
+
+Computes the worst-case response time of every IRQ with the classic
+fixed-priority analysis, and tells which ones can miss their deadline. The
+model file and the analysis are described in rta_model.h.
+
+A trace dump of trace_recorder.c (-t) adds measured numbers, kept when they
+are worse than the model:
+	- the longest exclusive run time of each IRQ, between the enter and exit
+	  events, without the handlers that preempted it;
+	- the shortest time between two entries of each IRQ;
+	- the longest PRIMASK section and the longest BASEPRI section per level,
+	  with the context that ran them. When a context raises BASEPRI inside
+	  the section of another (a handler preempting it), each level is
+	  charged to the context that set it, for the time that context ran at
+	  it, not for the whole time BASEPRI stayed raised.
+NVIC sections mask specific interrupts, not a level: they are not counted.
+The output of JITTER_Export (-l, a console log is fine) adds the shortest
+measured period of the analyzed IRQ.
+
+Build and run:
+
+cc -std=c99 -O2 -o rta tools/rta.c
+./rta -t ram.bin -l console.log irqs.txt
+
+The exit status is 3 when an IRQ can miss its deadline.
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rta_model.h"
+#include "trace_reader.h"
+
+#define MAX_NESTING                64
+/* Nested BASEPRI levels, each more urgent than the one below */
+#define MAX_BASEPRI_NESTING        16
+/* Exception numbers held by a payload that are accounted */
+#define MAX_EXCEPTIONS             512u
+
+typedef struct
+{
+  uint32_t exception;
+  uint64_t enterCycles;
+  uint64_t nestedCycles;
+} Frame_t;
+
+/* A raise of BASEPRI, and the time its owner ran at it */
+typedef struct
+{
+  uint32_t level;
+  uint32_t owner;
+  uint64_t cycles;
+} BasepriFrame_t;
+
+typedef struct
+{
+  Frame_t  stack[MAX_NESTING];
+  uint32_t depth;
+  uint64_t lastEnter[MAX_EXCEPTIONS];
+  uint64_t maxExclusive[MAX_EXCEPTIONS];
+  uint64_t minInterArrival[MAX_EXCEPTIONS];
+  uint64_t primaskStart;
+  uint32_t primaskDepth;
+  uint32_t primaskOwner;
+  BasepriFrame_t basepriStack[MAX_BASEPRI_NESTING];
+  uint32_t       basepriDepth;
+  uint64_t       basepriLastCycles;
+} Measure_t;
+
+static RTA_Model_t model;
+
+/* Priority of the code running at an exception number; unknown code is
+ * taken as the least urgent, which blocks the most */
+static int OwnerPriority(uint32_t exception)
+{
+  RTA_Irq_t *irq = (exception >= 16u) ? RTA_FindIrq(&model, (int)exception - 16) : NULL;
+
+  return (irq != NULL) ? irq->priority : RTA_THREAD_PRIORITY;
+}
+
+/* Charge the time since the last event to the innermost BASEPRI level, when
+ * its owner is the context that ran meanwhile */
+static void ChargeBasepri(Measure_t *measure, uint32_t owner, uint64_t cycles)
+{
+  BasepriFrame_t *frame;
+
+  if (measure->basepriDepth != 0u)
+  {
+    frame = &measure->basepriStack[measure->basepriDepth - 1u];
+    if (frame->owner == owner)
+    {
+      frame->cycles += cycles - measure->basepriLastCycles;
+    }
+  }
+  measure->basepriLastCycles = cycles;
+}
+
+/* Close the levels more urgent than the new BASEPRI value (all for 0) */
+static void PopBasepri(Measure_t *measure, uint32_t newLevel)
+{
+  BasepriFrame_t *frame;
+
+  while (measure->basepriDepth != 0u)
+  {
+    frame = &measure->basepriStack[measure->basepriDepth - 1u];
+    if ((newLevel != 0u) && (frame->level >= newLevel))
+    {
+      break;
+    }
+    RTA_AddBlocking(&model, 0, (int)frame->level, OwnerPriority(frame->owner), frame->cycles);
+    measure->basepriDepth--;
+  }
+}
+
+static void MeasureEvent(void *context, uint32_t type, uint32_t payload, uint64_t cycles, uint32_t value)
+{
+  Measure_t *measure = context;
+  Frame_t   *frame;
+  uint64_t   duration;
+  uint32_t   owner = (measure->depth != 0u) ? measure->stack[measure->depth - 1u].exception : 0u;
+
+  (void)value;
+
+  ChargeBasepri(measure, owner, cycles);
+
+  switch (type)
+  {
+    case TRACE_EVENT_IRQ_ENTER:
+      if (payload >= MAX_EXCEPTIONS)
+      {
+        break;
+      }
+      if (measure->lastEnter[payload] != 0u)
+      {
+        duration = cycles - measure->lastEnter[payload];
+        if ((measure->minInterArrival[payload] == 0u) || (duration < measure->minInterArrival[payload]))
+        {
+          measure->minInterArrival[payload] = duration;
+        }
+      }
+      measure->lastEnter[payload] = cycles;
+      if (measure->depth < MAX_NESTING)
+      {
+        frame               = &measure->stack[measure->depth++];
+        frame->exception    = payload;
+        frame->enterCycles  = cycles;
+        frame->nestedCycles = 0u;
+      }
+      break;
+
+    case TRACE_EVENT_IRQ_EXIT:
+      /* Exits of handlers entered before the oldest event are dropped */
+      if ((measure->depth != 0u) && (measure->stack[measure->depth - 1u].exception == payload))
+      {
+        frame    = &measure->stack[--measure->depth];
+        duration = cycles - frame->enterCycles;
+        if ((duration - frame->nestedCycles) > measure->maxExclusive[payload])
+        {
+          measure->maxExclusive[payload] = duration - frame->nestedCycles;
+        }
+        if (measure->depth != 0u)
+        {
+          measure->stack[measure->depth - 1u].nestedCycles += duration;
+        }
+      }
+      break;
+
+    case TRACE_EVENT_SECTION_ENTER:
+      if ((payload == TRACE_SECTION_PRIMASK) && (measure->primaskDepth++ == 0u))
+      {
+        measure->primaskStart = cycles;
+        measure->primaskOwner = owner;
+      }
+      break;
+
+    case TRACE_EVENT_SECTION_EXIT:
+      if ((payload == TRACE_SECTION_PRIMASK) && (measure->primaskDepth != 0u) && (--measure->primaskDepth == 0u))
+      {
+        RTA_AddBlocking(&model, 1, 0, OwnerPriority(measure->primaskOwner), cycles - measure->primaskStart);
+      }
+      break;
+
+    case TRACE_EVENT_BASEPRI:
+      PopBasepri(measure, payload);
+      if ((payload != 0u) && (measure->basepriDepth < MAX_BASEPRI_NESTING)
+          && ((measure->basepriDepth == 0u)
+              || (payload < measure->basepriStack[measure->basepriDepth - 1u].level)))
+      {
+        measure->basepriStack[measure->basepriDepth].level  = payload;
+        measure->basepriStack[measure->basepriDepth].owner  = owner;
+        measure->basepriStack[measure->basepriDepth].cycles = 0u;
+        measure->basepriDepth++;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* Merge the numbers of a trace dump, the worse value wins */
+static int LoadTrace(const char *path)
+{
+  static Measure_t measure;
+  TRACE_Dump_t     dump;
+  RTA_Irq_t       *irq;
+
+  if (TRACE_LoadDump(path, &dump) != 0)
+  {
+    return -1;
+  }
+  TRACE_ReadEvents(&dump, MeasureEvent, &measure);
+  free(dump.data);
+  model.numOfFixedBlockings = model.numOfBlockings;
+
+  for (uint32_t exception = 16u; exception < MAX_EXCEPTIONS; exception++)
+  {
+    if (measure.lastEnter[exception] == 0u)
+    {
+      continue;
+    }
+    irq = RTA_FindIrq(&model, (int)exception - 16);
+    if (irq == NULL)
+    {
+      fprintf(stderr, "%s: IRQ %u is traced but not in the model, it is ignored\n", path,
+              (unsigned)(exception - 16u));
+      continue;
+    }
+    if ((measure.maxExclusive[exception] > irq->wcet) || !irq->hasWcet)
+    {
+      irq->wcet           = measure.maxExclusive[exception];
+      irq->hasWcet        = 1;
+      irq->isWcetMeasured = 1;
+    }
+    if ((measure.minInterArrival[exception] != 0u)
+        && ((irq->period == 0u) || (measure.minInterArrival[exception] < irq->period)))
+    {
+      irq->period           = measure.minInterArrival[exception];
+      irq->isPeriodMeasured = 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Merge the shortest periods of JITTER_Export lines */
+static int LoadLog(const char *path)
+{
+  FILE         *input = fopen(path, "r");
+  char          line[RTA_MAX_LINE];
+  const char   *fields;
+  int           irqNum;
+  unsigned long minPeriod;
+  RTA_Irq_t    *irq;
+
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    fields = strstr(line, "jitter irq=");
+    if ((fields == NULL)
+        || (sscanf(fields, "jitter irq=%d nominal=%*u samples=%*u min=%lu", &irqNum, &minPeriod) != 2)
+        || (minPeriod == 0u))
+    {
+      continue;
+    }
+    irq = RTA_FindIrq(&model, irqNum);
+    if ((irq != NULL) && ((irq->period == 0u) || (minPeriod < irq->period)))
+    {
+      irq->period           = minPeriod;
+      irq->isPeriodMeasured = 1;
+    }
+  }
+
+  fclose(input);
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *modelPath = NULL;
+  const char *tracePath = NULL;
+  const char *logPath   = NULL;
+  uint64_t    blocking;
+  uint64_t    response;
+  int         numOfMisses = 0;
+  char        responseText[24];
+  RTA_Irq_t  *irq;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc))
+    {
+      tracePath = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc))
+    {
+      logPath = argv[++i];
+    }
+    else if ((argv[i][0] != '-') && (modelPath == NULL))
+    {
+      modelPath = argv[i];
+    }
+    else
+    {
+      modelPath = NULL;
+      break;
+    }
+  }
+  if (modelPath == NULL)
+  {
+    fprintf(stderr, "usage: %s [-t <trace dump>] [-l <JITTER_Export log>] <model>\n", argv[0]);
+    return 2;
+  }
+
+  if (RTA_LoadModel(modelPath, &model) != 0)
+  {
+    return 1;
+  }
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    if (model.irqs[i].priority == RTA_UNASSIGNED)
+    {
+      fprintf(stderr, "%s: no priority for %s (see prio_assign.c)\n", modelPath, model.irqs[i].name);
+      return 1;
+    }
+  }
+  if (((tracePath != NULL) && (LoadTrace(tracePath) != 0))
+      || ((logPath != NULL) && (LoadLog(logPath) != 0))
+      || (RTA_CompleteModel(&model, modelPath) != 0))
+  {
+    return 1;
+  }
+  RTA_ApplyResources(&model);
+
+  printf("overhead: entry %llu, exit %llu, tail-chain %llu cycles; utilization %.1f%%\n",
+         (unsigned long long)model.entryCycles, (unsigned long long)model.exitCycles,
+         (unsigned long long)model.tailChainCycles, RTA_GetUtilization(&model) * 100.0);
+  printf("%-16s %5s %4s %10s %10s %10s %10s %10s  %s\n",
+         "irq", "IRQn", "prio", "wcet", "period", "deadline", "blocking", "response", "result");
+
+  for (int i = 0; i < model.numOfIrqs; i++)
+  {
+    irq      = &model.irqs[i];
+    response = RTA_GetResponseTime(&model, irq, &blocking);
+    if (response > irq->deadline)
+    {
+      snprintf(responseText, sizeof(responseText), ">deadline");
+      numOfMisses++;
+    }
+    else
+    {
+      snprintf(responseText, sizeof(responseText), "%llu", (unsigned long long)response);
+    }
+    printf("%-16s %5d %4d %9llu%s %9llu%s %10llu %10llu %10s  %s\n",
+           irq->name, irq->irqNum, irq->priority,
+           (unsigned long long)irq->wcet, irq->isWcetMeasured ? "*" : " ",
+           (unsigned long long)irq->period, irq->isPeriodMeasured ? "*" : " ",
+           (unsigned long long)irq->deadline, (unsigned long long)blocking,
+           responseText, (response > irq->deadline) ? "MISS" : "ok");
+  }
+  printf("* measured\n");
+
+  return (numOfMisses != 0) ? 3 : 0;
+}
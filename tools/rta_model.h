@@ -0,0 +1,521 @@
+/* Interrupt model and response-time analysis, shared by the host tools
+(rta.c, prio_assign.c, irq_sim.c, irq_replay.c).
+
+The model is a text file, times in CPU cycles, '#' starts a comment:
+
+core <m0|m0plus|m3|m4|m4f|m7> [vector wait states] [fpu]
+overhead <entry> <exit> <tail-chain>
+irq <name> <IRQn> <priority> <wcet> <period> [deadline]
+blocking <primask|level> <cycles> [owner priority|thread]
+resource <name> <cycles> <user> <user>...
+
+	- core: sets the overheads from the timing of a core (cortexm_timing.h),
+	  with the wait states of the memory holding the vector table, and the
+	  FP registers stacked on every entry when "fpu" is given (the worst
+	  case of lazy stacking, every handler using the FPU);
+	- overhead: exception entry (stacking, vector fetch), exit (unstacking)
+	  and tail-chaining cycles, default 12 10 6 (Cortex-M3/M4 with zero wait
+	  state memory), measured values overriding those of the core line;
+	- irq: an interrupt, its NVIC priority level (lower is more urgent), the
+	  worst-case execution time of its handler, its period or minimum
+	  inter-arrival time, and its deadline (the period by default). "-" leaves
+	  a value to be measured (wcet, period) or assigned (priority);
+	- blocking: the longest section masking with PRIMASK, or with BASEPRI at
+	  the given level (THREAD_SAFE_SECTION masks basePriLevel), run by thread
+	  code (default) or by a handler of the given priority. It blocks the IRQs
+	  of equal or lower priority than its level, when run by lower priority
+	  code;
+	- resource: data shared by IRQs (by name) and "thread" code, protected by
+	  BASEPRI_EnterPriorityCeilingSection at the most urgent priority of its
+	  IRQ users, with sections of at most <cycles>. Every user less urgent
+	  than the ceiling blocks the IRQs up to the ceiling. A ceiling at level 0
+	  cannot be set in BASEPRI and is taken as a PRIMASK section.
+
+Response time R of IRQ i, from its request to the end of its handler:
+
+R = max(Bs + entry, Bh + tail-chain) + Ci + sum over hp(i) of ceil(R / Tj) (Cj + entry + exit)
+
+	- hp(i): the IRQs of higher priority, and those of the same priority with a
+	  lower number, which win the arbitration when both are pending;
+	- Bs: the longest section that can block i;
+	- Bh: the longest handler of the same priority and a higher number, which
+	  i cannot preempt but tail-chains to.
+The equation is iterated from R = Ci until it is stable or R exceeds the
+deadline. A preempting handler is charged a full entry and exit, an upper
+bound of the tail-chained case.
+
+*/
+
+#ifndef RTA_MODEL_H
+#define RTA_MODEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cortexm_timing.h"
+
+#define RTA_MAX_LINE               512
+#define RTA_MAX_NAME               64
+#define RTA_MAX_IRQS               256
+#define RTA_MAX_BLOCKINGS          1024
+#define RTA_MAX_RESOURCES          64
+#define RTA_MAX_USERS              16
+#define RTA_MAX_ITERATIONS         10000
+
+/* Priority of thread code, below every handler */
+#define RTA_THREAD_PRIORITY        0x7FFFFFFF
+/* Priority of an IRQ not assigned yet, above every level */
+#define RTA_UNASSIGNED             (-1)
+/* User index of thread code in a resource */
+#define RTA_THREAD_USER            (-1)
+
+typedef struct
+{
+  char     name[RTA_MAX_NAME];
+  int      irqNum;
+  int      priority;
+  uint64_t wcet;
+  uint64_t period;
+  uint64_t deadline;
+  int      hasWcet;
+  int      isWcetMeasured;
+  int      isPeriodMeasured;
+} RTA_Irq_t;
+
+typedef struct
+{
+  int      isPrimask;
+  int      level;
+  /* Priority of the code running the section */
+  int      ownerPriority;
+  uint64_t cycles;
+} RTA_Blocking_t;
+
+typedef struct
+{
+  char     name[RTA_MAX_NAME];
+  uint64_t cycles;
+  /* Indexes in irqs, or RTA_THREAD_USER */
+  int      users[RTA_MAX_USERS];
+  int      numOfUsers;
+} RTA_Resource_t;
+
+typedef struct
+{
+  RTA_Irq_t      irqs[RTA_MAX_IRQS];
+  int            numOfIrqs;
+  RTA_Blocking_t blockings[RTA_MAX_BLOCKINGS];
+  int            numOfBlockings;
+  /* Blockings of the model and the measures, the resources add theirs after */
+  int            numOfFixedBlockings;
+  RTA_Resource_t resources[RTA_MAX_RESOURCES];
+  int            numOfResources;
+  uint64_t       entryCycles;
+  uint64_t       exitCycles;
+  uint64_t       tailChainCycles;
+  /* Core timing, for the simulation of irq_sim.c */
+  const CORE_Profile_t *core;
+  uint32_t       vectorWaitStates;
+  int            isFpuUsed;
+} RTA_Model_t;
+
+static RTA_Irq_t *RTA_FindIrq(RTA_Model_t *model, int irqNum)
+{
+  for (int i = 0; i < model->numOfIrqs; i++)
+  {
+    if (model->irqs[i].irqNum == irqNum)
+    {
+      return &model->irqs[i];
+    }
+  }
+
+  return NULL;
+}
+
+static int RTA_FindIrqByName(const RTA_Model_t *model, const char *name)
+{
+  for (int i = 0; i < model->numOfIrqs; i++)
+  {
+    if (strcmp(model->irqs[i].name, name) == 0)
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* Keep the longest section per kind, level and owner */
+static void RTA_AddBlocking(RTA_Model_t *model, int isPrimask, int level, int ownerPriority, uint64_t cycles)
+{
+  RTA_Blocking_t *blocking;
+
+  if (isPrimask)
+  {
+    level = 0;
+  }
+
+  for (int i = 0; i < model->numOfBlockings; i++)
+  {
+    blocking = &model->blockings[i];
+    if ((blocking->isPrimask == isPrimask) && (blocking->level == level) && (blocking->ownerPriority == ownerPriority))
+    {
+      if (cycles > blocking->cycles)
+      {
+        blocking->cycles = cycles;
+      }
+      return;
+    }
+  }
+
+  if (model->numOfBlockings < RTA_MAX_BLOCKINGS)
+  {
+    blocking                = &model->blockings[model->numOfBlockings++];
+    blocking->isPrimask     = isPrimask;
+    blocking->level         = level;
+    blocking->ownerPriority = ownerPriority;
+    blocking->cycles        = cycles;
+  }
+}
+
+/* Most urgent priority of the IRQ users of a resource, RTA_THREAD_PRIORITY if none */
+static int RTA_GetCeiling(const RTA_Model_t *model, const RTA_Resource_t *resource)
+{
+  int ceiling = RTA_THREAD_PRIORITY;
+
+  for (int k = 0; k < resource->numOfUsers; k++)
+  {
+    if ((resource->users[k] != RTA_THREAD_USER) && (model->irqs[resource->users[k]].priority < ceiling))
+    {
+      ceiling = model->irqs[resource->users[k]].priority;
+    }
+  }
+
+  return ceiling;
+}
+
+/* Replace the blockings of the resources by those of the current priorities */
+static void RTA_ApplyResources(RTA_Model_t *model)
+{
+  const RTA_Resource_t *resource;
+  int                   ceiling;
+  int                   ownerPriority;
+
+  model->numOfBlockings = model->numOfFixedBlockings;
+
+  for (int r = 0; r < model->numOfResources; r++)
+  {
+    resource = &model->resources[r];
+    ceiling  = RTA_GetCeiling(model, resource);
+    if (ceiling == RTA_THREAD_PRIORITY)
+    {
+      continue;
+    }
+    for (int k = 0; k < resource->numOfUsers; k++)
+    {
+      ownerPriority = (resource->users[k] == RTA_THREAD_USER) ? RTA_THREAD_PRIORITY
+                                                              : model->irqs[resource->users[k]].priority;
+      if (ownerPriority > ceiling)
+      {
+        RTA_AddBlocking(model, ceiling <= 0, ceiling, ownerPriority, resource->cycles);
+      }
+    }
+  }
+}
+
+/* Cycles or "-", read as 0 */
+static int RTA_ParseCycles(const char *text, uint64_t *cycles)
+{
+  char *end;
+
+  if (strcmp(text, "-") == 0)
+  {
+    *cycles = 0u;
+    return 0;
+  }
+  *cycles = strtoull(text, &end, 0);
+
+  return (*end == '\0') ? 0 : -1;
+}
+
+static int RTA_ParseLine(RTA_Model_t *model, char **words, int numOfWords, char userNames[][RTA_MAX_NAME])
+{
+  RTA_Irq_t      *irq;
+  RTA_Resource_t *resource;
+  uint64_t        cycles;
+
+  if ((strcmp(words[0], "core") == 0) && (numOfWords >= 2) && (numOfWords <= 4))
+  {
+    model->core             = CORE_FindProfile(words[1]);
+    model->vectorWaitStates = (numOfWords >= 3) ? (uint32_t)strtoul(words[2], NULL, 0) : 0u;
+    model->isFpuUsed        = (numOfWords == 4) && (strcmp(words[3], "fpu") == 0);
+    if ((model->core == NULL) || ((numOfWords == 4) && !model->isFpuUsed)
+        || (model->isFpuUsed && (model->core->fpStackingCycles == 0u)))
+    {
+      return -1;
+    }
+    model->entryCycles     = model->core->stackingCycles + model->vectorWaitStates;
+    model->exitCycles      = model->core->unstackingCycles;
+    model->tailChainCycles = model->core->tailChainCycles + model->vectorWaitStates;
+    if (model->isFpuUsed)
+    {
+      model->entryCycles     += model->core->fpStackingCycles;
+      model->exitCycles      += model->core->fpUnstackingCycles;
+      model->tailChainCycles += model->core->fpStackingCycles;
+    }
+  }
+  else if ((strcmp(words[0], "overhead") == 0) && (numOfWords == 4))
+  {
+    model->entryCycles     = strtoull(words[1], NULL, 0);
+    model->exitCycles      = strtoull(words[2], NULL, 0);
+    model->tailChainCycles = strtoull(words[3], NULL, 0);
+  }
+  else if ((strcmp(words[0], "irq") == 0) && ((numOfWords == 6) || (numOfWords == 7))
+           && (model->numOfIrqs < RTA_MAX_IRQS))
+  {
+    irq = &model->irqs[model->numOfIrqs];
+    snprintf(irq->name, sizeof(irq->name), "%s", words[1]);
+    irq->irqNum   = atoi(words[2]);
+    irq->priority = (strcmp(words[3], "-") == 0) ? RTA_UNASSIGNED : atoi(words[3]);
+    if ((RTA_FindIrq(model, irq->irqNum) != NULL) || (RTA_FindIrqByName(model, irq->name) >= 0)
+        || (RTA_ParseCycles(words[4], &irq->wcet) != 0) || (RTA_ParseCycles(words[5], &irq->period) != 0))
+    {
+      return -1;
+    }
+    irq->hasWcet  = (strcmp(words[4], "-") != 0);
+    irq->deadline = (numOfWords == 7) ? strtoull(words[6], NULL, 0) : 0u;
+    model->numOfIrqs++;
+  }
+  else if ((strcmp(words[0], "blocking") == 0) && ((numOfWords == 3) || (numOfWords == 4)))
+  {
+    if (RTA_ParseCycles(words[2], &cycles) != 0)
+    {
+      return -1;
+    }
+    RTA_AddBlocking(model, strcmp(words[1], "primask") == 0, atoi(words[1]),
+                    ((numOfWords == 3) || (strcmp(words[3], "thread") == 0)) ? RTA_THREAD_PRIORITY : atoi(words[3]),
+                    cycles);
+    model->numOfFixedBlockings = model->numOfBlockings;
+  }
+  else if ((strcmp(words[0], "resource") == 0) && (numOfWords >= 4)
+           && ((numOfWords - 3) <= RTA_MAX_USERS) && (model->numOfResources < RTA_MAX_RESOURCES))
+  {
+    resource = &model->resources[model->numOfResources];
+    snprintf(resource->name, sizeof(resource->name), "%s", words[1]);
+    if (RTA_ParseCycles(words[2], &resource->cycles) != 0)
+    {
+      return -1;
+    }
+    /* Users are resolved once every irq is known */
+    resource->numOfUsers = numOfWords - 3;
+    for (int k = 0; k < resource->numOfUsers; k++)
+    {
+      snprintf(userNames[k], RTA_MAX_NAME, "%s", words[3 + k]);
+    }
+    model->numOfResources++;
+  }
+  else
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Read a model file, 0 on success */
+static int RTA_LoadModel(const char *path, RTA_Model_t *model)
+{
+  static char userNames[RTA_MAX_RESOURCES][RTA_MAX_USERS][RTA_MAX_NAME];
+  FILE       *input = fopen(path, "r");
+  char        line[RTA_MAX_LINE];
+  char       *words[RTA_MAX_USERS + 4];
+  int         numOfWords;
+  int         lineNum = 0;
+  int         user;
+
+  memset(model, 0, sizeof(*model));
+  model->core            = CORE_FindProfile("m3");
+  model->entryCycles     = 12u;
+  model->exitCycles      = 10u;
+  model->tailChainCycles = 6u;
+
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), input) != NULL)
+  {
+    lineNum++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    numOfWords = 0;
+    for (char *word = strtok(line, " \t"); word != NULL; word = strtok(NULL, " \t"))
+    {
+      if (numOfWords == (int)(sizeof(words) / sizeof(words[0])))
+      {
+        numOfWords = -1;
+        break;
+      }
+      words[numOfWords++] = word;
+    }
+    if (numOfWords == 0)
+    {
+      continue;
+    }
+    if ((numOfWords < 0) || (RTA_ParseLine(model, words, numOfWords, userNames[model->numOfResources]) != 0))
+    {
+      fprintf(stderr, "%s:%d: bad line\n", path, lineNum);
+      fclose(input);
+      return -1;
+    }
+  }
+  fclose(input);
+
+  for (int r = 0; r < model->numOfResources; r++)
+  {
+    for (int k = 0; k < model->resources[r].numOfUsers; k++)
+    {
+      user = (strcmp(userNames[r][k], "thread") == 0) ? RTA_THREAD_USER : RTA_FindIrqByName(model, userNames[r][k]);
+      if ((user != RTA_THREAD_USER) && (user < 0))
+      {
+        fprintf(stderr, "%s: unknown user %s of resource %s\n", path, userNames[r][k], model->resources[r].name);
+        return -1;
+      }
+      model->resources[r].users[k] = user;
+    }
+  }
+
+  return 0;
+}
+
+/* True if j preempts i, or wins the arbitration when both are pending */
+static int RTA_IsHigherPriority(const RTA_Irq_t *j, const RTA_Irq_t *i)
+{
+  return (j->priority < i->priority) || ((j->priority == i->priority) && (j->irqNum < i->irqNum));
+}
+
+/* Longest section that can block an IRQ */
+static uint64_t RTA_GetSectionBlocking(const RTA_Model_t *model, const RTA_Irq_t *irq)
+{
+  const RTA_Blocking_t *blocking;
+  uint64_t              cycles = 0u;
+
+  for (int k = 0; k < model->numOfBlockings; k++)
+  {
+    blocking = &model->blockings[k];
+    /* Sections of more urgent code are in its execution time, and the
+     * handlers of the same priority are accounted as handlers */
+    if ((blocking->ownerPriority > irq->priority)
+        && (blocking->isPrimask || (blocking->level <= irq->priority))
+        && (blocking->cycles > cycles))
+    {
+      cycles = blocking->cycles;
+    }
+  }
+
+  return cycles;
+}
+
+/* Longest handler of the same priority that the IRQ tail-chains to */
+static uint64_t RTA_GetHandlerBlocking(const RTA_Model_t *model, const RTA_Irq_t *irq, int *hasHandler)
+{
+  uint64_t cycles = 0u;
+
+  *hasHandler = 0;
+  for (int k = 0; k < model->numOfIrqs; k++)
+  {
+    if ((model->irqs[k].priority == irq->priority) && (model->irqs[k].irqNum > irq->irqNum))
+    {
+      *hasHandler = 1;
+      if (model->irqs[k].wcet > cycles)
+      {
+        cycles = model->irqs[k].wcet;
+      }
+    }
+  }
+
+  return cycles;
+}
+
+/* Worst-case response time, or a value above the deadline if missed.
+ * The deadline must be set (not 0) and every period too. */
+static uint64_t RTA_GetResponseTime(const RTA_Model_t *model, const RTA_Irq_t *irq, uint64_t *blocking)
+{
+  uint64_t sectionBlocking = RTA_GetSectionBlocking(model, irq);
+  uint64_t handlerBlocking;
+  uint64_t start;
+  uint64_t response;
+  uint64_t next;
+  int      hasHandler;
+
+  handlerBlocking = RTA_GetHandlerBlocking(model, irq, &hasHandler);
+  start           = sectionBlocking + model->entryCycles;
+  *blocking       = sectionBlocking;
+  if (hasHandler && ((handlerBlocking + model->tailChainCycles) > start))
+  {
+    start     = handlerBlocking + model->tailChainCycles;
+    *blocking = handlerBlocking;
+  }
+
+  response = start + irq->wcet;
+  for (int iteration = 0; iteration < RTA_MAX_ITERATIONS; iteration++)
+  {
+    next = start + irq->wcet;
+    for (int k = 0; k < model->numOfIrqs; k++)
+    {
+      if (RTA_IsHigherPriority(&model->irqs[k], irq))
+      {
+        next += ((response + model->irqs[k].period - 1u) / model->irqs[k].period)
+                * (model->irqs[k].wcet + model->entryCycles + model->exitCycles);
+      }
+    }
+    if ((next == response) || (next > irq->deadline))
+    {
+      return next;
+    }
+    response = next;
+  }
+
+  return UINT64_MAX;
+}
+
+/* Check that every IRQ has its wcet and period, default the deadlines */
+static int RTA_CompleteModel(RTA_Model_t *model, const char *path)
+{
+  RTA_Irq_t *irq;
+
+  for (int i = 0; i < model->numOfIrqs; i++)
+  {
+    irq = &model->irqs[i];
+    if ((irq->period == 0u) || !irq->hasWcet)
+    {
+      fprintf(stderr, "%s: no %s for %s, in the model or measured\n", path,
+              (irq->period == 0u) ? "period" : "wcet", irq->name);
+      return -1;
+    }
+    if (irq->deadline == 0u)
+    {
+      irq->deadline = irq->period;
+    }
+  }
+
+  return 0;
+}
+
+/* Share of the CPU taken by the IRQs, exception overheads included */
+static double RTA_GetUtilization(const RTA_Model_t *model)
+{
+  double utilization = 0.0;
+
+  for (int i = 0; i < model->numOfIrqs; i++)
+  {
+    utilization += (double)(model->irqs[i].wcet + model->entryCycles + model->exitCycles)
+                   / (double)model->irqs[i].period;
+  }
+
+  return utilization;
+}
+
+#endif /* RTA_MODEL_H */
@@ -0,0 +1,232 @@
+/* Host decoder of the traces recorded by trace_recorder.c.
+
+Reads a memory dump (traceBuffer alone, or any RAM dump containing it, from
+GDB "dump binary memory" or QEMU "pmemsave") and writes the Chrome trace JSON
+format, which chrome://tracing and ui.perfetto.dev both open:
+	- IRQs are slices on the "IRQs" track, nested when they preempt each
+	  other, back to back when they tail-chain;
+	- PRIMASK and NVIC sections are slices on their own tracks;
+	- BASEPRI is a counter track;
+	- markers are instant events, with their value as argument.
+
+Build and run:
+
+cc -std=c99 -O2 -o trace_decode tools/trace_decode.c
+./trace_decode ram.bin trace.json
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_reader.h"
+
+/* Tracks of the timeline */
+#define TRACK_IRQS                 0
+#define TRACK_FIRST_SECTION        1
+
+static const char *sectionNames[TRACE_NUM_OF_SECTIONS] = { "PRIMASK", "BASEPRI", "NVIC" };
+
+static const char *exceptionNames[16] =
+{
+  "Thread", "Reset", "NMI", "HardFault", "MemManage", "BusFault", "UsageFault", "Reserved7",
+  "Reserved8", "Reserved9", "Reserved10", "SVCall", "DebugMonitor", "Reserved13", "PendSV", "SysTick"
+};
+
+typedef struct
+{
+  FILE    *output;
+  double   cyclesPerMicrosecond;
+  uint64_t firstCycles;
+  uint64_t lastCycles;
+  uint32_t irqDepth;
+  uint32_t irqStack[512];
+  uint32_t sectionDepth[TRACE_NUM_OF_SECTIONS];
+  uint32_t numOfEvents;
+  int      isSynced;
+} Decoder_t;
+
+static double ToMicroseconds(const Decoder_t *decoder, uint64_t cycles)
+{
+  return (double)(cycles - decoder->firstCycles) / decoder->cyclesPerMicrosecond;
+}
+
+static void IrqName(uint32_t exception, char *name, size_t size)
+{
+  if (exception < 16u)
+  {
+    snprintf(name, size, "%s", exceptionNames[exception]);
+  }
+  else
+  {
+    snprintf(name, size, "IRQ %u", (unsigned)(exception - 16u));
+  }
+}
+
+static void WriteEvent(Decoder_t *decoder, const char *name, const char *phase, int track,
+                       uint64_t cycles, const char *args)
+{
+  fprintf(decoder->output, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%.3f%s%s%s}",
+          (decoder->numOfEvents == 0u) ? "" : ",", name, phase, track, ToMicroseconds(decoder, cycles),
+          (args != NULL) ? ",\"args\":{" : "", (args != NULL) ? args : "", (args != NULL) ? "}" : "");
+  decoder->numOfEvents++;
+}
+
+static void WriteTrackName(Decoder_t *decoder, int track, const char *name)
+{
+  fprintf(decoder->output, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+          (decoder->numOfEvents == 0u) ? "" : ",", track, name);
+  decoder->numOfEvents++;
+}
+
+static void DecodeEvent(void *context, uint32_t type, uint32_t payload, uint64_t cycles, uint32_t value)
+{
+  Decoder_t *decoder = context;
+  char       name[32];
+  char       args[48];
+
+  if (type == TRACE_EVENT_SYNC)
+  {
+    if (!decoder->isSynced)
+    {
+      decoder->firstCycles = cycles;
+      decoder->isSynced    = 1;
+    }
+    return;
+  }
+  decoder->lastCycles = cycles;
+
+  switch (type)
+  {
+    case TRACE_EVENT_IRQ_ENTER:
+      if (decoder->irqDepth < (sizeof(decoder->irqStack) / sizeof(decoder->irqStack[0])))
+      {
+        decoder->irqStack[decoder->irqDepth++] = payload;
+        IrqName(payload, name, sizeof(name));
+        WriteEvent(decoder, name, "B", TRACK_IRQS, cycles, NULL);
+      }
+      break;
+
+    case TRACE_EVENT_IRQ_EXIT:
+      /* Exits of handlers entered before the oldest event are dropped */
+      if ((decoder->irqDepth != 0u) && (decoder->irqStack[decoder->irqDepth - 1u] == payload))
+      {
+        decoder->irqDepth--;
+        IrqName(payload, name, sizeof(name));
+        WriteEvent(decoder, name, "E", TRACK_IRQS, cycles, NULL);
+      }
+      break;
+
+    case TRACE_EVENT_SECTION_ENTER:
+      if (payload < TRACE_NUM_OF_SECTIONS)
+      {
+        decoder->sectionDepth[payload]++;
+        WriteEvent(decoder, sectionNames[payload], "B", TRACK_FIRST_SECTION + (int)payload, cycles, NULL);
+      }
+      break;
+
+    case TRACE_EVENT_SECTION_EXIT:
+      if ((payload < TRACE_NUM_OF_SECTIONS) && (decoder->sectionDepth[payload] != 0u))
+      {
+        decoder->sectionDepth[payload]--;
+        WriteEvent(decoder, sectionNames[payload], "E", TRACK_FIRST_SECTION + (int)payload, cycles, NULL);
+      }
+      break;
+
+    case TRACE_EVENT_BASEPRI:
+      snprintf(args, sizeof(args), "\"level\":%u", (unsigned)payload);
+      WriteEvent(decoder, "BASEPRI", "C", TRACK_IRQS, cycles, args);
+      break;
+
+    case TRACE_EVENT_MARKER:
+    case TRACE_EVENT_MARKER_VALUE:
+      snprintf(name, sizeof(name), "marker %u", (unsigned)payload);
+      if (type == TRACE_EVENT_MARKER_VALUE)
+      {
+        snprintf(args, sizeof(args), "\"value\":%lu", (unsigned long)value);
+      }
+      fprintf(decoder->output, "%s\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%d,\"ts\":%.3f%s%s%s}",
+              (decoder->numOfEvents == 0u) ? "" : ",", name, TRACK_IRQS, ToMicroseconds(decoder, cycles),
+              (type == TRACE_EVENT_MARKER_VALUE) ? ",\"args\":{" : "",
+              (type == TRACE_EVENT_MARKER_VALUE) ? args : "",
+              (type == TRACE_EVENT_MARKER_VALUE) ? "}" : "");
+      decoder->numOfEvents++;
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* Decode the buffer, from the oldest event */
+static void Decode(Decoder_t *decoder, const TRACE_Dump_t *dump)
+{
+  WriteTrackName(decoder, TRACK_IRQS, "IRQs");
+  for (uint32_t i = 0; i < TRACE_NUM_OF_SECTIONS; i++)
+  {
+    WriteTrackName(decoder, TRACK_FIRST_SECTION + (int)i, sectionNames[i]);
+  }
+
+  TRACE_ReadEvents(dump, DecodeEvent, decoder);
+
+  /* Close what is still running at the end of the trace */
+  while (decoder->irqDepth != 0u)
+  {
+    DecodeEvent(decoder, TRACE_EVENT_IRQ_EXIT, decoder->irqStack[decoder->irqDepth - 1u], decoder->lastCycles, 0u);
+  }
+  for (uint32_t i = 0; i < TRACE_NUM_OF_SECTIONS; i++)
+  {
+    while (decoder->sectionDepth[i] != 0u)
+    {
+      DecodeEvent(decoder, TRACE_EVENT_SECTION_EXIT, i, decoder->lastCycles, 0u);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  TRACE_Dump_t dump;
+  Decoder_t    decoder;
+
+  if ((argc < 2) || (argc > 3))
+  {
+    fprintf(stderr, "usage: %s <memory dump> [output.json]\n", argv[0]);
+    return 2;
+  }
+
+  if (TRACE_LoadDump(argv[1], &dump) != 0)
+  {
+    return 1;
+  }
+
+  memset(&decoder, 0, sizeof(decoder));
+  decoder.output               = stdout;
+  decoder.cyclesPerMicrosecond = (double)dump.cyclesPerMicrosecond;
+  /* Without the frequency, timestamps are shown in cycles */
+  if (decoder.cyclesPerMicrosecond == 0.0)
+  {
+    decoder.cyclesPerMicrosecond = 1.0;
+  }
+  if (argc == 3)
+  {
+    decoder.output = fopen(argv[2], "w");
+    if (decoder.output == NULL)
+    {
+      perror(argv[2]);
+      return 1;
+    }
+  }
+
+  fprintf(decoder.output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  Decode(&decoder, &dump);
+  fprintf(decoder.output, "\n]}\n");
+
+  if (decoder.output != stdout)
+  {
+    fclose(decoder.output);
+  }
+  free(dump.data);
+
+  return 0;
+}
@@ -0,0 +1,195 @@
+/* Reader of the trace buffers recorded by trace_recorder.c, shared by the host
+tools (trace_decode.c, rta.c).
+
+TRACE_LoadDump finds the buffer in a memory dump by its header,
+TRACE_ReadEvents calls a function for every event from the oldest one, with
+the full 64-bit cycle count rebuilt from the sync events and the 16-bit
+deltas. Sync events are passed too, so that the caller knows where the time
+starts.
+
+*/
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Keep in sync with trace_recorder.h */
+#define TRACE_MAGIC                0x43525254UL
+#define TRACE_VERSION              1u
+#define TRACE_HEADER_WORDS         5u
+#define TRACE_TYPE_POS             26u
+#define TRACE_PAYLOAD_POS          16u
+#define TRACE_PAYLOAD_MASK         0x3FFu
+#define TRACE_TIMESTAMP_MASK       0xFFFFu
+#define TRACE_SYNC_PAYLOAD         0x3FFu
+/* Keep in sync with trace_recorder.c */
+#define TRACE_SYNC_PERIOD          0x4000UL
+
+#define TRACE_EVENT_SYNC           0u
+#define TRACE_EVENT_IRQ_ENTER      1u
+#define TRACE_EVENT_IRQ_EXIT       2u
+#define TRACE_EVENT_SECTION_ENTER  3u
+#define TRACE_EVENT_SECTION_EXIT   4u
+#define TRACE_EVENT_BASEPRI        5u
+#define TRACE_EVENT_MARKER         6u
+#define TRACE_EVENT_MARKER_VALUE   7u
+
+#define TRACE_SECTION_PRIMASK      0u
+#define TRACE_SECTION_BASEPRI      1u
+#define TRACE_SECTION_NVIC         2u
+#define TRACE_NUM_OF_SECTIONS      3u
+
+/* Called for every event, value is only set for TRACE_EVENT_MARKER_VALUE */
+typedef void (*TRACE_EventFn_t)(void *context, uint32_t type, uint32_t payload, uint64_t cycles,
+                                uint32_t value);
+
+typedef struct
+{
+  uint8_t       *data;
+  const uint8_t *words;
+  uint32_t       numOfWords;
+  uint32_t       writeIndex;
+  uint32_t       cyclesPerMicrosecond;
+} TRACE_Dump_t;
+
+/* Little-endian word of the dump, whatever the host */
+static uint32_t TRACE_ReadWord(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+/* Read a memory dump and find the trace buffer in it, 0 on success */
+static int TRACE_LoadDump(const char *path, TRACE_Dump_t *dump)
+{
+  FILE    *input;
+  long     size;
+  long     offset;
+  uint32_t numOfWords = 0u;
+
+  input = fopen(path, "rb");
+  if (input == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+  fseek(input, 0, SEEK_END);
+  size = ftell(input);
+  fseek(input, 0, SEEK_SET);
+  dump->data = malloc((size_t)size + 1u);
+  if ((dump->data == NULL) || (fread(dump->data, 1, (size_t)size, input) != (size_t)size))
+  {
+    fprintf(stderr, "%s: cannot read the dump\n", path);
+    fclose(input);
+    return -1;
+  }
+  fclose(input);
+
+  /* The header is word aligned, its size must be a power of two that fits */
+  for (offset = 0; (offset + (long)(TRACE_HEADER_WORDS * 4u)) <= size; offset += 4)
+  {
+    numOfWords = TRACE_ReadWord(&dump->data[offset + 8]);
+    if ((TRACE_ReadWord(&dump->data[offset]) == TRACE_MAGIC)
+        && (TRACE_ReadWord(&dump->data[offset + 4]) == TRACE_VERSION)
+        && (numOfWords != 0u) && ((numOfWords & (numOfWords - 1u)) == 0u)
+        && ((offset + (long)((TRACE_HEADER_WORDS + numOfWords) * 4u)) <= size))
+    {
+      break;
+    }
+  }
+  if ((offset + (long)(TRACE_HEADER_WORDS * 4u)) > size)
+  {
+    fprintf(stderr, "%s: no trace buffer found\n", path);
+    free(dump->data);
+    return -1;
+  }
+
+  dump->numOfWords           = numOfWords;
+  dump->cyclesPerMicrosecond = TRACE_ReadWord(&dump->data[offset + 12]);
+  dump->writeIndex           = TRACE_ReadWord(&dump->data[offset + 16]);
+  dump->words                = &dump->data[offset + (long)(TRACE_HEADER_WORDS * 4u)];
+
+  return 0;
+}
+
+/* Call eventFn for the events of the buffer, from the oldest one.
+ * Returns the time of the last event. */
+static uint64_t TRACE_ReadEvents(const TRACE_Dump_t *dump, TRACE_EventFn_t eventFn, void *context)
+{
+  uint32_t mask     = dump->numOfWords - 1u;
+  uint32_t count    = (dump->writeIndex < dump->numOfWords) ? dump->writeIndex : dump->numOfWords;
+  uint32_t index    = dump->writeIndex - count;
+  uint64_t cycles   = 0u;
+  int      isSynced = 0;
+  uint32_t word;
+  uint32_t next;
+  uint32_t type;
+  uint32_t payload;
+  uint32_t delta;
+
+  while (index != dump->writeIndex)
+  {
+    word    = TRACE_ReadWord(&dump->words[(index & mask) * 4u]);
+    next    = TRACE_ReadWord(&dump->words[((index + 1u) & mask) * 4u]);
+    type    = word >> TRACE_TYPE_POS;
+    payload = (word >> TRACE_PAYLOAD_POS) & TRACE_PAYLOAD_MASK;
+
+    if ((type == TRACE_EVENT_SYNC) && (payload == TRACE_SYNC_PAYLOAD) && ((index + 1u) != dump->writeIndex)
+        && ((word & TRACE_TIMESTAMP_MASK) == (next & TRACE_TIMESTAMP_MASK)))
+    {
+      if (!isSynced)
+      {
+        cycles   = next;
+        isSynced = 1;
+      }
+      else
+      {
+        /* A writer preempted before claiming its words steps back by less
+         * than a sync period (see trace_recorder.c), any other difference
+         * is forward: an idle gap can be longer than 2^31 cycles */
+        delta = next - (uint32_t)cycles;
+        if ((0u - delta) <= TRACE_SYNC_PERIOD)
+        {
+          cycles -= (uint64_t)(0u - delta);
+        }
+        else
+        {
+          cycles += delta;
+        }
+      }
+      eventFn(context, TRACE_EVENT_SYNC, payload, cycles, 0u);
+      index += 2u;
+      continue;
+    }
+
+    /* Nothing can be decoded before the first sync event */
+    if (!isSynced)
+    {
+      index++;
+      continue;
+    }
+
+    cycles += (uint64_t)(int64_t)(int16_t)(uint16_t)((word & TRACE_TIMESTAMP_MASK) - ((uint32_t)cycles & TRACE_TIMESTAMP_MASK));
+
+    if (type == TRACE_EVENT_MARKER_VALUE)
+    {
+      if ((index + 1u) == dump->writeIndex)
+      {
+        break;
+      }
+      eventFn(context, type, payload, cycles, next);
+      index += 2u;
+    }
+    else
+    {
+      eventFn(context, type, payload, cycles, 0u);
+      index++;
+    }
+  }
+
+  return cycles;
+}
+
+#endif /* TRACE_READER_H */
@@ -0,0 +1,251 @@
+#include "trace_recorder.h"
+#include "atomic_ops.h"
+#include "irq_instrument.h"
+
+#define TRACE_INDEX_MASK           (TRACE_BUFFER_WORDS - 1u)
+
+/* A sync event is written when the last one is older than this, so that two
+ * consecutive events are always less than 2^15 cycles apart. */
+#define TRACE_SYNC_PERIOD          0x4000UL
+
+#define TRACE_WORD(type, payload, cycles)                              \
+  (((uint32_t)(type) << TRACE_TYPE_POS)                                \
+   | (((uint32_t)(payload) & TRACE_PAYLOAD_MASK) << TRACE_PAYLOAD_POS) \
+   | ((uint32_t)(cycles) & TRACE_TIMESTAMP_MASK))
+
+#if ((TRACE_BUFFER_WORDS & (TRACE_BUFFER_WORDS - 1u)) != 0u)
+#error "TRACE_BUFFER_WORDS must be a power of two"
+#endif
+
+TRACE_Buffer_t traceBuffer;
+
+INTERRUPT_FAST_DATA static volatile bool     isRunning;
+INTERRUPT_FAST_DATA static volatile uint32_t lastSyncCycles;
+/* Word of the last event that may have unblocked an interrupt */
+INTERRUPT_FAST_DATA static volatile uint32_t lastUnblockingWord;
+
+static void TRACE_OnIrqEntry(IRQn_Type irqNum, uint32_t entryCycles);
+static void TRACE_OnIrqExit(IRQn_Type irqNum, uint32_t entryCycles, uint32_t exitCycles);
+
+static const INSTR_Hook_t traceHook = { TRACE_OnIrqEntry, TRACE_OnIrqExit };
+
+/* Notes:
+
+A binary trace of what the interrupt controller does, kept in a circular
+buffer in RAM and decoded on the host by tools/trace_decode.c into the Chrome
+trace JSON format (chrome://tracing, or ui.perfetto.dev which opens the same
+files), to see preemption, masked sections and tail-chaining on a timeline.
+
+Events:
+	- IRQ enter/exit, through a hook of irq_instrument.c (TRACE_EnableIrqTracing,
+	  for the IRQs enabled with INSTR_EnableIRQ);
+	- critical sections enter/exit and BASEPRI changes, recorded by
+	  interrupt_handling.c when it is built with INTERRUPT_ENABLE_TRACE (only the
+	  outermost PRIMASK section, and every BASEPRI write);
+	- user markers, with or without a 32-bit value.
+
+Most events take one word: the type, a 10-bit payload and the low 16 bits of
+the cycle counter. The decoder rebuilds the full time from the difference
+with the previous event, so the timestamps are delta-encoded without having
+to know the previous event when writing. To keep that difference below 2^15
+cycles and to give the decoder a starting point after the buffer wrapped, a
+sync event carrying the full cycle counter is written first whenever the last
+one is TRACE_SYNC_PERIOD cycles old.
+
+Writers claim their words with one ATOMIC_FetchAdd32 on writeIndex and then
+fill them, so any context can record, NMI included on ARMv7-M (on ARMv6-M the
+atomic operation relies on PRIMASK, which does not mask NMI: do not record
+from NMI there). A context preempted between reading the cycle counter and
+claiming its words records a timestamp slightly older than the preempting
+events before it; the decoder accepts such small steps back. A dump taken
+while a writer is preempted between the claim and the fill has a stale word
+at that place.
+
+The last section exit, IRQ exit or BASEPRI change is also kept aside, for
+TRACE_GetLastUnblockingEvent: when an interrupt enters late, it tells what
+was masking or preempting it (see irq_jitter.c).
+
+To get the trace, dump traceBuffer (its size is in the header) or the whole
+RAM: the decoder looks for the header by its magic word, which also works
+for QEMU memory dumps (pmemsave) and "dump binary memory" from GDB.
+
+For example:
+
+TRACE_Init(SystemCoreClock);
+INSTR_Install();
+INSTR_EnableIRQ(USART1_IRQn);
+TRACE_EnableIrqTracing();
+TRACE_Start();
+...
+TRACE_MarkerValue(1u, rxLength);
+
+*/
+
+/* Claim and fill the words of an event, preceded by a sync event if needed */
+__STATIC_FORCEINLINE void TRACE_Write(uint32_t type, uint32_t payload, uint32_t cycles,
+                                      bool hasValue, uint32_t value)
+{
+  uint32_t numOfWords = hasValue ? 2u : 1u;
+  bool     needsSync;
+  uint32_t index;
+
+  if (!isRunning)
+  {
+    return;
+  }
+
+  if ((type == TRACE_EVENT_SECTION_EXIT) || (type == TRACE_EVENT_IRQ_EXIT) || (type == TRACE_EVENT_BASEPRI))
+  {
+    lastUnblockingWord = TRACE_WORD(type, payload, cycles);
+  }
+
+  /* Two contexts may both decide to sync, which only costs two words */
+  needsSync = ((cycles - lastSyncCycles) >= TRACE_SYNC_PERIOD);
+  if (needsSync)
+  {
+    lastSyncCycles = cycles;
+    numOfWords    += 2u;
+  }
+
+  index = ATOMIC_FetchAdd32(&traceBuffer.writeIndex, numOfWords);
+
+  if (needsSync)
+  {
+    traceBuffer.words[index & TRACE_INDEX_MASK]        = TRACE_WORD(TRACE_EVENT_SYNC, TRACE_SYNC_PAYLOAD, cycles);
+    traceBuffer.words[(index + 1u) & TRACE_INDEX_MASK] = cycles;
+    index += 2u;
+  }
+
+  traceBuffer.words[index & TRACE_INDEX_MASK] = TRACE_WORD(type, payload, cycles);
+  if (hasValue)
+  {
+    traceBuffer.words[(index + 1u) & TRACE_INDEX_MASK] = value;
+  }
+}
+
+static void TRACE_OnIrqEntry(IRQn_Type irqNum, uint32_t entryCycles)
+{
+  TRACE_Write(TRACE_EVENT_IRQ_ENTER, (uint32_t)((int32_t)irqNum + 16), entryCycles, false, 0u);
+}
+
+static void TRACE_OnIrqExit(IRQn_Type irqNum, uint32_t entryCycles, uint32_t exitCycles)
+{
+  (void)entryCycles;
+  TRACE_Write(TRACE_EVENT_IRQ_EXIT, (uint32_t)((int32_t)irqNum + 16), exitCycles, false, 0u);
+}
+
+/**
+	\brief      		 Initialize the trace buffer.
+	\details    		 Clear the buffer and fill its header. The trace is stopped.
+	\param [in]      cpuFrequencyHz: Frequency of the cycle counter, used by the decoder to
+									 convert timestamps.
+ */
+void TRACE_Init(uint32_t cpuFrequencyHz)
+{
+  isRunning = false;
+
+  IRQ_EnableCycleCounter();
+
+  traceBuffer.magic                = TRACE_MAGIC;
+  traceBuffer.version              = TRACE_VERSION;
+  traceBuffer.numOfWords           = TRACE_BUFFER_WORDS;
+  traceBuffer.cyclesPerMicrosecond = cpuFrequencyHz / 1000000u;
+  traceBuffer.writeIndex           = 0u;
+  lastUnblockingWord               = 0u;
+
+  for (uint32_t i = 0; i < TRACE_BUFFER_WORDS; i++)
+  {
+    traceBuffer.words[i] = 0u;
+  }
+}
+
+/**
+	\brief      		 Start recording.
+	\details    		 The first event is preceded by a sync event.
+ */
+void TRACE_Start(void)
+{
+  lastSyncCycles = IRQ_GetCycleCount() - TRACE_SYNC_PERIOD;
+  __DMB();
+  isRunning = true;
+}
+
+/**
+	\brief      		 Stop recording.
+	\details    		 The buffer keeps the last TRACE_BUFFER_WORDS words, ready to be dumped.
+ */
+void TRACE_Stop(void)
+{
+  isRunning = false;
+  __DMB();
+}
+
+/**
+	\brief      		 Record IRQ enter and exit events.
+	\details    		 Register a hook in irq_instrument.c: the IRQs enabled with
+									 INSTR_EnableIRQ are traced.
+	\return          true if the hook is registered, false if irq_instrument.c has no room left.
+	\note       		 Call it once.
+ */
+bool TRACE_EnableIrqTracing(void)
+{
+  return INSTR_AddHook(&traceHook);
+}
+
+/**
+	\brief      		 Record an event.
+	\param [in]      event:   Type of the event, not TRACE_EVENT_SYNC or TRACE_EVENT_MARKER_VALUE.
+	\param [in]      payload: Payload of the event (10 bits).
+	\note       		 Can be called from any context, does nothing when the trace is stopped.
+ */
+INTERRUPT_FAST_CODE void TRACE_Record(TRACE_Event_t event, uint32_t payload)
+{
+  TRACE_Write((uint32_t)event, payload, IRQ_GetCycleCount(), false, 0u);
+}
+
+/**
+	\brief      		 Record a user marker.
+	\param [in]      id: Marker id (10 bits), shown as "marker <id>" by the decoder.
+ */
+INTERRUPT_FAST_CODE void TRACE_Marker(uint16_t id)
+{
+  TRACE_Write(TRACE_EVENT_MARKER, id, IRQ_GetCycleCount(), false, 0u);
+}
+
+/**
+	\brief      		 Record a user marker with a value.
+	\param [in]      id:    Marker id (10 bits).
+	\param [in]      value: Value shown with the marker.
+ */
+INTERRUPT_FAST_CODE void TRACE_MarkerValue(uint16_t id, uint32_t value)
+{
+  TRACE_Write(TRACE_EVENT_MARKER_VALUE, id, IRQ_GetCycleCount(), true, value);
+}
+
+/**
+	\brief      		 Get the last event that may have unblocked an interrupt.
+	\details    		 The last section exit, IRQ exit or BASEPRI change recorded.
+	\param [in]      nowCycles:    Current value of the cycle counter.
+	\param [in]      windowCycles: How far back to look, at most 65535 cycles.
+	\param [out]     event:        Type of the event.
+	\param [out]     payload:      Payload of the event.
+	\return          true if such an event was recorded in the last windowCycles cycles.
+	\note       		 Only the low 16 bits of the timestamp are kept: an event older than
+									 65535 cycles can be taken for a recent one.
+ */
+INTERRUPT_FAST_CODE bool TRACE_GetLastUnblockingEvent(uint32_t nowCycles, uint32_t windowCycles,
+                                                      TRACE_Event_t *event, uint32_t *payload)
+{
+  uint32_t word = lastUnblockingWord;
+  uint32_t age  = (nowCycles - word) & TRACE_TIMESTAMP_MASK;
+
+  if ((word == 0u) || (age > windowCycles))
+  {
+    return false;
+  }
+
+  *event   = (TRACE_Event_t)(word >> TRACE_TYPE_POS);
+  *payload = (word >> TRACE_PAYLOAD_POS) & TRACE_PAYLOAD_MASK;
+
+  return true;
+}
@@ -0,0 +1,75 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include "interrupt_handling.h"
+
+/* Size of the circular trace buffer in words, must be a power of two */
+#ifndef TRACE_BUFFER_WORDS
+#define TRACE_BUFFER_WORDS         1024u
+#endif
+
+/* Identifies the buffer in a memory dump, followed by the format version */
+#define TRACE_MAGIC                0x43525254UL
+#define TRACE_VERSION              1u
+
+/* Event word: type (6 bits) | payload (10 bits) | timestamp low half (16 bits) */
+#define TRACE_TYPE_POS             26u
+#define TRACE_PAYLOAD_POS          16u
+#define TRACE_PAYLOAD_MASK         0x3FFu
+#define TRACE_TIMESTAMP_MASK       0xFFFFu
+/* Payload of a sync event, followed by the full timestamp */
+#define TRACE_SYNC_PAYLOAD         0x3FFu
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+  TRACE_EVENT_SYNC          = 0,  /* next word: full timestamp */
+  TRACE_EVENT_IRQ_ENTER     = 1,  /* payload: exception number */
+  TRACE_EVENT_IRQ_EXIT      = 2,  /* payload: exception number */
+  TRACE_EVENT_SECTION_ENTER = 3,  /* payload: TRACE_Section_t */
+  TRACE_EVENT_SECTION_EXIT  = 4,  /* payload: TRACE_Section_t */
+  TRACE_EVENT_BASEPRI       = 5,  /* payload: new BASEPRI value */
+  TRACE_EVENT_MARKER        = 6,  /* payload: marker id */
+  TRACE_EVENT_MARKER_VALUE  = 7   /* payload: marker id, next word: value */
+} TRACE_Event_t;
+
+typedef enum
+{
+  TRACE_SECTION_PRIMASK = 0,
+  TRACE_SECTION_BASEPRI = 1,
+  TRACE_SECTION_NVIC    = 2
+} TRACE_Section_t;
+
+/* Layout read by tools/trace_decode.c, all little-endian words */
+typedef struct
+{
+  uint32_t          magic;
+  uint32_t          version;
+  uint32_t          numOfWords;
+  uint32_t          cyclesPerMicrosecond;
+  /* Free-running: the oldest word is at writeIndex - numOfWords once wrapped */
+  volatile uint32_t writeIndex;
+  uint32_t          words[TRACE_BUFFER_WORDS];
+} TRACE_Buffer_t;
+
+extern TRACE_Buffer_t traceBuffer;
+
+void TRACE_Init(uint32_t cpuFrequencyHz);
+void TRACE_Start(void);
+void TRACE_Stop(void);
+bool TRACE_EnableIrqTracing(void);
+
+INTERRUPT_FAST_CODE void TRACE_Record(TRACE_Event_t event, uint32_t payload);
+INTERRUPT_FAST_CODE void TRACE_Marker(uint16_t id);
+INTERRUPT_FAST_CODE void TRACE_MarkerValue(uint16_t id, uint32_t value);
+INTERRUPT_FAST_CODE bool TRACE_GetLastUnblockingEvent(uint32_t nowCycles, uint32_t windowCycles,
+                                                      TRACE_Event_t *event, uint32_t *payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_RECORDER_H */
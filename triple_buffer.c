@@ -0,0 +1,129 @@
+#include "triple_buffer.h"
+#include "atomic_ops.h"
+#include <string.h>
+
+/* Set in middle when the writer published a buffer the reader has not taken */
+#define TRIPLE_FRESH               0x4u
+#define TRIPLE_INDEX_MASK          0x3u
+
+/* Notes:
+
+For high-rate telemetry where only the latest sample matters, a triple buffer
+replaces NO_INTERRUPTS_SECTION(memcpy(&latest, &sample, sizeof(sample));)
+without any masking, on either side.
+
+Of the three buffers, one is owned by the writer (back), one by the reader
+(front) and one is shared (middle):
+	- the writer fills back, then publishes it by exchanging it with middle
+	  in one atomic operation, and gets the previous middle as its next back;
+	- the reader, when middle is marked fresh, exchanges it with front in
+	  one atomic operation and reads front as long as it wants.
+
+Neither side ever waits for the other: the writer always has a free buffer
+and the reader always has the newest complete one. Samples published while
+the reader does not update are overwritten, which is the point.
+
+There must be a single writer and a single reader (for example an ISR and
+thread mode).
+
+*/
+
+/**
+	\brief      		 Initialize a triple buffer.
+	\param [out]     buffer:  The triple buffer.
+	\param [in]      storage: Storage defined with TRIPLE_DEFINE_STORAGE.
+	\param [in]      size:    Size of a payload in bytes.
+	\note       		 The buffers are cleared, the reader reads zeros until the first publish.
+ */
+void TRIPLE_Init(TRIPLE_Buffer_t *buffer, void *storage, uint32_t size)
+{
+  buffer->buffers = (uint8_t*)storage;
+  buffer->stride  = TRIPLE_STRIDE(size);
+  buffer->back    = 0u;
+  buffer->middle  = 1u;
+  buffer->front   = 2u;
+
+  memset(storage, 0, 3u * buffer->stride);
+}
+
+/**
+	\brief      		 Get the buffer to fill.
+	\param [in]      buffer: The triple buffer.
+	\return          The buffer owned by the writer until the next TRIPLE_Publish.
+	\note       		 Writer side.
+ */
+INTERRUPT_FAST_CODE void *TRIPLE_GetWriteBuffer(TRIPLE_Buffer_t *buffer)
+{
+  return &buffer->buffers[buffer->back * buffer->stride];
+}
+
+/**
+	\brief      		 Publish the filled buffer.
+	\param [in, out] buffer: The triple buffer.
+	\note       		 Writer side.
+ */
+INTERRUPT_FAST_CODE void TRIPLE_Publish(TRIPLE_Buffer_t *buffer)
+{
+  buffer->back = ATOMIC_Exchange32(&buffer->middle, buffer->back | TRIPLE_FRESH)
+                 & TRIPLE_INDEX_MASK;
+}
+
+/**
+	\brief      		 Copy and publish a payload.
+	\param [in, out] buffer: The triple buffer.
+	\param [in]      data:   The payload.
+	\param [in]      size:   Size of the payload in bytes.
+	\note       		 Writer side.
+ */
+INTERRUPT_FAST_CODE void TRIPLE_Write(TRIPLE_Buffer_t *buffer, const void *data, uint32_t size)
+{
+  memcpy(TRIPLE_GetWriteBuffer(buffer), data, size);
+  TRIPLE_Publish(buffer);
+}
+
+/**
+	\brief      		 Take the newest published buffer.
+	\param [in, out] buffer: The triple buffer.
+	\return          true if a new buffer has been taken, false if nothing was published
+									 since the last update (the read buffer is unchanged).
+	\note       		 Reader side.
+ */
+bool TRIPLE_Update(TRIPLE_Buffer_t *buffer)
+{
+  if ((ATOMIC_LoadAcquire32(&buffer->middle) & TRIPLE_FRESH) == 0u)
+  {
+    return false;
+  }
+
+  buffer->front = ATOMIC_Exchange32(&buffer->middle, buffer->front) & TRIPLE_INDEX_MASK;
+
+  return true;
+}
+
+/**
+	\brief      		 Get the buffer to read.
+	\param [in]      buffer: The triple buffer.
+	\return          The buffer owned by the reader until the next TRIPLE_Update.
+	\note       		 Reader side.
+ */
+const void *TRIPLE_GetReadBuffer(const TRIPLE_Buffer_t *buffer)
+{
+  return &buffer->buffers[buffer->front * buffer->stride];
+}
+
+/**
+	\brief      		 Copy the newest payload.
+	\param [in, out] buffer: The triple buffer.
+	\param [out]     data:   Where to copy the payload.
+	\param [in]      size:   Size of the payload in bytes.
+	\return          true if the payload is new since the last read.
+	\note       		 Reader side.
+ */
+bool TRIPLE_Read(TRIPLE_Buffer_t *buffer, void *data, uint32_t size)
+{
+  bool isNew = TRIPLE_Update(buffer);
+
+  memcpy(data, TRIPLE_GetReadBuffer(buffer), size);
+
+  return isNew;
+}
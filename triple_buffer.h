@@ -0,0 +1,96 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include "interrupt_handling.h"
+
+/* Distance between two buffers, keeps each of them 8-byte aligned */
+#define TRIPLE_STRIDE(size)        (((size) + 7u) & ~7u)
+
+/* Storage of a triple buffer of size-byte payloads */
+#define TRIPLE_DEFINE_STORAGE(name, size) \
+  uint64_t name[(3u * TRIPLE_STRIDE(size)) / 8u]
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  uint8_t          *buffers;
+  uint32_t          stride;
+  /* Index of the shared buffer, with TRIPLE_FRESH if the reader has not taken it */
+  volatile uint32_t middle;
+  /* Owned by the writer */
+  uint32_t          back;
+  /* Owned by the reader */
+  uint32_t          front;
+} TRIPLE_Buffer_t;
+
+void        TRIPLE_Init(TRIPLE_Buffer_t *buffer, void *storage, uint32_t size);
+
+INTERRUPT_FAST_CODE void *TRIPLE_GetWriteBuffer(TRIPLE_Buffer_t *buffer);
+INTERRUPT_FAST_CODE void  TRIPLE_Publish(TRIPLE_Buffer_t *buffer);
+INTERRUPT_FAST_CODE void  TRIPLE_Write(TRIPLE_Buffer_t *buffer, const void *data, uint32_t size);
+
+bool        TRIPLE_Update(TRIPLE_Buffer_t *buffer);
+const void *TRIPLE_GetReadBuffer(const TRIPLE_Buffer_t *buffer);
+bool        TRIPLE_Read(TRIPLE_Buffer_t *buffer, void *data, uint32_t size);
+
+#ifdef __cplusplus
+}
+
+#include <type_traits>
+
+/* Typed wrapper: TripleBuffer<Telemetry_t> telemetry; */
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer()
+  {
+    TRIPLE_Init(&buffer, storage, sizeof(T));
+  }
+
+  /* The state points into the object's own storage */
+  TripleBuffer(const TripleBuffer&)            = delete;
+  TripleBuffer &operator=(const TripleBuffer&) = delete;
+
+  /* Writer side */
+  T &WriteBuffer()
+  {
+    return *static_cast<T*>(TRIPLE_GetWriteBuffer(&buffer));
+  }
+
+  void Publish()
+  {
+    TRIPLE_Publish(&buffer);
+  }
+
+  void Write(const T &value)
+  {
+    WriteBuffer() = value;
+    Publish();
+  }
+
+  /* Reader side */
+  bool Update()
+  {
+    return TRIPLE_Update(&buffer);
+  }
+
+  const T &ReadBuffer() const
+  {
+    return *static_cast<const T*>(TRIPLE_GetReadBuffer(&buffer));
+  }
+
+private:
+  static_assert(alignof(T) <= 8u, "TripleBuffer payloads are 8-byte aligned");
+  /* Payloads live in raw storage, copied without constructors */
+  static_assert(std::is_trivially_copyable<T>::value, "TripleBuffer payloads must be trivially copyable");
+
+  TRIPLE_Buffer_t buffer;
+  uint64_t        storage[(3u * TRIPLE_STRIDE(sizeof(T))) / 8u];
+};
+#endif
+
+#endif /* TRIPLE_BUFFER_H */